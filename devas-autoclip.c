@@ -0,0 +1,406 @@
+/*
+ * Clipping of extremely bright (glare source) pixels, which otherwise
+ * cause ringing in devas_filter ( ).
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include "devas-autoclip.h"
+#include "devas-image.h"
+#include "devas-select.h"
+#include "devas-license.h"	/* DeVAS open source license */
+
+#define	AUTO_CLIP_MEDIAN		/* based auto_clip value on median, */
+					/* not average */
+#define	CUTOFF_RATIO_MEAN	7.0	/* RADIANCE identifies glare sources */
+					/* as being brighter than 7 times the */
+					/* average luminance level. */
+#define	CUTOFF_RATIO_MEDIAN	12.0	/* need higher value for median */
+
+#ifndef	AUTO_CLIP_MEDIAN
+static double	auto_clip_level ( DeVAS_xyY_image *image,
+		    DeVAS_luminance_stats *stats );
+#else
+static double	auto_clip_level_median ( DeVAS_xyY_image *image,
+		    DeVAS_luminance_stats *stats );
+#endif	/* AUTO_CLIP_MEDIAN */
+static int	luminance_bin ( float luminance );
+
+double
+DeVAS_auto_clip_level ( DeVAS_xyY_image *image )
+/*
+ * Suggests a clip level to apply to extreamly bright pixels to reduce
+ * filter ringing.  DeVAS_NO_CLIP_LEVEL (< 0.0) is returned if no clipping
+ * is needed.
+ */
+{
+    DeVAS_luminance_stats   *stats;
+    double		    clip_level;
+
+    stats = DeVAS_luminance_stats_new ( );
+    DeVAS_luminance_stats_image ( stats, image );
+
+    clip_level = DeVAS_auto_clip_level_stats ( image, stats );
+
+    DeVAS_luminance_stats_delete ( stats );
+
+    return ( clip_level );
+}
+
+double
+DeVAS_auto_clip_level_stats ( DeVAS_xyY_image *image,
+	DeVAS_luminance_stats *stats )
+/*
+ * Same as DeVAS_auto_clip_level ( ), using luminance statistics already
+ * accumulated over all of image.
+ */
+{
+    if ( stats -> n_values != ( DeVAS_image_n_rows ( image ) *
+		DeVAS_image_n_cols ( image ) ) ) {
+	fprintf ( stderr,
+		"DeVAS_auto_clip_level_stats: statistics don't match image!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+#ifndef	AUTO_CLIP_MEDIAN
+    return ( auto_clip_level ( image, stats ) );
+#else
+    return ( auto_clip_level_median ( image, stats ) );
+#endif	/* AUTO_CLIP_MEDIAN */
+}
+
+DeVAS_luminance_stats *
+DeVAS_luminance_stats_new ( void )
+/*
+ * Returns empty statistics.
+ */
+{
+    DeVAS_luminance_stats   *stats;
+
+    stats = (DeVAS_luminance_stats *) malloc
+	( sizeof ( DeVAS_luminance_stats ) );
+    if ( stats == NULL ) {
+	fprintf ( stderr, "DeVAS_luminance_stats_new: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    stats -> histogram = (unsigned int *) calloc
+	( DeVAS_LUMINANCE_HISTOGRAM_BINS, sizeof ( unsigned int ) );
+    if ( stats -> histogram == NULL ) {
+	fprintf ( stderr, "DeVAS_luminance_stats_new: calloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    stats -> max = 0.0;
+    stats -> sum = 0.0;
+    stats -> n_values = 0;
+
+    return ( stats );
+}
+
+void
+DeVAS_luminance_stats_delete ( DeVAS_luminance_stats *stats )
+{
+    free ( stats -> histogram );
+    free ( stats );
+}
+
+void
+DeVAS_luminance_stats_add ( DeVAS_luminance_stats *stats, DeVAS_xyY *pixels,
+	int n_pixels )
+/*
+ * Add n_pixels consecutive pixels (normally a row) to stats.
+ */
+{
+    int	    i;
+    double  max;
+    double  sum;
+
+    max = stats -> max;
+    sum = 0.0;
+
+    for ( i = 0; i < n_pixels; i++ ) {
+	if ( pixels[i] . Y > max ) {
+	    max = pixels[i] . Y;
+	}
+	sum += pixels[i] . Y;
+	stats -> histogram[luminance_bin ( pixels[i] . Y )]++;
+    }
+
+    stats -> max = max;
+    stats -> sum += sum;
+    stats -> n_values += n_pixels;
+}
+
+void
+DeVAS_luminance_stats_merge ( DeVAS_luminance_stats *stats,
+	DeVAS_luminance_stats *partial_stats )
+/*
+ * Add partial_stats (for different pixels) to stats.
+ */
+{
+    int	    bin;
+
+    stats -> max = fmax ( stats -> max, partial_stats -> max );
+    stats -> sum += partial_stats -> sum;
+    stats -> n_values += partial_stats -> n_values;
+
+    for ( bin = 0; bin < DeVAS_LUMINANCE_HISTOGRAM_BINS; bin++ ) {
+	stats -> histogram[bin] += partial_stats -> histogram[bin];
+    }
+}
+
+void
+DeVAS_luminance_stats_image ( DeVAS_luminance_stats *stats,
+	DeVAS_xyY_image *image )
+/*
+ * Add all of image to stats, row parallel.
+ */
+{
+    DeVAS_luminance_stats   *partial_stats;
+    int			    row;
+
+#pragma omp parallel private ( partial_stats )
+    {
+	partial_stats = DeVAS_luminance_stats_new ( );
+
+#pragma omp for
+	for ( row = 0; row < DeVAS_image_n_rows ( image ); row++ ) {
+	    DeVAS_luminance_stats_add ( partial_stats,
+		    &DeVAS_image_data ( image, row, 0 ),
+		    DeVAS_image_n_cols ( image ) );
+	}
+
+#pragma omp critical ( devas_luminance_stats )
+	DeVAS_luminance_stats_merge ( stats, partial_stats );
+
+	DeVAS_luminance_stats_delete ( partial_stats );
+    }
+}
+
+#ifndef AUTO_CLIP_MEDIAN
+static double
+auto_clip_level ( DeVAS_xyY_image *image, DeVAS_luminance_stats *stats )
+/*
+ * Suggests a clip level to apply to extreamly bright pixels to reduce
+ * filter ringing.
+ *
+ * Uses a variant of the RADIANCE glare identification heuristic.  First,
+ * average luminance is computed and used to set a preliminary glare
+ * threshold value.  This average is not a robust estimator, since it is
+ * strongly affected by very bright glare pixels or glare pixels covering
+ * a large portion of the image.  To compensate for this, a second pass
+ * is done in which a revised average luminance is computed based only on
+ * pixels <= the preliminary glare threshold.  This revised average luminance
+ * is then used to compute a revised glare threshold, which is returned as
+ * the value of the function.  The first pass is taken from stats.
+ *
+ * DeVAS_NO_CLIP_LEVEL is returned if no clipping is needed.
+ */
+{
+    int		    row, col;
+    double	    max_luminance;
+    double	    average_luminance_initial;
+    double	    average_luminance_revised;
+    double	    cutoff_initial;
+    double	    cutoff_revised;
+    unsigned int    glare_count;
+
+    /* first pass */
+
+    max_luminance = stats -> max;
+    average_luminance_initial = stats -> sum / ( (double) stats -> n_values );
+    cutoff_initial = CUTOFF_RATIO_MEAN * average_luminance_initial;
+
+    if ( cutoff_initial >= max_luminance ) {
+	/* no need for glare source clipping */
+	return ( DeVAS_NO_CLIP_LEVEL );
+    }
+
+    /* second pass */
+
+    average_luminance_revised = 0.0;
+    glare_count = 0;
+
+    for ( row = 0; row < DeVAS_image_n_rows ( image ); row++ ) {
+	for ( col = 0; col < DeVAS_image_n_cols ( image ); col++ ) {
+	    if ( DeVAS_image_data ( image, row, col ) . Y >
+		    cutoff_initial ) {
+		glare_count++;
+	    } else {
+		average_luminance_revised +=
+		    DeVAS_image_data (image, row, col) . Y;
+	    }
+	}
+    }
+
+    average_luminance_revised /=
+	( ( ((double) DeVAS_image_n_rows ( image ) ) *
+	    ((double) DeVAS_image_n_cols ( image ) ) ) -
+	  ( (double) glare_count ) );
+    cutoff_revised = CUTOFF_RATIO_MEAN * average_luminance_revised;
+
+    /* printf ( "clip_level = %f\n", cutoff_revised ); */
+
+    return ( cutoff_revised );
+}
+
+#else
+
+static double
+auto_clip_level_median ( DeVAS_xyY_image *image, DeVAS_luminance_stats *stats )
+/*
+ * Suggests a clip level to apply to extreamly bright pixels to reduce
+ * filter ringing.
+ *
+ * Uses a variant of the RADIANCE glare identification heuristic based on
+ * a multiple of the median luminance.  The median is computed exactly:
+ * the histogram in stats gives the bin holding the median and its rank
+ * within the bin, and a linear time selection is done over just the
+ * values in that bin.
+ *
+ * As in earlier versions, the median is of the interior pixels only, so
+ * the one pixel border is removed from the (whole image) histogram.
+ * Images too small to have an interior use all pixels.
+ *
+ * DeVAS_NO_CLIP_LEVEL is returned if no clipping is needed.
+ */
+{
+    int		    row, col;
+    int		    n_rows, n_cols;
+    int		    border;	/* 1 if median is of interior pixels */
+    unsigned int    *histogram;
+    float	    *luminance;
+    int		    n_values;
+    int		    k;		/* rank of median */
+    int		    median_bin;
+    int		    n_below;	/* values in bins below median_bin */
+    double	    max_luminance;
+    double	    median;
+    double	    cutoff;
+
+    n_rows = DeVAS_image_n_rows ( image );
+    n_cols = DeVAS_image_n_cols ( image );
+
+    max_luminance = stats -> max;
+
+    if ( max_luminance <= 0.0 ) {
+	fprintf ( stderr, "auto_clip_median: no non-zero luminance!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    histogram = (unsigned int *) malloc ( sizeof ( unsigned int ) *
+	    DeVAS_LUMINANCE_HISTOGRAM_BINS );
+    if ( histogram == NULL ) {
+	fprintf ( stderr, "auto_clip_median: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+    memcpy ( histogram, stats -> histogram,
+	    sizeof ( unsigned int ) * DeVAS_LUMINANCE_HISTOGRAM_BINS );
+    n_values = stats -> n_values;
+
+    border = ( ( n_rows > 2 ) && ( n_cols > 2 ) ) ? 1 : 0;
+    if ( border ) {
+	for ( col = 0; col < n_cols; col++ ) {
+	    histogram[luminance_bin ( DeVAS_image_data ( image, 0, col ) . Y )]--;
+	    histogram[luminance_bin
+		( DeVAS_image_data ( image, n_rows - 1, col ) . Y )]--;
+	}
+	for ( row = 1; row < n_rows - 1; row++ ) {
+	    histogram[luminance_bin ( DeVAS_image_data ( image, row, 0 ) . Y )]--;
+	    histogram[luminance_bin
+		( DeVAS_image_data ( image, row, n_cols - 1 ) . Y )]--;
+	}
+	n_values = ( n_rows - 2 ) * ( n_cols - 2 );
+    }
+
+    /* same rank as DeVAS_float_percentile ( luminance, n, 0.5 ) */
+    k = (int) rint ( 0.5 * ( (double) ( n_values - 1 ) ) );
+
+    n_below = 0;
+    for ( median_bin = 0; ( n_below + histogram[median_bin] ) <=
+	    (unsigned int) k; median_bin++ ) {
+	n_below += histogram[median_bin];
+    }
+
+    luminance = (float *) malloc ( sizeof ( float ) *
+	    histogram[median_bin] );
+    if ( luminance == NULL ) {
+	fprintf ( stderr, "auto_clip_median: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    n_values = 0;
+
+    for ( row = border; row < n_rows - border; row++ ) {
+	for ( col = border; col < n_cols - border; col++ ) {
+	    if ( luminance_bin ( DeVAS_image_data ( image, row, col ) . Y ) ==
+		    median_bin ) {
+		luminance[n_values++] = DeVAS_image_data ( image, row, col ) . Y;
+	    }
+	}
+    }
+
+    median = DeVAS_float_select ( luminance, n_values, k - n_below );
+
+    free ( luminance );
+    free ( histogram );
+
+    cutoff = CUTOFF_RATIO_MEDIAN * median;
+
+    /* printf ( "median = %f, maximum = %f", median, max_luminance ); */
+
+    if ( cutoff >= max_luminance ) {
+	/* printf ( ", no clipping\n" ); */
+	return ( DeVAS_NO_CLIP_LEVEL );
+    } else {
+	/* printf ( ", clip level = %f\n", cutoff ); */
+	return ( cutoff );
+    }
+}
+
+#endif	/* AUTO_CLIP_MEDIAN */
+
+static int
+luminance_bin ( float luminance )
+/*
+ * Histogram bin for luminance.  For positive floats, the bit pattern read
+ * as an unsigned integer increases with the value.
+ */
+{
+    unsigned int    bits;
+
+    if ( ! ( luminance > 0.0 ) ) {
+	return ( 0 );
+    }
+
+    memcpy ( &bits, &luminance, sizeof ( bits ) );
+
+    return ( (int) ( bits >> 16 ) );
+}
+
+void
+DeVAS_clip_max_value ( DeVAS_xyY_image *image, double clip_value )
+/*
+ * In-pace clipping of xyY image object luminance (Y) values.
+ */
+{
+    int	    row, col;
+
+#pragma omp parallel for private ( col )
+    for ( row = 0; row < DeVAS_image_n_rows ( image ); row++ ) {
+	for ( col = 0; col < DeVAS_image_n_cols ( image ); col++ ) {
+	    if ( DeVAS_image_data ( image, row, col ) . Y > clip_value ) {
+		DeVAS_image_data ( image, row, col ) . Y = clip_value;
+	    }
+	}
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ * Clipping of extremely bright (glare source) pixels.
+ */
+
+#ifndef __DeVAS_AUTOCLIP_H
+#define __DeVAS_AUTOCLIP_H
+
+#include "devas-image.h"
+
+#define	DeVAS_NO_CLIP_LEVEL	-1.0	/* don't clip values */
+
+/*
+ * Luminance statistics used to pick a clip level, accumulated a row at a
+ * time (for example, by DeVAS_xyY_image_from_radfile_stats ( ) while
+ * decoding) so that no separate pass over the image is needed.  Partial
+ * statistics for different rows can be merged.
+ *
+ * The histogram is indexed by the high 16 bits of the IEEE float
+ * representation of luminance, which orders non-negative values, so it
+ * can be used to find the bin holding any order statistic.  Values <= 0
+ * are counted in bin 0.
+ */
+
+#define	DeVAS_LUMINANCE_HISTOGRAM_BINS	32768
+
+typedef struct {
+    double	    max;
+    double	    sum;
+    int		    n_values;
+    unsigned int    *histogram;
+} DeVAS_luminance_stats;
+
+/* function prototypes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+double		    DeVAS_auto_clip_level ( DeVAS_xyY_image *image );
+double		    DeVAS_auto_clip_level_stats ( DeVAS_xyY_image *image,
+			DeVAS_luminance_stats *stats );
+DeVAS_luminance_stats	*DeVAS_luminance_stats_new ( void );
+void		    DeVAS_luminance_stats_delete
+			( DeVAS_luminance_stats *stats );
+void		    DeVAS_luminance_stats_add ( DeVAS_luminance_stats *stats,
+			DeVAS_xyY *pixels, int n_pixels );
+void		    DeVAS_luminance_stats_merge
+			( DeVAS_luminance_stats *stats,
+			  DeVAS_luminance_stats *partial_stats );
+void		    DeVAS_luminance_stats_image
+			( DeVAS_luminance_stats *stats,
+			  DeVAS_xyY_image *image );
+void		    DeVAS_clip_max_value ( DeVAS_xyY_image *image,
+			double clip_value );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DeVAS_AUTOCLIP_H */
@@ -0,0 +1,1004 @@
+/*
+ * Time the stages of the devas-filter and devas-visibility pipelines on a
+ * synthetic scene, so that the effect of a change can be measured without
+ * a real rendering, and write the results as JSON so that they can be
+ * compared across versions.
+ *
+ * The scene is a room with a window on the far wall (a glare source, so
+ * that autoclip has something to do), a patterned floor, a low step, a
+ * crate, and a column.  Luminance, chromaticity, and the xyz, dist, and nor
+ * geometry are computed by casting one ray per pixel, so luminance and
+ * geometry boundaries are consistent.  The input image is written to and
+ * timed reading back from a Radiance file.  Geometry is passed directly,
+ * since there is no writer for the ASCII geometry format.
+ *
+ * Options:
+ *
+ *   --size=<n>K|<cols>x<rows>
+ *		Image size.  <n>K is n x 1024 columns by n x 768 rows.
+ *		Default 1K.
+ *
+ *   --margin=<value>
+ *		As for devas-filter.  Default 0.
+ *
+ *   --fft-padding
+ *		As for devas-filter.
+ *
+ *   --chroma-resolution=full|reduced
+ *		As for devas-filter.  Default full.
+ *
+ *   --table-cache=<directory>
+ *		As for devas-filter.  Tables are computed and stored on the
+ *		first run, if not already in <directory>, and mapped from the
+ *		cache on later runs.
+ *
+ *   --no-view	Write the input image without a VIEW record.  The view is
+ *		still needed for filtering, so it is restored after the
+ *		image is read.
+ *
+ *   --acuity=<value>
+ *		Decimal Snellen acuity.  Default 0.2 (20/100).
+ *
+ *   --contrast=<value>
+ *		Contrast sensitivity ratio.  Default 0.2.
+ *
+ *   --repeat=<n>
+ *		Number of times to run the pipeline.  Default 3.
+ *
+ *   --tmpdir=<directory>
+ *		Where to put the image files that are written and read.
+ *		Default $TMPDIR, or /tmp.
+ *
+ *   --write-scene=<directory>
+ *		Write the synthetic scene to input.hdr, coordinates.txt,
+ *		xyz.txt, dist.txt, and nor.txt in <directory> (which must
+ *		exist), for use as devas-filter and devas-visibility input,
+ *		and exit without timing anything.  Used by the regression
+ *		tests (see tests/CMakeLists.txt).
+ *
+ *   output.json
+ *		Where to write results.  Default standard output.
+ *
+ * For each stage, the JSON output gives the number of times the stage ran
+ * in a pipeline run and the mean and minimum over runs of the time spent
+ * in it.  Stages inside devas_filter ( ) and devas_visibility ( ) are
+ * recorded by those routines (see devas-timing.h).  The first run
+ * includes FFTW planning.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif	/* _OPENMP */
+#include "devas-image.h"
+#include "devas-filter.h"
+#include "devas-filter-version.h"
+#include "devas-autoclip.h"
+#include "devas-margin.h"
+#include "devas-gblur-iir.h"
+#include "devas-gblur-fft.h"	/* STD_DEV_MIN */
+#include "devas-timing.h"
+#include "devas-table-cache.h"
+#include "devas-visibility.h"
+#include "visualize-hazards.h"
+#include "read-geometry.h"
+#include "radianceIO.h"
+#include "devas-png.h"
+#include "devas-utils.h"
+#include "dilate.h"
+#include "ChungLeggeCSF.h"
+#include "devas-license.h"	/* DeVAS open source license */
+
+#define	BENCH_SIZE_COLS		1024	/* per K of --size=<n>K */
+#define	BENCH_SIZE_ROWS		768
+#define	BENCH_HORIZONTAL_FOV	60.0	/* degrees */
+#define	BENCH_MAX_STAGES	DeVAS_TIMING_MAX_STAGES
+
+/* same as devas-visibility */
+#define	POSITION_PATCH_SIZE		3
+#define	ORIENTATION_PATCH_SIZE		3
+#define	POSITION_THRESHOLD		2 /* cm */
+#define	ORIENTATION_THRESHOLD		20 /* degrees */
+#define	LOW_LUMINANCE_LEVEL		1.0	/* in cd/m^2 */
+#define	LOW_LUMINANCE_SIGMA		0.2	/* in degrees of visual angle */
+#define	SMOOTHING_FLAG			TRUE
+#define	SATURATION			0.75
+
+/* scene, in centimeters; the viewpoint is at the origin, looking along +y */
+#define	ROOM_HALF_WIDTH		300.0
+#define	ROOM_FLOOR		-150.0
+#define	ROOM_CEILING		150.0
+#define	ROOM_DEPTH		1000.0
+#define	FLOOR_TILE		60.0
+#define	AMBIENT_ILLUMINANCE	40.0	/* lux */
+#define	LIGHT_INTENSITY		2500.0	/* cd */
+#define	WINDOW_LUMINANCE	8000.0	/* cd/m^2 */
+
+typedef struct {
+    double  min[3];
+    double  max[3];
+    double  reflectance;
+    double  x, y;		/* chromaticity */
+} Bench_box;
+
+static Bench_box    bench_boxes[] = {
+    { { -120.0, 300.0, ROOM_FLOOR }, { 120.0, 400.0, -130.0 },
+	0.32, 0.345, 0.355 },					/* step */
+    { { 150.0, 500.0, ROOM_FLOOR }, { 260.0, 620.0, -60.0 },
+	0.45, 0.400, 0.380 },					/* crate */
+    { { -250.0, 600.0, ROOM_FLOOR }, { -200.0, 650.0, ROOM_CEILING },
+	0.70, 0.313, 0.329 }					/* column */
+};
+#define	N_BENCH_BOXES	( (int) ( sizeof ( bench_boxes ) / sizeof ( Bench_box ) ) )
+
+static double	light_position[3] = { 0.0, 500.0, 140.0 };
+
+typedef struct {
+    char    name[DeVAS_TIMING_NAME_MAX];
+    int	    count;		/* per run */
+    double  total;		/* seconds, summed over runs */
+    double  min;		/* seconds, best run */
+    int	    n_runs;		/* runs in which stage appeared */
+} Bench_stage;
+
+static Bench_stage  bench_stages[BENCH_MAX_STAGES];
+static int	    bench_n_stages = 0;
+
+static void	    synthesize_scene ( int n_rows, int n_cols,
+			DeVAS_xyY_image **image_p,
+			DeVAS_coordinates **coordinates_p,
+			DeVAS_XYZ_image **xyz_p, DeVAS_float_image **dist_p,
+			DeVAS_XYZ_image **nor_p );
+static void	    write_scene ( char *directory, DeVAS_xyY_image *image,
+			DeVAS_XYZ_image *xyz, DeVAS_float_image *dist,
+			DeVAS_XYZ_image *nor );
+static void	    write_geometry ( char *file_name, DeVAS_XYZ_image *geom3d,
+			DeVAS_float_image *geom1d );
+static void	    cast_ray ( FVECT origin, FVECT direction,
+			DeVAS_xyY *xyY, DeVAS_XYZ *xyz, float *dist,
+			DeVAS_XYZ *nor );
+static double	    run_pipeline ( char *input_file_name,
+			char *output_file_name, char *hazards_file_name,
+			VIEW view, double margin, int fft_padding,
+			double acuity, double contrast,
+			DeVAS_coordinates *coordinates, DeVAS_XYZ_image *xyz,
+			DeVAS_float_image *dist, DeVAS_XYZ_image *nor );
+static void	    collect_stages ( void );
+static void	    write_results ( FILE *output, int n_rows, int n_cols,
+			int view_record, double margin, int fft_padding,
+			DeVAS_chroma_resolution chroma_resolution,
+			char *table_cache, double acuity, double contrast, int repeat,
+			double total, double total_min );
+static void	    print_usage ( void );
+
+char	*Usage = "devas-bench [--size=<n>K|<cols>x<rows>] [--margin=<value>]"
+    "\n\t[--fft-padding] [--chroma-resolution=full|reduced] [--no-view]"
+    "\n\t[--table-cache=<directory>] [--acuity=<value>] [--contrast=<value>]"
+    "\n\t[--repeat=<n>] [--tmpdir=<directory>] [--write-scene=<directory>]"
+    "\n\t[output.json]";
+
+int
+main ( int argc, char *argv[] )
+{
+    int			n_rows = BENCH_SIZE_ROWS;
+    int			n_cols = BENCH_SIZE_COLS;
+    double		margin = 0.0;
+    int			fft_padding = FALSE;
+    DeVAS_chroma_resolution	chroma_resolution = DeVAS_CHROMA_FULL;
+    char		*chroma_resolution_name;
+    char		*table_cache = NULL;
+    int			view_record = TRUE;
+    double		acuity = 0.2;
+    double		contrast = 0.2;
+    int			repeat = 3;
+    char		*tmpdir;
+    char		*scene_directory = NULL;
+    char		*size;
+    char		*output_file_name = NULL;
+    FILE		*output;
+    char		*input_file_name;
+    char		*filtered_file_name;
+    char		*hazards_file_name;
+    size_t		name_length;
+    DeVAS_xyY_image	*image;
+    DeVAS_coordinates	*coordinates;
+    DeVAS_XYZ_image	*xyz;
+    DeVAS_float_image	*dist;
+    DeVAS_XYZ_image	*nor;
+    VIEW		view;
+    double		run_time;
+    double		total, total_min;
+    int			run;
+    int			argpt = 1;
+
+    tmpdir = getenv ( "TMPDIR" );
+    if ( tmpdir == NULL ) {
+	tmpdir = "/tmp";
+    }
+
+    /* scan and collect option flags */
+    while ( ( ( argc - argpt ) >= 1 ) && ( argv[argpt][0] == '-' ) ) {
+	if ( strncasecmp ( argv[argpt], "--size=", strlen ( "--size=" ) )
+		== 0 ) {
+	    size = argv[argpt] + strlen ( "--size=" );
+	    if ( ( strlen ( size ) >= 2 ) &&
+		    ( ( size[strlen ( size ) - 1] == 'K' ) ||
+		      ( size[strlen ( size ) - 1] == 'k' ) ) ) {
+		n_cols = atoi ( size ) * BENCH_SIZE_COLS;
+		n_rows = atoi ( size ) * BENCH_SIZE_ROWS;
+	    } else if ( sscanf ( size, "%dx%d", &n_cols, &n_rows ) != 2 ) {
+		n_cols = n_rows = 0;
+	    }
+	    if ( ( n_rows < 16 ) || ( n_cols < 16 ) ) {
+		fprintf ( stderr, "devas-bench: invalid size (%s)!\n", size );
+		print_usage ( );
+		return ( EXIT_FAILURE );	/* error return */
+	    }
+	    argpt++;
+
+	} else if ( strncasecmp ( argv[argpt], "--margin=",
+		    strlen ( "--margin=" ) ) == 0 ) {
+	    margin = atof ( argv[argpt] + strlen ( "--margin=" ) );
+	    if ( margin < 0.0 ) {
+		fprintf ( stderr, "devas-bench: invalid margin (%s)!\n",
+			argv[argpt] );
+		return ( EXIT_FAILURE );	/* error return */
+	    }
+	    argpt++;
+
+	} else if ( strcasecmp ( argv[argpt], "--fft-padding" ) == 0 ) {
+	    fft_padding = TRUE;
+	    argpt++;
+
+	} else if ( strncasecmp ( argv[argpt], "--chroma-resolution=",
+		    strlen ( "--chroma-resolution=" ) ) == 0 ) {
+	    chroma_resolution_name = argv[argpt] +
+		strlen ( "--chroma-resolution=" );
+	    if ( strcasecmp ( chroma_resolution_name, "full" ) == 0 ) {
+		chroma_resolution = DeVAS_CHROMA_FULL;
+	    } else if ( strcasecmp ( chroma_resolution_name, "reduced" ) == 0 ) {
+		chroma_resolution = DeVAS_CHROMA_REDUCED;
+	    } else {
+		fprintf ( stderr, "devas-bench: invalid chroma resolution (%s)!\n",
+			argv[argpt] );
+		return ( EXIT_FAILURE );	/* error return */
+	    }
+	    argpt++;
+
+	} else if ( strncasecmp ( argv[argpt], "--table-cache=",
+		    strlen ( "--table-cache=" ) ) == 0 ) {
+	    table_cache = argv[argpt] + strlen ( "--table-cache=" );
+	    argpt++;
+
+	} else if ( strcasecmp ( argv[argpt], "--no-view" ) == 0 ) {
+	    view_record = FALSE;
+	    argpt++;
+
+	} else if ( strncasecmp ( argv[argpt], "--acuity=",
+		    strlen ( "--acuity=" ) ) == 0 ) {
+	    acuity = atof ( argv[argpt] + strlen ( "--acuity=" ) );
+	    argpt++;
+
+	} else if ( strncasecmp ( argv[argpt], "--contrast=",
+		    strlen ( "--contrast=" ) ) == 0 ) {
+	    contrast = atof ( argv[argpt] + strlen ( "--contrast=" ) );
+	    argpt++;
+
+	} else if ( strncasecmp ( argv[argpt], "--repeat=",
+		    strlen ( "--repeat=" ) ) == 0 ) {
+	    repeat = atoi ( argv[argpt] + strlen ( "--repeat=" ) );
+	    if ( repeat < 1 ) {
+		fprintf ( stderr, "devas-bench: invalid repeat (%s)!\n",
+			argv[argpt] );
+		return ( EXIT_FAILURE );	/* error return */
+	    }
+	    argpt++;
+
+	} else if ( strncasecmp ( argv[argpt], "--tmpdir=",
+		    strlen ( "--tmpdir=" ) ) == 0 ) {
+	    tmpdir = argv[argpt] + strlen ( "--tmpdir=" );
+	    argpt++;
+
+	} else if ( strncasecmp ( argv[argpt], "--write-scene=",
+		    strlen ( "--write-scene=" ) ) == 0 ) {
+	    scene_directory = argv[argpt] + strlen ( "--write-scene=" );
+	    argpt++;
+
+	} else {
+	    fprintf ( stderr, "devas-bench: invalid flag (%s)!\n",
+		    argv[argpt] );
+	    print_usage ( );
+	    return ( EXIT_FAILURE );	/* error return */
+	}
+    }
+
+    if ( ( argc - argpt ) > 1 ) {
+	print_usage ( );
+	return ( EXIT_FAILURE );	/* error return */
+    }
+    if ( ( argc - argpt ) == 1 ) {
+	output_file_name = argv[argpt];
+    }
+
+    /* names of files written and read by the pipeline */
+    name_length = strlen ( tmpdir ) + 64;
+    input_file_name = (char *) malloc ( name_length );
+    filtered_file_name = (char *) malloc ( name_length );
+    hazards_file_name = (char *) malloc ( name_length );
+    if ( ( input_file_name == NULL ) || ( filtered_file_name == NULL ) ||
+	    ( hazards_file_name == NULL ) ) {
+	fprintf ( stderr, "devas-bench: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+    snprintf ( input_file_name, name_length, "%s/devas-bench-%d-input.hdr",
+	    tmpdir, (int) getpid ( ) );
+    snprintf ( filtered_file_name, name_length,
+	    "%s/devas-bench-%d-filtered.hdr", tmpdir, (int) getpid ( ) );
+    snprintf ( hazards_file_name, name_length,
+	    "%s/devas-bench-%d-hazards.png", tmpdir, (int) getpid ( ) );
+
+    synthesize_scene ( n_rows, n_cols, &image, &coordinates, &xyz, &dist,
+	    &nor );
+
+    if ( scene_directory != NULL ) {
+	write_scene ( scene_directory, image, xyz, dist, nor );
+
+	free ( input_file_name );
+	free ( filtered_file_name );
+	free ( hazards_file_name );
+	DeVAS_xyY_image_delete ( image );
+	DeVAS_coordinates_delete ( coordinates );
+	DeVAS_XYZ_image_delete ( xyz );
+	DeVAS_float_image_delete ( dist );
+	DeVAS_XYZ_image_delete ( nor );
+
+	return ( EXIT_SUCCESS );	/* nothing timed */
+    }
+
+    view = DeVAS_image_view ( image );
+    if ( ! view_record ) {
+	DeVAS_image_view ( image ) . type = 0;	/* not written */
+    }
+    DeVAS_xyY_image_to_radfilename ( input_file_name, image );
+    DeVAS_xyY_image_delete ( image );
+
+    devas_filter_set_chroma_resolution ( chroma_resolution );
+    DeVAS_table_cache_set_directory ( table_cache );
+    DeVAS_timing_enable ( TRUE );
+
+    total = 0.0;
+    total_min = 0.0;
+    for ( run = 0; run < repeat; run++ ) {
+	DeVAS_timing_reset ( );
+
+	run_time = run_pipeline ( input_file_name, filtered_file_name,
+		hazards_file_name, view, margin, fft_padding, acuity, contrast,
+		coordinates, xyz, dist, nor );
+
+	collect_stages ( );
+
+	total += run_time;
+	if ( ( run == 0 ) || ( run_time < total_min ) ) {
+	    total_min = run_time;
+	}
+    }
+
+    if ( output_file_name == NULL ) {
+	output = stdout;
+    } else {
+	output = fopen ( output_file_name, "w" );
+	if ( output == NULL ) {
+	    perror ( output_file_name );
+	    return ( EXIT_FAILURE );	/* error return */
+	}
+    }
+
+    write_results ( output, n_rows, n_cols, view_record, margin, fft_padding,
+	    chroma_resolution, table_cache, acuity, contrast, repeat, total,
+	    total_min );
+
+    if ( output != stdout ) {
+	fclose ( output );
+    }
+
+    /* clean up */
+    remove ( input_file_name );
+    remove ( filtered_file_name );
+    remove ( hazards_file_name );
+    free ( input_file_name );
+    free ( filtered_file_name );
+    free ( hazards_file_name );
+    DeVAS_coordinates_delete ( coordinates );
+    DeVAS_XYZ_image_delete ( xyz );
+    DeVAS_float_image_delete ( dist );
+    DeVAS_XYZ_image_delete ( nor );
+
+    return ( EXIT_SUCCESS );	/* normal exit */
+}
+
+static void
+synthesize_scene ( int n_rows, int n_cols, DeVAS_xyY_image **image_p,
+	DeVAS_coordinates **coordinates_p, DeVAS_XYZ_image **xyz_p,
+	DeVAS_float_image **dist_p, DeVAS_XYZ_image **nor_p )
+{
+    DeVAS_xyY_image	*image;
+    DeVAS_coordinates	*coordinates;
+    DeVAS_XYZ_image	*xyz;
+    DeVAS_float_image	*dist;
+    DeVAS_XYZ_image	*nor;
+    VIEW		view = NULLVIEW;
+    char		*error;
+    int			row, col;
+    FVECT		origin, direction;
+
+    view.type = VT_PER;
+    view.vdir[1] = 1.0;
+    view.vup[2] = 1.0;
+    view.vdist = 1.0;
+    view.horiz = BENCH_HORIZONTAL_FOV;
+    view.vert = 2.0 * atan ( tan ( 0.5 * BENCH_HORIZONTAL_FOV * M_PI / 180.0 )
+	    * ( (double) n_rows ) / ( (double) n_cols ) ) * 180.0 / M_PI;
+
+    error = setview ( &view );
+    if ( error != NULL ) {
+	fprintf ( stderr, "devas-bench: %s!\n", error );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    image = DeVAS_xyY_image_new ( n_rows, n_cols );
+    xyz = DeVAS_XYZ_image_new ( n_rows, n_cols );
+    dist = DeVAS_float_image_new ( n_rows, n_cols );
+    nor = DeVAS_XYZ_image_new ( n_rows, n_cols );
+
+#pragma omp parallel for private ( col, origin, direction )
+    for ( row = 0; row < n_rows; row++ ) {
+	for ( col = 0; col < n_cols; col++ ) {
+	    /* Radiance image coordinates have y increasing upward */
+	    viewray ( origin, direction, &view,
+		    ( col + 0.5 ) / ( (double) n_cols ),
+		    1.0 - ( ( row + 0.5 ) / ( (double) n_rows ) ) );
+
+	    cast_ray ( origin, direction, &DeVAS_image_data ( image, row, col ),
+		    &DeVAS_image_data ( xyz, row, col ),
+		    &DeVAS_image_data ( dist, row, col ),
+		    &DeVAS_image_data ( nor, row, col ) );
+	}
+    }
+
+    DeVAS_image_view ( image ) = view;
+    DeVAS_image_view ( xyz ) = view;
+    DeVAS_image_view ( dist ) = view;
+    DeVAS_image_view ( nor ) = view;
+
+    coordinates = DeVAS_coordinates_new ( );
+    coordinates->units = centimeters;
+    coordinates->convert_to_centimeters = 1.0;
+    coordinates->view = view;
+
+    *image_p = image;
+    *coordinates_p = coordinates;
+    *xyz_p = xyz;
+    *dist_p = dist;
+    *nor_p = nor;
+}
+
+static void
+write_scene ( char *directory, DeVAS_xyY_image *image, DeVAS_XYZ_image *xyz,
+	DeVAS_float_image *dist, DeVAS_XYZ_image *nor )
+/*
+ * Write the scene as the input files of devas-visibility, with distances
+ * in centimeters.
+ */
+{
+    char    *file_name;
+    size_t  name_length;
+    FILE    *coordinates_file;
+
+    name_length = strlen ( directory ) + 32;
+    file_name = (char *) malloc ( name_length );
+    if ( file_name == NULL ) {
+	fprintf ( stderr, "devas-bench: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    snprintf ( file_name, name_length, "%s/input.hdr", directory );
+    DeVAS_xyY_image_to_radfilename ( file_name, image );
+
+    snprintf ( file_name, name_length, "%s/coordinates.txt", directory );
+    coordinates_file = fopen ( file_name, "w" );
+    if ( coordinates_file == NULL ) {
+	perror ( file_name );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+    fprintf ( coordinates_file, "distance-units=centimeters\n" );
+    fputs ( VIEWSTR, coordinates_file );
+    fprintview ( &DeVAS_image_view ( image ), coordinates_file );
+    putc ( '\n', coordinates_file );
+    fclose ( coordinates_file );
+
+    snprintf ( file_name, name_length, "%s/xyz.txt", directory );
+    write_geometry ( file_name, xyz, NULL );
+
+    snprintf ( file_name, name_length, "%s/dist.txt", directory );
+    write_geometry ( file_name, NULL, dist );
+
+    snprintf ( file_name, name_length, "%s/nor.txt", directory );
+    write_geometry ( file_name, nor, NULL );
+
+    free ( file_name );
+}
+
+static void
+write_geometry ( char *file_name, DeVAS_XYZ_image *geom3d,
+	DeVAS_float_image *geom1d )
+/*
+ * Write one of geom3d or geom1d as an ASCII geometry file.
+ */
+{
+    FILE    *file;
+    int	    n_rows, n_cols;
+    int	    row, col;
+
+    file = fopen ( file_name, "w" );
+    if ( file == NULL ) {
+	perror ( file_name );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    if ( geom3d != NULL ) {
+	n_rows = DeVAS_image_n_rows ( geom3d );
+	n_cols = DeVAS_image_n_cols ( geom3d );
+    } else {
+	n_rows = DeVAS_image_n_rows ( geom1d );
+	n_cols = DeVAS_image_n_cols ( geom1d );
+    }
+
+    fprintf ( file, "#?RADIANCE\nFORMAT=ascii\n\n-Y %d +X %d\n", n_rows,
+	    n_cols );
+
+    for ( row = 0; row < n_rows; row++ ) {
+	for ( col = 0; col < n_cols; col++ ) {
+	    if ( geom3d != NULL ) {
+		fprintf ( file, "%.6g %.6g %.6g\n",
+			DeVAS_image_data ( geom3d, row, col ) . X,
+			DeVAS_image_data ( geom3d, row, col ) . Y,
+			DeVAS_image_data ( geom3d, row, col ) . Z );
+	    } else {
+		fprintf ( file, "%.6g\n",
+			DeVAS_image_data ( geom1d, row, col ) );
+	    }
+	}
+    }
+
+    if ( fclose ( file ) != 0 ) {
+	perror ( file_name );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+}
+
+static void
+cast_ray ( FVECT origin, FVECT direction, DeVAS_xyY *xyY, DeVAS_XYZ *xyz,
+	float *dist, DeVAS_XYZ *nor )
+/*
+ * Find the nearest surface along a ray and shade it.
+ */
+{
+    double  t, t_hit;
+    double  t_near, t_far;
+    double  t1, t2;
+    double  normal[3];
+    double  hit[3];
+    double  to_light[3];
+    double  light_distance_sq;
+    double  cos_incidence;
+    double  reflectance, x, y;
+    double  luminance;
+    int	    emitter;
+    int	    axis, near_axis;
+    int	    i;
+
+    t_hit = HUGE_VAL;
+    normal[0] = normal[1] = normal[2] = 0.0;
+    reflectance = 0.0;
+    x = y = 0.0;
+
+    /* room: floor, ceiling, side walls, back wall */
+    if ( direction[2] < 0.0 ) {
+	t = ( ROOM_FLOOR - origin[2] ) / direction[2];
+	if ( t < t_hit ) {
+	    t_hit = t;
+	    normal[0] = 0.0; normal[1] = 0.0; normal[2] = 1.0;
+	    reflectance = 0.25; x = 0.360; y = 0.365;
+	}
+    } else if ( direction[2] > 0.0 ) {
+	t = ( ROOM_CEILING - origin[2] ) / direction[2];
+	if ( t < t_hit ) {
+	    t_hit = t;
+	    normal[0] = 0.0; normal[1] = 0.0; normal[2] = -1.0;
+	    reflectance = 0.80; x = 0.313; y = 0.329;
+	}
+    }
+    if ( direction[0] != 0.0 ) {
+	t = ( ( ( direction[0] < 0.0 ) ? -ROOM_HALF_WIDTH : ROOM_HALF_WIDTH )
+		- origin[0] ) / direction[0];
+	if ( t < t_hit ) {
+	    t_hit = t;
+	    normal[0] = ( direction[0] < 0.0 ) ? 1.0 : -1.0;
+	    normal[1] = 0.0; normal[2] = 0.0;
+	    reflectance = 0.60; x = 0.320; y = 0.340;
+	}
+    }
+    if ( direction[1] > 0.0 ) {
+	t = ( ROOM_DEPTH - origin[1] ) / direction[1];
+	if ( t < t_hit ) {
+	    t_hit = t;
+	    normal[0] = 0.0; normal[1] = -1.0; normal[2] = 0.0;
+	    reflectance = 0.55; x = 0.330; y = 0.345;
+	}
+    }
+
+    /* boxes, using the slab method */
+    for ( i = 0; i < N_BENCH_BOXES; i++ ) {
+	t_near = -HUGE_VAL;
+	t_far = HUGE_VAL;
+	near_axis = 0;
+	for ( axis = 0; axis < 3; axis++ ) {
+	    if ( direction[axis] == 0.0 ) {
+		if ( ( origin[axis] < bench_boxes[i].min[axis] ) ||
+			( origin[axis] > bench_boxes[i].max[axis] ) ) {
+		    t_far = -1.0;	/* miss */
+		}
+		continue;
+	    }
+	    t1 = ( bench_boxes[i].min[axis] - origin[axis] ) / direction[axis];
+	    t2 = ( bench_boxes[i].max[axis] - origin[axis] ) / direction[axis];
+	    if ( t1 > t2 ) {
+		t = t1; t1 = t2; t2 = t;
+	    }
+	    if ( t1 > t_near ) {
+		t_near = t1;
+		near_axis = axis;
+	    }
+	    if ( t2 < t_far ) {
+		t_far = t2;
+	    }
+	}
+	if ( ( t_near <= t_far ) && ( t_near > 0.0 ) && ( t_near < t_hit ) ) {
+	    t_hit = t_near;
+	    normal[0] = normal[1] = normal[2] = 0.0;
+	    normal[near_axis] = ( direction[near_axis] < 0.0 ) ? 1.0 : -1.0;
+	    reflectance = bench_boxes[i].reflectance;
+	    x = bench_boxes[i].x;
+	    y = bench_boxes[i].y;
+	}
+    }
+
+    for ( axis = 0; axis < 3; axis++ ) {
+	hit[axis] = origin[axis] + ( t_hit * direction[axis] );
+    }
+
+    /* window in the back wall, and tiles on the floor */
+    emitter = ( normal[1] < 0.0 ) && ( fabs ( hit[0] ) < 150.0 ) &&
+	( hit[2] > -20.0 ) && ( hit[2] < 110.0 );
+    if ( normal[2] > 0.0 && hit[2] <= ROOM_FLOOR ) {
+	if ( ( ( (int) floor ( hit[0] / FLOOR_TILE ) +
+			(int) floor ( hit[1] / FLOOR_TILE ) ) & 1 ) != 0 ) {
+	    reflectance *= 0.8;
+	}
+    }
+
+    if ( emitter ) {
+	luminance = WINDOW_LUMINANCE;
+	x = 0.300;
+	y = 0.320;
+    } else {
+	/* ambient plus an unshadowed point source, Lambertian surfaces */
+	light_distance_sq = 0.0;
+	for ( axis = 0; axis < 3; axis++ ) {
+	    to_light[axis] = light_position[axis] - hit[axis];
+	    light_distance_sq += to_light[axis] * to_light[axis];
+	}
+	cos_incidence = ( ( to_light[0] * normal[0] ) +
+		( to_light[1] * normal[1] ) + ( to_light[2] * normal[2] ) ) /
+	    sqrt ( light_distance_sq );
+	if ( cos_incidence < 0.0 ) {
+	    cos_incidence = 0.0;
+	}
+	luminance = ( reflectance / M_PI ) * ( AMBIENT_ILLUMINANCE +
+		( LIGHT_INTENSITY * cos_incidence /
+		  ( light_distance_sq * 1.0e-4 ) ) );	/* cm^2 to m^2 */
+    }
+
+    xyY->x = x;
+    xyY->y = y;
+    xyY->Y = luminance;
+
+    xyz->X = hit[0];
+    xyz->Y = hit[1];
+    xyz->Z = hit[2];
+
+    *dist = t_hit * sqrt ( ( direction[0] * direction[0] ) +
+	    ( direction[1] * direction[1] ) + ( direction[2] * direction[2] ) );
+
+    nor->X = normal[0];
+    nor->Y = normal[1];
+    nor->Z = normal[2];
+}
+
+static double
+run_pipeline ( char *input_file_name, char *output_file_name,
+	char *hazards_file_name, VIEW view, double margin, int fft_padding,
+	double acuity, double contrast, DeVAS_coordinates *coordinates,
+	DeVAS_XYZ_image *xyz, DeVAS_float_image *dist, DeVAS_XYZ_image *nor )
+/*
+ * The steps of devas-visibility, in the same order and with the same
+ * defaults.  Returns total seconds.
+ */
+{
+    double		run_start;
+    double		stage_start;
+    DeVAS_xyY_image	*input_image;
+    DeVAS_xyY_image	*filtered_image;
+    double		clip_value;
+    DeVAS_luminance_stats	*luminance_stats;
+    double		acuity_adjustment;
+    int			v_margin, h_margin;
+    double		low_lum_sigma_pixels;
+    DeVAS_float_image	*luminance;
+    DeVAS_float_image	*luminance_smoothed;
+    DeVAS_float_image	*luminance_smoothed_margin;
+    DeVAS_gray_image	*low_luminance;
+    int			low_luminance_found;
+    DeVAS_gray_image	*luminance_boundaries;
+    DeVAS_gray_image	*geometry_boundaries;
+    DeVAS_float_image	*hazards;
+    DeVAS_float_image	*distance;
+    DeVAS_RGB_image	*hazards_visualization;
+    double		hazard_average;
+    int			row, col;
+
+    run_start = DeVAS_timing_now ( );
+
+    stage_start = DeVAS_timing_start ( );
+    luminance_stats = DeVAS_luminance_stats_new ( );
+    input_image = DeVAS_xyY_image_from_radfilename_stats ( input_file_name,
+	    luminance_stats );
+    DeVAS_timing_stop ( "hdr_read", stage_start );
+
+    DeVAS_image_view ( input_image ) = view;	/* in case of --no-view */
+
+    stage_start = DeVAS_timing_start ( );
+    clip_value = DeVAS_auto_clip_level_stats ( input_image, luminance_stats );
+    DeVAS_luminance_stats_delete ( luminance_stats );
+    if ( clip_value >= 0.0 ) {
+	DeVAS_clip_max_value ( input_image, clip_value );
+    }
+    DeVAS_timing_stop ( "autoclip", stage_start );
+
+    v_margin = (int) round ( 0.5 * margin *
+	    DeVAS_image_n_rows ( input_image ) );
+    h_margin = (int) round ( 0.5 * margin *
+	    DeVAS_image_n_cols ( input_image ) );
+
+    acuity_adjustment = ChungLeggeCSF_cutoff_acuity_adjust ( acuity,
+	    contrast );
+
+    filtered_image = devas_filter_margin ( input_image, v_margin, h_margin,
+	    fft_padding, acuity_adjustment, contrast, SMOOTHING_FLAG,
+	    SATURATION );
+
+    /* areas darker than visibility threshold */
+    low_lum_sigma_pixels = LOW_LUMINANCE_SIGMA *
+	( ( (double) imax ( DeVAS_image_n_rows ( input_image ),
+			    DeVAS_image_n_cols ( input_image ) ) ) /
+	  fmax ( view.vert, view.horiz ) );
+
+    if ( margin > 0.0 ) {
+	if ( low_lum_sigma_pixels < STD_DEV_MIN ) {
+	    low_lum_sigma_pixels = STD_DEV_MIN;
+	}
+
+	stage_start = DeVAS_timing_start ( );
+	luminance = DeVAS_float_image_new (
+		DeVAS_image_n_rows ( input_image ) + ( 2 * v_margin ),
+		DeVAS_image_n_cols ( input_image ) + ( 2 * h_margin ) );
+	DeVAS_xyY_add_margin_split ( v_margin, v_margin, h_margin, h_margin,
+		input_image, luminance, NULL, NULL );
+	DeVAS_timing_stop ( "margin", stage_start );
+    } else {
+	luminance = DeVAS_float_image_new ( DeVAS_image_n_rows ( input_image ),
+		DeVAS_image_n_cols ( input_image ) );
+	DeVAS_image_view ( luminance ) = view;
+	for ( row = 0; row < DeVAS_image_n_rows ( input_image ); row++ ) {
+	    for ( col = 0; col < DeVAS_image_n_cols ( input_image ); col++ ) {
+		DeVAS_image_data ( luminance, row, col ) =
+		    DeVAS_image_data ( input_image, row, col ) . Y;
+	    }
+	}
+    }
+
+    stage_start = DeVAS_timing_start ( );
+    luminance_smoothed_margin = DeVAS_float_gblur_auto ( luminance,
+	    low_lum_sigma_pixels );
+    if ( margin > 0.0 ) {
+	DeVAS_image_view ( luminance_smoothed_margin ) . vert =
+	    DeVAS_image_view ( luminance ) . vert;
+	DeVAS_image_view ( luminance_smoothed_margin ) . horiz =
+	    DeVAS_image_view ( luminance ) . horiz;
+	luminance_smoothed = DeVAS_float_strip_margin ( v_margin, h_margin,
+		luminance_smoothed_margin );
+	DeVAS_float_image_delete ( luminance_smoothed_margin );
+    } else {
+	luminance_smoothed = luminance_smoothed_margin;
+    }
+    low_luminance = DeVAS_gray_image_new (
+	    DeVAS_image_n_rows ( luminance_smoothed ),
+	    DeVAS_image_n_cols ( luminance_smoothed ) );
+    low_luminance_found = FALSE;
+    for ( row = 0; row < DeVAS_image_n_rows ( luminance_smoothed ); row++ ) {
+	for ( col = 0; col < DeVAS_image_n_cols ( luminance_smoothed );
+		col++ ) {
+	    if ( DeVAS_image_data ( luminance_smoothed, row, col ) <=
+		    LOW_LUMINANCE_LEVEL ) {
+		DeVAS_image_data ( low_luminance, row, col ) = 255;
+		low_luminance_found = TRUE;
+	    } else {
+		DeVAS_image_data ( low_luminance, row, col ) = 0;
+	    }
+	}
+    }
+    if ( ! low_luminance_found ) {
+	DeVAS_gray_image_delete ( low_luminance );
+	low_luminance = NULL;
+    }
+    DeVAS_timing_stop ( "low_luminance", stage_start );
+
+    DeVAS_float_image_delete ( luminance );
+    DeVAS_float_image_delete ( luminance_smoothed );
+    DeVAS_xyY_image_delete ( input_image );
+
+    stage_start = DeVAS_timing_start ( );
+    DeVAS_xyY_image_to_radfilename ( output_file_name, filtered_image );
+    DeVAS_timing_stop ( "hdr_write", stage_start );
+
+    hazards = devas_visibility ( filtered_image, coordinates, xyz, dist, nor,
+	    POSITION_PATCH_SIZE, ORIENTATION_PATCH_SIZE, POSITION_THRESHOLD,
+	    ORIENTATION_THRESHOLD, &luminance_boundaries, &geometry_boundaries,
+	    NULL );
+
+    /* what devas_visibility ( ) does when boundaries are dense */
+    stage_start = DeVAS_timing_start ( );
+    distance = dt_euclid_sq ( luminance_boundaries );
+    DeVAS_timing_stop ( "dt_euclid_sq", stage_start );
+    DeVAS_float_image_delete ( distance );
+
+    stage_start = DeVAS_timing_start ( );
+    hazards_visualization = visualize_hazards ( hazards, Gaussian_measure,
+	    0.75, red_green_type, low_luminance, NULL, &geometry_boundaries,
+	    &hazard_average );
+    DeVAS_timing_stop ( "visualize_hazards", stage_start );
+
+    stage_start = DeVAS_timing_start ( );
+    DeVAS_RGB_image_to_filename_png ( hazards_file_name,
+	    hazards_visualization );
+    DeVAS_timing_stop ( "png_write", stage_start );
+
+    /* clean up */
+    DeVAS_xyY_image_delete ( filtered_image );
+    DeVAS_float_image_delete ( hazards );
+    DeVAS_RGB_image_delete ( hazards_visualization );
+    DeVAS_gray_image_delete ( luminance_boundaries );
+    DeVAS_gray_image_delete ( geometry_boundaries );
+    if ( low_luminance != NULL ) {
+	DeVAS_gray_image_delete ( low_luminance );
+    }
+
+    return ( DeVAS_timing_now ( ) - run_start );
+}
+
+static void
+collect_stages ( void )
+/*
+ * Add the stages recorded during one run to bench_stages.
+ */
+{
+    int	    stage;
+    int	    i;
+    double  seconds;
+
+    for ( stage = 0; stage < DeVAS_timing_n_stages ( ); stage++ ) {
+	seconds = DeVAS_timing_stage_seconds ( stage );
+
+	for ( i = 0; i < bench_n_stages; i++ ) {
+	    if ( strcmp ( bench_stages[i].name,
+			DeVAS_timing_stage_name ( stage ) ) == 0 ) {
+		break;
+	    }
+	}
+
+	if ( i == bench_n_stages ) {
+	    if ( bench_n_stages >= BENCH_MAX_STAGES ) {
+		continue;
+	    }
+	    strcpy ( bench_stages[i].name, DeVAS_timing_stage_name ( stage ) );
+	    bench_stages[i].count = DeVAS_timing_stage_count ( stage );
+	    bench_stages[i].total = 0.0;
+	    bench_stages[i].min = seconds;
+	    bench_stages[i].n_runs = 0;
+	    bench_n_stages++;
+	}
+
+	bench_stages[i].total += seconds;
+	if ( seconds < bench_stages[i].min ) {
+	    bench_stages[i].min = seconds;
+	}
+	bench_stages[i].n_runs++;
+    }
+}
+
+static void
+write_results ( FILE *output, int n_rows, int n_cols, int view_record,
+	double margin, int fft_padding,
+	DeVAS_chroma_resolution chroma_resolution, char *table_cache,
+	double acuity, double contrast, int repeat, double total,
+	double total_min )
+{
+    int	    i;
+    int	    n_threads;
+
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads ( );
+#else
+    n_threads = 1;
+#endif	/* _OPENMP */
+
+    fprintf ( output, "{\n" );
+    fprintf ( output, "  \"program\": \"devas-bench\",\n" );
+    fprintf ( output, "  \"version\": \"%s\",\n",
+	    DeVAS_FILTER_VERSION_STRING );
+    fprintf ( output, "  \"n_rows\": %d,\n", n_rows );
+    fprintf ( output, "  \"n_cols\": %d,\n", n_cols );
+    fprintf ( output, "  \"view_record\": %s,\n",
+	    view_record ? "true" : "false" );
+    fprintf ( output, "  \"margin\": %g,\n", margin );
+    fprintf ( output, "  \"fft_padding\": %s,\n",
+	    fft_padding ? "true" : "false" );
+    fprintf ( output, "  \"chroma_resolution\": \"%s\",\n",
+	    ( chroma_resolution == DeVAS_CHROMA_REDUCED ) ? "reduced" : "full" );
+    fprintf ( output, "  \"table_cache\": %s,\n",
+	    ( table_cache != NULL ) ? "true" : "false" );
+    fprintf ( output, "  \"acuity\": %g,\n", acuity );
+    fprintf ( output, "  \"contrast\": %g,\n", contrast );
+    fprintf ( output, "  \"threads\": %d,\n", n_threads );
+    fprintf ( output, "  \"repeat\": %d,\n", repeat );
+    fprintf ( output, "  \"stages\": [\n" );
+    for ( i = 0; i < bench_n_stages; i++ ) {
+	fprintf ( output, "    { \"name\": \"%s\", \"count\": %d, "
+		"\"mean_seconds\": %.6f, \"min_seconds\": %.6f }%s\n",
+		bench_stages[i].name, bench_stages[i].count,
+		bench_stages[i].total / bench_stages[i].n_runs,
+		bench_stages[i].min,
+		( i < ( bench_n_stages - 1 ) ) ? "," : "" );
+    }
+    fprintf ( output, "  ],\n" );
+    fprintf ( output, "  \"total\": { \"mean_seconds\": %.6f, "
+	    "\"min_seconds\": %.6f }\n", total / repeat, total_min );
+    fprintf ( output, "}\n" );
+}
+
+static void
+print_usage ( void )
+{
+    fprintf ( stderr, "%s\n", Usage );
+}
@@ -35,6 +35,7 @@
 #include <math.h>
 #include "devas-canny.h"
 #include "devas-gblur.h"
+#include "devas-select.h"
 #include "devas-image.h"
 
 #define	SIMPLE		1	/* Used to flag what sort of thresholding */
@@ -53,9 +54,6 @@
 #define	T2		0.0
 #define	T3		0.0
 
-#define	EPSILON		0.0001	/* Used to avoid a boundary condition in */
-				/* computing percentile bin numbers. */
-
 #define	SQR(x)	((x)*(x))
 
 #ifdef CANNY_LOG_MAGNITUDE
@@ -155,9 +153,6 @@ canny_base ( DeVAS_float_image *input, double st_dev, double high_threshold,
     DeVAS_float_image	*magnitude;	/* gradient magnitude (A in Fleck) */
     DeVAS_float_image	*grad_Y, *grad_X;	/* X and Y in Fleck */
     DeVAS_gray_image	*edge_map;	/* detected edges */
-#ifdef CANNY_LOG_MAGNITUDE
-    int		      row, col;
-#endif	/* CANNY_LOG_MAGNITUDE */
 
     n_rows = DeVAS_image_n_rows ( input );
     n_cols = DeVAS_image_n_cols ( input );
@@ -178,27 +173,17 @@ canny_base ( DeVAS_float_image *input, double st_dev, double high_threshold,
     }
 
     if ( st_dev >= GBLUR_STD_DEV_MIN ) {
-	blurred_input = devas_float_gblur ( input, st_dev );
 #ifdef CANNY_LOG_MAGNITUDE
-	for ( row = 0; row < n_rows; row++ ) {
-	    for ( col = 0; col < n_cols; col++ ) {
-		DeVAS_image_data ( blurred_input, row, col ) =
-		    log ( DeVAS_image_data ( blurred_input, row, col ) +
-			    CANNY_LOG_EPSILON );
-	    }
-	}
+	/* log applied as part of the blur's final pass */
+	blurred_input = devas_float_gblur_log ( input, st_dev,
+		CANNY_LOG_EPSILON );
+#else
+	blurred_input = devas_float_gblur ( input, st_dev );
 #endif	/* CANNY_LOG_MAGNITUDE */
     } else if ( st_dev <= 0 ) {
 	/* don't blur */
 #ifdef CANNY_LOG_MAGNITUDE
-	blurred_input = DeVAS_float_image_new ( n_rows, n_cols );
-	for ( row = 0; row < n_rows; row++ ) {
-	    for ( col = 0; col < n_cols; col++ ) {
-		DeVAS_image_data ( blurred_input, row, col ) =
-		    log ( DeVAS_image_data ( input, row, col ) +
-			    CANNY_LOG_EPSILON );
-	    }
-	}
+	blurred_input = devas_float_log ( input, CANNY_LOG_EPSILON );
 #else
 	blurred_input = input;
 #endif	/* CANNY_LOG_MAGNITUDE */
@@ -401,85 +386,68 @@ auto_thresh_values ( DeVAS_float_image *magnitude, double *high_threshold,
  * includes a chosen percentile of all of the gradient magnitude values,
  * whether or not they are local maxima.
  *
- * Percentile cutoffs are computed using a histogram method.  A large number
- * of bins are used due to the high dynamic range involved and the nature
- * of the frequency distibution of gradient magnitudes.
+ * Percentile cutoffs are computed exactly using a linear time selection
+ * algorithm, rather than with a histogram, since the high dynamic range
+ * involved and the nature of the frequency distibution of gradient
+ * magnitudes make binning inaccurate.
  */
 {
-    unsigned int    magnitude_hist[MAGNITUDE_HIST_NBINS];
+    float   	    *values;
     int	    	    row, col;
     int	    	    n_rows, n_cols;
-    int	    	    bin;
-    int	    	    bin_index;
-    double  	    magnitude_max;
-    double  	    norm;
-    double  	    percentile;
-    unsigned int    total_count;
+    int		    n_values;
+    float	    value;
 
     n_rows = DeVAS_image_n_rows ( magnitude );
     n_cols = DeVAS_image_n_cols ( magnitude );
 
-    for ( bin = 0; bin < MAGNITUDE_HIST_NBINS; bin++ ) {
-	magnitude_hist[bin] = 0;
+    if ( ( n_rows < 3 ) || ( n_cols < 3 ) ) {
+	/* no interior pixels, so no contrast! */
+	*high_threshold = *low_threshold = -1.0;
+	return;
+    }
+
+    values = (float *) malloc ( sizeof ( float ) * ( n_rows - 2 ) *
+	    ( n_cols - 2 ) );
+    if ( values == NULL ) {
+	fprintf ( stderr, "canny_autothresh: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
     }
 
-    /* Compute maximum value of gradient, ignoring pixels at edge of image. */
-    magnitude_max = -1.0;
+    /* Collect gradient magnitudes, ignoring pixels at edge of image. */
+    n_values = 0;
     for ( row = 1; row < n_rows - 1; row++ ) {
 	for ( col = 1; col < n_cols - 1; col++ ) {
-	    if ( DeVAS_image_data ( magnitude, row, col ) < 0.0 ) {
+	    value = DeVAS_image_data ( magnitude, row, col );
+	    if ( value < 0.0 ) {
 		fprintf ( stderr,
 			"canny_autothresh: gradient magnitude < 0.0!\n" );
 		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
 		exit ( EXIT_FAILURE );
 	    }
-
-	    if ( DeVAS_image_data ( magnitude, row, col ) > magnitude_max ) {
-		magnitude_max = DeVAS_image_data ( magnitude, row, col );
+#ifndef PERCENTILE_ALL
+	    if ( value == CANNY_MAG_NO_EDGE ) {
+		continue;	/* remove non-local-maxima from count */
 	    }
+#endif	/* PERCENTILE_ALL */
+	    values[n_values++] = value;
 	}
     }
-    
-    if ( magnitude_max < 0.0 ) {
+
+    if ( n_values == 0 ) {
 	/* no contrast! */
+	free ( values );
 	*high_threshold = *low_threshold = -1.0;
 	return;
     }
 
-    /* Spread out gradient magnitude values amoung histogram bins. */
-    if ( magnitude_max > 0.0 ) {
-	norm = 1.0 / magnitude_max;
-	for ( row = 1; row < n_rows - 1; row++ ) {
-	    for ( col = 1; col < n_cols - 1; col++ ) {
-		bin_index = norm * DeVAS_image_data ( magnitude, row, col ) *
-		    ( ( (double) MAGNITUDE_HIST_NBINS ) - EPSILON );
-		magnitude_hist[bin_index]++;
-	    }
-	}
-    } else {
-	magnitude_hist[0]++;
-    }
-
-    percentile = 0.0;
-#ifdef PERCENTILE_ALL
-    total_count = ( n_rows - 1 ) * ( n_cols - 1 );
-#else
-    total_count = ( ( n_rows - 1 ) * ( n_cols - 1 ) ) - magnitude_hist[0];
-    				/* remove non-local-maxima from count */
-#endif	/* PERCENTILE_ALL */
-
-    /* Search for bin index corresponding to requested percentile. */
-    for ( bin = MAGNITUDE_HIST_NBINS - 1; bin >= 0; bin-- ) {
-	percentile += ((double) magnitude_hist[bin] ) / ((double) total_count );
-
-	if ( percentile > PERCENTILE_EDGE_PIXELS ) {
-	    break;
-	}
-    }
-
-    *high_threshold = ( ((double) bin ) + 0.5 ) /
-	    ( ((double) MAGNITUDE_HIST_NBINS ) - EPSILON ) * magnitude_max;
+    /* Value exceeded by PERCENTILE_EDGE_PIXELS of the magnitudes. */
+    *high_threshold = DeVAS_float_percentile ( values, n_values,
+	    1.0 - PERCENTILE_EDGE_PIXELS );
     *low_threshold = *high_threshold * LOW_THRESHOLD_MULTIPLE;
+
+    free ( values );
 }
 
 static DeVAS_gray_image *
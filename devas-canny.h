@@ -46,10 +46,6 @@
 					/* (for auto-level hysteresis */
 					/* thresholding) */
 
-#define	MAGNITUDE_HIST_NBINS	1000	/* needs to be large enought to deal */
-					/* with gradient magnitude histograms */
-					/* having narrow peaks. */
-
 /*
  * The following values are specified as defines rather than as enums,
  * since they have to be assignable to gray_image pixels.
@@ -25,21 +25,36 @@
 #include <string.h>		/* for strcmp, strlen */
 #include <strings.h>		/* for strcasecmp, strncasecmp */
 #include <libgen.h>		/* for basename */
+#ifdef DeVAS_USE_SERVER
+#include <unistd.h>		/* for sysconf */
+#endif	/* DeVAS_USE_SERVER */
 /* #define DeVAS_CHECK_BOUNDS */	/* optional DeVAS_image bounds checking */
 #include "devas-image.h"
 #include "devas-filter.h"
 #include "devas-presets.h"
 #include "devas-utils.h"
 #include "devas-margin.h"
+#include "devas-autoclip.h"
+#include "devas-fft-plan.h"
+#include "devas-table-cache.h"
+#include "devas-timing.h"
 #include "radianceIO.h"
 #include "acuity-conversion.h"
 #include "ChungLeggeCSF.h"
+#ifndef DeVAS_VISIBILITY
+#include "devas-sequence.h"
+#endif	/* DeVAS_VISIBILITY */
 #ifdef DeVAS_VISIBILITY
 #include "read-geometry.h"
 #include "devas-visibility.h"
 #include "visualize-hazards.h"
 #include "devas-png.h"
 #include "devas-gblur-fft.h"
+#include "devas-gblur-iir.h"
+#include "devas-geometry-cache.h"
+#ifdef DeVAS_USE_SERVER
+#include "devas-server.h"
+#endif	/* DeVAS_USE_SERVER */
 #ifdef DeVAS_USE_CAIRO
 #include "devas-add-text.h"
 #endif  /* DeVAS_USE_CAIRO */
@@ -66,6 +81,10 @@
 #define	LOW_LUMINANCE_LEVEL	1.0	/* in cd/m^2 */
 #define	LOW_LUMINANCE_SIGMA	0.2	/* in degrees of visual angle */
 
+#ifdef DeVAS_USE_SERVER
+#define	SERVER_GEOMETRY_CACHE_SIZE	8	/* parsed geometry files kept */
+#endif	/* DeVAS_USE_SERVER */
+
 #endif	/* DeVAS_VISIBILITY */
 
     /* code used by both devas-filter and devas-visibility */
@@ -80,9 +99,12 @@ char	*Usage = /* devas-filter */
 char	*Usage2 = "[--snellen|--logMAR] [--sensitivity-ratio|--pelli-robson]"
     "\n\t[--approxCS] [--approxSaturation]"
     "\n\t[--autoclip|--clip=<level>] [--color|--grayscale|saturation=<value>]"
-    "\n\t[--margin=<value>] [--verbose] [--version] [--presets]"
+    "\n\t[--margin=<value>] [--fft-padding]"
+    "\n\t[--chroma-resolution=full|reduced] [--table-cache=<directory>]"
+    "\n\t[--frames=<first>:<last>|--frame-list=<file>]"
+    "\n\t[--verbose] [--version] [--presets] [--profile=<file>]"
 	    "\n\t\tacuity contrast input.hdr output.hdr";
-int	args_needed = 4;
+#define	ARGS_NEEDED	4
 
 /*
  * Options (can be in any order):
@@ -176,6 +198,55 @@ int	args_needed = 4;
  *		horizontal and vertical padding as a fraction of the original
  *		horizontal and vertical size.
  *
+ *   --fft-padding
+ *
+ *		Increase the padded image size (with or without --margin) to
+ *		the size with no prime factors larger than 7 that is expected
+ *		to be cheapest to process, which FFTW transforms much faster
+ *		than sizes with large prime factors.  The extra padding is
+ *		discarded in the output.  With --verbose, the size used is
+ *		reported.
+ *
+ *   --chroma-resolution=full|reduced
+ *
+ *		Resolution at which the chromaticity channels are filtered.
+ *		reduced filters them at the lowest resolution that still
+ *		represents every frequency passed with a CSF weight of at
+ *		least 0.01, and interpolates the result back to full
+ *		resolution.  The 0.01 only decides the resolution; it is
+ *		not a bound on the change in color, since the averaging
+ *		and interpolation also attenuate and alias some of the
+ *		frequencies that are represented.  This is much faster for
+ *		severe losses, and changes the output colors only slightly
+ *		(compare with full to check a particular image).  Default
+ *		is full.  With --verbose, the resolution used is reported.
+ *
+ *   --table-cache=<directory>
+ *
+ *		Keep the filter tables computed for each image size and set
+ *		of acuity and contrast values in <directory> (created if
+ *		needed), and use them on later runs with the same values
+ *		rather than computing them again.  Results are unchanged.
+ *
+ *   --frames=<first>:<last>
+ *
+ *		Filter a sequence of frames, such as a walkthrough or
+ *		animation.  input.hdr and output.hdr are printf-style
+ *		patterns containing a single %d conversion, such as
+ *		frame%04d.hdr, which is replaced by each frame number from
+ *		<first> through <last>.  The next frame is read and the
+ *		previous one written while each frame is filtered, and FFT
+ *		plans, filter tables, and work images are reused for frames
+ *		of the same size.  The number of frames per second is
+ *		reported.
+ *
+ *   --frame-list=<file>
+ *
+ *		Same as --frames, with the frames given by <file>, which
+ *		contains an input and an output file name for each frame.
+ *		The input.hdr and output.hdr arguments are left off the
+ *		command line.
+ *
  *   --version	Print version number and then exit.  No other flages or
  *		arguments are required.
  *
@@ -187,6 +258,13 @@ int	args_needed = 4;
  *   --verbose
  *		Print possibly informative information about a particular run.
  *
+ *   --profile=<file>
+ *
+ *		Write the time taken by each processing stage, the memory
+ *		held by image objects, and the peak resident set size to
+ *		<file>, in Chrome trace event JSON format (viewable with
+ *		chrome://tracing or https://ui.perfetto.dev).
+ *
  * Arguments:
  *
  *   acuity	Acuity, in format as specified by --Snellen or --logMAR flags.
@@ -214,12 +292,16 @@ char	*Usage = /* devas-visibility */
     "\n\t[--geometryboundaries=<filename>.png]"
     "\n\t[--lowluminance=<filename>.png]"
     "\n\t[--falsepositives=<filename>.png]"
+    "\n\t[--png-compression=fast|default|best]"
+    "\n\t[--nearest-boundary=auto|transform|grid]"
     "\n\t\tinput.hdr coordinates xyz.txt dist.txt nor.txt"
     "\n\t\tsimulated-view.hdr hazards.png";
 char	*Usage2 = "[--snellen|--logMAR] [--sensitivity-ratio|--pelli-robson]"
     "\n\t[--approxCS] [--approxSaturation]"
     "\n\t[--autoclip|--clip=<level>] [--color|--grayscale|saturation=<value>]"
-    "\n\t[--margin=<value>] [--verbose] [--version] [--presets]"
+    "\n\t[--margin=<value>] [--fft-padding]"
+    "\n\t[--chroma-resolution=full|reduced] [--table-cache=<directory>]"
+    "\n\t[--verbose] [--version] [--presets] [--profile=<file>]"
     "\n\t[--red-green|--red-gray] [--printaverage|--printaveragena]"
 #ifdef DeVAS_USE_CAIRO
     "\n\t[--quantscore] [--fontsize=<n>]"
@@ -230,9 +312,15 @@ char	*Usage2 = "[--snellen|--logMAR] [--sensitivity-ratio|--pelli-robson]"
     "\n\t[--geometryboundaries=<filename>.png]"
     "\n\t[--lowluminance=<filename>.png]"
     "\n\t[--falsepositives=<filename>.png]"
+    "\n\t[--png-compression=fast|default|best]"
+    "\n\t[--nearest-boundary=auto|transform|grid]"
 	    "\n\t\tacuity contrast input.hdr coordinates xyz.txt dist.txt"
 	    "\n\t\tnor.txt simulated-view.hdr hazards.png";
-int	args_needed = 9;
+#ifdef DeVAS_USE_SERVER
+char	*Usage3 = "--server=<socket> [--workers=<n>] [--threads=<n>]"
+    "\n\t[--geometry-cache=<n>]";
+#endif	/* DeVAS_USE_SERVER */
+#define	ARGS_NEEDED	9
 
 /*
  * Options:
@@ -291,6 +379,62 @@ int	args_needed = 9;
  *   		do not correspond to actual scene geometry.  Uses a gray-cyan
  *   		colormap.
  *
+ *   --png-compression=fast|default|best
+ *
+ *   		Compression used for the PNG output files.  fast is much
+ *   		faster to write for the mostly black hazard, boundary, and
+ *   		low luminance images, at the cost of somewhat larger files.
+ *   		best gives the smallest files.  Default is default.
+ *
+ *   --nearest-boundary=auto|transform|grid
+ *
+ *   		How distances from boundary pixels to the nearest boundary
+ *   		pixel of the other type are found.  transform computes a
+ *   		distance transform of the whole image.  grid searches
+ *   		outward from each boundary pixel through a grid of bucketed
+ *   		boundary pixels, which is faster when boundaries are sparse.
+ *   		Results are the same.  auto (the default) chooses based on
+ *   		the number of boundary pixels.
+ *
+ *   --table-cache=<directory>
+ *
+ *   		Keep the filter tables computed for each image size and set
+ *   		of acuity and contrast values in <directory> (created if
+ *   		needed), and use them on later runs with the same values
+ *   		rather than computing them again.  Results are unchanged.
+ *
+ *   --profile=<file>
+ *
+ *   		Write the time taken by each processing stage, the memory
+ *   		held by image objects, and the peak resident set size to
+ *   		<file>, in Chrome trace event JSON format (viewable with
+ *   		chrome://tracing or https://ui.perfetto.dev).  In server
+ *   		mode, peak resident set size is for the worker process.
+ *
+ *   --server=<socket> [--workers=<n>] [--threads=<n>]
+ *   		[--geometry-cache=<n>]
+ *
+ *   		Must be the first argument, and the only other options
+ *   		allowed are --workers, --threads, and --geometry-cache.
+ *   		Rather than
+ *   		processing a single image, listen on the Unix domain socket
+ *   		<socket> for jobs, each a JSON object of the form
+ *
+ *   		  {"args": ["--mild", "input.hdr", ...], "cwd": "<dir>"}
+ *
+ *   		where args are the usual command line arguments and the
+ *   		optional cwd is the directory relative file names are
+ *   		resolved against.  Output from the job is returned over the
+ *   		connection, followed by a final line {"status": <n>} giving
+ *   		the exit status.  Jobs are run by <n> worker processes
+ *   		(default, the number of processors), each using --threads
+ *   		threads (default, the number of processors divided by the
+ *   		number of workers, and at least 1).  Workers keep FFTW
+ *   		plans and the most recently used <n> parsed geometry files
+ *   		(default 8) from one job to the next.  A client must send
+ *   		its job description within 30 seconds of connecting.  Runs
+ *   		until interrupted.  Not available on Windows.
+ *
  * Arguments:
  *
  *   input.hdr	Original Radiance image of area in design model to be evaluated
@@ -380,14 +524,6 @@ typedef enum { undefined_smoothing, no_smoothing, smoothing } SmoothingType;
 #define	PELLI_ROBSON_MAX	2.4
 #define PELLI_ROBSON_NORMAL	2.0	/* normal vision score on chart */
 
-#define	AUTO_CLIP_MEDIAN		/* based auto_clip value on median, */
-					/* not average */
-#define	CUTOFF_RATIO_MEAN	7.0	/* RADIANCE identifies glare sources */
-					/* as being brighter than 7 times the */
-					/* average luminance level. */
-#define	CUTOFF_RATIO_MEDIAN	12.0	/* need higher value for median */
-#define	NO_CLIP_LEVEL		-1.0	/* don't clip values */
-
 #define	exp10(x)	pow ( 10.0, (x) ) /* can't count on availablility
 					     of exp10 */
 
@@ -397,12 +533,18 @@ static void	print_usage ( void );
 static void	internal_error ( void );
 static double	PelliRobson2contrastratio ( double PelliRobson_score );
 static double	contrastratio2PelliRobson ( double contrast_ratio );
-#ifndef	AUTO_CLIP_MEDIAN
-static double	auto_clip_level ( DeVAS_xyY_image *image );
-#else
-static double	auto_clip_level_median ( DeVAS_xyY_image *image );
-#endif	/* AUTO_CLIP_MEDIAN */
-static void	clip_max_value ( DeVAS_xyY_image *image, double clip_value );
+static void	clip_input ( DeVAS_xyY_image *input_image, ClipType clip_type,
+		    double clip_value, DeVAS_luminance_stats *luminance_stats );
+static void	margin_pixels ( double margin, DeVAS_xyY_image *input_image,
+		    int *v_margin, int *h_margin );
+
+#ifndef DeVAS_VISIBILITY	/* code specific to devas-filter */
+static void	filter_sequence ( DeVAS_sequence *sequence, ClipType clip_type,
+		    double clip_value, double margin, int fft_padding,
+		    double acuity_adjustment, double contrast_ratio,
+		    int smoothing_flag, double saturation, int argc,
+		    char *argv[] );
+#endif	/* DeVAS_VISIBILITY */
 
 #ifdef DeVAS_VISIBILITY	/* code specific to devas-visibility */
 static DeVAS_float_image
@@ -411,7 +553,7 @@ static DeVAS_gray_image
 		*luminance_threshold ( double low_luminace_level,
 		    DeVAS_float_image *luminance_smoothed );
 static double	angle2pixels ( double low_lum_sigma_angle,
-		    DeVAS_float_image *input_float );
+		    DeVAS_xyY_image *input_image );
 static void	make_visible ( DeVAS_gray_image *boundaries );
 #ifdef DeVAS_USE_CAIRO
 static void	add_quantscore ( DeVAS_RGB_image *hazards_visualization,
@@ -423,9 +565,34 @@ static void	add_quantscore ( DeVAS_RGB_image *hazards_visualization,
 
 static void	devas_filter_print_defaults ( void );
 static void	devas_filter_print_presets ( void );
+static int	devas_commandline ( int argc, char *argv[] );
+#ifdef DeVAS_USE_SERVER
+static int	devas_server ( int argc, char *argv[] );
+
+static int	server_mode = FALSE;	/* running jobs for devas_server ( ) */
+#endif	/* DeVAS_USE_SERVER */
 
 int
 main ( int argc, char *argv[] )
+{
+#ifdef DeVAS_USE_SERVER
+    if ( ( argc >= 2 ) &&
+	    ( ( strncasecmp ( argv[1], "--server=",
+			      strlen ( "--server=" ) ) == 0 ) ||
+	      ( strncasecmp ( argv[1], "-server=",
+			      strlen ( "-server=" ) ) == 0 ) ) ) {
+	return ( devas_server ( argc, argv ) );
+    }
+#endif	/* DeVAS_USE_SERVER */
+
+    return ( devas_commandline ( argc, argv ) );
+}
+
+static int
+devas_commandline ( int argc, char *argv[] )
+/*
+ * Process one command line.  Returns exit status.
+ */
 {
     /* option flags */
     PresetType		preset_type = no_preset;
@@ -448,6 +615,7 @@ main ( int argc, char *argv[] )
     /* (0-1) => partial desat */
     /* 1 => leave sat as is */
     double		clip_value = -1.0;
+    DeVAS_luminance_stats	*luminance_stats = NULL;	/* for autoclip */
     double		acuity = -1.0;		/* ratio to normal */
     double		contrast_ratio = -1.0;	/* ratio to normal */
     int			smoothing_flag;		/* reduce banding artifacts */
@@ -459,14 +627,26 @@ main ( int argc, char *argv[] )
     						/* to mitigate FFT */
     						/* wraparound artificats */
     int			v_margin, h_margin;	/* in pixels */
+    int			fft_padding = FALSE;	/* round padded sizes up */
+    						/* to fast FFT sizes */
     char		*input_file_name;
+    char		*profile_file_name = NULL;
+    char		*chroma_resolution_name;
+    double		run_start;
+    double		stage_start;
 
     DeVAS_xyY_image	*input_image;		/* Y values in cd/m^2 */
-    DeVAS_xyY_image	*margin_image;		/* to deal with wrap-around */
-    DeVAS_xyY_image	*margin_filtered_image;	/* artifacts */
     char		*filtered_image_file_name;
     DeVAS_xyY_image	*filtered_image;	/* Y values in cd/m^2 */
 
+#ifndef DeVAS_VISIBILITY	/* code specific to devas-filter */
+    int			frames_set = FALSE;	/* --frames */
+    int			first_frame = 0, last_frame = -1;
+    char		*frame_list_file_name = NULL;
+    char		frames_extra;		/* for sscanf ( ) check */
+    DeVAS_sequence	*sequence = NULL;
+#endif	/* DeVAS_VISIBILITY */
+
 #ifdef DeVAS_VISIBILITY	/* code specific to devas-visibility */
     char		*coordinates_file_name;
     char		*xyz_file_name;
@@ -481,6 +661,8 @@ main ( int argc, char *argv[] )
     DeVAS_gray_image	*geometry_boundaries = NULL;
     char		*low_luminance_file_name = NULL;
     char		*false_positives_file_name = NULL;
+    char		*png_compression_name;
+    char		*nearest_method_name;
     DeVAS_float_image	*false_positive_hazards = NULL;
     DeVAS_coordinates	*coordinates;
     DeVAS_XYZ_image	*xyz;
@@ -531,9 +713,25 @@ main ( int argc, char *argv[] )
     /* code used by both devas-filter and devas-visibility */
 
     int			argpt = 1;
+    int			args_needed = ARGS_NEEDED;
 
     progname = basename ( argv[0] );
 
+    /* profiling is only on for jobs that ask for it */
+    DeVAS_timing_trace_enable ( FALSE );
+    DeVAS_timing_enable ( FALSE );
+    DeVAS_timing_reset ( );
+    devas_filter_set_chroma_resolution ( DeVAS_CHROMA_FULL );
+    DeVAS_table_cache_set_directory ( NULL );
+
+#ifdef DeVAS_VISIBILITY	/* code specific to devas-visibility */
+    /* settings persist across jobs in server mode, so start from defaults */
+    DeVAS_verbose = FALSE;
+    DeVAS_veryverbose = FALSE;
+    DeVAS_png_set_compression ( DeVAS_PNG_COMPRESSION_DEFAULT );
+    devas_visibility_set_nearest_method ( DeVAS_NEAREST_AUTO );
+#endif	/* DeVAS_VISIBILITY */
+
     /* scan and collect option flags */
     while ( ( ( argc - argpt ) >= 1 ) && ( argv[argpt][0] == '-' ) ) {
 	if ( strcmp ( argv[argpt], "-" ) == 0 ) {
@@ -792,33 +990,56 @@ main ( int argc, char *argv[] )
 	    }
 	    argpt++;
 
+	} else if ( ( strcasecmp ( argv[argpt], "--fft-padding" ) == 0 ) ||
+		( strcasecmp ( argv[argpt], "-fft-padding" ) == 0 ) ) {
+	    fft_padding = TRUE;
+	    argpt++;
+
+	} else if ( ( strncasecmp ( argv[argpt], "--chroma-resolution=",
+			strlen ( "--chroma-resolution=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-chroma-resolution=",
+			strlen ( "-chroma-resolution=" ) ) == 0 ) ) {
+	    chroma_resolution_name = strchr ( argv[argpt], '=' ) + 1;
+	    if ( strcasecmp ( chroma_resolution_name, "full" ) == 0 ) {
+		devas_filter_set_chroma_resolution ( DeVAS_CHROMA_FULL );
+	    } else if ( strcasecmp ( chroma_resolution_name, "reduced" ) == 0 ) {
+		devas_filter_set_chroma_resolution ( DeVAS_CHROMA_REDUCED );
+	    } else {
+		fprintf ( stderr,
+			"%s: invalid --chroma-resolution value (%s)!\n",
+			progname, chroma_resolution_name );
+		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+		return ( EXIT_FAILURE );    /* error exit */
+	    }
+	    argpt++;
+
 	} else if ( ( strcasecmp ( argv[argpt], "--version" ) == 0 ) ||
 		( strcasecmp ( argv[argpt], "-version" ) == 0 ) ) {
 	    /* print version number then exit */
 	    devas_filter_print_version ( );
 	    /* argpt++; */
-	    exit ( EXIT_SUCCESS );
+	    return ( EXIT_SUCCESS );
 
 	} else if ( ( strcasecmp ( argv[argpt], "--v" ) == 0 ) ||
 		( strcasecmp ( argv[argpt], "-v" ) == 0 ) ) {
 	    /* print version number then exit */
 	    devas_filter_print_version ( );
 	    /* argpt++; */
-	    exit ( EXIT_SUCCESS );
+	    return ( EXIT_SUCCESS );
 
 	} else if ( ( strcasecmp ( argv[argpt], "--presets" ) == 0 ) ||
 		( strcasecmp ( argv[argpt], "-presets" ) == 0 ) ) {
 	    /* print presets number then exit */
 	    devas_filter_print_presets ( );
 	    /* argpt++; */
-	    exit ( EXIT_SUCCESS );
+	    return ( EXIT_SUCCESS );
 
 	} else if ( ( strcasecmp ( argv[argpt], "--defaults" ) == 0 ) ||
 		( strcasecmp ( argv[argpt], "-defaults" ) == 0 ) ) {
 	    /* print default values then exit */
 	    devas_filter_print_defaults ( );
 	    /* argpt++; */
-	    exit ( EXIT_SUCCESS );
+	    return ( EXIT_SUCCESS );
 
 	} else if ( ( strcasecmp ( argv[argpt], "--verbose" ) == 0 ) ||
 		( strcasecmp ( argv[argpt], "-verbose" ) == 0 ) ) {
@@ -826,6 +1047,34 @@ main ( int argc, char *argv[] )
 	    DeVAS_verbose = TRUE;
 	    argpt++;
 
+	} else if ( ( strncasecmp ( argv[argpt], "--table-cache=",
+			strlen ( "--table-cache=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-table-cache=",
+			strlen ( "-table-cache=" ) ) == 0 ) ) {
+	    /* reuse filter tables from earlier runs */
+	    if ( *( strchr ( argv[argpt], '=' ) + 1 ) == '\0' ) {
+		fprintf ( stderr, "%s: missing --table-cache directory name!\n",
+			progname );
+		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+		return ( EXIT_FAILURE );    /* error exit */
+	    }
+	    DeVAS_table_cache_set_directory ( strchr ( argv[argpt], '=' ) + 1 );
+	    argpt++;
+
+	} else if ( ( strncasecmp ( argv[argpt], "--profile=",
+			strlen ( "--profile=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-profile=",
+			strlen ( "-profile=" ) ) == 0 ) ) {
+	    /* write Chrome trace event JSON */
+	    profile_file_name = strchr ( argv[argpt], '=' ) + 1;
+	    if ( *profile_file_name == '\0' ) {
+		fprintf ( stderr, "%s: missing --profile file name!\n",
+			progname );
+		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+		return ( EXIT_FAILURE );    /* error exit */
+	    }
+	    argpt++;
+
 	    /* "hidden" options: */
 	} else if ( ( strcasecmp ( argv[argpt], "--veryverbose" ) == 0 ) ||
 		( strcasecmp ( argv[argpt], "-veryverbose" ) == 0 ) ) {
@@ -912,7 +1161,41 @@ main ( int argc, char *argv[] )
 	    /* print CSF parameters then exit */
 	    ChungLeggeCSF_print_parms ( );
 	    /* argpt++; */
-	    exit ( EXIT_SUCCESS );
+	    return ( EXIT_SUCCESS );
+
+#ifndef DeVAS_VISIBILITY	/* code specific to devas-filter */
+
+	} else if ( ( strncasecmp ( argv[argpt], "--frames=",
+			strlen ( "--frames=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-frames=",
+			strlen ( "-frames=" ) ) == 0 ) ) {
+	    /* input and output file names are frame number patterns */
+	    if ( ( sscanf ( strchr ( argv[argpt], '=' ) + 1, "%d:%d%c",
+			    &first_frame, &last_frame, &frames_extra ) != 2 ) ||
+		    ( last_frame < first_frame ) ) {
+		fprintf ( stderr, "%s: invalid --frames value (%s)!\n",
+			progname, strchr ( argv[argpt], '=' ) + 1 );
+		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+		return ( EXIT_FAILURE );    /* error exit */
+	    }
+	    frames_set = TRUE;
+	    argpt++;
+
+	} else if ( ( strncasecmp ( argv[argpt], "--frame-list=",
+			strlen ( "--frame-list=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-frame-list=",
+			strlen ( "-frame-list=" ) ) == 0 ) ) {
+	    /* input and output file names for each frame */
+	    frame_list_file_name = strchr ( argv[argpt], '=' ) + 1;
+	    if ( *frame_list_file_name == '\0' ) {
+		fprintf ( stderr, "%s: missing --frame-list file name!\n",
+			progname );
+		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+		return ( EXIT_FAILURE );    /* error exit */
+	    }
+	    argpt++;
+
+#endif	/* DeVAS_VISIBILITY */
 
 #ifdef DeVAS_VISIBILITY	/* code specific to devas-visibility */
 
@@ -974,6 +1257,45 @@ main ( int argc, char *argv[] )
 		strlen ( "-falsepositives=" );
 	    argpt++;
 
+	} else if ( ( strncasecmp ( argv[argpt], "--png-compression=",
+			strlen ( "--png-compression=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-png-compression=",
+			strlen ( "-png-compression=" ) ) == 0 ) ) {
+	    png_compression_name = strchr ( argv[argpt], '=' ) + 1;
+	    if ( strcasecmp ( png_compression_name, "fast" ) == 0 ) {
+		DeVAS_png_set_compression ( DeVAS_PNG_COMPRESSION_FAST );
+	    } else if ( strcasecmp ( png_compression_name, "default" ) == 0 ) {
+		DeVAS_png_set_compression ( DeVAS_PNG_COMPRESSION_DEFAULT );
+	    } else if ( strcasecmp ( png_compression_name, "best" ) == 0 ) {
+		DeVAS_png_set_compression ( DeVAS_PNG_COMPRESSION_BEST );
+	    } else {
+		fprintf ( stderr, "%s: invalid --png-compression value (%s)!\n",
+			progname, png_compression_name );
+		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+		return ( EXIT_FAILURE );    /* error exit */
+	    }
+	    argpt++;
+
+	} else if ( ( strncasecmp ( argv[argpt], "--nearest-boundary=",
+			strlen ( "--nearest-boundary=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-nearest-boundary=",
+			strlen ( "-nearest-boundary=" ) ) == 0 ) ) {
+	    nearest_method_name = strchr ( argv[argpt], '=' ) + 1;
+	    if ( strcasecmp ( nearest_method_name, "auto" ) == 0 ) {
+		devas_visibility_set_nearest_method ( DeVAS_NEAREST_AUTO );
+	    } else if ( strcasecmp ( nearest_method_name, "transform" ) == 0 ) {
+		devas_visibility_set_nearest_method ( DeVAS_NEAREST_TRANSFORM );
+	    } else if ( strcasecmp ( nearest_method_name, "grid" ) == 0 ) {
+		devas_visibility_set_nearest_method ( DeVAS_NEAREST_GRID );
+	    } else {
+		fprintf ( stderr,
+			"%s: invalid --nearest-boundary value (%s)!\n",
+			progname, nearest_method_name );
+		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+		return ( EXIT_FAILURE );    /* error exit */
+	    }
+	    argpt++;
+
 	} else if ( strncasecmp ( argv[argpt], "--reciprocal=",
 		    strlen ( "--reciprocal=" ) ) == 0 ) {
 	    measurement_type = reciprocal_measure;
@@ -1228,6 +1550,19 @@ main ( int argc, char *argv[] )
 	approxSaturationquiet_flag = FALSE;
     }
 
+#ifndef DeVAS_VISIBILITY	/* code specific to devas-filter */
+    if ( frames_set && ( frame_list_file_name != NULL ) ) {
+	fprintf ( stderr, "%s: --frames and --frame-list both specified!\n",
+		progname );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	return ( EXIT_FAILURE );	/* error return */
+    }
+
+    if ( frame_list_file_name != NULL ) {
+	args_needed -= 2;	/* no input.hdr or output.hdr arguments */
+    }
+#endif	/* DeVAS_VISIBILITY */
+
     if ( ( argc - argpt ) != args_needed ) {
 	print_usage ( );
 	return ( EXIT_FAILURE );	/* error return */
@@ -1473,8 +1808,8 @@ main ( int argc, char *argv[] )
 	}
     }
 
-    /* find name of original Radiance file */
-    input_file_name = argv[argpt++];
+    /* find name of original Radiance file (none with --frame-list) */
+    input_file_name = ( argpt < argc ) ? argv[argpt++] : NULL;
 
 #ifdef DeVAS_VISIBILITY	/* code specific to devas-visibility */
 
@@ -1489,7 +1824,7 @@ main ( int argc, char *argv[] )
     /* code used by both devas-filter and devas-visibility */
 
     /* file name of output simulated low vision file */
-    filtered_image_file_name = argv[argpt++];
+    filtered_image_file_name = ( argpt < argc ) ? argv[argpt++] : NULL;
 
 #ifdef DeVAS_VISIBILITY	/* code specific to devas-visibility */
 
@@ -1529,100 +1864,87 @@ main ( int argc, char *argv[] )
 	acuity_adjustment = acuity;
     }
 
-    input_image = DeVAS_xyY_image_from_radfilename ( input_file_name );
+    if ( profile_file_name != NULL ) {
+	DeVAS_timing_trace_enable ( TRUE );
+    }
+    run_start = DeVAS_timing_start ( );
+
+#ifndef DeVAS_VISIBILITY	/* code specific to devas-filter */
+    if ( frames_set ) {
+	sequence = DeVAS_sequence_from_pattern ( input_file_name,
+		filtered_image_file_name, first_frame, last_frame );
+    } else if ( frame_list_file_name != NULL ) {
+	sequence = DeVAS_sequence_from_list ( frame_list_file_name );
+    }
+
+    if ( sequence != NULL ) {
+	filter_sequence ( sequence, clip_type, clip_value, margin,
+		fft_padding, acuity_adjustment, contrast_ratio,
+		smoothing_flag, saturation, argc, argv );
+	DeVAS_sequence_delete ( sequence );
+	DeVAS_fft_plan_cache_destroy ( );
+
+	if ( profile_file_name != NULL ) {
+	    DeVAS_timing_stop ( progname, run_start );
+	    DeVAS_timing_write_trace ( profile_file_name, progname );
+	    DeVAS_timing_trace_enable ( FALSE );
+	    DeVAS_timing_enable ( FALSE );
+	}
+
+	return ( EXIT_SUCCESS );	/* normal exit */
+    }
+#endif	/* DeVAS_VISIBILITY */
+
+    stage_start = DeVAS_timing_start ( );
+    if ( clip_type == auto_clip ) {
+	/* autoclip statistics are gathered while decoding */
+	luminance_stats = DeVAS_luminance_stats_new ( );
+    }
+    input_image = DeVAS_xyY_image_from_radfilename_stats ( input_file_name,
+	    luminance_stats );
     /*
      * DeVAS_xyY_image_from_radfilename copies VIEW record from Radiance
      * .hdr file to input_image object.
      */
+    DeVAS_timing_stop ( "read_input", stage_start );
 
-    switch ( clip_type ) {
-
-	case auto_clip:
-
-#ifndef	AUTO_CLIP_MEDIAN
-	    clip_value = auto_clip_level ( input_image );
-#else
-	    clip_value = auto_clip_level_median ( input_image );
-#endif	/* AUTO_CLIP_MEDIAN */
-	    if ( clip_value >= 0.0 ) {
-		clip_max_value ( input_image, clip_value );
-
-		if ( DeVAS_verbose ) {
-		    fprintf ( stderr, "autoclipped to <= %.2f\n", clip_value );
-		}
-	    } else if ( DeVAS_verbose ) {
-		fprintf ( stderr, "autoclip: clipping not needed\n" );
-	    }
-
-	    break;
+    stage_start = DeVAS_timing_start ( );
+    clip_input ( input_image, clip_type, clip_value, luminance_stats );
+    DeVAS_timing_stop ( "clip", stage_start );
 
-	case value_clip:
-
-	    clip_max_value ( input_image, clip_value );
+    margin_pixels ( margin, input_image, &v_margin, &h_margin );
 
-	    break;
-
-	case undefined_clip:
-	default:
-
-	    internal_error ( );
-	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+    /*
+     * Filter the image.  The margin (if any) is added to the luminance
+     * and chromaticity channels as the image is split apart inside
+     * devas_filter_margin ( ) and is stripped back off as the output is
+     * reassembled, so neither a padded copy of the input nor of the output
+     * is needed here.
+     */
+    stage_start = DeVAS_timing_start ( );
+    filtered_image = devas_filter_margin ( input_image, v_margin, h_margin,
+	    fft_padding, acuity_adjustment, contrast_ratio, smoothing_flag,
+	    saturation );
+    DeVAS_timing_stop ( "devas_filter", stage_start );
 
-	    break;
+    if ( DeVAS_veryverbose ) {
+	fprintf ( stderr,
+		"devas_filter ( %s, %.4f, %.4f, %d, %.2f )\n",
+		input_file_name, acuity_adjustment, contrast_ratio,
+		smoothing_flag, saturation );
     }
 
-    if ( margin > 0.0 ) {
-	/*
-	 * Add margin around input image to reduce problems with top-bottom
-	 * and left-right wraparound artifacts.
-	 */
-
-	/* margin sizes in pixels */
-	v_margin = (int) round ( 0.5 * margin *
-		DeVAS_image_n_rows ( input_image ) );
-	h_margin = (int) round ( 0.5 * margin *
-		DeVAS_image_n_cols ( input_image ) );
-
-#ifdef UNIFORM_MARGINS
-	/* make the margin based only on the smaller dimension */
-	if ( v_margin > h_margin ) {
-	    v_margin = h_margin;
-	} else {
-	    h_margin = v_margin;
-	}
-#endif	/* UNIFORM_MARGINS */
-
-	/* add the margin */
-	margin_image = DeVAS_xyY_add_margin ( v_margin, h_margin, input_image );
-
-	/* filter the padded image */
-	margin_filtered_image = devas_filter ( margin_image,
-		acuity_adjustment, contrast_ratio, smoothing_flag,
-		saturation );
-
-	if ( DeVAS_veryverbose ) {
-	    fprintf ( stderr,
-		    "devas_filter ( %s, %.4f, %.4f, %d, %.2f )\n",
-		    input_file_name, acuity_adjustment, contrast_ratio,
-		    smoothing_flag, saturation );
-	}
+#ifdef DeVAS_VISIBILITY	/* code specific to devas-visibility */
 
-	/* strip the padding back off */
-	filtered_image = DeVAS_xyY_strip_margin ( v_margin, h_margin,
-		margin_filtered_image );
+    /*
+     * Find areas darker than visibility threshold.
+     */
 
-#ifdef DeVAS_VISIBILITY	/* code specific to devas-visibility */
+    stage_start = DeVAS_timing_start ( );
 
-	/*
-	 * Find areas darker than visibility threshold.
-	 */
+    low_lum_sigma_pixels = angle2pixels ( low_lum_sigma_angle, input_image );
 
-	/* add the margin */
-	input_float = xyY2Y_image ( input_image );
-	margin_float =  DeVAS_float_add_margin ( v_margin, h_margin,
-		input_float );
-	low_lum_sigma_pixels = angle2pixels ( low_lum_sigma_angle,
-		input_float );
+    if ( margin > 0.0 ) {
 	if ( low_lum_sigma_pixels < STD_DEV_MIN ) {
 	    if ( DeVAS_verbose ) {
 		fprintf ( stderr,
@@ -1631,7 +1953,15 @@ main ( int argc, char *argv[] )
 	    }
 	    low_lum_sigma_pixels = STD_DEV_MIN;
 	}
-	luminance_smoothed_margin = DeVAS_float_gblur_fft ( margin_float,
+
+	/* padded luminance, made directly from the xyY input */
+	margin_float = DeVAS_float_image_new (
+		DeVAS_image_n_rows ( input_image ) + ( 2 * v_margin ),
+		DeVAS_image_n_cols ( input_image ) + ( 2 * h_margin ) );
+	DeVAS_xyY_add_margin_split ( v_margin, v_margin, h_margin, h_margin,
+		input_image, margin_float, NULL, NULL );
+
+	luminance_smoothed_margin = DeVAS_float_gblur_auto ( margin_float,
 		low_lum_sigma_pixels );
 	DeVAS_image_view ( luminance_smoothed_margin ) . vert =
 	    DeVAS_image_view ( margin_float ) .vert;
@@ -1640,81 +1970,43 @@ main ( int argc, char *argv[] )
 
 	luminance_smoothed = DeVAS_float_strip_margin ( v_margin, h_margin,
 		luminance_smoothed_margin );
-	DeVAS_float_image_delete ( input_float );
 	DeVAS_float_image_delete ( margin_float );
 	DeVAS_float_image_delete ( luminance_smoothed_margin );
-
-	low_luminance = luminance_threshold ( low_luminace_level,
-		luminance_smoothed );
-	DeVAS_float_image_delete ( luminance_smoothed );
-
-	if ( low_luminance_file_name != NULL ) {
-	    if ( low_luminance == NULL ) {
-		fprintf ( stderr,
-	"No low luminance pixels, so no low luminance file written\n" );
-	    } else {
-		make_visible ( low_luminance );
-
-		DeVAS_gray_image_to_filename_png ( low_luminance_file_name,
-			low_luminance );
-	    }
-	}
-#endif	/* DeVAS_VISIBILITY */
-
-    /* code used by both devas-filter and devas-visibility */
-
-	/* clean up */
-	DeVAS_xyY_image_delete ( margin_image );
-	DeVAS_xyY_image_delete ( margin_filtered_image );
-
     } else {
-
-	/* filter the unpadded image */
-	filtered_image = devas_filter ( input_image, acuity_adjustment,
-		contrast_ratio, smoothing_flag, saturation );
-
-	if ( DeVAS_veryverbose ) {
-	    fprintf ( stderr,
-		    "devas_filter ( %s, %.4f, %.4f, %d, %.2f )\n",
-		    input_file_name, acuity_adjustment, contrast_ratio,
-		    smoothing_flag, saturation );
-	}
-
-#ifdef DeVAS_VISIBILITY	/* code specific to devas-visibility */
-	/*
-	 * Find areas darker than visibility threshold.
-	 */
-
 	input_float = xyY2Y_image ( input_image );
-	low_lum_sigma_pixels = angle2pixels ( low_lum_sigma_angle,
-		input_float );
-	luminance_smoothed = DeVAS_float_gblur_fft ( input_float,
+	luminance_smoothed = DeVAS_float_gblur_auto ( input_float,
 		low_lum_sigma_pixels );
-	low_luminance = luminance_threshold ( low_luminace_level,
-		luminance_smoothed );
-	DeVAS_float_image_delete ( luminance_smoothed );
+	DeVAS_float_image_delete ( input_float );
+    }
 
-	if ( low_luminance_file_name != NULL ) {
-	    if ( low_luminance == NULL ) {
-		fprintf ( stderr,
+    low_luminance = luminance_threshold ( low_luminace_level,
+	    luminance_smoothed );
+    DeVAS_float_image_delete ( luminance_smoothed );
+
+    DeVAS_timing_stop ( "low_luminance", stage_start );
+
+    if ( low_luminance_file_name != NULL ) {
+	if ( low_luminance == NULL ) {
+	    fprintf ( stderr,
 	"No low luminance pixels, so no low luminance file written\n" );
-	    } else {
-		make_visible ( low_luminance );
+	} else {
+	    make_visible ( low_luminance );
 
-		DeVAS_gray_image_to_filename_png ( low_luminance_file_name,
-			low_luminance );
-	    }
+	    DeVAS_gray_image_to_filename_png ( low_luminance_file_name,
+		    low_luminance );
 	}
+    }
 #endif	/* DeVAS_VISIBILITY */
-    /* code used by both devas-filter and devas-visibility */
 
-    }
+    /* code used by both devas-filter and devas-visibility */
 
     /* add command line to description */
     add_description_arguments ( filtered_image, argc, argv );
 
     /* output radiance file */
+    stage_start = DeVAS_timing_start ( );
     DeVAS_xyY_image_to_radfilename ( filtered_image_file_name, filtered_image );
+    DeVAS_timing_stop ( "write_output", stage_start );
 
     /* clean up */
     DeVAS_xyY_image_delete ( input_image );
@@ -1722,10 +2014,13 @@ main ( int argc, char *argv[] )
 #ifdef DeVAS_VISIBILITY	/* code specific to devas-visibility */
 
     /* read in geometry files */
-    coordinates = DeVAS_coordinates_from_filename ( coordinates_file_name );
-    xyz = DeVAS_geom3d_from_radfilename ( xyz_file_name );
-    dist = DeVAS_geom1d_from_radfilename ( dist_file_name );
-    nor = DeVAS_geom3d_from_radfilename ( nor_file_name );
+    stage_start = DeVAS_timing_start ( );
+    coordinates =
+	DeVAS_coordinates_from_filename_cached ( coordinates_file_name );
+    xyz = DeVAS_geom3d_from_radfilename_cached ( xyz_file_name );
+    dist = DeVAS_geom1d_from_radfilename_cached ( dist_file_name );
+    nor = DeVAS_geom3d_from_radfilename_cached ( nor_file_name );
+    DeVAS_timing_stop ( "read_geometry", stage_start );
 
     if ( !DeVAS_image_samesize ( xyz, filtered_image ) ) {
 	fprintf ( stderr, "size mismatch with xyz image!\n" );
@@ -1765,6 +2060,7 @@ main ( int argc, char *argv[] )
      * boundary.
      */
 
+    stage_start = DeVAS_timing_start ( );
     if ( false_positives_file_name != NULL ) {
 	hazards = devas_visibility ( filtered_image, coordinates, xyz, dist,
 		nor,
@@ -1779,6 +2075,7 @@ main ( int argc, char *argv[] )
 		position_threshold, orientation_threshold,
 		&luminance_boundaries, &geometry_boundaries, NULL );
     }
+    DeVAS_timing_stop ( "devas_visibility", stage_start );
 
     if ( luminance_boundaries_file_name != NULL ) {
 	make_visible ( luminance_boundaries );
@@ -1803,10 +2100,12 @@ main ( int argc, char *argv[] )
      * are not visible at specified level of low vision.
      */
 
+    stage_start = DeVAS_timing_start ( );
     hazards_visualization =
 	visualize_hazards ( hazards, measurement_type, scale_parameter,
 		visualization_type, low_luminance, ROI, &geometry_boundaries,
 		&hazard_average );
+    DeVAS_timing_stop ( "visualize_hazards", stage_start );
 
     if ( print_average ) {
 	printf ( "Hazard Visibility Score = %.3f\n", hazard_average );
@@ -1823,9 +2122,10 @@ main ( int argc, char *argv[] )
     }
 #endif	/* DeVAS_USE_CAIRO */
 
+    stage_start = DeVAS_timing_start ( );
     DeVAS_RGB_image_to_filename_png ( hazards_file_name,
 	    hazards_visualization );
-
+    DeVAS_timing_stop ( "write_hazards", stage_start );
 
     /* clean up */
     DeVAS_float_image_delete ( hazards );
@@ -1839,6 +2139,7 @@ main ( int argc, char *argv[] )
 
     /* compute and write false positive information if requested */
     if ( false_positives_file_name != NULL ) {
+	stage_start = DeVAS_timing_start ( );
 	fp_visualization = 
 	    visualize_hazards ( false_positive_hazards, measurement_type,
 		    scale_parameter, visualization_type_fp,
@@ -1846,6 +2147,7 @@ main ( int argc, char *argv[] )
 
 	DeVAS_RGB_image_to_filename_png ( false_positives_file_name,
 		fp_visualization );
+	DeVAS_timing_stop ( "write_false_positives", stage_start );
 
 	DeVAS_float_image_delete ( false_positive_hazards );
 	DeVAS_RGB_image_delete ( fp_visualization );
@@ -1861,10 +2163,116 @@ main ( int argc, char *argv[] )
 
     /* clean up */
     DeVAS_xyY_image_delete ( filtered_image );
+#ifdef DeVAS_USE_SERVER
+    if ( ! server_mode ) {	/* plans are reused by later jobs */
+	DeVAS_fft_plan_cache_destroy ( );
+    }
+#else
+    DeVAS_fft_plan_cache_destroy ( );
+#endif	/* DeVAS_USE_SERVER */
+
+    if ( profile_file_name != NULL ) {
+	DeVAS_timing_stop ( progname, run_start );
+	DeVAS_timing_write_trace ( profile_file_name, progname );
+	DeVAS_timing_trace_enable ( FALSE );
+	DeVAS_timing_enable ( FALSE );
+    }
 
     return ( EXIT_SUCCESS );	/* normal exit */
 }
 
+#ifdef DeVAS_USE_SERVER
+
+static int
+devas_server ( int argc, char *argv[] )
+/*
+ * devas-visibility --server=<socket> [--workers=<n>] [--threads=<n>]
+ *	[--geometry-cache=<n>]
+ */
+{
+    char    *socket_path;
+    int	    n_processors;
+    int	    n_workers;
+    int	    n_threads = 0;		/* 0: share processors among workers */
+    int	    geometry_cache_size = SERVER_GEOMETRY_CACHE_SIZE;
+    int	    argpt;
+
+    progname = basename ( argv[0] );
+
+    socket_path = strchr ( argv[1], '=' ) + 1;
+    n_processors = (int) sysconf ( _SC_NPROCESSORS_ONLN );
+    if ( n_processors < 1 ) {
+	n_processors = 1;
+    }
+    n_workers = n_processors;
+
+    for ( argpt = 2; argpt < argc; argpt++ ) {
+	if ( ( strncasecmp ( argv[argpt], "--workers=",
+			strlen ( "--workers=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-workers=",
+			strlen ( "-workers=" ) ) == 0 ) ) {
+	    n_workers = atoi ( strchr ( argv[argpt], '=' ) + 1 );
+	    if ( n_workers < 1 ) {
+		fprintf ( stderr, "%s: invalid --workers value (%s)!\n",
+			progname, argv[argpt] );
+		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+		return ( EXIT_FAILURE );    /* error exit */
+	    }
+
+	} else if ( ( strncasecmp ( argv[argpt], "--threads=",
+			strlen ( "--threads=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-threads=",
+			strlen ( "-threads=" ) ) == 0 ) ) {
+	    n_threads = atoi ( strchr ( argv[argpt], '=' ) + 1 );
+	    if ( n_threads < 1 ) {
+		fprintf ( stderr, "%s: invalid --threads value (%s)!\n",
+			progname, argv[argpt] );
+		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+		return ( EXIT_FAILURE );    /* error exit */
+	    }
+
+	} else if ( ( strncasecmp ( argv[argpt], "--geometry-cache=",
+			strlen ( "--geometry-cache=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-geometry-cache=",
+			strlen ( "-geometry-cache=" ) ) == 0 ) ) {
+	    geometry_cache_size = atoi ( strchr ( argv[argpt], '=' ) + 1 );
+	    if ( geometry_cache_size < 0 ) {
+		fprintf ( stderr, "%s: invalid --geometry-cache value (%s)!\n",
+			progname, argv[argpt] );
+		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+		return ( EXIT_FAILURE );    /* error exit */
+	    }
+
+	} else {
+	    fprintf ( stderr, "%s: invalid flag with --server (%s)!\n",
+		    progname, argv[argpt] );
+	    print_usage ( );
+	    return ( EXIT_FAILURE );    /* error exit */
+	}
+    }
+
+    if ( strlen ( socket_path ) == 0 ) {
+	fprintf ( stderr, "%s: missing --server socket name!\n", progname );
+	return ( EXIT_FAILURE );    /* error exit */
+    }
+
+    /* one thread per processor in all, rather than per worker */
+    if ( n_threads == 0 ) {
+	n_threads = n_processors / n_workers;
+	if ( n_threads < 1 ) {
+	    n_threads = 1;
+	}
+    }
+
+    server_mode = TRUE;
+    DeVAS_geometry_cache_set_size ( geometry_cache_size );
+
+    return ( DeVAS_server ( socket_path, n_workers, n_threads, progname,
+		devas_commandline ) );
+}
+
+#endif	/* DeVAS_USE_SERVER */
+
 static void
 add_description_arguments ( DeVAS_xyY_image *image, int argc, char *argv[] )
 /*
@@ -1894,12 +2302,186 @@ add_description_arguments ( DeVAS_xyY_image *image, int argc, char *argv[] )
 	strcat_safe ( DeVAS_image_description ( image ), "\n" );
 }
 
+static void
+clip_input ( DeVAS_xyY_image *input_image, ClipType clip_type,
+	double clip_value, DeVAS_luminance_stats *luminance_stats )
+/*
+ * Clip large luminance values as specified by --autoclip or --clip.
+ * For auto_clip, luminance_stats must hold the statistics gathered while
+ * reading input_image, and is deleted.
+ */
+{
+    switch ( clip_type ) {
+
+	case auto_clip:
+
+	    clip_value = DeVAS_auto_clip_level_stats ( input_image,
+		    luminance_stats );
+	    DeVAS_luminance_stats_delete ( luminance_stats );
+	    if ( clip_value >= 0.0 ) {
+		DeVAS_clip_max_value ( input_image, clip_value );
+
+		if ( DeVAS_verbose ) {
+		    fprintf ( stderr, "autoclipped to <= %.2f\n", clip_value );
+		}
+	    } else if ( DeVAS_verbose ) {
+		fprintf ( stderr, "autoclip: clipping not needed\n" );
+	    }
+
+	    break;
+
+	case value_clip:
+
+	    DeVAS_clip_max_value ( input_image, clip_value );
+
+	    break;
+
+	case undefined_clip:
+	default:
+
+	    internal_error ( );
+	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+
+	    break;
+    }
+}
+
+static void
+margin_pixels ( double margin, DeVAS_xyY_image *input_image, int *v_margin,
+	int *h_margin )
+/*
+ * Size in pixels of the --margin added around input_image.
+ */
+{
+    if ( margin > 0.0 ) {
+	/*
+	 * Add margin around input image to reduce problems with top-bottom
+	 * and left-right wraparound artifacts.
+	 */
+
+	/* margin sizes in pixels */
+	*v_margin = (int) round ( 0.5 * margin *
+		DeVAS_image_n_rows ( input_image ) );
+	*h_margin = (int) round ( 0.5 * margin *
+		DeVAS_image_n_cols ( input_image ) );
+
+#ifdef UNIFORM_MARGINS
+	/* make the margin based only on the smaller dimension */
+	if ( *v_margin > *h_margin ) {
+	    *v_margin = *h_margin;
+	} else {
+	    *h_margin = *v_margin;
+	}
+#endif	/* UNIFORM_MARGINS */
+
+    } else {
+	*v_margin = *h_margin = 0;
+    }
+}
+
+#ifndef DeVAS_VISIBILITY	/* code specific to devas-filter */
+
+static void
+filter_sequence ( DeVAS_sequence *sequence, ClipType clip_type,
+	double clip_value, double margin, int fft_padding,
+	double acuity_adjustment, double contrast_ratio, int smoothing_flag,
+	double saturation, int argc, char *argv[] )
+/*
+ * Filter every frame of sequence, reading the next frame and writing the
+ * previous one while each frame is filtered.  FFT plans are kept by
+ * devas-fft-plan.c, and the log2r and CSF weight tables are kept for the
+ * duration of the sequence, so frames of the same size only pay for the
+ * filtering itself.  Reports the number of frames filtered per second.
+ */
+{
+    DeVAS_luminance_stats   *luminance_stats = NULL;	/* for autoclip */
+    DeVAS_luminance_stats   *next_luminance_stats = NULL;
+    DeVAS_xyY_image	    *input_image;
+    DeVAS_xyY_image	    *filtered_image;
+    int			    frame;
+    int			    v_margin, h_margin;
+    double		    sequence_start;
+    double		    seconds;
+    double		    stage_start;
+
+    devas_filter_keep_tables ( TRUE );
+
+    sequence_start = DeVAS_timing_now ( );
+
+    if ( clip_type == auto_clip ) {
+	/* autoclip statistics are gathered while decoding */
+	next_luminance_stats = DeVAS_luminance_stats_new ( );
+    }
+    DeVAS_sequence_read_start ( sequence, 0, next_luminance_stats );
+
+    for ( frame = 0; frame < DeVAS_sequence_n_frames ( sequence ); frame++ ) {
+	stage_start = DeVAS_timing_start ( );
+	input_image = DeVAS_sequence_read_finish ( sequence );
+	luminance_stats = next_luminance_stats;
+	DeVAS_timing_stop ( "read_input", stage_start );
+
+	if ( DeVAS_verbose ) {
+	    fprintf ( stderr, "frame %d: %s -> %s\n", frame,
+		    DeVAS_sequence_input_file_name ( sequence, frame ),
+		    DeVAS_sequence_output_file_name ( sequence, frame ) );
+	}
+
+	/* read the next frame while this one is filtered */
+	if ( ( frame + 1 ) < DeVAS_sequence_n_frames ( sequence ) ) {
+	    if ( clip_type == auto_clip ) {
+		next_luminance_stats = DeVAS_luminance_stats_new ( );
+	    }
+	    DeVAS_sequence_read_start ( sequence, frame + 1,
+		    next_luminance_stats );
+	}
+
+	stage_start = DeVAS_timing_start ( );
+	clip_input ( input_image, clip_type, clip_value, luminance_stats );
+	DeVAS_timing_stop ( "clip", stage_start );
+
+	margin_pixels ( margin, input_image, &v_margin, &h_margin );
+
+	stage_start = DeVAS_timing_start ( );
+	filtered_image = devas_filter_margin ( input_image, v_margin,
+		h_margin, fft_padding, acuity_adjustment, contrast_ratio,
+		smoothing_flag, saturation );
+	DeVAS_timing_stop ( "devas_filter", stage_start );
+
+	DeVAS_xyY_image_delete ( input_image );
+
+	/* add command line to description */
+	add_description_arguments ( filtered_image, argc, argv );
+
+	/* written while the next frame is filtered */
+	stage_start = DeVAS_timing_start ( );
+	DeVAS_sequence_write_start ( sequence, frame, filtered_image );
+	DeVAS_timing_stop ( "write_output", stage_start );
+    }
+
+    stage_start = DeVAS_timing_start ( );
+    DeVAS_sequence_write_finish ( sequence );
+    DeVAS_timing_stop ( "write_output", stage_start );
+
+    devas_filter_keep_tables ( FALSE );
+
+    seconds = DeVAS_timing_now ( ) - sequence_start;
+    fprintf ( stderr, "%d frames in %.2f seconds (%.2f frames/second)\n",
+	    DeVAS_sequence_n_frames ( sequence ), seconds,
+	    DeVAS_sequence_n_frames ( sequence ) / seconds );
+}
+
+#endif	/* DeVAS_VISIBILITY */
+
 static void
 print_usage ( void )
 {
     fprintf ( stderr, "%s %s\n", progname, Usage );
     fprintf ( stderr, "\t\t\tor\n" );
     fprintf ( stderr, "%s %s\n", progname, Usage2 );
+#ifdef DeVAS_USE_SERVER
+    fprintf ( stderr, "\t\t\tor\n" );
+    fprintf ( stderr, "%s %s\n", progname, Usage3 );
+#endif	/* DeVAS_USE_SERVER */
 }
 
 static void
@@ -1971,201 +2553,6 @@ contrastratio2PelliRobson ( double contrast_ratio )
     return ( PelliRobson_score );
 }
 
-#ifndef AUTO_CLIP_MEDIAN
-static double
-auto_clip_level ( DeVAS_xyY_image *image )
-/*
- * Suggests a clip level to apply to extreamly bright pixels to reduce
- * filter ringing.
- *
- * Uses a variant of the RADIANCE glare identification heuristic.  First,
- * average luminance is computed and used to set a preliminary glare
- * threshold value.  This average is not a robust estimator, since it is
- * strongly affected by very bright glare pixels or glare pixels covering
- * a large portion of the image.  To compensate for this, a second pass
- * is done in which a revised average luminance is computed based only on
- * pixels <= the preliminary glare threshold.  This revised average luminance
- * is then used to compute a revised glare threshold, which is returned as
- * the value of the function.
- *
- * NO_CLIP_LEVEL is returned if no clipping is needed.
- */
-{
-    int		    row, col;
-    double	    max_luminance;
-    double	    average_luminance_initial;
-    double	    average_luminance_revised;
-    double	    cutoff_initial;
-    double	    cutoff_revised;
-    unsigned int    glare_count;
-
-    /* first pass */
-
-    max_luminance = average_luminance_initial = 0.0;
-
-    for ( row = 0; row < DeVAS_image_n_rows ( image ); row++ ) {
-	for ( col = 0; col < DeVAS_image_n_cols ( image ); col++ ) {
-	    if ( max_luminance < DeVAS_image_data (image, row, col ) . Y ) {
-		max_luminance = DeVAS_image_data (image, row, col ) . Y;
-	    }
-
-	    average_luminance_initial +=
-		DeVAS_image_data (image, row, col ) . Y;
-	}
-    }
-
-    average_luminance_initial /=
-	( ((double) DeVAS_image_n_rows ( image ) ) *
-	    ((double) DeVAS_image_n_cols ( image ) ) );
-    cutoff_initial = CUTOFF_RATIO_MEAN * average_luminance_initial;
-
-    if ( cutoff_initial >= max_luminance ) {
-	/* no need for glare source clipping */
-	return ( NO_CLIP_LEVEL );
-    }
-
-    /* second pass */
-
-    average_luminance_revised = 0.0;
-    glare_count = 0;
-
-    for ( row = 0; row < DeVAS_image_n_rows ( image ); row++ ) {
-	for ( col = 0; col < DeVAS_image_n_cols ( image ); col++ ) {
-	    if ( DeVAS_image_data ( image, row, col ) . Y >
-		    cutoff_initial ) {
-		glare_count++;
-	    } else {
-		average_luminance_revised +=
-		    DeVAS_image_data (image, row, col) . Y;
-	    }
-	}
-    }
-
-    average_luminance_revised /=
-	( ( ((double) DeVAS_image_n_rows ( image ) ) *
-	    ((double) DeVAS_image_n_cols ( image ) ) ) -
-	  ( (double) glare_count ) );
-    cutoff_revised = CUTOFF_RATIO_MEAN * average_luminance_revised;
-
-    /* printf ( "clip_level = %f\n", cutoff_revised ); */
-
-    return ( cutoff_revised );
-}
-
-#else
-
-#define	MAGNITUDE_HIST_NBINS	1000
-#define	MEDIAN_EPSILON		0.0001	/* Used to avoid a boundary condition */
-					/* computing percentile bin numbers. */
-
-static double
-auto_clip_level_median ( DeVAS_xyY_image *image )
-/*
- * Suggests a clip level to apply to extreamly bright pixels to reduce
- * filter ringing.
- *
- * Uses a variant of the RADIANCE glare identification heuristic based on
- * a multiple of the median luminance.
- *
- * NO_CLIP_LEVEL is returned if no clipping is needed.
- */
-{
-    int		    row, col;
-    int		    n_rows, n_cols;
-    unsigned int    magnitude_hist[MAGNITUDE_HIST_NBINS];
-    int		    bin;
-    double	    max_luminance;
-    double	    norm;
-    unsigned int    total_count;
-    double	    percentile;
-    double	    previous_percentile;
-    double	    median;
-    double	    cutoff;
-
-    n_rows = DeVAS_image_n_rows ( image );
-    n_cols = DeVAS_image_n_cols ( image );
-
-    for ( bin = 0; bin < MAGNITUDE_HIST_NBINS; bin++ ) {
-	magnitude_hist[bin] = 0;
-    }
-
-    max_luminance = 0.0;
-
-    for ( row = 0; row < n_rows; row++ ) {
-	for ( col = 0; col < n_cols; col++ ) {
-	    max_luminance = fmax ( max_luminance,
-		    DeVAS_image_data (image, row, col ) . Y );
-	}
-    }
-
-    if ( max_luminance <= 0.0 ) {
-	fprintf ( stderr, "auto_clip_median: no non-zero luminance!\n" );
-	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
-	exit ( EXIT_FAILURE );
-    }
-
-    /* Spread out luminance values amoung histogram bins. */
-    norm = 1.0 / max_luminance;
-    for ( row = 1; row < n_rows - 1; row++ ) {
-	for ( col = 1; col < n_cols - 1; col++ ) {
-	    bin = norm * DeVAS_image_data ( image, row, col ) . Y *
-		( ( (double) MAGNITUDE_HIST_NBINS ) - MEDIAN_EPSILON );
-	    magnitude_hist[bin]++;
-	}
-    }
-
-    percentile = 0.0;
-    previous_percentile = -1.0;
-    total_count = n_rows * n_cols;
-
-    /* Search for bin index corresponding to median (percentile == 0.5. */
-    for ( bin = MAGNITUDE_HIST_NBINS - 1; bin >= 0; bin-- ) {
-	percentile += ((double) magnitude_hist[bin] ) / ((double) total_count );
-
-	if ( percentile > 0.5 ) {
-	    if ( ( 0.5 - previous_percentile ) < ( percentile - 0.5 ) ) {
-		bin--;
-	    }
-
-	    break;
-	}
-    }
-
-    median = ( ((double) bin ) + 0.5 ) /
-	( ((double) MAGNITUDE_HIST_NBINS ) - MEDIAN_EPSILON ) * max_luminance;
-
-    cutoff = CUTOFF_RATIO_MEDIAN * median;
-
-    /* printf ( "median = %f, maximum = %f", median, max_luminance ); */
-
-    if ( cutoff >= max_luminance ) {
-	/* printf ( ", no clipping\n" ); */
-	return ( NO_CLIP_LEVEL );
-    } else {
-	/* printf ( ", clip level = %f\n", cutoff ); */
-	return ( cutoff );
-    }
-}
-
-#endif
-
-void
-clip_max_value ( DeVAS_xyY_image *image, double clip_value )
-/*
- * In-pace clipping of xyY image object luminance (Y) values.
- */
-{
-    int	    row, col;
-
-    for ( row = 0; row < DeVAS_image_n_rows ( image ); row++ ) {
-	for ( col = 0; col < DeVAS_image_n_cols ( image ); col++ ) {
-	    if ( DeVAS_image_data ( image, row, col ) . Y > clip_value ) {
-		DeVAS_image_data ( image, row, col ) . Y = clip_value;
-	    }
-	}
-    }
-}
-
 #ifdef DeVAS_VISIBILITY	/* code specific to devas-visibility */
 
 static DeVAS_float_image *
@@ -2231,23 +2618,23 @@ luminance_threshold ( double low_luminace_level,
 }
 
 static double
-angle2pixels ( double low_lum_sigma_angle, DeVAS_float_image *input_float )
+angle2pixels ( double low_lum_sigma_angle, DeVAS_xyY_image *input_image )
 {
     double  fov_angle, fov_pixels;
     double  low_lum_sigma_pixels;
 
-    fov_angle = fmax ( DeVAS_image_view ( input_float ) . vert,
-	    DeVAS_image_view ( input_float ) . horiz );
+    fov_angle = fmax ( DeVAS_image_view ( input_image ) . vert,
+	    DeVAS_image_view ( input_image ) . horiz );
     if ( fov_angle <= 0.0 ) {
 	fprintf ( stderr, "angle2pixels: invalid or missing fov (%f, %f)!\n",
-		DeVAS_image_view ( input_float ) . vert,
-		DeVAS_image_view ( input_float ) . horiz );
+		DeVAS_image_view ( input_image ) . vert,
+		DeVAS_image_view ( input_image ) . horiz );
 	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
 	exit ( EXIT_FAILURE );
     }
 
-    fov_pixels = imax ( DeVAS_image_n_rows ( input_float ),
-	    DeVAS_image_n_cols ( input_float ) );
+    fov_pixels = imax ( DeVAS_image_n_rows ( input_image ),
+	    DeVAS_image_n_cols ( input_image ) );
 
     low_lum_sigma_pixels = low_lum_sigma_angle * ( fov_pixels / fov_angle );
 
@@ -5,6 +5,7 @@
 #include <strings.h>
 #include <string.h>
 #include "dilate.h"
+#include "devas-edge-list.h"
 #include "devas-visibility.h"
 #include "visualize-hazards.h"
 #include "devas-image.h"
@@ -25,14 +26,38 @@ char	*Usage =
 #ifdef DeVAS_USE_CAIRO
 	"\n\t[--quantscore] [--fontsize=<n>]"
 #endif	/* DeVAS_USE_CAIRO */
-	"\n\t[--mask=<mask-filename>]"
-	"\n\tstandard.png comparison.png coord visualization.png";
+	"\n\t[--mask=<mask-filename>] [--scores=<filename>.csv|.json]"
+	"\n\tstandard.png comparison.png coord visualization.png"
+	"\n  or"
+	"\ndevas-compare-boundaries --multi [options]"
+	"\n\tstandard.png coord comparison.png visualization.png"
+	"\n\t[comparison.png visualization.png ...]";
 int	args_needed = 4;
 
+/*
+ * --multi compares one standard against any number of comparison boundary
+ * sets, reading the standard, coordinates, and mask once.  Distance
+ * transforms for the different comparisons are computed in parallel.
+ * A visualization is written for each comparison.
+ *
+ * --scores=<filename> writes a table of matching scores (the same value
+ * as printed by --quantscore, but excluding masked pixels), one row per
+ * comparison, as JSON if <filename> ends in .json and as CSV otherwise.
+ * With --multi and no --scores, the CSV table is written to stdout.
+ */
+
 int		    imax ( int a, int b );
-DeVAS_float_image    *compute_hazards ( DeVAS_gray_image *standard,
+DeVAS_float_image    *compute_hazards ( DeVAS_edge_list *standard,
 			DeVAS_float_image *comparison_edge_distance,
 			double degrees_per_pixel );
+DeVAS_float_image    *comparison_hazards ( char *comparison_name,
+			DeVAS_edge_list *standard, double degrees_per_pixel );
+void		    write_scores ( FILE *output, int json_flag,
+			char *standard_name, int n_comparisons,
+			char **comparison_names, double *scores,
+			Measurement_type measurement_type,
+			double scale_parameter );
+void		    write_quoted ( FILE *output, char *string, int json_flag );
 void		    make_visible ( DeVAS_gray_image *boundaries );
 
 #ifdef DeVAS_USE_CAIRO
@@ -66,16 +91,24 @@ main ( int argc, char *argv[] )
 #endif	/* DeVAS_USE_CAIRO */
 
     DeVAS_gray_image	*standard;
+    DeVAS_edge_list	*standard_edges;
     char		*standard_name;
-    DeVAS_gray_image	*comparison;
-    char		*comparison_name;
+    char		*coordinates_name;
+    int			multi_flag = FALSE;
+    int			n_comparisons;
+    char		**comparison_names;
+    char		**visualization_names;
     DeVAS_coordinates	*coordinates;
     double		degrees_per_pixel;
-    DeVAS_float_image	*comparison_edge_distance;
-    DeVAS_float_image	*hazards;
+    DeVAS_float_image	**hazards;
+    double		*scores;
     DeVAS_RGB_image	*hazards_visualization;
     char		*mask_file_name = NULL;
     DeVAS_gray_image	*mask = NULL;
+    char		*scores_file_name = NULL;
+    FILE		*scores_file;
+    int			json_flag;
+    int			i;
     int			argpt = 1;
 
     while ( ( ( argc - argpt ) >= 1 ) && ( argv[argpt][0] == '-' ) ) {
@@ -146,6 +179,21 @@ main ( int argc, char *argv[] )
 	    mask_file_name = argv[argpt] + strlen ( "-mask=" );
 	    argpt++;
 
+	} else if ( ( strcasecmp ( argv[argpt], "--multi" ) == 0 ) ||
+		( strcasecmp ( argv[argpt], "-multi" ) == 0 ) ) {
+	    multi_flag = TRUE;
+	    argpt++;
+
+	} else if ( strncasecmp ( argv[argpt], "--scores=",
+		    strlen ( "--scores=" ) ) == 0 ) {
+	    scores_file_name = argv[argpt] + strlen ( "--scores=" );
+	    argpt++;
+
+	} else if ( strncasecmp ( argv[argpt], "-scores=",
+		    strlen ( "-scores=" ) ) == 0 ) {
+	    scores_file_name = argv[argpt] + strlen ( "-scores=" );
+	    argpt++;
+
 	/* hidden options */
 #ifdef DeVAS_USE_CAIRO
 	} else if ( strncasecmp ( argv[argpt], "--log=",
@@ -166,44 +214,67 @@ main ( int argc, char *argv[] )
 	}
     }
 
-    if ( ( argc - argpt ) != args_needed ) {
-	fprintf ( stderr, "%s\n", Usage );
-	return ( EXIT_FAILURE );        /* error return */
+    if ( multi_flag ) {
+	if ( ( ( argc - argpt ) < args_needed ) ||
+		( ( ( argc - argpt ) % 2 ) != 0 ) ) {
+	    fprintf ( stderr, "%s\n", Usage );
+	    return ( EXIT_FAILURE );        /* error return */
+	}
+	n_comparisons = ( argc - argpt - 2 ) / 2;
+    } else {
+	if ( ( argc - argpt ) != args_needed ) {
+	    fprintf ( stderr, "%s\n", Usage );
+	    return ( EXIT_FAILURE );        /* error return */
+	}
+	n_comparisons = 1;
     }
 
-    standard_name = argv[argpt++];
-    standard = DeVAS_gray_image_from_filename_png ( standard_name );
-    comparison_name = argv[argpt++];
-    comparison = DeVAS_gray_image_from_filename_png ( comparison_name );
-
-    if ( !DeVAS_image_samesize ( standard, comparison ) ) {
-	fprintf ( stderr, "%s and %s not same size!\n", standard_name,
-		comparison_name );
+    comparison_names = (char **) malloc ( n_comparisons * sizeof ( char * ) );
+    visualization_names =
+	(char **) malloc ( n_comparisons * sizeof ( char * ) );
+    hazards = (DeVAS_float_image **)
+	malloc ( n_comparisons * sizeof ( DeVAS_float_image * ) );
+    scores = (double *) malloc ( n_comparisons * sizeof ( double ) );
+    if ( ( comparison_names == NULL ) || ( visualization_names == NULL ) ||
+	    ( hazards == NULL ) || ( scores == NULL ) ) {
+	fprintf ( stderr, "devas-compare-boundaries: malloc failed!\n" );
 	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
 	return ( EXIT_FAILURE );        /* error return */
     }
 
-    coordinates = DeVAS_coordinates_from_filename ( argv[argpt++] );
+    standard_name = argv[argpt++];
+    if ( multi_flag ) {
+	coordinates_name = argv[argpt++];
+	for ( i = 0; i < n_comparisons; i++ ) {
+	    comparison_names[i] = argv[argpt++];
+	    visualization_names[i] = argv[argpt++];
+	}
+    } else {
+	comparison_names[0] = argv[argpt++];
+	coordinates_name = argv[argpt++];
+	visualization_names[0] = argv[argpt++];
+    }
+
+    standard = DeVAS_gray_image_from_filename_png ( standard_name );
+    standard_edges = DeVAS_edge_list_from_gray_image ( standard );
+
+    coordinates = DeVAS_coordinates_from_filename ( coordinates_name );
 
     degrees_per_pixel = fmax ( coordinates->view.vert,
 	    coordinates->view.horiz ) /
 	((double) imax ( DeVAS_image_n_rows ( standard ),
 	    DeVAS_image_n_cols ( standard ) ) );
 
-    /* squared-distance transform */
-    comparison_edge_distance = dt_euclid_sq ( comparison );
-
     /*
      * Compute distance, represented as a visual angle, from each standard
-     * boundary pixel to nearest comparison boundary pixel.
+     * boundary pixel to nearest comparison boundary pixel.  The distance
+     * transforms for different comparisons are independent.
      */
-
-    hazards = compute_hazards ( standard, comparison_edge_distance,
-	    degrees_per_pixel );
-
-    /* clean up */
-    DeVAS_gray_image_delete ( comparison );
-    DeVAS_float_image_delete ( comparison_edge_distance );
+#pragma omp parallel for schedule ( dynamic )
+    for ( i = 0; i < n_comparisons; i++ ) {
+	hazards[i] = comparison_hazards ( comparison_names[i],
+		standard_edges, degrees_per_pixel );
+    }
 
     switch ( measurement_type ) {
 	case reciprocal_measure:
@@ -228,31 +299,58 @@ main ( int argc, char *argv[] )
 	mask = DeVAS_gray_image_from_filename_png ( mask_file_name );
     }
 
-    hazards_visualization = visualize_hazards ( hazards, measurement_type,
-	    scale_parameter, visualization_type, mask, NULL, &standard, NULL );
-
-    /* clean up */
-    DeVAS_gray_image_delete ( standard );
+    for ( i = 0; i < n_comparisons; i++ ) {
+	hazards_visualization = visualize_hazards ( hazards[i],
+		measurement_type, scale_parameter, visualization_type, mask,
+		NULL, &standard, &scores[i] );
 
 #ifdef DeVAS_USE_CAIRO
-    if ( quantscore ) {
-	add_quantscore ( standard_name, comparison_name, hazards,
-		hazards_visualization, text_font_size,
-		measurement_type, scale_parameter,
-		visualization_type,
-		log_output_flag, log_output_filename );
-    }
+	if ( quantscore ) {
+	    add_quantscore ( standard_name, comparison_names[i], hazards[i],
+		    hazards_visualization, text_font_size,
+		    measurement_type, scale_parameter,
+		    visualization_type,
+		    log_output_flag, log_output_filename );
+	}
 #endif	/* DeVAS_USE_CAIRO */
 
-    DeVAS_RGB_image_to_filename_png ( argv[argpt++], hazards_visualization );
+	DeVAS_RGB_image_to_filename_png ( visualization_names[i],
+		hazards_visualization );
+
+	/* clean up */
+	DeVAS_float_image_delete ( hazards[i] );
+	DeVAS_RGB_image_delete ( hazards_visualization );
+    }
+
+    if ( scores_file_name != NULL ) {
+	json_flag = ( strlen ( scores_file_name ) >= strlen ( ".json" ) ) &&
+	    ( strcasecmp ( scores_file_name + strlen ( scores_file_name ) -
+			   strlen ( ".json" ), ".json" ) == 0 );
+	scores_file = fopen ( scores_file_name, "w" );
+	if ( scores_file == NULL ) {
+	    perror ( scores_file_name );
+	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	    return ( EXIT_FAILURE );        /* error return */
+	}
+	write_scores ( scores_file, json_flag, standard_name, n_comparisons,
+		comparison_names, scores, measurement_type, scale_parameter );
+	fclose ( scores_file );
+    } else if ( multi_flag ) {
+	write_scores ( stdout, FALSE, standard_name, n_comparisons,
+		comparison_names, scores, measurement_type, scale_parameter );
+    }
 
     /* clean up */
-    DeVAS_float_image_delete ( hazards );
-    DeVAS_RGB_image_delete ( hazards_visualization );
+    DeVAS_gray_image_delete ( standard );
+    DeVAS_edge_list_delete ( standard_edges );
     DeVAS_coordinates_delete ( coordinates );
     if ( mask_file_name != NULL ) {
 	DeVAS_gray_image_delete ( mask );
     }
+    free ( comparison_names );
+    free ( visualization_names );
+    free ( hazards );
+    free ( scores );
 
     return ( EXIT_SUCCESS );	/* normal exit */
 }
@@ -268,13 +366,13 @@ imax ( int a, int b )
 }
 
 DeVAS_float_image *
-compute_hazards ( DeVAS_gray_image *standard,
+compute_hazards ( DeVAS_edge_list *standard,
 	DeVAS_float_image *comparison_edge_distance, double degrees_per_pixel )
 /*
  * Compute distance, represented as a visual angle, from each geometric
  * boundary pixel to nearest luminance boundary pixel.
  *
- * standard:	TRUE is pixel is a geometric edge.
+ * standard:	Locations of geometric edges.
  *
  * comparison_edge_distance:	Squared distance to nearest luminance edge.
  *
@@ -289,9 +387,11 @@ compute_hazards ( DeVAS_gray_image *standard,
  */
 {
     int			row, col;
+    int			n_rows, n_cols;
+    int			i;
     DeVAS_float_image	*hazards;
 
-    if ( ! DeVAS_image_samesize ( standard, comparison_edge_distance ) ) {
+    if ( ! DeVAS_edge_list_samesize ( standard, comparison_edge_distance ) ) {
 	fprintf ( stderr, "compute_hazards: argument size mismatch!\n" );
 	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
 	exit ( EXIT_FAILURE );
@@ -304,23 +404,144 @@ compute_hazards ( DeVAS_gray_image *standard,
 	exit ( EXIT_FAILURE );
     }
 
-    hazards = DeVAS_float_image_new ( DeVAS_image_n_rows ( standard ),
-	    DeVAS_image_n_cols ( standard ) );
+    n_rows = DeVAS_image_n_rows ( comparison_edge_distance );
+    n_cols = DeVAS_image_n_cols ( comparison_edge_distance );
 
-    for ( row = 0; row < DeVAS_image_n_rows ( standard ); row++ ) {
-	for ( col = 0; col < DeVAS_image_n_cols ( standard );
-		col++ ) {
-	    if ( DeVAS_image_data ( standard, row, col ) ) {
-		DeVAS_image_data ( hazards, row, col ) = degrees_per_pixel *
-		    sqrt ( DeVAS_image_data ( comparison_edge_distance, row,
-				col ) );
+    hazards = DeVAS_float_image_new ( n_rows, n_cols );
+
+    for ( row = 0; row < n_rows; row++ ) {
+	for ( col = 0; col < n_cols; col++ ) {
+	    DeVAS_image_data ( hazards, row, col ) = HAZARD_NO_EDGE;
+	}
+	for ( i = DeVAS_edge_list_row_start ( standard, row );
+		i < DeVAS_edge_list_row_end ( standard, row ); i++ ) {
+	    col = DeVAS_edge_list_col ( standard, i );
+	    DeVAS_image_data ( hazards, row, col ) = degrees_per_pixel *
+		sqrt ( DeVAS_image_data ( comparison_edge_distance, row,
+			    col ) );
+	}
+    }
+
+    return ( hazards );
+}
+
+DeVAS_float_image *
+comparison_hazards ( char *comparison_name, DeVAS_edge_list *standard,
+	double degrees_per_pixel )
+/*
+ * Read comparison boundaries and compute distance, represented as a visual
+ * angle, from each standard boundary pixel to the nearest comparison
+ * boundary pixel.  Safe to call concurrently for different comparisons.
+ */
+{
+    DeVAS_gray_image	*comparison;
+    DeVAS_float_image	*comparison_edge_distance;
+    DeVAS_float_image	*hazards;
+
+    comparison = DeVAS_gray_image_from_filename_png ( comparison_name );
+
+    if ( !DeVAS_edge_list_samesize ( standard, comparison ) ) {
+	fprintf ( stderr, "standard and %s not same size!\n",
+		comparison_name );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    /* squared-distance transform */
+    comparison_edge_distance = dt_euclid_sq ( comparison );
+
+    hazards = compute_hazards ( standard, comparison_edge_distance,
+	    degrees_per_pixel );
+
+    /* clean up */
+    DeVAS_gray_image_delete ( comparison );
+    DeVAS_float_image_delete ( comparison_edge_distance );
+
+    return ( hazards );
+}
+
+void
+write_scores ( FILE *output, int json_flag, char *standard_name,
+	int n_comparisons, char **comparison_names, double *scores,
+	Measurement_type measurement_type, double scale_parameter )
+/*
+ * Write table of matching scores.  Scores are missing (empty in CSV,
+ * null in JSON) if there are no unmasked pixels in the standard.
+ */
+{
+    int	    i;
+    char    *measure_name;
+
+    switch ( measurement_type ) {
+	case reciprocal_measure:
+	    measure_name = "reciprocal";
+	    break;
+
+	case linear_measure:
+	    measure_name = "linear";
+	    break;
+
+	case Gaussian_measure:
+	    measure_name = "Gaussian";
+	    break;
+
+	default:
+	    fprintf ( stderr, "devas-compare-boundaries: internal error!\n" );
+	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	    exit ( EXIT_FAILURE );	/* error return */
+    }
+
+    if ( json_flag ) {
+	fprintf ( output, "[\n" );
+	for ( i = 0; i < n_comparisons; i++ ) {
+	    fprintf ( output, "  { \"standard\": " );
+	    write_quoted ( output, standard_name, TRUE );
+	    fprintf ( output, ", \"comparison\": " );
+	    write_quoted ( output, comparison_names[i], TRUE );
+	    fprintf ( output, ", \"measure\": \"%s\", \"scale\": %g, ",
+		    measure_name, scale_parameter );
+	    if ( isnan ( scores[i] ) ) {
+		fprintf ( output, "\"score\": null }" );
 	    } else {
-		DeVAS_image_data ( hazards, row, col ) = HAZARD_NO_EDGE;
+		fprintf ( output, "\"score\": %.3f }", scores[i] );
+	    }
+	    fprintf ( output, "%s\n", ( i < n_comparisons - 1 ) ? "," : "" );
+	}
+	fprintf ( output, "]\n" );
+    } else {
+	fprintf ( output, "standard,comparison,measure,scale,score\n" );
+	for ( i = 0; i < n_comparisons; i++ ) {
+	    write_quoted ( output, standard_name, FALSE );
+	    fprintf ( output, "," );
+	    write_quoted ( output, comparison_names[i], FALSE );
+	    fprintf ( output, ",%s,%g,", measure_name, scale_parameter );
+	    if ( !isnan ( scores[i] ) ) {
+		fprintf ( output, "%.3f", scores[i] );
 	    }
+	    fprintf ( output, "\n" );
 	}
     }
+}
 
-    return ( hazards );
+void
+write_quoted ( FILE *output, char *string, int json_flag )
+/*
+ * Write string in double quotes, escaping as required for JSON or CSV.
+ */
+{
+    char    *cp;
+
+    putc ( '"', output );
+    for ( cp = string; *cp != '\0'; cp++ ) {
+	if ( *cp == '"' ) {
+	    fputs ( json_flag ? "\\\"" : "\"\"", output );
+	} else if ( json_flag && ( *cp == '\\' ) ) {
+	    fputs ( "\\\\", output );
+	} else {
+	    putc ( *cp, output );
+	}
+    }
+    putc ( '"', output );
 }
 
 void
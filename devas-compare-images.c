@@ -0,0 +1,431 @@
+/*
+ * Compare an image file against a reference version of the same image, as
+ * produced by an earlier build of devas-filter or devas-visibility, and
+ * report whether the differences are within given tolerances.  Intended
+ * for checking that optimizations have not changed results by more than
+ * round-off.
+ *
+ * devas-compare-images [--pixel-tolerance=<value>] [--max-differing=<value>]
+ *	[--max-abs-diff=<value>] [--min-psnr=<dB>] [--max-hvs-delta=<value>]
+ *	reference test
+ *
+ * Both files must be Radiance HDR files, both PNG files, or both text
+ * files (by extension).  HDR files are compared as floating point RGB, PNG
+ * files as 8 bit RGB.  Grayscale PNG files are read as RGB.  Text (.txt)
+ * files hold the output of devas-visibility --printaverage, and the
+ * Hazard Visibility Scores in them are compared.
+ *
+ *   --pixel-tolerance=<value>
+ *		A pixel differs if any channel differs by more than <value>
+ *		times the peak value (255 for PNG files, the largest channel
+ *		value in the reference for HDR files).  Default 0.
+ *
+ *   --max-differing=<value>
+ *		Largest fraction of pixels that may differ.  Default 0.
+ *
+ *   --max-abs-diff=<value>
+ *		Largest allowed difference in any channel of any pixel, as a
+ *		fraction of the peak value as above.  Default no limit.
+ *
+ *   --min-psnr=<dB>
+ *		Smallest allowed peak signal to noise ratio, in decibels,
+ *		with peak as above.  Default no limit.
+ *
+ *   --max-hvs-delta=<value>
+ *		Largest allowed absolute difference between Hazard
+ *		Visibility Scores, for text files.  Default 0.
+ *
+ * Prints maximum and mean absolute difference, PSNR, and the number of
+ * differing pixels (or the two scores and their difference), followed by
+ * "pass" or "fail".  Exit status is 0 if the test file is within all
+ * tolerances and 1 otherwise.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+#include "devas-image.h"
+#include "devas-png.h"
+#include "radianceIO.h"
+#include "devas-license.h"	/* DeVAS open source license */
+
+typedef struct {
+    double  max_abs_diff;
+    double  mean_abs_diff;
+    double  mse;
+    double  peak;
+    long    n_pixels;
+    long    n_differing;
+} Image_differences;
+
+static int	    has_extension ( char *file_name, char *extension );
+static int	    compare_hvs ( char *reference_file_name,
+			char *test_file_name, double max_hvs_delta );
+static double	    read_hvs ( char *file_name );
+static void	    compare_hdr ( char *reference_file_name,
+			char *test_file_name, double pixel_tolerance,
+			Image_differences *differences );
+static void	    compare_png ( char *reference_file_name,
+			char *test_file_name, double pixel_tolerance,
+			Image_differences *differences );
+static double	    psnr ( Image_differences *differences );
+
+char	*Usage =
+"devas-compare-images [--pixel-tolerance=<value>] [--max-differing=<value>]"
+	"\n\t[--max-abs-diff=<value>] [--min-psnr=<dB>] [--max-hvs-delta=<value>]"
+	"\n\treference test";
+int	args_needed = 2;
+
+int
+main ( int argc, char *argv[] )
+{
+    double		pixel_tolerance = 0.0;
+    double		max_differing = 0.0;
+    double		max_abs_diff = HUGE_VAL;
+    double		min_psnr = -HUGE_VAL;
+    double		max_hvs_delta = 0.0;
+    char		*reference_file_name;
+    char		*test_file_name;
+    Image_differences	differences;
+    int			pass;
+    int			argpt = 1;
+
+    /* scan and collect option flags */
+    while ( ( ( argc - argpt ) >= 1 ) && ( argv[argpt][0] == '-' ) ) {
+	if ( ( strncasecmp ( argv[argpt], "--pixel-tolerance=",
+			strlen ( "--pixel-tolerance=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-pixel-tolerance=",
+			strlen ( "-pixel-tolerance=" ) ) == 0 ) ) {
+	    pixel_tolerance = atof ( strchr ( argv[argpt], '=' ) + 1 );
+	    if ( pixel_tolerance < 0.0 ) {
+		fprintf ( stderr, "invalid pixel tolerance (%s)!\n",
+			argv[argpt] );
+		exit ( EXIT_FAILURE );
+	    }
+	    argpt++;
+
+	} else if ( ( strncasecmp ( argv[argpt], "--max-differing=",
+			strlen ( "--max-differing=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-max-differing=",
+			strlen ( "-max-differing=" ) ) == 0 ) ) {
+	    max_differing = atof ( strchr ( argv[argpt], '=' ) + 1 );
+	    if ( ( max_differing < 0.0 ) || ( max_differing > 1.0 ) ) {
+		fprintf ( stderr, "invalid max differing fraction (%s)!\n",
+			argv[argpt] );
+		exit ( EXIT_FAILURE );
+	    }
+	    argpt++;
+
+	} else if ( ( strncasecmp ( argv[argpt], "--max-abs-diff=",
+			strlen ( "--max-abs-diff=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-max-abs-diff=",
+			strlen ( "-max-abs-diff=" ) ) == 0 ) ) {
+	    max_abs_diff = atof ( strchr ( argv[argpt], '=' ) + 1 );
+	    if ( max_abs_diff < 0.0 ) {
+		fprintf ( stderr, "invalid max absolute difference (%s)!\n",
+			argv[argpt] );
+		exit ( EXIT_FAILURE );
+	    }
+	    argpt++;
+
+	} else if ( ( strncasecmp ( argv[argpt], "--max-hvs-delta=",
+			strlen ( "--max-hvs-delta=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-max-hvs-delta=",
+			strlen ( "-max-hvs-delta=" ) ) == 0 ) ) {
+	    max_hvs_delta = atof ( strchr ( argv[argpt], '=' ) + 1 );
+	    if ( max_hvs_delta < 0.0 ) {
+		fprintf ( stderr, "invalid max HVS delta (%s)!\n",
+			argv[argpt] );
+		exit ( EXIT_FAILURE );
+	    }
+	    argpt++;
+
+	} else if ( ( strncasecmp ( argv[argpt], "--min-psnr=",
+			strlen ( "--min-psnr=" ) ) == 0 ) ||
+		( strncasecmp ( argv[argpt], "-min-psnr=",
+			strlen ( "-min-psnr=" ) ) == 0 ) ) {
+	    min_psnr = atof ( strchr ( argv[argpt], '=' ) + 1 );
+	    argpt++;
+
+	} else {
+	    fprintf ( stderr, "%s\n", Usage );
+	    exit ( EXIT_FAILURE );
+	}
+    }
+
+    if ( ( argc - argpt ) != args_needed ) {
+	fprintf ( stderr, "%s\n", Usage );
+	exit ( EXIT_FAILURE );
+    }
+
+    reference_file_name = argv[argpt++];
+    test_file_name = argv[argpt++];
+
+    if ( ( has_extension ( reference_file_name, ".png" ) !=
+		has_extension ( test_file_name, ".png" ) ) ||
+	    ( has_extension ( reference_file_name, ".txt" ) !=
+		has_extension ( test_file_name, ".txt" ) ) ) {
+	fprintf ( stderr, "can't compare different kinds of file (%s, %s)!\n",
+		reference_file_name, test_file_name );
+	exit ( EXIT_FAILURE );
+    }
+
+    if ( has_extension ( reference_file_name, ".txt" ) ) {
+	return ( compare_hvs ( reference_file_name, test_file_name,
+		    max_hvs_delta ) );
+    }
+
+    if ( has_extension ( reference_file_name, ".png" ) ) {
+	compare_png ( reference_file_name, test_file_name, pixel_tolerance,
+		&differences );
+    } else {
+	compare_hdr ( reference_file_name, test_file_name, pixel_tolerance,
+		&differences );
+    }
+
+    pass = ( differences.n_differing <=
+		( max_differing * differences.n_pixels ) ) &&
+	    ( differences.max_abs_diff <= ( max_abs_diff * differences.peak ) ) &&
+	    ( psnr ( &differences ) >= min_psnr );
+
+    printf ( "max_abs_diff = %g\n", differences.max_abs_diff );
+    printf ( "mean_abs_diff = %g\n", differences.mean_abs_diff );
+    if ( differences.mse == 0.0 ) {
+	printf ( "psnr = inf\n" );
+    } else {
+	printf ( "psnr = %.2f dB\n", psnr ( &differences ) );
+    }
+    printf ( "differing pixels = %ld of %ld (%.4f%%)\n",
+	    differences.n_differing, differences.n_pixels,
+	    ( 100.0 * differences.n_differing ) / differences.n_pixels );
+    printf ( "%s\n", pass ? "pass" : "fail" );
+
+    return ( pass ? EXIT_SUCCESS : EXIT_FAILURE );
+}
+
+static int
+has_extension ( char *file_name, char *extension )
+{
+    char    *file_extension;
+
+    file_extension = strrchr ( file_name, '.' );
+
+    return ( ( file_extension != NULL ) &&
+	    ( strcasecmp ( file_extension, extension ) == 0 ) );
+}
+
+static int
+compare_hvs ( char *reference_file_name, char *test_file_name,
+	double max_hvs_delta )
+/*
+ * Compare the Hazard Visibility Scores in two files, printing the scores
+ * and "pass" or "fail".  Returns the exit status.
+ */
+{
+    double  reference_hvs;
+    double  test_hvs;
+    int	    pass;
+
+    reference_hvs = read_hvs ( reference_file_name );
+    test_hvs = read_hvs ( test_file_name );
+
+    pass = ( fabs ( test_hvs - reference_hvs ) <= max_hvs_delta );
+
+    printf ( "reference hvs = %g\n", reference_hvs );
+    printf ( "test hvs = %g\n", test_hvs );
+    printf ( "hvs delta = %g\n", fabs ( test_hvs - reference_hvs ) );
+    printf ( "%s\n", pass ? "pass" : "fail" );
+
+    return ( pass ? EXIT_SUCCESS : EXIT_FAILURE );
+}
+
+static double
+read_hvs ( char *file_name )
+/*
+ * Hazard Visibility Score from the output of devas-visibility
+ * --printaverage (or --printaveragena).  Other lines are ignored.
+ */
+{
+    FILE    *file;
+    char    line[256];
+    double  hvs;
+    int	    found;
+
+    file = fopen ( file_name, "r" );
+    if ( file == NULL ) {
+	perror ( file_name );
+	exit ( EXIT_FAILURE );
+    }
+
+    found = FALSE;
+    while ( ( !found ) && ( fgets ( line, sizeof ( line ), file ) != NULL ) ) {
+	found = ( sscanf ( line, "Hazard Visibility Score = %lf", &hvs ) == 1 )
+	    || ( sscanf ( line, "%lf", &hvs ) == 1 );
+    }
+
+    fclose ( file );
+
+    if ( !found ) {
+	fprintf ( stderr, "%s: no Hazard Visibility Score!\n", file_name );
+	exit ( EXIT_FAILURE );
+    }
+
+    return ( hvs );
+}
+
+static void
+compare_hdr ( char *reference_file_name, char *test_file_name,
+	double pixel_tolerance, Image_differences *differences )
+{
+    DeVAS_RGBf_image	*reference;
+    DeVAS_RGBf_image	*test;
+    DeVAS_RGBf		reference_pixel, test_pixel;
+    double		diff_red, diff_green, diff_blue;
+    double		max_diff;
+    double		sum_abs_diff, sum_sq_diff;
+    double		threshold;
+    int			row, col;
+
+    reference = DeVAS_RGBf_image_from_radfilename ( reference_file_name );
+    test = DeVAS_RGBf_image_from_radfilename ( test_file_name );
+
+    if ( !DeVAS_image_samesize ( reference, test ) ) {
+	fprintf ( stderr, "image sizes differ (%dx%d, %dx%d)!\n",
+		DeVAS_image_n_cols ( reference ),
+		DeVAS_image_n_rows ( reference ),
+		DeVAS_image_n_cols ( test ), DeVAS_image_n_rows ( test ) );
+	exit ( EXIT_FAILURE );
+    }
+
+    differences->peak = 0.0;
+    for ( row = 0; row < DeVAS_image_n_rows ( reference ); row++ ) {
+	for ( col = 0; col < DeVAS_image_n_cols ( reference ); col++ ) {
+	    reference_pixel = DeVAS_image_data ( reference, row, col );
+	    differences->peak = fmax ( differences->peak,
+		    fmax ( reference_pixel.red,
+			fmax ( reference_pixel.green, reference_pixel.blue ) ) );
+	}
+    }
+
+    threshold = pixel_tolerance * differences->peak;
+
+    differences->max_abs_diff = 0.0;
+    differences->n_differing = 0;
+    sum_abs_diff = sum_sq_diff = 0.0;
+
+    for ( row = 0; row < DeVAS_image_n_rows ( reference ); row++ ) {
+	for ( col = 0; col < DeVAS_image_n_cols ( reference ); col++ ) {
+	    reference_pixel = DeVAS_image_data ( reference, row, col );
+	    test_pixel = DeVAS_image_data ( test, row, col );
+
+	    diff_red = fabs ( test_pixel.red - reference_pixel.red );
+	    diff_green = fabs ( test_pixel.green - reference_pixel.green );
+	    diff_blue = fabs ( test_pixel.blue - reference_pixel.blue );
+
+	    sum_abs_diff += diff_red + diff_green + diff_blue;
+	    sum_sq_diff += ( diff_red * diff_red ) +
+		( diff_green * diff_green ) + ( diff_blue * diff_blue );
+
+	    max_diff = fmax ( diff_red, fmax ( diff_green, diff_blue ) );
+	    if ( max_diff > differences->max_abs_diff ) {
+		differences->max_abs_diff = max_diff;
+	    }
+	    if ( max_diff > threshold ) {
+		differences->n_differing++;
+	    }
+	}
+    }
+
+    differences->n_pixels = ( (long) DeVAS_image_n_rows ( reference ) ) *
+	DeVAS_image_n_cols ( reference );
+    differences->mean_abs_diff = sum_abs_diff / ( 3 * differences->n_pixels );
+    differences->mse = sum_sq_diff / ( 3 * differences->n_pixels );
+
+    DeVAS_RGBf_image_delete ( reference );
+    DeVAS_RGBf_image_delete ( test );
+}
+
+static void
+compare_png ( char *reference_file_name, char *test_file_name,
+	double pixel_tolerance, Image_differences *differences )
+{
+    DeVAS_RGB_image	*reference;
+    DeVAS_RGB_image	*test;
+    DeVAS_RGB		reference_pixel, test_pixel;
+    int			diff_red, diff_green, diff_blue;
+    int			max_diff;
+    double		sum_abs_diff, sum_sq_diff;
+    double		threshold;
+    int			row, col;
+
+    reference = DeVAS_RGB_image_from_filename_png ( reference_file_name );
+    test = DeVAS_RGB_image_from_filename_png ( test_file_name );
+
+    if ( !DeVAS_image_samesize ( reference, test ) ) {
+	fprintf ( stderr, "image sizes differ (%dx%d, %dx%d)!\n",
+		DeVAS_image_n_cols ( reference ),
+		DeVAS_image_n_rows ( reference ),
+		DeVAS_image_n_cols ( test ), DeVAS_image_n_rows ( test ) );
+	exit ( EXIT_FAILURE );
+    }
+
+    differences->peak = 255.0;
+    threshold = pixel_tolerance * differences->peak;
+
+    differences->max_abs_diff = 0.0;
+    differences->n_differing = 0;
+    sum_abs_diff = sum_sq_diff = 0.0;
+
+    for ( row = 0; row < DeVAS_image_n_rows ( reference ); row++ ) {
+	for ( col = 0; col < DeVAS_image_n_cols ( reference ); col++ ) {
+	    reference_pixel = DeVAS_image_data ( reference, row, col );
+	    test_pixel = DeVAS_image_data ( test, row, col );
+
+	    diff_red = abs ( test_pixel.red - reference_pixel.red );
+	    diff_green = abs ( test_pixel.green - reference_pixel.green );
+	    diff_blue = abs ( test_pixel.blue - reference_pixel.blue );
+
+	    sum_abs_diff += diff_red + diff_green + diff_blue;
+	    sum_sq_diff += ( diff_red * diff_red ) +
+		( diff_green * diff_green ) + ( diff_blue * diff_blue );
+
+	    max_diff = diff_red;
+	    if ( diff_green > max_diff ) {
+		max_diff = diff_green;
+	    }
+	    if ( diff_blue > max_diff ) {
+		max_diff = diff_blue;
+	    }
+	    if ( max_diff > differences->max_abs_diff ) {
+		differences->max_abs_diff = max_diff;
+	    }
+	    if ( max_diff > threshold ) {
+		differences->n_differing++;
+	    }
+	}
+    }
+
+    differences->n_pixels = ( (long) DeVAS_image_n_rows ( reference ) ) *
+	DeVAS_image_n_cols ( reference );
+    differences->mean_abs_diff = sum_abs_diff / ( 3 * differences->n_pixels );
+    differences->mse = sum_sq_diff / ( 3 * differences->n_pixels );
+
+    DeVAS_RGB_image_delete ( reference );
+    DeVAS_RGB_image_delete ( test );
+}
+
+static double
+psnr ( Image_differences *differences )
+/*
+ * Infinite for identical images.
+ */
+{
+    if ( differences->mse == 0.0 ) {
+	return ( HUGE_VAL );
+    }
+
+    return ( 10.0 * log10 ( ( differences->peak * differences->peak ) /
+		differences->mse ) );
+}
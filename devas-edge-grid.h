@@ -0,0 +1,43 @@
+/*
+ * Nearest edge queries using edge locations bucketed into a uniform grid
+ * of square cells.
+ */
+
+#ifndef __DeVAS_EDGE_GRID_H
+#define __DeVAS_EDGE_GRID_H
+
+#include "devas-image.h"
+#include "devas-edge-list.h"
+
+/*
+ * Edges in cell [cell_row][cell_col] are edge_row[i], edge_col[i] for
+ * i = cell_start[c] .. cell_start[c+1]-1, c = cell_row * n_cell_cols +
+ * cell_col.
+ */
+typedef struct {
+    int	    n_rows, n_cols;	/* size of represented image */
+    int	    cell_size;		/* pixels per cell side */
+    int	    n_cell_rows, n_cell_cols;
+    int	    *cell_start;	/* index of first edge in cell */
+    int	    *edge_row;		/* edge locations, ordered by cell */
+    int	    *edge_col;
+} DeVAS_edge_grid;
+
+/* function prototypes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+DeVAS_edge_grid	    *DeVAS_edge_grid_new ( DeVAS_edge_list *edges );
+void		    DeVAS_edge_grid_delete ( DeVAS_edge_grid *grid );
+float		    DeVAS_edge_grid_nearest_sq ( DeVAS_edge_grid *grid,
+			int row, int col );
+int		    DeVAS_edge_grid_preferred ( DeVAS_edge_list *queries,
+			DeVAS_edge_list *edges );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DeVAS_EDGE_GRID_H */
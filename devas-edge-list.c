@@ -0,0 +1,159 @@
+/*
+ * Sparse representation of boundary maps.
+ *
+ * Luminance and geometry boundary maps are full size images in which only
+ * a small fraction of the pixels are set.  Converting them to lists of
+ * edge locations lets hazard computation, scoring, and visualization
+ * touch only the edge pixels.  Locations are stored in row order with an
+ * index to the start of each row, so that the edges in any row (and hence
+ * in any neighborhood of rows) can be found directly.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "devas-edge-list.h"
+#include "devas-image.h"
+#include "devas-license.h"	/* DeVAS open source license */
+
+static DeVAS_edge_list	*edge_list_new ( int n_rows, int n_cols,
+			    int n_edges );
+
+DeVAS_edge_list *
+DeVAS_edge_list_from_gray_image ( DeVAS_gray_image *image )
+/*
+ * Edge pixels are those with non-zero values.
+ */
+{
+    DeVAS_edge_list *edges;
+    int		    n_rows, n_cols;
+    int		    row, col;
+    int		    n_edges;
+    int		    i;
+
+    n_rows = DeVAS_image_n_rows ( image );
+    n_cols = DeVAS_image_n_cols ( image );
+
+    n_edges = 0;
+    for ( row = 0; row < n_rows; row++ ) {
+	for ( col = 0; col < n_cols; col++ ) {
+	    n_edges += ( DeVAS_image_data ( image, row, col ) != 0 );
+	}
+    }
+
+    edges = edge_list_new ( n_rows, n_cols, n_edges );
+
+    i = 0;
+    for ( row = 0; row < n_rows; row++ ) {
+	edges->row_start[row] = i;
+	for ( col = 0; col < n_cols; col++ ) {
+	    if ( DeVAS_image_data ( image, row, col ) ) {
+		edges->col[i++] = col;
+	    }
+	}
+    }
+    edges->row_start[n_rows] = i;
+
+    return ( edges );
+}
+
+DeVAS_edge_list *
+DeVAS_edge_list_from_float_image ( DeVAS_float_image *image )
+/*
+ * Edge pixels are those with non-negative values, as in the hazards
+ * images computed by devas_visibility ( ).
+ */
+{
+    DeVAS_edge_list *edges;
+    int		    n_rows, n_cols;
+    int		    row, col;
+    int		    n_edges;
+    int		    i;
+
+    n_rows = DeVAS_image_n_rows ( image );
+    n_cols = DeVAS_image_n_cols ( image );
+
+    n_edges = 0;
+    for ( row = 0; row < n_rows; row++ ) {
+	for ( col = 0; col < n_cols; col++ ) {
+	    n_edges += ( DeVAS_image_data ( image, row, col ) >= 0.0 );
+	}
+    }
+
+    edges = edge_list_new ( n_rows, n_cols, n_edges );
+
+    i = 0;
+    for ( row = 0; row < n_rows; row++ ) {
+	edges->row_start[row] = i;
+	for ( col = 0; col < n_cols; col++ ) {
+	    if ( DeVAS_image_data ( image, row, col ) >= 0.0 ) {
+		edges->col[i++] = col;
+	    }
+	}
+    }
+    edges->row_start[n_rows] = i;
+
+    return ( edges );
+}
+
+DeVAS_gray_image *
+DeVAS_edge_list_to_gray_image ( DeVAS_edge_list *edges )
+/*
+ * Edge pixels are set to TRUE, all others to FALSE.
+ */
+{
+    DeVAS_gray_image	*image;
+    int			row, col;
+    int			i;
+
+    image = DeVAS_gray_image_new ( edges->n_rows, edges->n_cols );
+
+    for ( row = 0; row < edges->n_rows; row++ ) {
+	for ( col = 0; col < edges->n_cols; col++ ) {
+	    DeVAS_image_data ( image, row, col ) = FALSE;
+	}
+	for ( i = DeVAS_edge_list_row_start ( edges, row );
+		i < DeVAS_edge_list_row_end ( edges, row ); i++ ) {
+	    col = DeVAS_edge_list_col ( edges, i );
+	    DeVAS_image_data ( image, row, col ) = TRUE;
+	}
+    }
+
+    return ( image );
+}
+
+void
+DeVAS_edge_list_delete ( DeVAS_edge_list *edges )
+{
+    free ( edges->row_start );
+    free ( edges->col );
+    free ( edges );
+}
+
+static DeVAS_edge_list *
+edge_list_new ( int n_rows, int n_cols, int n_edges )
+{
+    DeVAS_edge_list *edges;
+
+    edges = (DeVAS_edge_list *) malloc ( sizeof ( DeVAS_edge_list ) );
+    if ( edges == NULL ) {
+	fprintf ( stderr, "DeVAS_edge_list: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    edges->n_rows = n_rows;
+    edges->n_cols = n_cols;
+    edges->n_edges = n_edges;
+
+    edges->row_start = (int *) malloc ( ( n_rows + 1 ) * sizeof ( int ) );
+    /* at least one element, so malloc ( 0 ) is never a failure */
+    edges->col = (int *) malloc ( ( ( n_edges > 0 ) ? n_edges : 1 ) *
+	    sizeof ( int ) );
+    if ( ( edges->row_start == NULL ) || ( edges->col == NULL ) ) {
+	fprintf ( stderr, "DeVAS_edge_list: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    return ( edges );
+}
@@ -0,0 +1,48 @@
+/*
+ * Sparse representation of boundary maps, which are mostly zero: the
+ * locations of the non-zero pixels, stored row by row.
+ */
+
+#ifndef __DeVAS_EDGE_LIST_H
+#define __DeVAS_EDGE_LIST_H
+
+#include "devas-image.h"
+
+/*
+ * Edge pixels in row r are at columns col[row_start[r]] through
+ * col[row_start[r+1]-1], in increasing order.  row_start has n_rows + 1
+ * entries.
+ */
+typedef struct {
+    int	    n_rows, n_cols;	/* size of represented image */
+    int	    n_edges;		/* number of edge pixels */
+    int	    *row_start;		/* index into col of first edge in row */
+    int	    *col;		/* column of each edge pixel */
+} DeVAS_edge_list;
+
+#define	DeVAS_edge_list_n_edges(edges)		(edges)->n_edges
+#define	DeVAS_edge_list_row_start(edges,row)	(edges)->row_start[row]
+#define	DeVAS_edge_list_row_end(edges,row)	(edges)->row_start[(row)+1]
+#define	DeVAS_edge_list_col(edges,i)		(edges)->col[i]
+#define	DeVAS_edge_list_samesize(edges,image)				\
+	    ( ( (edges)->n_rows == DeVAS_image_n_rows ( image ) ) &&	\
+	      ( (edges)->n_cols == DeVAS_image_n_cols ( image ) ) )
+
+/* function prototypes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+DeVAS_edge_list	    *DeVAS_edge_list_from_gray_image ( DeVAS_gray_image
+			*image );
+DeVAS_edge_list	    *DeVAS_edge_list_from_float_image ( DeVAS_float_image
+			*image );
+DeVAS_gray_image    *DeVAS_edge_list_to_gray_image ( DeVAS_edge_list *edges );
+void		    DeVAS_edge_list_delete ( DeVAS_edge_list *edges );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DeVAS_EDGE_LIST_H */
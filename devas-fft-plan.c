@@ -0,0 +1,377 @@
+/*
+ * Cache of FFTW plans for 2-D real-to-complex and complex-to-real transforms
+ * of DeVAS images.
+ *
+ * Creating an FFTW plan, even with FFTW_ESTIMATE, costs far more than
+ * executing it for the image sizes typical of devas-filter.  Plans are
+ * created the first time a given transform type, image size, and pair of
+ * array alignments is seen, and are then reused via FFTW's new-array
+ * execute functions for all subsequent transforms of the same kind.  This
+ * allows the luminance and chroma transforms in devas_filter ( ) and the
+ * FFT-based Gaussian blur to share plans, and repeated calls at the same
+ * size cost only the execute.
+ *
+ * The FFTW planner is not thread safe, so plan lookup and creation are
+ * protected by a mutex.  The execute functions are thread safe and are
+ * called without holding the lock.
+ *
+ * Plans persist until DeVAS_fft_plan_cache_destroy ( ) is called, which
+ * must not be done while any other thread is doing a transform.
+ *
+ * FFTW is fastest for sizes whose only prime factors are small.
+ * DeVAS_fft_padded_size ( ) chooses padded image sizes, using a simple
+ * model of the cost of FFTW_ESTIMATE plans for sizes with prime factors
+ * no larger than 7.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <fftw3.h>
+#include "devas-fft-plan.h"
+#include "devas-image.h"
+#include "devas-utils.h"
+#include "devas-license.h"	/* DeVAS open source license */
+
+typedef enum { FFT_PLAN_R2C, FFT_PLAN_C2R } FFT_plan_type;
+
+typedef struct FFT_plan_entry {
+    FFT_plan_type	    type;
+    int			    n_rows, n_cols;	/* real (spatial) image size */
+    int			    input_alignment;	/* fftwf_alignment_of ( ) */
+    int			    output_alignment;
+    fftwf_plan		    plan;
+    struct FFT_plan_entry   *next;
+} FFT_plan_entry;
+
+/*
+ * Estimated cost per element of each prime factor of a transform dimension,
+ * fit to timings of 2-D real-to-complex FFTW_ESTIMATE transforms of
+ * 1000 - 2400 pixel square images (x86-64, SSE/AVX).  Odd sizes cost
+ * an additional FFT_COST_ODD.  FFT_COST_PIXEL accounts for the other
+ * per-pixel work done on a padded image, so that the extra area of a
+ * larger padded size is not undervalued.  Only relative values matter.
+ */
+#define	FFT_COST_2	0.7
+#define	FFT_COST_3	1.5
+#define	FFT_COST_5	2.5
+#define	FFT_COST_7	2.8
+#define	FFT_COST_ODD	1.5
+#define	FFT_COST_PIXEL	4.0
+
+#define	FFT_PAD_MAX_RATIO	1.25	/* don't consider padding a dimension */
+					/* by more than this factor */
+
+static FFT_plan_entry	*plan_cache = NULL;
+static pthread_mutex_t	plan_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int		is_smooth ( int n );
+static double		element_cost ( int n );
+static int		smooth_sizes ( int n, int **sizes );
+static fftwf_plan	get_plan ( FFT_plan_type type, int n_rows, int n_cols,
+			    float *real_data, DeVAS_complexf *complex_data );
+
+void
+DeVAS_fft_r2c ( DeVAS_float_image *input, DeVAS_complexf_image *output )
+/*
+ * Forward transform of input into output, which must be n_rows x
+ * ( ( n_cols / 2 ) + 1 ) and distinct from input.
+ */
+{
+    int		n_rows, n_cols;
+    fftwf_plan	plan;
+
+    n_rows = DeVAS_image_n_rows ( input );
+    n_cols = DeVAS_image_n_cols ( input );
+
+    if ( ( DeVAS_image_n_rows ( output ) != n_rows ) ||
+	    ( DeVAS_image_n_cols ( output ) != ( n_cols / 2 ) + 1 ) ) {
+	fprintf ( stderr, "DeVAS_fft_r2c: image sizes don't match!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    plan = get_plan ( FFT_PLAN_R2C, n_rows, n_cols,
+	    &DeVAS_image_data ( input, 0, 0 ),
+	    &DeVAS_image_data ( output, 0, 0 ) );
+
+    fftwf_execute_dft_r2c ( plan, &DeVAS_image_data ( input, 0, 0 ),
+	    (fftwf_complex *) &DeVAS_image_data ( output, 0, 0 ) );
+}
+
+void
+DeVAS_fft_c2r ( DeVAS_complexf_image *input, DeVAS_float_image *output )
+/*
+ * Inverse transform of input into output (unnormalized).  input must be
+ * n_rows x ( ( n_cols / 2 ) + 1 ), where output is n_rows x n_cols.  As
+ * with all multi-dimensional FFTW complex-to-real transforms, the contents
+ * of input are destroyed.
+ */
+{
+    int		n_rows, n_cols;
+    fftwf_plan	plan;
+
+    n_rows = DeVAS_image_n_rows ( output );
+    n_cols = DeVAS_image_n_cols ( output );
+
+    if ( ( DeVAS_image_n_rows ( input ) != n_rows ) ||
+	    ( DeVAS_image_n_cols ( input ) != ( n_cols / 2 ) + 1 ) ) {
+	fprintf ( stderr, "DeVAS_fft_c2r: image sizes don't match!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    plan = get_plan ( FFT_PLAN_C2R, n_rows, n_cols,
+	    &DeVAS_image_data ( output, 0, 0 ),
+	    &DeVAS_image_data ( input, 0, 0 ) );
+
+    fftwf_execute_dft_c2r ( plan,
+	    (fftwf_complex *) &DeVAS_image_data ( input, 0, 0 ),
+	    &DeVAS_image_data ( output, 0, 0 ) );
+}
+
+void
+DeVAS_fft_plan_cache_destroy ( void )
+/*
+ * Destroy all cached plans and release FFTW's internal planning data.
+ */
+{
+    FFT_plan_entry  *entry;
+    FFT_plan_entry  *next;
+
+    pthread_mutex_lock ( &plan_cache_lock );
+
+    for ( entry = plan_cache; entry != NULL; entry = next ) {
+	next = entry->next;
+	fftwf_destroy_plan ( entry->plan );
+	free ( entry );
+    }
+    plan_cache = NULL;
+
+    fftwf_cleanup ( );
+
+    pthread_mutex_unlock ( &plan_cache_lock );
+}
+
+static fftwf_plan
+get_plan ( FFT_plan_type type, int n_rows, int n_cols, float *real_data,
+	DeVAS_complexf *complex_data )
+/*
+ * Return a cached plan matching the transform type, size, and alignment
+ * of the arrays, creating it if necessary.  FFTW_ESTIMATE planning does
+ * not overwrite the arrays, so the plan is made using the caller's data.
+ */
+{
+    FFT_plan_entry  *entry;
+    int		    real_alignment, complex_alignment;
+    int		    input_alignment, output_alignment;
+    fftwf_plan	    plan;
+
+    if ( (void *) real_data == (void *) complex_data ) {
+	fprintf ( stderr,
+		"DeVAS_fft: in-place transforms are not supported!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    real_alignment = fftwf_alignment_of ( real_data );
+    complex_alignment = fftwf_alignment_of ( (float *) complex_data );
+
+    if ( type == FFT_PLAN_R2C ) {
+	input_alignment = real_alignment;
+	output_alignment = complex_alignment;
+    } else {
+	input_alignment = complex_alignment;
+	output_alignment = real_alignment;
+    }
+
+    pthread_mutex_lock ( &plan_cache_lock );
+
+    for ( entry = plan_cache; entry != NULL; entry = entry->next ) {
+	if ( ( entry->type == type ) && ( entry->n_rows == n_rows ) &&
+		( entry->n_cols == n_cols ) &&
+		( entry->input_alignment == input_alignment ) &&
+		( entry->output_alignment == output_alignment ) ) {
+	    plan = entry->plan;
+	    pthread_mutex_unlock ( &plan_cache_lock );
+	    return ( plan );
+	}
+    }
+
+    if ( type == FFT_PLAN_R2C ) {
+	plan = fftwf_plan_dft_r2c_2d ( n_rows, n_cols, real_data,
+		(fftwf_complex *) complex_data, FFTW_ESTIMATE );
+    } else {
+	plan = fftwf_plan_dft_c2r_2d ( n_rows, n_cols,
+		(fftwf_complex *) complex_data, real_data, FFTW_ESTIMATE );
+    }
+    if ( plan == NULL ) {
+	fprintf ( stderr, "DeVAS_fft: can't create plan for %d x %d!\n",
+		n_rows, n_cols );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    entry = (FFT_plan_entry *) malloc ( sizeof ( FFT_plan_entry ) );
+    if ( entry == NULL ) {
+	fprintf ( stderr, "DeVAS_fft: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    entry->type = type;
+    entry->n_rows = n_rows;
+    entry->n_cols = n_cols;
+    entry->input_alignment = input_alignment;
+    entry->output_alignment = output_alignment;
+    entry->plan = plan;
+    entry->next = plan_cache;
+    plan_cache = entry;
+
+    pthread_mutex_unlock ( &plan_cache_lock );
+
+    return ( plan );
+}
+
+void
+DeVAS_fft_padded_size ( int n_rows, int n_cols, int *n_rows_padded,
+	int *n_cols_padded )
+/*
+ * Choose the n_rows_padded x n_cols_padded transform size, at least as
+ * large as n_rows x n_cols, with the lowest estimated FFT cost.  Only sizes
+ * with no prime factors larger than 7 are considered.  Cost is estimated as
+ *
+ *   n_rows_padded * n_cols_padded *
+ *	( element_cost ( n_rows_padded ) + element_cost ( n_cols_padded ) +
+ *	  FFT_COST_PIXEL )
+ *
+ * so a somewhat larger size made up of factors of 2 can be chosen over the
+ * smallest size with larger factors.
+ */
+{
+    int	    *row_sizes, *col_sizes;
+    int	    n_row_sizes, n_col_sizes;
+    int	    i, j;
+    double  cost, best_cost;
+
+    if ( ( n_rows < 1 ) || ( n_cols < 1 ) ) {
+	fprintf ( stderr, "DeVAS_fft_padded_size: invalid size (%d, %d)!\n",
+		n_rows, n_cols );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    n_row_sizes = smooth_sizes ( n_rows, &row_sizes );
+    n_col_sizes = smooth_sizes ( n_cols, &col_sizes );
+
+    best_cost = -1.0;
+    for ( i = 0; i < n_row_sizes; i++ ) {
+	for ( j = 0; j < n_col_sizes; j++ ) {
+	    cost = ((double) row_sizes[i] ) * ((double) col_sizes[j] ) *
+		( element_cost ( row_sizes[i] ) +
+		  element_cost ( col_sizes[j] ) + FFT_COST_PIXEL );
+	    if ( ( best_cost < 0.0 ) || ( cost < best_cost ) ) {
+		best_cost = cost;
+		*n_rows_padded = row_sizes[i];
+		*n_cols_padded = col_sizes[j];
+	    }
+	}
+    }
+
+    free ( row_sizes );
+    free ( col_sizes );
+}
+
+static int
+smooth_sizes ( int n, int **sizes )
+/*
+ * Allocate and fill in the list of sizes >= n, and not much larger, with
+ * no prime factors larger than 7.  The smallest such size is always
+ * included.  Returns the number of sizes.
+ */
+{
+    int	    n_sizes;
+    int	    max_sizes;
+    int	    size;
+    int	    limit;
+
+    max_sizes = 16;
+    *sizes = (int *) malloc ( max_sizes * sizeof ( int ) );
+    if ( *sizes == NULL ) {
+	fprintf ( stderr, "DeVAS_fft_padded_size: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    limit = (int) ( FFT_PAD_MAX_RATIO * ((double) n ) );
+    n_sizes = 0;
+    for ( size = n; ( n_sizes == 0 ) || ( size <= limit ); size++ ) {
+	if ( is_smooth ( size ) ) {
+	    if ( n_sizes >= max_sizes ) {
+		max_sizes *= 2;
+		*sizes = (int *) realloc ( *sizes, max_sizes * sizeof ( int ) );
+		if ( *sizes == NULL ) {
+		    fprintf ( stderr, "DeVAS_fft_padded_size: realloc failed!\n" );
+		    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+		    exit ( EXIT_FAILURE );
+		}
+	    }
+	    (*sizes)[n_sizes++] = size;
+	}
+    }
+
+    return ( n_sizes );
+}
+
+static double
+element_cost ( int n )
+/*
+ * Estimated relative cost per element of transforming a dimension of size
+ * n, which must have no prime factors larger than 7.
+ */
+{
+    double  cost;
+
+    cost = ( ( n % 2 ) != 0 ) ? FFT_COST_ODD : 0.0;
+
+    while ( ( n % 2 ) == 0 ) {
+	cost += FFT_COST_2;
+	n /= 2;
+    }
+    while ( ( n % 3 ) == 0 ) {
+	cost += FFT_COST_3;
+	n /= 3;
+    }
+    while ( ( n % 5 ) == 0 ) {
+	cost += FFT_COST_5;
+	n /= 5;
+    }
+    while ( ( n % 7 ) == 0 ) {
+	cost += FFT_COST_7;
+	n /= 7;
+    }
+
+    return ( cost );
+}
+
+static int
+is_smooth ( int n )
+/*
+ * TRUE if n has no prime factors larger than 7.
+ */
+{
+    while ( ( n % 2 ) == 0 ) {
+	n /= 2;
+    }
+    while ( ( n % 3 ) == 0 ) {
+	n /= 3;
+    }
+    while ( ( n % 5 ) == 0 ) {
+	n /= 5;
+    }
+    while ( ( n % 7 ) == 0 ) {
+	n /= 7;
+    }
+
+    return ( n == 1 );
+}
@@ -0,0 +1,30 @@
+/*
+ * Cache of FFTW plans for 2-D real-to-complex and complex-to-real transforms
+ * of DeVAS images, keyed by image size, and selection of transform sizes
+ * that FFTW handles efficiently.
+ */
+
+#ifndef __DeVAS_FFT_PLAN_H
+#define __DeVAS_FFT_PLAN_H
+
+#include "devas-image.h"
+
+/* function prototypes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void		    DeVAS_fft_r2c ( DeVAS_float_image *input,
+			DeVAS_complexf_image *output );
+void		    DeVAS_fft_c2r ( DeVAS_complexf_image *input,
+			DeVAS_float_image *output );
+void		    DeVAS_fft_plan_cache_destroy ( void );
+void		    DeVAS_fft_padded_size ( int n_rows, int n_cols,
+			int *n_rows_padded, int *n_cols_padded );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DeVAS_FFT_PLAN_H */
@@ -1,7 +1,7 @@
 #ifndef __DeVAS_FILTER_VERSION_H
 #define __DeVAS_FILTER_VERSION_H
 
-#define	DeVAS_FILTER_VERSION		4.1.02
-#define	DeVAS_FILTER_VERSION_STRING	"4.1.02"
+#define	DeVAS_FILTER_VERSION		4.1.03
+#define	DeVAS_FILTER_VERSION_STRING	"4.1.03"
 
 #endif  /* __DeVAS_FILTER_VERSION_H */
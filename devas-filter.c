@@ -44,12 +44,15 @@
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
-#include <fftw3.h>
 #include "devas-filter.h"
 #include "devas-image.h"
+#include "devas-fft-plan.h"
+#include "devas-table-cache.h"
+#include "devas-margin.h"
 #include "devas-utils.h"
 #include "ChungLeggeCSF.h"
 #include "dilate.h"
+#include "devas-timing.h"
 #ifdef OUTPUT_CONTRAST_BANDS
 #include "devas-png.h"
 #endif	/* OUTPUT_CONTRAST_BANDS */
@@ -72,21 +75,16 @@
 					/* that will be feathered if */
 					/* necessary */
 
+#define	CHROMA_WEIGHT_MIN	0.01	/* DeVAS_CHROMA_REDUCED represents */
+					/* all frequencies with a larger */
+					/* CSF weight (not an error bound) */
+
 #define	LOG2R_0		-10.0	/* Marker value for value of log2r(0). */
 				/* Can't happen in practice, since r is pixel */
 				/* distance and so never less than 1.0 except */
 				/* at DC.  Needs to be < 1.0 for log2r_min to */
 				/* work. */
 
-/*
- * Used in clip_to_xyY_gamut ( ):
- */
-
-typedef struct {
-    double  x;
-    double  y;
-} XY_point;
-
 /*
  * Global variables exposed to other routines:
  */
@@ -95,6 +93,49 @@ int  DeVAS_verbose = FALSE;
 int  DeVAS_veryverbose = FALSE;
 int  DeVAS_band_number = -1;
 
+/*
+ * Local variables:
+ */
+
+static DeVAS_chroma_resolution	chroma_resolution = DeVAS_CHROMA_FULL;
+
+/* tables kept between calls by devas_filter_keep_tables ( ) */
+static int			keep_tables = FALSE;
+static DeVAS_float_image	*kept_log2r = NULL;
+static DeVAS_float_image	*kept_CSF_weights = NULL;
+static double			kept_CSF_fov;
+static double			kept_CSF_acuity;
+static double			kept_CSF_contrast_sensitivity;
+
+/*
+ * Work images kept between calls by devas_filter_keep_tables ( ), so that
+ * the frames of a sequence don't each allocate and free them.  Each is
+ * reallocated only if its size changes.
+ */
+static struct {
+    DeVAS_float_image	*luminance;	/* channels of input, with margins */
+    DeVAS_float_image	*x;
+    DeVAS_float_image	*y;
+    DeVAS_complexf_image *frequency_space;
+    DeVAS_complexf_image *weighted_frequency_space;
+    DeVAS_float_image	*contrast_band;
+    DeVAS_float_image	*local_luminance;
+    DeVAS_float_image	*thresholded_contrast_band;
+    DeVAS_gray_image	*threshold_mask_initial_positive;
+    DeVAS_gray_image	*threshold_mask_initial_negative;
+    DeVAS_float_image	*threshold_distsq_positive;
+    DeVAS_float_image	*threshold_distsq_negative;
+    DeVAS_float_image	*filtered_luminance;
+    DeVAS_complexf_image *x_frequency_space;	/* used by filter_color ( ) */
+    DeVAS_complexf_image *y_frequency_space;
+    DeVAS_float_image	*color_filtered_x;
+    DeVAS_float_image	*color_filtered_y;
+    DeVAS_float_image	*reduced_x;	/* reduced resolution chroma */
+    DeVAS_float_image	*reduced_y;
+    DeVAS_float_image	*upsampled_x;
+    DeVAS_float_image	*upsampled_y;
+} kept_work;
+
 /*
  * Local functions:
  */
@@ -109,15 +150,19 @@ static void		preallocate_images ( int n_rows, int n_cols,
     			    DeVAS_float_image **threshold_distsq_positive,
     			    DeVAS_float_image **threshold_distsq_negative,
 			    DeVAS_float_image **filtered_luminance );
-static DeVAS_complexf_image *forward_transform ( DeVAS_float_image *source );
+static DeVAS_complexf_image *forward_transform ( DeVAS_float_image *source,
+			    DeVAS_complexf_image **kept_p );
 static DeVAS_float_image	*log2r_prep ( DeVAS_complexf_image
 							*transformed_image );
+static DeVAS_float_image	*make_log2r ( DeVAS_complexf_image
+							*transformed_image );
+static DeVAS_float_image	*get_log2r ( DeVAS_complexf_image
+							*transformed_image );
 static void		bandpass_filter ( int band,
 			    DeVAS_complexf_image *frequency_space,
 			    DeVAS_complexf_image *weighted_frequency_space,
 			    DeVAS_float_image *log2r,
-			    DeVAS_float_image *contrast_band,
-			    fftwf_plan fft_inverse_plan );
+			    DeVAS_float_image *contrast_band );
 static void		apply_threshold ( double sensitivity,
 			    float peak_frequency_image,
 			    DeVAS_float_image *contrast_band,
@@ -130,28 +175,54 @@ static void		apply_threshold ( double sensitivity,
 			    int smoothing_flag );
 static float		feather ( float contrast, float distsq,
 			    float smoothing_radius, float smoothing_feather );
-static DeVAS_float_image	*CSF_weight_prep ( DeVAS_complexf_image
-						*frequency_space,
-				double fov, double acuity,
-				double contrast_sensitivity );
-static DeVAS_float_image *filter_color ( DeVAS_float_image *chroma_channel,
-				DeVAS_float_image *CSF_weights );
+static DeVAS_float_image	*CSF_weight_prep ( unsigned int n_rows,
+				unsigned int n_cols, double fov,
+				double acuity, double contrast_sensitivity );
+static DeVAS_float_image	*make_CSF_weights ( unsigned int n_rows,
+				unsigned int n_cols, double fov,
+				double acuity, double contrast_sensitivity );
+static DeVAS_float_image	*get_CSF_weights ( unsigned int n_rows,
+				unsigned int n_cols, double fov,
+				double acuity, double contrast_sensitivity );
+static void		release_table ( DeVAS_float_image *table );
+static DeVAS_float_image	*work_float_image ( DeVAS_float_image **kept_p,
+			    int n_rows, int n_cols );
+static DeVAS_gray_image	*work_gray_image ( DeVAS_gray_image **kept_p,
+			    int n_rows, int n_cols );
+static DeVAS_complexf_image *work_complexf_image ( DeVAS_complexf_image
+			    **kept_p, int n_rows, int n_cols );
+static void		release_work_images ( void );
+static int		chroma_decimation_factor ( int n_rows, int n_cols,
+			    double fov, double acuity,
+			    double contrast_sensitivity );
+static DeVAS_float_image	*decimate ( DeVAS_float_image *channel,
+			    int factor, DeVAS_float_image **kept_p );
+static DeVAS_float_image	*upsample ( DeVAS_float_image *reduced,
+			    int factor, int n_rows, int n_cols,
+			    DeVAS_float_image **kept_p );
+static void		upsample_coordinates ( int factor, int n,
+			    int n_reduced, int *index_0, float *fraction );
+static void		filter_color ( DeVAS_float_image *x,
+			    DeVAS_float_image *y,
+			    DeVAS_float_image *CSF_weights,
+			    DeVAS_float_image **filtered_x_p,
+			    DeVAS_float_image **filtered_y_p );
 static DeVAS_complexf	rxc ( DeVAS_float real_value,
 			    DeVAS_complexf complex_value );
 static void		disassemble_input ( DeVAS_xyY_image *input_image,
+			    int top, int bottom, int left, int right,
 			    DeVAS_float_image **luminance,
 			    DeVAS_float_image **x, DeVAS_float_image **y );
 static DeVAS_xyY_image	*assemble_output ( DeVAS_float_image
 							*filtered_luminance,
 			    DeVAS_float_image *filtered_x,
 			    DeVAS_float_image *filtered_y,
-			    double saturation );
+			    double saturation, int top, int left,
+			    int n_rows, int n_cols );
 static void		desaturate ( double saturation, DeVAS_float_image *x,
 			    DeVAS_float_image *y );
-static DeVAS_xyY		clip_to_xyY_gamut ( DeVAS_xyY xyY );
-static XY_point		line_intersection ( XY_point line_1_p1,
-			    XY_point line_1_p2, XY_point line_2_p1,
-			    XY_point line_2_p2 );
+static void		clip_to_xyY_gamut ( float *x, float *y, float *Y,
+			    int n_cols, DeVAS_xyY *xyY );
 static void		cleanup ( DeVAS_complexf_image *frequency_space,
 			    DeVAS_float_image *log2r,
 			    DeVAS_complexf_image *weighted_frequency_space,
@@ -168,8 +239,7 @@ static void		cleanup ( DeVAS_complexf_image *frequency_space,
 			    DeVAS_float_image *threshold_distsq_negative,
 			    double saturation,
 			    DeVAS_float_image *filtered_x,
-			    DeVAS_float_image *filtered_y,
-			    fftwf_plan *fft_inverse_plan );
+			    DeVAS_float_image *filtered_y );
 
 DeVAS_xyY_image *
 devas_filter ( DeVAS_xyY_image *input_image, double acuity,
@@ -182,6 +252,32 @@ devas_filter ( DeVAS_xyY_image *input_image, double acuity,
  * saturation:		 control saturation of output
  */
 {
+    return ( devas_filter_margin ( input_image, 0, 0, FALSE, acuity,
+		contrast_sensitivity, smoothing_flag, saturation ) );
+}
+
+DeVAS_xyY_image *
+devas_filter_margin ( DeVAS_xyY_image *input_image, int v_margin,
+	int h_margin, int fft_padding, double acuity,
+	double contrast_sensitivity, int smoothing_flag, double saturation )
+/*
+ * Same as devas_filter ( ), except that the image is filtered as if it
+ * had been padded using DeVAS_xyY_add_margin ( ) and the padding was then
+ * removed using DeVAS_xyY_strip_margin ( ).  The margin is generated as
+ * part of splitting the input into luminance and chromaticity channels
+ * and is discarded as the output is reassembled, so no padded xyY images
+ * are created.
+ *
+ * v_margin:		 vertical margin (pixels) added to top and bottom
+ * h_margin:		 horizontal margin (pixels) added to left and right
+ * fft_padding:		 TRUE => further increase the padded size to the
+ * 			 size chosen by DeVAS_fft_padded_size ( ), which
+ * 			 FFTW transforms much faster
+ */
+{
+    int			n_rows, n_cols;	/* size of input and output */
+    int			n_rows_padded, n_cols_padded;	/* size filtered */
+    int			top, bottom, left, right;	/* margins */
     int			band;		/* band index */
     int			n_bands;	/* number of bands actually used */
     int     		n_bands_max;	/* maximum possible number of bands */
@@ -202,7 +298,6 @@ devas_filter ( DeVAS_xyY_image *input_image, double acuity,
     DeVAS_float_image	*contrast_band;	/* a_i in Peli (1990) */
     DeVAS_float_image	*local_luminance; /* l_i in Peli (1990) */
     DeVAS_float_image	*thresholded_contrast_band; /* result of thesholding */
-    fftwf_plan		fft_inverse_plan;	/* to create bandpass images */
     DeVAS_gray_image	*threshold_mask_initial_positive; /* threshold mask */
     DeVAS_gray_image	*threshold_mask_initial_negative; /* threshold mask */
     DeVAS_float_image	*threshold_distsq_positive;	 /* threshold mask */
@@ -213,6 +308,12 @@ devas_filter ( DeVAS_xyY_image *input_image, double acuity,
     DeVAS_float_image	*filtered_y = NULL;	/* filtered x chromaticity */
     						/* not always used */
     DeVAS_xyY_image	*filtered_image;	/* full xyY output image */
+    int			chroma_factor = 1;	/* chroma decimation */
+    DeVAS_float_image	*reduced_x;	/* decimated chromaticity channels */
+    DeVAS_float_image	*reduced_y;
+    DeVAS_float_image	*reduced_filtered_x;
+    DeVAS_float_image	*reduced_filtered_y;
+    double		stage_start;	/* for DeVAS_timing_stop ( ) */
 
     /*
      * Check argument validity.
@@ -246,13 +347,45 @@ devas_filter ( DeVAS_xyY_image *input_image, double acuity,
 	exit ( EXIT_FAILURE );
     }
 
+    if ( ( v_margin < 0 ) || ( h_margin < 0 ) ) {
+	fprintf ( stderr, "invalid margin (%d, %d)!\n", v_margin, h_margin );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
     /*
      * One-time jobs:
      */
 
-    disassemble_input ( input_image, &luminance, &x, &y );
-    	/* break input into separate luminance and chromaticity channels */
+    n_rows = DeVAS_image_n_rows ( input_image );
+    n_cols = DeVAS_image_n_cols ( input_image );
+
+    n_rows_padded = n_rows + ( 2 * v_margin );
+    n_cols_padded = n_cols + ( 2 * h_margin );
+    if ( fft_padding ) {
+	/* cheapest transform size at least as large as margin-padded size */
+	DeVAS_fft_padded_size ( n_rows + ( 2 * v_margin ),
+		n_cols + ( 2 * h_margin ), &n_rows_padded, &n_cols_padded );
+    }
+
+    /* any extra padding is split as evenly as possible */
+    top = ( n_rows_padded - n_rows ) / 2;
+    bottom = n_rows_padded - n_rows - top;
+    left = ( n_cols_padded - n_cols ) / 2;
+    right = n_cols_padded - n_cols - left;
+
+    if ( DeVAS_verbose ) {
+	fprintf ( stderr, "image size = %d x %d, FFT size = %d x %d\n",
+		n_cols, n_rows, n_cols_padded, n_rows_padded );
+    }
+
+    stage_start = DeVAS_timing_start ( );
+    disassemble_input ( input_image, top, bottom, left, right,
+	    &luminance, &x, &y );
+    	/* break input into separate luminance and chromaticity channels, */
+	/* adding margins if needed */
     	/* allocates luminance, x, and y images */
+    DeVAS_timing_stop ( "disassemble_input", stage_start );
 
     /*
      * Field-of-view needed in order to compute degrees/pixel, which is
@@ -292,7 +425,10 @@ devas_filter ( DeVAS_xyY_image *input_image, double acuity,
 		&threshold_distsq_negative,
 		&filtered_luminance );
 
-    frequency_space = forward_transform ( luminance );	/* only done once */
+    stage_start = DeVAS_timing_start ( );
+    frequency_space = forward_transform ( luminance,
+	    &kept_work.frequency_space );	/* only done once */
+    DeVAS_timing_stop ( "forward_transform", stage_start );
     DC = DeVAS_image_data ( frequency_space, 0, 0 ) . real /
 	((double) ( DeVAS_image_n_rows ( luminance ) *
 	    DeVAS_image_n_cols ( luminance ) ) );
@@ -311,16 +447,9 @@ devas_filter ( DeVAS_xyY_image *input_image, double acuity,
     	/* a_i in Peli (1990) */
 
     /* get a bit of speed by reusing for every band */
-    log2r = log2r_prep ( frequency_space );
-
-    /* get a bit of speed by reusing for every band */
-    fft_inverse_plan =
-	fftwf_plan_dft_c2r_2d ( DeVAS_image_n_rows ( luminance ),
-	    	DeVAS_image_n_cols ( luminance ),
-		(fftwf_complex *)
-		    &DeVAS_image_data ( weighted_frequency_space, 0, 0 ),
-		&DeVAS_image_data ( contrast_band, 0, 0 ),
-		FFTW_ESTIMATE);
+    stage_start = DeVAS_timing_start ( );
+    log2r = get_log2r ( frequency_space );
+    DeVAS_timing_stop ( "log2r_prep", stage_start );
 
     /*
      * Iterate through bands to compute filtered_luminance:
@@ -384,6 +513,8 @@ devas_filter ( DeVAS_xyY_image *input_image, double acuity,
 
 	n_bands++;	/* on to the next band */
 
+	stage_start = DeVAS_timing_start ( );
+
 	if ( peak_sensitivity < 1.0 ) {
 	    /* skip below threshold band on low frequency side of CSF */
 	    if ( DeVAS_veryverbose ) {
@@ -395,7 +526,7 @@ devas_filter ( DeVAS_xyY_image *input_image, double acuity,
 	} else {
 	    /* compute the bandpass band */
 	    bandpass_filter ( band,  frequency_space, weighted_frequency_space,
-		    log2r, contrast_band, fft_inverse_plan );
+		    log2r, contrast_band );
 
 	    /*
 	     * treat bandpass band as local contrast and threshold based
@@ -421,6 +552,8 @@ devas_filter ( DeVAS_xyY_image *input_image, double acuity,
 		/* for use in next iteration */
 	    	/* do this even when skipping below threshold band on */
 		/* low frequency side of CSF */
+
+	DeVAS_timing_stop_indexed ( "band", band, stage_start );
     }
 
     if ( DeVAS_veryverbose ) {
@@ -441,24 +574,82 @@ devas_filter ( DeVAS_xyY_image *input_image, double acuity,
 	 * This is a useful heuristic, but not based on any photometric
 	 * model of low vision color perception.
 	 */
-	CSF_weights = CSF_weight_prep ( frequency_space, fov, acuity,
-		contrast_sensitivity );
+	stage_start = DeVAS_timing_start ( );
+
+	if ( chroma_resolution == DeVAS_CHROMA_REDUCED ) {
+	    chroma_factor = chroma_decimation_factor ( DeVAS_image_n_rows ( x ),
+		    DeVAS_image_n_cols ( x ), fov, acuity,
+		    contrast_sensitivity );
+	}
+
+	if ( chroma_factor > 1 ) {
+	    /*
+	     * Filter at reduced resolution.  Decimation preserves
+	     * cycles/image, so the same fov applies.  Desaturation is
+	     * pointwise and affine, so it is also done at reduced
+	     * resolution.
+	     */
+	    reduced_x = decimate ( x, chroma_factor, &kept_work.reduced_x );
+	    reduced_y = decimate ( y, chroma_factor, &kept_work.reduced_y );
+
+	    if ( DeVAS_verbose ) {
+		fprintf ( stderr,
+	"chroma filtered at 1/%d resolution (%d x %d), representing all\n"
+	"  frequencies with CSF weight >= %.3f (a cutoff, not an error\n"
+	"  bound: averaging and interpolation also attenuate and alias\n"
+	"  some represented frequencies)\n",
+			chroma_factor, DeVAS_image_n_cols ( reduced_x ),
+			DeVAS_image_n_rows ( reduced_x ), CHROMA_WEIGHT_MIN );
+	    }
 
-	/* spatial processing of color channels */
-	filtered_x = filter_color ( x, CSF_weights );
-	filtered_y = filter_color ( y, CSF_weights );
+	    CSF_weights = get_CSF_weights ( DeVAS_image_n_rows ( reduced_x ),
+		    ( DeVAS_image_n_cols ( reduced_x ) / 2 ) + 1, fov, acuity,
+		    contrast_sensitivity );
 
-	/* partial desaturation of color channels */
-	desaturate ( saturation, filtered_x, filtered_y );
+	    filter_color ( reduced_x, reduced_y, CSF_weights,
+		    &reduced_filtered_x, &reduced_filtered_y );
+
+	    /* partial desaturation of color channels */
+	    desaturate ( saturation, reduced_filtered_x, reduced_filtered_y );
+
+	    filtered_x = upsample ( reduced_filtered_x, chroma_factor,
+		    DeVAS_image_n_rows ( x ), DeVAS_image_n_cols ( x ),
+		    &kept_work.upsampled_x );
+	    filtered_y = upsample ( reduced_filtered_y, chroma_factor,
+		    DeVAS_image_n_rows ( y ), DeVAS_image_n_cols ( y ),
+		    &kept_work.upsampled_y );
+
+	    if ( !keep_tables ) {
+		DeVAS_float_image_delete ( reduced_x );
+		DeVAS_float_image_delete ( reduced_y );
+		DeVAS_float_image_delete ( reduced_filtered_x );
+		DeVAS_float_image_delete ( reduced_filtered_y );
+	    }
+	} else {
+	    CSF_weights = get_CSF_weights (
+		    DeVAS_image_n_rows ( frequency_space ),
+		    DeVAS_image_n_cols ( frequency_space ), fov, acuity,
+		    contrast_sensitivity );
+
+	    /* spatial processing of color channels */
+	    filter_color ( x, y, CSF_weights, &filtered_x, &filtered_y );
+
+	    /* partial desaturation of color channels */
+	    desaturate ( saturation, filtered_x, filtered_y );
+	}
 
 	/* clean up */
-	DeVAS_float_image_delete ( CSF_weights );
+	release_table ( CSF_weights );
+
+	DeVAS_timing_stop ( "filter_color", stage_start );
     }
 
+    stage_start = DeVAS_timing_start ( );
     filtered_image = assemble_output ( filtered_luminance, filtered_x,
-	    filtered_y, saturation );
+	    filtered_y, saturation, top, left, n_rows, n_cols );
 	/* reassemble separate luminance and chromaticity channels into */
-	/* single output image */
+	/* single output image, discarding any margins */
+    DeVAS_timing_stop ( "assemble_output", stage_start );
 
     /* keep exposure values as before */
     DeVAS_image_exposure_set ( filtered_image ) =
@@ -485,12 +676,47 @@ devas_filter ( DeVAS_xyY_image *input_image, double acuity,
 		threshold_distsq_negative,
 		saturation,
 		filtered_x,
-		filtered_y,
-		&fft_inverse_plan );
+		filtered_y );
 
     return ( filtered_image );
 }
 
+void
+devas_filter_set_chroma_resolution ( DeVAS_chroma_resolution resolution )
+/*
+ * Set the resolution at which chromaticity is filtered for subsequent
+ * calls.  Default is DeVAS_CHROMA_FULL.
+ */
+{
+    chroma_resolution = resolution;
+}
+
+void
+devas_filter_keep_tables ( int keep )
+/*
+ * When keep is TRUE, the log2r and CSF weight tables and the work images
+ * are kept after each call and reused by the next if the image size and
+ * CSF parameters are unchanged, as when filtering the frames of a
+ * sequence.  When keep is FALSE, any kept tables and images are freed.
+ * Default is FALSE.
+ */
+{
+    keep_tables = keep;
+
+    if ( !keep ) {
+	release_work_images ( );
+
+	if ( kept_log2r != NULL ) {
+	    DeVAS_table_cache_release ( kept_log2r );
+	    kept_log2r = NULL;
+	}
+	if ( kept_CSF_weights != NULL ) {
+	    DeVAS_table_cache_release ( kept_CSF_weights );
+	    kept_CSF_weights = NULL;
+	}
+    }
+}
+
 void
 devas_filter_print_version ( void )
 {
@@ -498,12 +724,15 @@ devas_filter_print_version ( void )
 }
 
 static DeVAS_complexf_image *
-forward_transform ( DeVAS_float_image *source )
+forward_transform ( DeVAS_float_image *source, DeVAS_complexf_image **kept_p )
+/*
+ * Real to complex transform of source, into a work image (see
+ * work_complexf_image ( )).
+ */
 {
     unsigned int	n_rows_input, n_cols_input;
     unsigned int	n_rows_transform, n_cols_transform;
     DeVAS_complexf_image	*transformed_image;
-    fftwf_plan		fft_forward_plan;
 
     n_rows_input = DeVAS_image_n_rows ( source );
     n_cols_input = DeVAS_image_n_cols ( source );
@@ -511,20 +740,11 @@ forward_transform ( DeVAS_float_image *source )
     n_rows_transform = n_rows_input;
     n_cols_transform = ( n_cols_input / 2 ) + 1;
 
-    transformed_image =
-	DeVAS_complexf_image_new ( n_rows_transform, n_cols_transform );
-
-    fft_forward_plan = fftwf_plan_dft_r2c_2d ( n_rows_input, n_cols_input,
-	    &DeVAS_image_data ( source, 0, 0 ),
-	    (fftwf_complex *) &DeVAS_image_data ( transformed_image, 0, 0 ),
-	    FFTW_ESTIMATE );
-    	/* FFTW3 documentation says to always create plan before initializing */
-        /* input array, but then goes on to say that "technically" this is */
-        /* not required for FFTW_ESTIMATE */
-
-    fftwf_execute ( fft_forward_plan );
+    transformed_image = work_complexf_image ( kept_p, n_rows_transform,
+	    n_cols_transform );
 
-    fftwf_destroy_plan ( fft_forward_plan );
+    /* plans are cached and shared with the other transforms of this size */
+    DeVAS_fft_r2c ( source, transformed_image );
 
     return ( transformed_image );
 }
@@ -591,11 +811,55 @@ log2r_prep ( DeVAS_complexf_image *transformed_image )
     return ( log2r );
 }
 
+static DeVAS_float_image *
+make_log2r ( DeVAS_complexf_image *transformed_image )
+/*
+ * log2r_prep ( ), using the on-disk table cache if one has been set.
+ */
+{
+    DeVAS_float_image	*log2r;
+
+    log2r = DeVAS_table_cache_load ( "log2r",
+	    DeVAS_image_n_rows ( transformed_image ),
+	    DeVAS_image_n_cols ( transformed_image ), 0, NULL );
+    if ( log2r == NULL ) {
+	log2r = log2r_prep ( transformed_image );
+	DeVAS_table_cache_store ( "log2r", log2r, 0, NULL );
+    }
+
+    return ( log2r );
+}
+
+static DeVAS_float_image *
+get_log2r ( DeVAS_complexf_image *transformed_image )
+/*
+ * make_log2r ( ), reusing the kept table if it is the right size.
+ */
+{
+    if ( !keep_tables ) {
+	return ( make_log2r ( transformed_image ) );
+    }
+
+    if ( ( kept_log2r != NULL ) &&
+	    ( ( DeVAS_image_n_rows ( kept_log2r ) !=
+		DeVAS_image_n_rows ( transformed_image ) ) ||
+	      ( DeVAS_image_n_cols ( kept_log2r ) !=
+		DeVAS_image_n_cols ( transformed_image ) ) ) ) {
+	DeVAS_table_cache_release ( kept_log2r );
+	kept_log2r = NULL;
+    }
+
+    if ( kept_log2r == NULL ) {
+	kept_log2r = make_log2r ( transformed_image );
+    }
+
+    return ( kept_log2r );
+}
+
 static void
 bandpass_filter ( int band,  DeVAS_complexf_image *frequency_space,
 	DeVAS_complexf_image *weighted_frequency_space,
-	DeVAS_float_image *log2r, DeVAS_float_image *contrast_band,
-	fftwf_plan fft_inverse_plan )
+	DeVAS_float_image *log2r, DeVAS_float_image *contrast_band )
 /*
  * Weight frequency space values using equation A2 in Peli (1990). Weights are
  * a shifted cosine over (-pi - pi), centered at the band frequency, with a
@@ -628,9 +892,7 @@ bandpass_filter ( int band,  DeVAS_complexf_image *frequency_space,
 	}
     }
 
-    fftwf_execute ( fft_inverse_plan );	/* specified in calling program: */
-    					/* src: weighted_frequency_space */
-    					/* dst: contrast_band */
+    DeVAS_fft_c2r ( weighted_frequency_space, contrast_band );
 
     norm = 1.0 / (double) ( DeVAS_image_n_rows ( contrast_band ) *
 	    DeVAS_image_n_cols ( contrast_band ) );
@@ -898,7 +1160,7 @@ feather ( float contrast, float distsq, float smoothing_radius,
 }
 
 static DeVAS_float_image *
-CSF_weight_prep ( DeVAS_complexf_image *frequency_space, double fov,
+CSF_weight_prep ( unsigned int n_rows, unsigned int n_cols, double fov,
 	double acuity, double contrast_sensitivity )
 /*
  * Precompute CSF-based filter weights for filtering color channels.
@@ -908,20 +1170,25 @@ CSF_weight_prep ( DeVAS_complexf_image *frequency_space, double fov,
  * These values can be reused for each color, thus saving repetitions
  * of square, square root, and CSF computations.
  *
- * frequency_space:	Used only to pass size of transformed image.
+ * Weights depend only on the squared distance from DC, row_dist^2 + col^2,
+ * so the CSF is evaluated only once for each (row_dist, col) pair with
+ * col >= row_dist.  The rows for the second half of the transform repeat
+ * those of the first half, and an entry with col < row_dist is the same
+ * as the already computed entry at [col][row_dist].  These are copied
+ * rather than recomputed, with identical results and no storage beyond
+ * the weights themselves.
+ *
+ * n_rows, n_cols:	Size of transformed image.
  */
 {
     DeVAS_float_image	*CSF_weights;
     int			row, col;
-    unsigned int	n_rows, n_cols;
-    double		row_dist, col_dist;
+    unsigned int	row_dist;
+    unsigned int	distsq;
     double		CSF_peak_frequency;
     double		CSF_peak_sensitivity;
     double		frequency_angle;
 
-    n_rows = DeVAS_image_n_rows ( frequency_space );
-    n_cols = DeVAS_image_n_cols ( frequency_space );
-
     CSF_weights = DeVAS_float_image_new ( n_rows, n_cols );
 
     CSF_peak_frequency = ChungLeggeCSF_peak_frequency ( acuity,
@@ -933,43 +1200,33 @@ CSF_weight_prep ( DeVAS_complexf_image *frequency_space, double fov,
      * DC at [0][0], full resolution in row dimension (requires
      * offset), half resolution in col dimension (use as-is).
      */
-    for ( col = 0; col < n_cols; col++ ) {
-	frequency_angle = ((double) col ) / fov;
-
-	if ( frequency_angle <= CSF_peak_frequency ) {
-	    DeVAS_image_data ( CSF_weights, 0, col ) = 1.0;
+    for ( row = 0; row < n_rows; row++ ) {
+	if ( row < ( n_rows + 1 ) / 2 ) {
+	    row_dist = row;		/* first half of transform */
 	} else {
-	    DeVAS_image_data ( CSF_weights, 0, col ) =
-		ChungLeggeCSF ( frequency_angle, acuity,
-		    contrast_sensitivity ) /  CSF_peak_sensitivity;
+	    row_dist = n_rows - row;	/* second half of transform */
 	}
-    }
 
-    /* first half of transform */
-    for ( row = 1; row < ( n_rows + 1 ) / 2; row++ ) {
-	for ( col = 0; col < n_cols; col++ ) {
-	    row_dist = (double) row;
-	    col_dist = (double) col;
-	    frequency_angle = sqrt ( ( row_dist * row_dist ) +
-		    ( col_dist * col_dist ) ) / fov;
-
-	    if ( frequency_angle <= CSF_peak_frequency ) {
-		DeVAS_image_data ( CSF_weights, row, col ) = 1.0;
-	    } else {
+	if ( ( row_dist < ( n_rows + 1 ) / 2 ) &&
+		( row_dist != (unsigned int) row ) ) {
+	    /* mirror of a row in the first half */
+	    for ( col = 0; col < n_cols; col++ ) {
 		DeVAS_image_data ( CSF_weights, row, col ) =
-		    ChungLeggeCSF ( frequency_angle, acuity,
-			    contrast_sensitivity ) /  CSF_peak_sensitivity;
+		    DeVAS_image_data ( CSF_weights, row_dist, col );
 	    }
+	    continue;
 	}
-    }
 
-    /* second half of transform */
-    for ( row = ( n_rows + 1 ) / 2; row < n_rows; row++ ) {
 	for ( col = 0; col < n_cols; col++ ) {
-	    row_dist = (double) ( n_rows - row );
-	    col_dist = (double) col;
-	    frequency_angle = sqrt ( ( row_dist * row_dist ) +
-		    ( col_dist * col_dist ) ) / fov;
+	    if ( ( (unsigned int) col < row_dist ) && ( row_dist < n_cols ) ) {
+		/* transposed entry, in an earlier first half row */
+		DeVAS_image_data ( CSF_weights, row, col ) =
+		    DeVAS_image_data ( CSF_weights, col, row_dist );
+		continue;
+	    }
+
+	    distsq = ( row_dist * row_dist ) + ( col * col );
+	    frequency_angle = sqrt ( (double) distsq ) / fov;
 
 	    if ( frequency_angle <= CSF_peak_frequency ) {
 		DeVAS_image_data ( CSF_weights, row, col ) = 1.0;
@@ -985,58 +1242,450 @@ CSF_weight_prep ( DeVAS_complexf_image *frequency_space, double fov,
 }
 
 static DeVAS_float_image *
-filter_color ( DeVAS_float_image *chroma_channel,
-	DeVAS_float_image *CSF_weights )
+make_CSF_weights ( unsigned int n_rows, unsigned int n_cols, double fov,
+	double acuity, double contrast_sensitivity )
+/*
+ * CSF_weight_prep ( ), using the on-disk table cache if one has been set.
+ */
+{
+    DeVAS_float_image	*CSF_weights;
+    double		parameters[3];
+
+    parameters[0] = fov;
+    parameters[1] = acuity;
+    parameters[2] = contrast_sensitivity;
+
+    CSF_weights = DeVAS_table_cache_load ( "CSF", n_rows, n_cols, 3,
+	    parameters );
+    if ( CSF_weights == NULL ) {
+	CSF_weights = CSF_weight_prep ( n_rows, n_cols, fov, acuity,
+		contrast_sensitivity );
+	DeVAS_table_cache_store ( "CSF", CSF_weights, 3, parameters );
+    }
+
+    return ( CSF_weights );
+}
+
+static DeVAS_float_image *
+get_CSF_weights ( unsigned int n_rows, unsigned int n_cols, double fov,
+	double acuity, double contrast_sensitivity )
+/*
+ * make_CSF_weights ( ), reusing the kept table if it was made with the
+ * same arguments.
+ */
+{
+    if ( !keep_tables ) {
+	return ( make_CSF_weights ( n_rows, n_cols, fov, acuity,
+		    contrast_sensitivity ) );
+    }
+
+    if ( ( kept_CSF_weights != NULL ) &&
+	    ( ( DeVAS_image_n_rows ( kept_CSF_weights ) != n_rows ) ||
+	      ( DeVAS_image_n_cols ( kept_CSF_weights ) != n_cols ) ||
+	      ( kept_CSF_fov != fov ) || ( kept_CSF_acuity != acuity ) ||
+	      ( kept_CSF_contrast_sensitivity != contrast_sensitivity ) ) ) {
+	DeVAS_table_cache_release ( kept_CSF_weights );
+	kept_CSF_weights = NULL;
+    }
+
+    if ( kept_CSF_weights == NULL ) {
+	kept_CSF_weights = make_CSF_weights ( n_rows, n_cols, fov, acuity,
+		contrast_sensitivity );
+	kept_CSF_fov = fov;
+	kept_CSF_acuity = acuity;
+	kept_CSF_contrast_sensitivity = contrast_sensitivity;
+    }
+
+    return ( kept_CSF_weights );
+}
+
+static void
+release_table ( DeVAS_float_image *table )
 /*
- * Filter chroma_channel using CSF as if it were an MTF.
+ * Done with a table from get_log2r ( ) or get_CSF_weights ( ).
  */
 {
-    DeVAS_float_image	*filtered_chroma_channel;
-    fftwf_plan		fft_inverse_plan;
-    DeVAS_complexf_image	*frequency_space;
+    if ( ( table != kept_log2r ) && ( table != kept_CSF_weights ) ) {
+	DeVAS_table_cache_release ( table );
+    }
+}
+
+static DeVAS_float_image *
+work_float_image ( DeVAS_float_image **kept_p, int n_rows, int n_cols )
+/*
+ * An n_rows x n_cols image with undefined contents.  When tables are
+ * kept, this is *kept_p, reallocated if it doesn't exist or is the wrong
+ * size, and must not be deleted by the caller.  Otherwise, it is a new
+ * image.
+ */
+{
+    if ( !keep_tables ) {
+	return ( DeVAS_float_image_new ( n_rows, n_cols ) );
+    }
+
+    if ( ( *kept_p != NULL ) &&
+	    ( ( DeVAS_image_n_rows ( *kept_p ) != n_rows ) ||
+	      ( DeVAS_image_n_cols ( *kept_p ) != n_cols ) ) ) {
+	DeVAS_float_image_delete ( *kept_p );
+	*kept_p = NULL;
+    }
+
+    if ( *kept_p == NULL ) {
+	*kept_p = DeVAS_float_image_new ( n_rows, n_cols );
+    }
+
+    return ( *kept_p );
+}
+
+static DeVAS_gray_image *
+work_gray_image ( DeVAS_gray_image **kept_p, int n_rows, int n_cols )
+/*
+ * As for work_float_image ( ).
+ */
+{
+    if ( !keep_tables ) {
+	return ( DeVAS_gray_image_new ( n_rows, n_cols ) );
+    }
+
+    if ( ( *kept_p != NULL ) &&
+	    ( ( DeVAS_image_n_rows ( *kept_p ) != n_rows ) ||
+	      ( DeVAS_image_n_cols ( *kept_p ) != n_cols ) ) ) {
+	DeVAS_gray_image_delete ( *kept_p );
+	*kept_p = NULL;
+    }
+
+    if ( *kept_p == NULL ) {
+	*kept_p = DeVAS_gray_image_new ( n_rows, n_cols );
+    }
+
+    return ( *kept_p );
+}
+
+static DeVAS_complexf_image *
+work_complexf_image ( DeVAS_complexf_image **kept_p, int n_rows, int n_cols )
+/*
+ * As for work_float_image ( ).
+ */
+{
+    if ( !keep_tables ) {
+	return ( DeVAS_complexf_image_new ( n_rows, n_cols ) );
+    }
+
+    if ( ( *kept_p != NULL ) &&
+	    ( ( DeVAS_image_n_rows ( *kept_p ) != n_rows ) ||
+	      ( DeVAS_image_n_cols ( *kept_p ) != n_cols ) ) ) {
+	DeVAS_complexf_image_delete ( *kept_p );
+	*kept_p = NULL;
+    }
+
+    if ( *kept_p == NULL ) {
+	*kept_p = DeVAS_complexf_image_new ( n_rows, n_cols );
+    }
+
+    return ( *kept_p );
+}
+
+static void
+release_work_images ( void )
+/*
+ * Free the work images kept by work_float_image ( ), work_gray_image ( ),
+ * and work_complexf_image ( ).
+ */
+{
+    DeVAS_float_image	**float_images[] = {
+	&kept_work.luminance, &kept_work.x, &kept_work.y,
+	&kept_work.contrast_band, &kept_work.local_luminance,
+	&kept_work.thresholded_contrast_band,
+	&kept_work.threshold_distsq_positive,
+	&kept_work.threshold_distsq_negative,
+	&kept_work.filtered_luminance,
+	&kept_work.color_filtered_x, &kept_work.color_filtered_y,
+	&kept_work.reduced_x, &kept_work.reduced_y,
+	&kept_work.upsampled_x, &kept_work.upsampled_y };
+    DeVAS_gray_image	**gray_images[] = {
+	&kept_work.threshold_mask_initial_positive,
+	&kept_work.threshold_mask_initial_negative };
+    DeVAS_complexf_image **complexf_images[] = {
+	&kept_work.frequency_space, &kept_work.weighted_frequency_space,
+	&kept_work.x_frequency_space, &kept_work.y_frequency_space };
+    int			i;
+
+    for ( i = 0; i < sizeof ( float_images ) / sizeof ( float_images[0] );
+	    i++ ) {
+	if ( *float_images[i] != NULL ) {
+	    DeVAS_float_image_delete ( *float_images[i] );
+	    *float_images[i] = NULL;
+	}
+    }
+    for ( i = 0; i < sizeof ( gray_images ) / sizeof ( gray_images[0] );
+	    i++ ) {
+	if ( *gray_images[i] != NULL ) {
+	    DeVAS_gray_image_delete ( *gray_images[i] );
+	    *gray_images[i] = NULL;
+	}
+    }
+    for ( i = 0; i < sizeof ( complexf_images ) /
+	    sizeof ( complexf_images[0] ); i++ ) {
+	if ( *complexf_images[i] != NULL ) {
+	    DeVAS_complexf_image_delete ( *complexf_images[i] );
+	    *complexf_images[i] = NULL;
+	}
+    }
+}
+
+static int
+chroma_decimation_factor ( int n_rows, int n_cols, double fov, double acuity,
+	double contrast_sensitivity )
+/*
+ * Largest integer factor by which the chroma channels can be decimated
+ * while still representing every frequency at which the CSF weight used
+ * by CSF_weight_prep ( ) is at least CHROMA_WEIGHT_MIN.  Returns 1 if
+ * there is no such factor larger than 1.
+ */
+{
+    double  CSF_peak_frequency;
+    double  CSF_peak_sensitivity;
+    double  max_radius;
+    double  radius;		/* cycles/image */
+    int	    factor;
+
+    CSF_peak_frequency = ChungLeggeCSF_peak_frequency ( acuity,
+	    contrast_sensitivity );
+    CSF_peak_sensitivity = ChungLeggeCSF_peak_sensitivity ( acuity,
+	    contrast_sensitivity );
+
+    /* weights decrease monotonically above the peak */
+    max_radius = 0.5 * imin ( n_rows, n_cols );
+    for ( radius = fmax ( 1.0, ceil ( CSF_peak_frequency * fov ) );
+	    radius < max_radius; radius += 1.0 ) {
+	if ( ( ChungLeggeCSF ( radius / fov, acuity, contrast_sensitivity ) /
+		    CSF_peak_sensitivity ) < CHROMA_WEIGHT_MIN ) {
+	    break;
+	}
+    }
+
+    /* reduced Nyquist frequency must be at least radius */
+    factor = (int) floor ( max_radius / radius );
+
+    return ( ( factor > 1 ) ? factor : 1 );
+}
+
+static DeVAS_float_image *
+decimate ( DeVAS_float_image *channel, int factor, DeVAS_float_image **kept_p )
+/*
+ * Average over factor x factor blocks.  Blocks at the bottom and right
+ * edges may be partial.  The result is a work image (see
+ * work_float_image ( )).
+ */
+{
+    DeVAS_float_image	*reduced;
+    int			reduced_n_rows, reduced_n_cols;
+    int			row, col;
+    int			block_row, block_col;
+    int			row_end, col_end;
+    double		sum;
+
+    reduced_n_rows = ( DeVAS_image_n_rows ( channel ) + factor - 1 ) / factor;
+    reduced_n_cols = ( DeVAS_image_n_cols ( channel ) + factor - 1 ) / factor;
+
+    reduced = work_float_image ( kept_p, reduced_n_rows, reduced_n_cols );
+    DeVAS_image_view ( reduced ) = DeVAS_image_view ( channel );
+
+#pragma omp parallel for private ( col, block_row, block_col, row_end, \
+	col_end, sum )
+    for ( row = 0; row < reduced_n_rows; row++ ) {
+	row_end = imin ( ( row + 1 ) * factor, DeVAS_image_n_rows ( channel ) );
+	for ( col = 0; col < reduced_n_cols; col++ ) {
+	    col_end = imin ( ( col + 1 ) * factor,
+		    DeVAS_image_n_cols ( channel ) );
+	    sum = 0.0;
+	    for ( block_row = row * factor; block_row < row_end; block_row++ ) {
+		for ( block_col = col * factor; block_col < col_end;
+			block_col++ ) {
+		    sum += DeVAS_image_data ( channel, block_row, block_col );
+		}
+	    }
+	    DeVAS_image_data ( reduced, row, col ) = sum /
+		( ( row_end - ( row * factor ) ) *
+		  ( col_end - ( col * factor ) ) );
+	}
+    }
+
+    return ( reduced );
+}
+
+static DeVAS_float_image *
+upsample ( DeVAS_float_image *reduced, int factor, int n_rows, int n_cols,
+	DeVAS_float_image **kept_p )
+/*
+ * Bilinear interpolation of a channel decimated by decimate ( ) back to
+ * n_rows x n_cols.  Reduced pixels are centered on the blocks they
+ * average.  Interpolation is separable, so sample positions and weights
+ * are computed once per row and once per column.  The result is a work
+ * image (see work_float_image ( )).
+ */
+{
+    DeVAS_float_image	*upsampled;
+    int			*row_0, *col_0;
+    float		*row_fraction, *col_fraction;
+    int			row, col;
+    int			row_1, col_1;
+    int			reduced_n_rows, reduced_n_cols;
+    float		top, bottom;
+
+    reduced_n_rows = DeVAS_image_n_rows ( reduced );
+    reduced_n_cols = DeVAS_image_n_cols ( reduced );
+
+    row_0 = (int *) malloc ( n_rows * sizeof ( int ) );
+    col_0 = (int *) malloc ( n_cols * sizeof ( int ) );
+    row_fraction = (float *) malloc ( n_rows * sizeof ( float ) );
+    col_fraction = (float *) malloc ( n_cols * sizeof ( float ) );
+    if ( ( row_0 == NULL ) || ( col_0 == NULL ) || ( row_fraction == NULL )
+	    || ( col_fraction == NULL ) ) {
+	fprintf ( stderr, "upsample: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    upsample_coordinates ( factor, n_rows, reduced_n_rows, row_0,
+	    row_fraction );
+    upsample_coordinates ( factor, n_cols, reduced_n_cols, col_0,
+	    col_fraction );
+
+    upsampled = work_float_image ( kept_p, n_rows, n_cols );
+
+#pragma omp parallel for private ( col, row_1, col_1, top, bottom )
+    for ( row = 0; row < n_rows; row++ ) {
+	row_1 = imin ( row_0[row] + 1, reduced_n_rows - 1 );
+	for ( col = 0; col < n_cols; col++ ) {
+	    col_1 = imin ( col_0[col] + 1, reduced_n_cols - 1 );
+
+	    top = DeVAS_image_data ( reduced, row_0[row], col_0[col] ) +
+		( col_fraction[col] *
+		  ( DeVAS_image_data ( reduced, row_0[row], col_1 ) -
+		    DeVAS_image_data ( reduced, row_0[row], col_0[col] ) ) );
+	    bottom = DeVAS_image_data ( reduced, row_1, col_0[col] ) +
+		( col_fraction[col] *
+		  ( DeVAS_image_data ( reduced, row_1, col_1 ) -
+		    DeVAS_image_data ( reduced, row_1, col_0[col] ) ) );
+
+	    DeVAS_image_data ( upsampled, row, col ) = top +
+		( row_fraction[row] * ( bottom - top ) );
+	}
+    }
+
+    free ( row_0 );
+    free ( col_0 );
+    free ( row_fraction );
+    free ( col_fraction );
+
+    return ( upsampled );
+}
+
+static void
+upsample_coordinates ( int factor, int n, int n_reduced, int *index_0,
+	float *fraction )
+/*
+ * For each of n full resolution positions, the lower of the two reduced
+ * resolution samples it lies between and the fractional distance to the
+ * upper one.  Positions beyond the first or last sample are clamped.
+ */
+{
+    int	    i;
+    double  position;
+
+    for ( i = 0; i < n; i++ ) {
+	position = ( ( i + 0.5 ) / factor ) - 0.5;
+
+	if ( position <= 0.0 ) {
+	    index_0[i] = 0;
+	    fraction[i] = 0.0;
+	} else if ( position >= ( n_reduced - 1 ) ) {
+	    index_0[i] = n_reduced - 1;
+	    fraction[i] = 0.0;
+	} else {
+	    index_0[i] = (int) floor ( position );
+	    fraction[i] = position - index_0[i];
+	}
+    }
+}
+
+
+static void
+filter_color ( DeVAS_float_image *x, DeVAS_float_image *y,
+	DeVAS_float_image *CSF_weights, DeVAS_float_image **filtered_x_p,
+	DeVAS_float_image **filtered_y_p )
+/*
+ * Filter the x and y chroma channels using CSF as if it were an MTF.
+ *
+ * Both channels use the same weights, so they are weighted and
+ * normalized in shared passes over the images.  The transforms of the
+ * two channels are independent and are done concurrently when OpenMP is
+ * available (plan lookup is locked, plan execution is thread safe).
+ */
+{
+    DeVAS_float_image	*filtered_x, *filtered_y;
+    DeVAS_complexf_image	*x_frequency_space = NULL;
+    DeVAS_complexf_image	*y_frequency_space = NULL;
     double		norm;
     int			row, col;
 
-    /* forward FFT */
-    frequency_space = forward_transform ( chroma_channel );
+    /* forward FFTs */
+#pragma omp parallel sections
+    {
+#pragma omp section
+	x_frequency_space = forward_transform ( x,
+		&kept_work.x_frequency_space );
+#pragma omp section
+	y_frequency_space = forward_transform ( y,
+		&kept_work.y_frequency_space );
+    }
 
     /* multiply by frequency space CSF values */
+#pragma omp parallel for private ( col )
     for ( row = 0; row < DeVAS_image_n_rows ( CSF_weights ); row++ ) {
 	for ( col = 0; col < DeVAS_image_n_cols ( CSF_weights ); col++ ) {
-	    DeVAS_image_data ( frequency_space, row, col ) =
+	    DeVAS_image_data ( x_frequency_space, row, col ) =
 		rxc ( DeVAS_image_data ( CSF_weights, row, col ),
-			DeVAS_image_data ( frequency_space, row, col ) );
+			DeVAS_image_data ( x_frequency_space, row, col ) );
+	    DeVAS_image_data ( y_frequency_space, row, col ) =
+		rxc ( DeVAS_image_data ( CSF_weights, row, col ),
+			DeVAS_image_data ( y_frequency_space, row, col ) );
 	}
     }
 
-    /* inverse FFT */
-    filtered_chroma_channel =
-	DeVAS_float_image_new ( DeVAS_image_n_rows ( chroma_channel ),
-	    DeVAS_image_n_cols ( chroma_channel ) );
-    fft_inverse_plan =
-	fftwf_plan_dft_c2r_2d ( DeVAS_image_n_rows ( chroma_channel ),
-		DeVAS_image_n_cols ( chroma_channel ),
-		(fftwf_complex *) &DeVAS_image_data ( frequency_space, 0, 0 ),
-		&DeVAS_image_data ( filtered_chroma_channel, 0, 0 ),
-		FFTW_ESTIMATE);
-    fftwf_execute ( fft_inverse_plan );
+    /* inverse FFTs */
+    filtered_x = work_float_image ( &kept_work.color_filtered_x,
+	    DeVAS_image_n_rows ( x ), DeVAS_image_n_cols ( x ) );
+    filtered_y = work_float_image ( &kept_work.color_filtered_y,
+	    DeVAS_image_n_rows ( y ), DeVAS_image_n_cols ( y ) );
+#pragma omp parallel sections
+    {
+#pragma omp section
+	DeVAS_fft_c2r ( x_frequency_space, filtered_x );
+#pragma omp section
+	DeVAS_fft_c2r ( y_frequency_space, filtered_y );
+    }
 
     /* normalize */
-    norm = 1.0 / (double) ( DeVAS_image_n_rows ( filtered_chroma_channel ) *
-	    DeVAS_image_n_cols ( filtered_chroma_channel ) );
-    for ( row = 0; row < DeVAS_image_n_rows ( filtered_chroma_channel );
-	    					row++ ) {
-	for ( col = 0; col < DeVAS_image_n_cols ( filtered_chroma_channel );
-						    col++ ) {
-	    DeVAS_image_data ( filtered_chroma_channel, row, col ) *= norm;
+    norm = 1.0 / (double) ( DeVAS_image_n_rows ( filtered_x ) *
+	    DeVAS_image_n_cols ( filtered_x ) );
+#pragma omp parallel for private ( col )
+    for ( row = 0; row < DeVAS_image_n_rows ( filtered_x ); row++ ) {
+	for ( col = 0; col < DeVAS_image_n_cols ( filtered_x ); col++ ) {
+	    DeVAS_image_data ( filtered_x, row, col ) *= norm;
+	    DeVAS_image_data ( filtered_y, row, col ) *= norm;
 	}
     }
 
     /* clean up */
-    fftwf_destroy_plan ( fft_inverse_plan );
-    DeVAS_complexf_image_delete ( frequency_space );
+    if ( !keep_tables ) {
+	DeVAS_complexf_image_delete ( x_frequency_space );
+	DeVAS_complexf_image_delete ( y_frequency_space );
+    }
 
-    return ( filtered_chroma_channel );
+    *filtered_x_p = filtered_x;
+    *filtered_y_p = filtered_y;
 }
 
 static DeVAS_complexf
@@ -1054,37 +1703,49 @@ rxc ( DeVAS_float real_value, DeVAS_complexf complex_value )
 }
 
 static void
-disassemble_input ( DeVAS_xyY_image *input_image, DeVAS_float_image **luminance,
+disassemble_input ( DeVAS_xyY_image *input_image, int top, int bottom,
+	int left, int right, DeVAS_float_image **luminance,
 	DeVAS_float_image **x, DeVAS_float_image **y )
 /*
- * Break input into separate luminance and chromaticity channels
+ * Break input into separate luminance and chromaticity channels, with the
+ * specified margins (which may be 0) added.
  */
 {
     int	    row, col;
+    int	    n_rows, n_cols;
 
-    *luminance = DeVAS_float_image_new ( DeVAS_image_n_rows ( input_image ),
-	    DeVAS_image_n_cols ( input_image ) );
-    *x = DeVAS_float_image_new ( DeVAS_image_n_rows ( input_image ),
-	    DeVAS_image_n_cols ( input_image ) );
-    *y = DeVAS_float_image_new ( DeVAS_image_n_rows ( input_image ),
-	    DeVAS_image_n_cols ( input_image ) );
-
-    for ( row = 0; row < DeVAS_image_n_rows ( input_image ); row++ ) {
-	for ( col = 0; col < DeVAS_image_n_cols ( input_image ); col++ ) {
-	    DeVAS_image_data ( *luminance, row, col ) =
-		DeVAS_image_data ( input_image, row, col ) . Y;
-	    DeVAS_image_data (*x, row, col ) =
-		DeVAS_image_data ( input_image, row, col ) . x;
-	    DeVAS_image_data (*y, row, col ) =
-		DeVAS_image_data ( input_image, row, col ) . y;
+    n_rows = DeVAS_image_n_rows ( input_image ) + top + bottom;
+    n_cols = DeVAS_image_n_cols ( input_image ) + left + right;
+
+    *luminance = work_float_image ( &kept_work.luminance, n_rows, n_cols );
+    *x = work_float_image ( &kept_work.x, n_rows, n_cols );
+    *y = work_float_image ( &kept_work.y, n_rows, n_cols );
+
+    if ( ( top > 0 ) || ( bottom > 0 ) || ( left > 0 ) || ( right > 0 ) ) {
+	/* also sets view records, with fov adjusted for the margins */
+	DeVAS_xyY_add_margin_split ( top, bottom, left, right, input_image,
+		*luminance, *x, *y );
+    } else {
+	for ( row = 0; row < n_rows; row++ ) {
+	    for ( col = 0; col < n_cols; col++ ) {
+		DeVAS_image_data ( *luminance, row, col ) =
+		    DeVAS_image_data ( input_image, row, col ) . Y;
+		DeVAS_image_data (*x, row, col ) =
+		    DeVAS_image_data ( input_image, row, col ) . x;
+		DeVAS_image_data (*y, row, col ) =
+		    DeVAS_image_data ( input_image, row, col ) . y;
+	    }
 	}
-    }
 
-    /* Copy over view record (for fov). */
-    DeVAS_image_view ( *x ) = DeVAS_image_view ( input_image );
-    DeVAS_image_view ( *y ) = DeVAS_image_view ( input_image );
-    DeVAS_image_view ( *luminance ) = DeVAS_image_view ( input_image );
+	/* Copy over view record (for fov). */
+	DeVAS_image_view ( *x ) = DeVAS_image_view ( input_image );
+	DeVAS_image_view ( *y ) = DeVAS_image_view ( input_image );
+	DeVAS_image_view ( *luminance ) = DeVAS_image_view ( input_image );
+    }
 
+    if ( DeVAS_image_description ( *luminance ) != NULL ) {
+	free ( DeVAS_image_description ( *luminance ) );  /* from last frame */
+    }
     if ( DeVAS_image_description ( input_image ) != NULL ) {
 	DeVAS_image_description ( *luminance ) =
 	    strdup ( DeVAS_image_description ( input_image ) );
@@ -1096,44 +1757,41 @@ disassemble_input ( DeVAS_xyY_image *input_image, DeVAS_float_image **luminance,
 static DeVAS_xyY_image *
 assemble_output ( DeVAS_float_image *filtered_luminance,
 	DeVAS_float_image *filtered_x, DeVAS_float_image *filtered_y,
-	double saturation )
+	double saturation, int top, int left, int n_rows, int n_cols )
 /*
  * Reassemble separate luminance and chromaticity channels into single
- * output image.
+ * n_rows x n_cols output image, taken from the channels starting at
+ * [top][left] (skipping any margins).
  */
 {
-    DeVAS_xyY	    xyY;
     DeVAS_xyY_image  *output_image;
     int		    row, col;
 
-    output_image =
-	DeVAS_xyY_image_new ( DeVAS_image_n_rows ( filtered_luminance ),
-		DeVAS_image_n_cols ( filtered_luminance ) );
+    output_image = DeVAS_xyY_image_new ( n_rows, n_cols );
 
     if ( saturation > 0.0 )  {
 	/* partially desaturated output requested */
+	/* filtered (x,y) values may be out of gamut */
+#pragma omp parallel for
 	for ( row = 0; row < DeVAS_image_n_rows ( output_image ); row++ ) {
-	    for ( col = 0; col < DeVAS_image_n_cols ( output_image ); col++ ) {
-		xyY.x = DeVAS_image_data ( filtered_x, row, col );
-		xyY.y = DeVAS_image_data ( filtered_y, row, col );
-		xyY.Y = DeVAS_image_data ( filtered_luminance, row, col );
-
-		DeVAS_image_data ( output_image, row, col ) =
-		    clip_to_xyY_gamut ( xyY );
-			/* filtered (x,y) values may be out of gamut */
-	    }
-	} 
+	    clip_to_xyY_gamut ( &DeVAS_image_data ( filtered_x, row + top, left ),
+		    &DeVAS_image_data ( filtered_y, row + top, left ),
+		    &DeVAS_image_data ( filtered_luminance, row + top, left ),
+		    n_cols, &DeVAS_image_data ( output_image, row, 0 ) );
+	}
     } else {
 	/* totally desaturated output requested */
+	/* whitepoint is in gamut, so only Y needs clipping */
+#pragma omp parallel for private ( col )
 	for ( row = 0; row < DeVAS_image_n_rows ( output_image ); row++ ) {
 	    for ( col = 0; col < DeVAS_image_n_cols ( output_image ); col++ ) {
-		xyY.x = DeVAS_x_WHITEPOINT;
-		xyY.y = DeVAS_y_WHITEPOINT;
-		xyY.Y = DeVAS_image_data ( filtered_luminance, row, col );
-
-		DeVAS_image_data ( output_image, row, col ) =
-		    clip_to_xyY_gamut ( xyY );
-			/* filtered (x,y) values may be out of gamut */
+		DeVAS_image_data ( output_image, row, col ) . x =
+		    DeVAS_x_WHITEPOINT;
+		DeVAS_image_data ( output_image, row, col ) . y =
+		    DeVAS_y_WHITEPOINT;
+		DeVAS_image_data ( output_image, row, col ) . Y =
+		    fmax ( DeVAS_image_data ( filtered_luminance, row + top,
+				col + left ), 0.0 );	/* can't be negative */
 	    }
 	}
     }
@@ -1174,111 +1832,56 @@ desaturate ( double saturation, DeVAS_float_image *x, DeVAS_float_image *y )
     }
 }
 
-static DeVAS_xyY
-clip_to_xyY_gamut ( DeVAS_xyY xyY )
+static void
+clip_to_xyY_gamut ( float *x, float *y, float *Y, int n_cols,
+	DeVAS_xyY *xyY )
 /*
- * If value is outside of gamut triangle, return the point on the gamut
- * triangle intersected by a line from the whitepoint to the value.
+ * Combine a row of x, y, and Y values into xyY values.  (x,y) values
+ * outside of the gamut triangle are moved to the point on the triangle
+ * intersected by a line from the whitepoint to the value, and negative Y
+ * values are set to 0.
+ *
+ * Each edge of the triangle is a coordinate axis or x + y = 1, so the
+ * intersections have simple closed forms, and the tests are written as
+ * selects so that the loop can be vectorized.  If more than one edge is
+ * crossed, the y-axis takes precedence over the hypotenuse and the x-axis
+ * over both.
  */
 {
-    DeVAS_xyY	ingamut_xyY;
-    XY_point	xy_point, origin, x_max, y_max, white_pt;
-    XY_point	intersection;
-
-    ingamut_xyY.Y = fmax ( xyY.Y, 0.0 );	/* Y can't be negative */
+    int	    col;
+    double  cross;	/* determinant of whitepoint and (x,y) */
+    double  clipped_x, clipped_y;
 
-    xy_point.x = xyY.x; xy_point.y = xyY.y;
-    origin.x = 0.0; origin.y = 0.0;
-    x_max.x = 1.0; x_max.y = 0.0;
-    y_max.x = 0.0; y_max.y = 1.0;
-    white_pt.x = DeVAS_x_WHITEPOINT;
-    white_pt.y = DeVAS_y_WHITEPOINT;
-
-    if ( xyY.y < 0.0 ) {
-	/* wrong side of x-axis */
-	intersection = line_intersection ( origin, x_max, white_pt, xy_point );
-	if ( ( intersection.y >= 0.0 ) && intersection.y <= 1.0 ) {
-	    ingamut_xyY.x = intersection.x;
-	    ingamut_xyY.y = intersection.y;
-
-	    return ( ingamut_xyY );
-	}
-    } else if ( xyY.x < 0.0 ) {
-	/* wrong side of y-axis */
-	intersection = line_intersection ( origin, y_max, white_pt, xy_point );
-	if ( ( intersection.x >= 0.0 ) && intersection.x <= 1.0 ) {
-	    ingamut_xyY.x = intersection.x;
-	    ingamut_xyY.y = intersection.y;
+    for ( col = 0; col < n_cols; col++ ) {
+	cross = ( DeVAS_x_WHITEPOINT * y[col] ) -
+	    ( DeVAS_y_WHITEPOINT * x[col] );
 
-	    return ( ingamut_xyY );
-	}
-    } else if ( ( xyY.x + xyY.y ) > 1.0 ) {
 	/* wrong side of gamut hypotenuse */
-	intersection = line_intersection ( x_max, y_max, white_pt, xy_point );
-	if ( ( intersection.x <= 1.0 ) && intersection.y <= 1.0 ) {
-	    ingamut_xyY.x = intersection.x;
-	    ingamut_xyY.y = intersection.y;
-
-	    return ( ingamut_xyY );
-	}
-    } else if ( ( xyY.x >= 0.0 ) && ( xyY.y >= 0.0 ) &&
-	    ( ( xyY.x + xyY.y ) <= 1.0 ) ) {
-	ingamut_xyY.x = xyY.x;
-	ingamut_xyY.y = xyY.y;
-
-	return ( ingamut_xyY );
-    }
-
-    fprintf ( stderr, "clip_to_xyY_gamut: internal error!\n" );
-    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
-    exit ( EXIT_FAILURE );
-}
+	clipped_x = ( ( x[col] + y[col] ) > 1.0 ) ?
+	    ( ( DeVAS_x_WHITEPOINT - x[col] ) - cross ) /
+		( ( DeVAS_y_WHITEPOINT - y[col] ) +
+		  ( DeVAS_x_WHITEPOINT - x[col] ) ) :
+	    x[col];
+	clipped_y = ( ( x[col] + y[col] ) > 1.0 ) ?
+	    ( ( DeVAS_y_WHITEPOINT - y[col] ) + cross ) /
+		( ( DeVAS_y_WHITEPOINT - y[col] ) +
+		  ( DeVAS_x_WHITEPOINT - x[col] ) ) :
+	    y[col];
 
-#define	LINE_INTERSECTION_EPSILON	0.0001
-
-static XY_point
-line_intersection ( XY_point line_1_p1, XY_point line_1_p2, XY_point line_2_p1,
-	XY_point line_2_p2 )
-/*
- * Returns the intersection of two infinite lines, each specified in terms
- * of two points on the line.  It is a fatal error for the two points
- * specifying a particular line to be coincident or for the two lines to
- * be parallel or coincident.
- *
- * Algorithm taken from <https://en.wikipedia.org/wiki/Line–line_intersection>.
- */
-{
-    double	denominator;
-    XY_point	intersection;
+	/* wrong side of y-axis */
+	clipped_x = ( x[col] < 0.0 ) ? 0.0 : clipped_x;
+	clipped_y = ( x[col] < 0.0 ) ?
+	    cross / ( DeVAS_x_WHITEPOINT - x[col] ) : clipped_y;
 
-    denominator = ( ( line_1_p1.x - line_1_p2.x ) *
-	    				( line_2_p1.y - line_2_p2.y ) ) -
-	( ( line_1_p1.y - line_1_p2.y ) * ( line_2_p1.x - line_2_p2.x ) );
+	/* wrong side of x-axis */
+	clipped_x = ( y[col] < 0.0 ) ?
+	    cross / ( y[col] - DeVAS_y_WHITEPOINT ) : clipped_x;
+	clipped_y = ( y[col] < 0.0 ) ? 0.0 : clipped_y;
 
-    if ( fabs ( denominator ) < LINE_INTERSECTION_EPSILON ) {
-	fprintf ( stderr,
-	    "line_intersection: coincident or parallel lines or points!\n" );
-	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
-	exit ( EXIT_FAILURE );
+	xyY[col].x = clipped_x;
+	xyY[col].y = clipped_y;
+	xyY[col].Y = fmax ( Y[col], 0.0 );	/* Y can't be negative */
     }
-
-    intersection.x =
-	( ( ( ( line_1_p1.x * line_1_p2.y ) - ( line_1_p1.y * line_1_p2.x ) ) *
-	    			( line_2_p1.x - line_2_p2.x ) ) -
-	  ( ( line_1_p1.x - line_1_p2.x ) *
-	    ( ( line_2_p1.x * line_2_p2.y ) -
-	      			( line_2_p1.y * line_2_p2.x ) ) ) ) /
-			denominator;
-
-    intersection.y =
-	( ( ( ( line_1_p1.x * line_1_p2.y ) - ( line_1_p1.y * line_1_p2.x ) ) *
-	    			( line_2_p1.y - line_2_p2.y ) ) -
-	  ( ( line_1_p1.y - line_1_p2.y ) *
-	    ( ( line_2_p1.x * line_2_p2.y ) -
-	      			( line_2_p1.y * line_2_p2.x ) ) ) ) /
-			denominator;
-
-    return ( intersection );
 }
 
 static void
@@ -1293,7 +1896,8 @@ preallocate_images ( int n_rows, int n_cols,
     DeVAS_float_image	**threshold_distsq_negative,
     DeVAS_float_image	**filtered_luminance )
 /*
- * Preallocate image objects that will be reused for each processed band.
+ * Preallocate image objects that will be reused for each processed band
+ * (and, when tables are kept, for each call).
  */
 {
     int	    n_rows_transform, n_cols_transform;
@@ -1301,16 +1905,25 @@ preallocate_images ( int n_rows, int n_cols,
     n_rows_transform = n_rows;
     n_cols_transform = ( n_cols / 2 ) + 1;
 
-    *weighted_frequency_space =
-	DeVAS_complexf_image_new ( n_rows_transform, n_cols_transform );
-    *contrast_band = DeVAS_float_image_new ( n_rows, n_cols );
-    *local_luminance = DeVAS_float_image_new ( n_rows, n_cols );
-    *thresholded_contrast_band = DeVAS_float_image_new ( n_rows, n_cols );
-    *threshold_mask_initial_positive = DeVAS_gray_image_new ( n_rows, n_cols );
-    *threshold_mask_initial_negative = DeVAS_gray_image_new ( n_rows, n_cols );
-    *threshold_distsq_positive = DeVAS_float_image_new ( n_rows, n_cols );
-    *threshold_distsq_negative = DeVAS_float_image_new ( n_rows, n_cols );
-    *filtered_luminance = DeVAS_float_image_new ( n_rows, n_cols );
+    *weighted_frequency_space = work_complexf_image
+	( &kept_work.weighted_frequency_space, n_rows_transform,
+	  n_cols_transform );
+    *contrast_band = work_float_image ( &kept_work.contrast_band,
+	    n_rows, n_cols );
+    *local_luminance = work_float_image ( &kept_work.local_luminance,
+	    n_rows, n_cols );
+    *thresholded_contrast_band = work_float_image
+	( &kept_work.thresholded_contrast_band, n_rows, n_cols );
+    *threshold_mask_initial_positive = work_gray_image
+	( &kept_work.threshold_mask_initial_positive, n_rows, n_cols );
+    *threshold_mask_initial_negative = work_gray_image
+	( &kept_work.threshold_mask_initial_negative, n_rows, n_cols );
+    *threshold_distsq_positive = work_float_image
+	( &kept_work.threshold_distsq_positive, n_rows, n_cols );
+    *threshold_distsq_negative = work_float_image
+	( &kept_work.threshold_distsq_negative, n_rows, n_cols );
+    *filtered_luminance = work_float_image ( &kept_work.filtered_luminance,
+	    n_rows, n_cols );
 }
 
 static void
@@ -1331,14 +1944,18 @@ cleanup (
     DeVAS_float_image *threshold_distsq_negative,
     double saturation,	/* needed for filtered_x and filtered_y */
     DeVAS_float_image *filtered_x,
-    DeVAS_float_image *filtered_y,
-    fftwf_plan *fft_inverse_plan )
+    DeVAS_float_image *filtered_y )
 /*
- * de-leak memory
+ * de-leak memory (work images are kept when tables are)
  */
 {
+    release_table ( log2r );
+
+    if ( keep_tables ) {
+	return;
+    }
+
     DeVAS_complexf_image_delete ( frequency_space );
-    DeVAS_float_image_delete ( log2r );
     DeVAS_complexf_image_delete ( weighted_frequency_space );
     DeVAS_float_image_delete ( contrast_band );
     DeVAS_float_image_delete ( local_luminance );
@@ -1355,6 +1972,4 @@ cleanup (
 	DeVAS_float_image_delete ( filtered_x );
 	DeVAS_float_image_delete ( filtered_y );
     }
-    fftwf_destroy_plan ( *fft_inverse_plan );
-    fftwf_cleanup ( );
 }
@@ -9,6 +9,17 @@
 extern int	DeVAS_verbose;		/* print generally useful info */
 extern int	DeVAS_veryverbose;	/* print debugging info */
 
+/*
+ * Resolution at which chromaticity channels are filtered.
+ * DeVAS_CHROMA_REDUCED filters them at the lowest resolution that
+ * represents every frequency passed with a CSF weight of at least 0.01,
+ * and interpolates the result back to full resolution.
+ */
+typedef enum {
+    DeVAS_CHROMA_FULL,
+    DeVAS_CHROMA_REDUCED
+} DeVAS_chroma_resolution;
+
 /* function prototypes */
 
 #ifdef __cplusplus
@@ -18,6 +29,13 @@ extern "C" {
 DeVAS_xyY_image	*devas_filter ( DeVAS_xyY_image *input_image, double acuity,
 		    double contrast_sensitivity, int smoothing_flag,
        		    double saturation );
+DeVAS_xyY_image	*devas_filter_margin ( DeVAS_xyY_image *input_image,
+		    int v_margin, int h_margin, int fft_padding,
+		    double acuity, double contrast_sensitivity,
+		    int smoothing_flag, double saturation );
+void		devas_filter_set_chroma_resolution
+		    ( DeVAS_chroma_resolution resolution );
+void		devas_filter_keep_tables ( int keep );
 void		devas_filter_print_version ( void );
 
 #ifdef __cplusplus
@@ -1,31 +1,45 @@
 /*
  * 2-D Gaussian blur of floating point values.
  * Convolution is done using fftw.
+ *
+ * By default, the transfer function of the Gaussian is computed
+ * analytically on the half-spectrum grid, as the product of separate row
+ * and column factors.  Define GBLUR_FFT_SPATIAL_KERNEL to instead generate
+ * a full size space domain kernel and transform it (slower, and requires
+ * an extra full size image and forward transform).
  */
 
+/* #define	GBLUR_FFT_SPATIAL_KERNEL */
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
 #include "devas-gblur-fft.h"
 #include "devas-image.h"
-#include <fftw3.h>
+#include "devas-fft-plan.h"
 #include "devas-utils.h"
 
 #define	SQR(x)	((x) * (x))
 
+#ifdef GBLUR_FFT_SPATIAL_KERNEL
 static DeVAS_float_image *generate_gaussian_kernel ( int n_rows, int n_cols,
 			    double st_dev );
 static double		gaussian ( double r_sq, double st_dev );
 static void		apply_weights ( DeVAS_complexf_image *transformed_image,
 			    DeVAS_complexf_image *transformed_kernel );
-static int		DeVAS_float_image_samesize_local
-			    ( DeVAS_float_image *input,
-				DeVAS_float_image *output);
-			/* there is also a samesize routine in DeVAS-utils */
 static int		DeVAS_complexf_image_samesize_local
 			    ( DeVAS_complexf_image *input,
 					DeVAS_complexf_image *output);
 static DeVAS_complexf	cxc ( DeVAS_complexf a, DeVAS_complexf b );
+#else
+static void		apply_gaussian_transfer
+			    ( DeVAS_complexf_image *transformed_image,
+			      int n_rows, int n_cols, double st_dev );
+#endif	/* GBLUR_FFT_SPATIAL_KERNEL */
+static int		DeVAS_float_image_samesize_local
+			    ( DeVAS_float_image *input,
+				DeVAS_float_image *output);
+			/* there is also a samesize routine in DeVAS-utils */
 
 DeVAS_float_image  	*DeVAS_float_gblur_fft ( DeVAS_float_image *input,
 			    float st_dev )
@@ -60,11 +74,11 @@ DeVAS_float_gblur2_fft ( DeVAS_float_image *input, DeVAS_float_image *output,
 {
     int			n_rows_input, n_cols_input;
     int			n_rows_transform, n_cols_transform;
+#ifdef GBLUR_FFT_SPATIAL_KERNEL
     DeVAS_float_image	*gaussian_kernel;
     DeVAS_complexf_image	*transformed_kernel;
+#endif	/* GBLUR_FFT_SPATIAL_KERNEL */
     DeVAS_complexf_image	*transformed_image;
-    fftwf_plan		fft_plan_input;		/* also use this for kernel */
-    fftwf_plan		fft_plan_inverse;
 
     int			row, col;
     float		norm;
@@ -90,43 +104,40 @@ DeVAS_float_gblur2_fft ( DeVAS_float_image *input, DeVAS_float_image *output,
     n_rows_transform = n_rows_input;
     n_cols_transform = ( n_cols_input / 2 ) + 1;
 
+#ifdef GBLUR_FFT_SPATIAL_KERNEL
     transformed_kernel =
 	DeVAS_complexf_image_new ( n_rows_transform, n_cols_transform );
     		/* if possible, use fft3w allocator */
+#endif	/* GBLUR_FFT_SPATIAL_KERNEL */
 
     transformed_image =
 	DeVAS_complexf_image_new ( n_rows_transform, n_cols_transform );
     		/* if possible, use fft3w allocator */
 
-    fft_plan_input = fftwf_plan_dft_r2c_2d ( n_rows_input, n_cols_input,
-	    &DeVAS_image_data ( input, 0, 0 ),
-	    (fftwf_complex *) &DeVAS_image_data ( transformed_image, 0, 0 ),
-	    FFTW_ESTIMATE );
-
-    fftwf_execute ( fft_plan_input );
+    DeVAS_fft_r2c ( input, transformed_image );
 
+#ifdef GBLUR_FFT_SPATIAL_KERNEL
     /*
      * Generate a space domain Gaussian kernel with the specified standard
      * deviation and then convolve this with the input image using
-     * multiplication in the frequency domain.  Some speedup might be
-     * achieved if the transform of the kernel was replaced by an
-     * anylitically computed transformed kernel.
+     * multiplication in the frequency domain.
      */
     gaussian_kernel = generate_gaussian_kernel ( n_rows_input, n_cols_input,
 	    st_dev );
 
-    /* repurpose fft_plan_input for use with Gaussian kernel */
-    fftwf_execute_dft_r2c ( fft_plan_input,
-	    &DeVAS_image_data ( gaussian_kernel, 0, 0 ),
-	    (fftwf_complex *) &DeVAS_image_data ( transformed_kernel, 0, 0 ) );
+    DeVAS_fft_r2c ( gaussian_kernel, transformed_kernel );
 
     apply_weights ( transformed_image, transformed_kernel );
+#else
+    /*
+     * Multiply by the analytically computed transform of a Gaussian with
+     * the specified standard deviation.
+     */
+    apply_gaussian_transfer ( transformed_image, n_rows_input, n_cols_input,
+	    st_dev );
+#endif	/* GBLUR_FFT_SPATIAL_KERNEL */
 
-    fft_plan_inverse = fftwf_plan_dft_c2r_2d ( n_rows_input, n_cols_input,
-	    (fftwf_complex *) &DeVAS_image_data ( transformed_image, 0, 0 ),
-	    &DeVAS_image_data ( output, 0, 0), FFTW_ESTIMATE );
-
-    fftwf_execute ( fft_plan_inverse );
+    DeVAS_fft_c2r ( transformed_image, output );
 
     norm = 1.0 / (double) ( n_rows_input * n_cols_input );
     for ( row = 0; row < n_rows_input; row++ ) {
@@ -135,21 +146,25 @@ DeVAS_float_gblur2_fft ( DeVAS_float_image *input, DeVAS_float_image *output,
 	}
     }
 
-    fftwf_destroy_plan ( fft_plan_input );
-    fftwf_destroy_plan ( fft_plan_inverse );
-    fftwf_cleanup ( );
+#ifdef GBLUR_FFT_SPATIAL_KERNEL
     DeVAS_float_image_delete ( gaussian_kernel );
     DeVAS_complexf_image_delete ( transformed_kernel );
+#endif	/* GBLUR_FFT_SPATIAL_KERNEL */
     DeVAS_complexf_image_delete ( transformed_image );
 }
 
 void
-DeVAS_gblur_fft_destroy ( void ) {
-    /*
-     * Do nothing (included for compatibility with gblur (...) ).
-     */
+DeVAS_gblur_fft_destroy ( void )
+/*
+ * Release the cached FFTW plans used by DeVAS_float_gblur2_fft ( ).  These
+ * are shared with devas_filter ( ), so this releases its plans as well.
+ */
+{
+    DeVAS_fft_plan_cache_destroy ( );
 }
 
+#ifdef GBLUR_FFT_SPATIAL_KERNEL
+
 static DeVAS_float_image *
 generate_gaussian_kernel ( int n_rows, int n_cols, double st_dev )
 /*
@@ -251,15 +266,6 @@ apply_weights ( DeVAS_complexf_image *transformed_image,
     }
 }
 
-static int
-DeVAS_float_image_samesize_local ( DeVAS_float_image *input,
-	DeVAS_float_image *output )
-{
-    return ( ( DeVAS_image_n_rows ( input ) == DeVAS_image_n_rows ( output ) )
-				&&
-	    ( DeVAS_image_n_cols ( input ) == DeVAS_image_n_cols ( output ) ) );
-}
-
 static int
 DeVAS_complexf_image_samesize_local ( DeVAS_complexf_image *input,
 	DeVAS_complexf_image *output)
@@ -282,3 +288,83 @@ cxc ( DeVAS_complexf a, DeVAS_complexf b )
 
     return ( product );
 }
+
+#else
+
+static void
+apply_gaussian_transfer ( DeVAS_complexf_image *transformed_image,
+	int n_rows, int n_cols, double st_dev )
+/*
+ * Multiply the half-spectrum transform of an n_rows x n_cols image by the
+ * transfer function of a Gaussian with standard deviation st_dev (pixels):
+ *
+ *   exp ( -2 pi^2 st_dev^2 ( f_row^2 + f_col^2 ) )
+ *
+ * with frequencies in cycles/pixel.  The transfer function is separable,
+ * so only n_rows + ( ( n_cols / 2 ) + 1 ) calls to exp ( ) are needed.
+ * The DC weight is exactly 1.0, so mean luminance is preserved.
+ */
+{
+    int	    row, col;
+    int	    n_rows_transform, n_cols_transform;
+    float   *row_weight, *col_weight;
+    double  scale;
+    double  frequency;
+    float   weight;
+
+    n_rows_transform = DeVAS_image_n_rows ( transformed_image );
+    n_cols_transform = DeVAS_image_n_cols ( transformed_image );
+
+    if ( ( n_rows_transform != n_rows ) ||
+	    ( n_cols_transform != ( n_cols / 2 ) + 1 ) ) {
+	fprintf ( stderr, "apply_gaussian_transfer: image sizes don't match!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    row_weight = (float *) malloc ( n_rows_transform * sizeof ( float ) );
+    col_weight = (float *) malloc ( n_cols_transform * sizeof ( float ) );
+    if ( ( row_weight == NULL ) || ( col_weight == NULL ) ) {
+	fprintf ( stderr, "apply_gaussian_transfer: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    scale = -2.0 * SQR ( M_PI * st_dev );
+
+    /* rows above n_rows / 2 are negative frequencies */
+    for ( row = 0; row < n_rows_transform; row++ ) {
+	frequency = ( ( row <= ( n_rows / 2 ) ) ? row : ( row - n_rows ) ) /
+	    ((double) n_rows );
+	row_weight[row] = exp ( scale * SQR ( frequency ) );
+    }
+
+    /* half-spectrum columns are all non-negative frequencies */
+    for ( col = 0; col < n_cols_transform; col++ ) {
+	frequency = ((double) col ) / ((double) n_cols );
+	col_weight[col] = exp ( scale * SQR ( frequency ) );
+    }
+
+    for ( row = 0; row < n_rows_transform; row++ ) {
+	for ( col = 0; col < n_cols_transform; col++ ) {
+	    weight = row_weight[row] * col_weight[col];
+	    DeVAS_image_data ( transformed_image, row, col ) . real *= weight;
+	    DeVAS_image_data ( transformed_image, row, col ) . imaginary *=
+		weight;
+	}
+    }
+
+    free ( row_weight );
+    free ( col_weight );
+}
+
+#endif	/* GBLUR_FFT_SPATIAL_KERNEL */
+
+static int
+DeVAS_float_image_samesize_local ( DeVAS_float_image *input,
+	DeVAS_float_image *output )
+{
+    return ( ( DeVAS_image_n_rows ( input ) == DeVAS_image_n_rows ( output ) )
+				&&
+	    ( DeVAS_image_n_cols ( input ) == DeVAS_image_n_cols ( output ) ) );
+}
@@ -0,0 +1,261 @@
+/*
+ * 2-D Gaussian blur of floating point values using a recursive (IIR)
+ * approximation to the Gaussian.
+ *
+ * I.T. Young and L.J. van Vliet, "Recursive implementation of the Gaussian
+ * filter," Signal Processing, 44(2), 1995.
+ *
+ * Boundaries are handled as if the image were extended by replicating the
+ * edge pixels, using the exact initialization for the anti-causal pass
+ * given in B. Triggs and M. Sdika, "Boundary conditions for Young-van Vliet
+ * recursive filtering," IEEE Trans. Signal Processing, 54(6), 2006.
+ *
+ * Cost per pixel is independent of the standard deviation, so this is much
+ * faster than direct convolution for large blurs.  The approximation is
+ * not exact: near a step edge, results differ from a true Gaussian by up
+ * to about 2% of the step height for standard deviations of 2 pixels or
+ * more, less for larger blurs.
+ *
+ * DeVAS_float_gblur_auto ( ) picks between direct convolution
+ * (devas_float_gblur ( )) and the recursive filter based on the standard
+ * deviation and the image size.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "devas-gblur-iir.h"
+#include "devas-gblur.h"
+#include "devas-image.h"
+#include "devas-license.h"	/* DeVAS open source license */
+
+#define	N_FEEDBACK	3	/* order of the recursive filter */
+
+typedef struct {
+    double  B;			/* input gain */
+    double  b1, b2, b3;		/* feedback coefficients */
+    double  M[N_FEEDBACK][N_FEEDBACK];	/* Triggs-Sdika boundary matrix */
+} IIR_coefficients;
+
+static void	iir_coefficients ( double st_dev, IIR_coefficients *c );
+static void	iir_1d ( double *in_out, int size, IIR_coefficients *c );
+static int	imax ( int x, int y );
+static int	imin ( int x, int y );
+
+DeVAS_float_image *
+DeVAS_float_gblur_iir ( DeVAS_float_image *input, float st_dev )
+/*
+ * Convolve input image with (an approximation to a) Gaussian of specified
+ * standard deviation, returning result in a new output image of the same
+ * size.
+ */
+{
+    DeVAS_float_image	*output;
+    int			row, col;
+    int			n_rows, n_cols;
+    double		*line;
+    IIR_coefficients	c;
+
+    if ( st_dev < GBLUR_IIR_STD_DEV_MIN ) {
+	fprintf ( stderr,
+		"DeVAS_float_gblur_iir: st_dev too small to use (%g)\n",
+		st_dev );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );	/* can't blur this little! */
+    }
+
+    n_rows = DeVAS_image_n_rows ( input );
+    n_cols = DeVAS_image_n_cols ( input );
+
+    output = DeVAS_float_image_new ( n_rows, n_cols );
+
+    iir_coefficients ( st_dev, &c );
+
+    /* extra room for the values past the end used by the backward pass */
+    line = (double *) malloc ( ( imax ( n_rows, n_cols ) + N_FEEDBACK ) *
+	    sizeof ( double ) );
+    if ( line == NULL ) {
+	fprintf ( stderr, "DeVAS_float_gblur_iir: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    /* blur rows */
+    for ( row = 0; row < n_rows; row++ ) {
+	for ( col = 0; col < n_cols; col++ ) {
+	    line[col] = DeVAS_image_data ( input, row, col );
+	}
+
+	iir_1d ( line, n_cols, &c );
+
+	for ( col = 0; col < n_cols; col++ ) {
+	    DeVAS_image_data ( output, row, col ) = line[col];
+	}
+    }
+
+    /* blur columns (in place) */
+    for ( col = 0; col < n_cols; col++ ) {
+	for ( row = 0; row < n_rows; row++ ) {
+	    line[row] = DeVAS_image_data ( output, row, col );
+	}
+
+	iir_1d ( line, n_rows, &c );
+
+	for ( row = 0; row < n_rows; row++ ) {
+	    DeVAS_image_data ( output, row, col ) = line[row];
+	}
+    }
+
+    free ( line );
+
+    return ( output );
+}
+
+DeVAS_float_image *
+DeVAS_float_gblur_auto ( DeVAS_float_image *input, float st_dev )
+/*
+ * Gaussian blur using whichever implementation is likely to be fastest.
+ *
+ * Direct convolution costs about 2 * kernel_size (14 * st_dev) multiply-adds
+ * per pixel and handles image edges by renormalization.  The recursive
+ * filter costs about 16 multiply-adds per pixel, independent of st_dev.
+ * Direct convolution is used for small standard deviations, where it is
+ * both competitive and more accurate, and for images smaller than the
+ * convolution kernel, where edge effects dominate and direct convolution's
+ * renormalization at the edges gives more sensible results.
+ */
+{
+    int	    min_dimension;
+
+    if ( st_dev < GBLUR_STD_DEV_MIN ) {
+	fprintf ( stderr,
+		"DeVAS_float_gblur_auto: st_dev too small to use (%g)\n",
+		st_dev );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );	/* can't blur this little! */
+    }
+
+    min_dimension = imin ( DeVAS_image_n_rows ( input ),
+	    DeVAS_image_n_cols ( input ) );
+
+    if ( ( st_dev < GBLUR_AUTO_IIR_MIN ) ||
+	    ( min_dimension < DeVAS_float_gblur_kernel_size ( st_dev ) ) ) {
+	return ( devas_float_gblur ( input, st_dev ) );
+    } else {
+	return ( DeVAS_float_gblur_iir ( input, st_dev ) );
+    }
+}
+
+static void
+iir_coefficients ( double st_dev, IIR_coefficients *c )
+/*
+ * Young-van Vliet filter coefficients, normalized so that
+ *
+ *   w[n] = B * in[n] + b1 * w[n-1] + b2 * w[n-2] + b3 * w[n-3]
+ *
+ * and the Triggs-Sdika matrix used to initialize the backward pass.
+ */
+{
+    double  q, q2, q3;
+    double  b0;
+    double  a1, a2, a3;
+    double  scale;
+
+    if ( st_dev >= 2.5 ) {
+	q = ( 0.98711 * st_dev ) - 0.96330;
+    } else {
+	q = 3.97156 - ( 4.14554 * sqrt ( 1.0 - ( 0.26891 * st_dev ) ) );
+    }
+    q2 = q * q;
+    q3 = q2 * q;
+
+    b0 = 1.57825 + ( 2.44413 * q ) + ( 1.4281 * q2 ) + ( 0.422205 * q3 );
+    c->b1 = ( ( 2.44413 * q ) + ( 2.85619 * q2 ) + ( 1.26661 * q3 ) ) / b0;
+    c->b2 = - ( ( 1.4281 * q2 ) + ( 1.26661 * q3 ) ) / b0;
+    c->b3 = ( 0.422205 * q3 ) / b0;
+    c->B = 1.0 - ( c->b1 + c->b2 + c->b3 );
+
+    a1 = c->b1;
+    a2 = c->b2;
+    a3 = c->b3;
+
+    /*
+     * The factor of B accounts for the input gain of the anti-causal
+     * pass, which is not part of the filter form used by Triggs-Sdika.
+     */
+    scale = c->B / ( ( 1.0 + a1 - a2 + a3 ) * ( 1.0 - a1 - a2 - a3 ) *
+	    ( 1.0 + a2 + ( ( a1 - a3 ) * a3 ) ) );
+
+    c->M[0][0] = scale * ( - ( a3 * a1 ) + 1.0 - ( a3 * a3 ) - a2 );
+    c->M[0][1] = scale * ( a3 + a1 ) * ( a2 + ( a3 * a1 ) );
+    c->M[0][2] = scale * a3 * ( a1 + ( a3 * a2 ) );
+    c->M[1][0] = scale * ( a1 + ( a3 * a2 ) );
+    c->M[1][1] = - scale * ( a2 - 1.0 ) * ( a2 + ( a3 * a1 ) );
+    c->M[1][2] = - scale * a3 * ( ( a3 * a1 ) + ( a3 * a3 ) + a2 - 1.0 );
+    c->M[2][0] = scale * ( ( a3 * a1 ) + a2 + ( a1 * a1 ) - ( a2 * a2 ) );
+    c->M[2][1] = scale * ( ( a1 * a2 ) + ( a3 * a2 * a2 ) - ( a1 * a3 * a3 ) -
+	    ( a3 * a3 * a3 ) - ( a3 * a2 ) + a3 );
+    c->M[2][2] = scale * a3 * ( a1 + ( a3 * a2 ) );
+}
+
+static void
+iir_1d ( double *in_out, int size, IIR_coefficients *c )
+/*
+ * Causal pass followed by anti-causal pass, in place.  in_out must have
+ * room for N_FEEDBACK values past size.
+ */
+{
+    int	    i, j, k;
+    double  w0, w1, w2;		/* w[n-1], w[n-2], w[n-3] */
+    double  right_edge;
+    double  u[N_FEEDBACK];
+    double  v;
+
+    right_edge = in_out[size - 1];
+
+    /* causal pass, with the signal extended by in_out[0] to the left */
+    w0 = w1 = w2 = in_out[0];
+    for ( i = 0; i < size; i++ ) {
+	v = ( c->B * in_out[i] ) + ( c->b1 * w0 ) + ( c->b2 * w1 ) +
+	    ( c->b3 * w2 );
+	w2 = w1;
+	w1 = w0;
+	w0 = v;
+	in_out[i] = v;
+    }
+
+    /*
+     * Anti-causal pass initialization (Triggs-Sdika), with the signal
+     * extended by right_edge to the right.  Since the filter has unit
+     * gain, the steady state response to the extension is right_edge
+     * itself for both passes.
+     */
+    for ( k = 0; k < N_FEEDBACK; k++ ) {
+	u[k] = in_out[imax ( size - 1 - k, 0 )] - right_edge;
+    }
+    for ( j = 0; j < N_FEEDBACK; j++ ) {
+	v = right_edge;
+	for ( k = 0; k < N_FEEDBACK; k++ ) {
+	    v += c->M[j][k] * u[k];
+	}
+	in_out[size - 1 + j] = v;
+    }
+
+    /* anti-causal pass */
+    for ( i = size - 2; i >= 0; i-- ) {
+	in_out[i] = ( c->B * in_out[i] ) + ( c->b1 * in_out[i + 1] ) +
+	    ( c->b2 * in_out[i + 2] ) + ( c->b3 * in_out[i + 3] );
+    }
+}
+
+static int
+imax ( int x, int y )
+{
+    return ( ( x > y ) ? x : y );
+}
+
+static int
+imin ( int x, int y )
+{
+    return ( ( x < y ) ? x : y );
+}
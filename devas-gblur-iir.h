@@ -0,0 +1,29 @@
+#ifndef __DeVAS_GBLUR_IIR_H
+#define __DeVAS_GBLUR_IIR_H
+
+#include "devas-image.h"
+
+#define	GBLUR_IIR_STD_DEV_MIN	0.5	/* Young-van Vliet coefficients are */
+					/* not valid below this */
+
+#define	GBLUR_AUTO_IIR_MIN	2.0	/* DeVAS_float_gblur_auto uses the */
+					/* recursive filter at or above this */
+					/* standard deviation and the direct */
+					/* convolution below it */
+
+/* function prototypes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+DeVAS_float_image   *DeVAS_float_gblur_iir ( DeVAS_float_image *input,
+			float st_dev );
+DeVAS_float_image   *DeVAS_float_gblur_auto ( DeVAS_float_image *input,
+			float st_dev );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DeVAS_GBLUR_IIR_H */
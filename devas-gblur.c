@@ -2,11 +2,18 @@
  * Space-domain 2-D Gaussian blur of floating point values.
  * Convolution is done using separable kernels.
  * Portion of kernel outside image edges are is ignored.
+ *
+ * devas_float_gblur_log ( ) fuses a log ( value + offset ) transform into
+ * the final (column) pass, avoiding an extra sweep over the image for
+ * callers such as the Canny edge detector that want the log of the blurred
+ * luminance.
  */
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <float.h>
+#include <string.h>
 #include "devas-gblur.h"
 #include "devas-image.h"
 
@@ -30,12 +37,83 @@ static int	imax ( int x, int y );
 static int	imin ( int x, int y );
 static float	*DeVAS_float_gblur_kernel ( float st_deviation,
 		    int kernel_size );
+static DeVAS_float_image
+		*gblur_base ( DeVAS_float_image *input, float st_dev,
+		    int log_flag, float log_offset );
+static void	log_offset_1d ( DeVAS_float *in, DeVAS_float *out, int size,
+		    float offset );
 
 DeVAS_float_image *
 devas_float_gblur ( DeVAS_float_image *input, float st_dev )
 /*
  * Convolve input image with Gaussian of specified standard deviation,
- * returning result in a preallocated output image of the same size.
+ * returning result in a newly allocated output image of the same size.
+ */
+{
+    return ( gblur_base ( input, st_dev, FALSE, 0.0 ) );
+}
+
+DeVAS_float_image *
+devas_float_gblur_log ( DeVAS_float_image *input, float st_dev,
+	float log_offset )
+/*
+ * Same as devas_float_gblur ( ), except that the returned values are
+ * log ( blurred_value + log_offset ).  The log is applied as the results
+ * of the column pass are written, so no additional pass over the image
+ * is needed.
+ *
+ * log_offset must be > 0.0.
+ */
+{
+    if ( log_offset <= 0.0 ) {
+	fprintf ( stderr,
+		"devas_float_gblur_log: log_offset must be positive (%g)\n",
+		log_offset );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    return ( gblur_base ( input, st_dev, TRUE, log_offset ) );
+}
+
+DeVAS_float_image *
+devas_float_log ( DeVAS_float_image *input, float log_offset )
+/*
+ * Returns log ( value + log_offset ) for all pixels in input, without
+ * blurring.  Uses the same vectorized log as devas_float_gblur_log ( ).
+ */
+{
+    DeVAS_float_image	*output;
+    int			row;
+    int			n_rows, n_cols;
+
+    if ( log_offset <= 0.0 ) {
+	fprintf ( stderr,
+		"devas_float_log: log_offset must be positive (%g)\n",
+		log_offset );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    n_rows = DeVAS_image_n_rows ( input );
+    n_cols = DeVAS_image_n_cols ( input );
+
+    output = DeVAS_float_image_new ( n_rows, n_cols );
+
+    for ( row = 0; row < n_rows; row++ ) {
+	log_offset_1d ( &DeVAS_image_data ( input, row, 0 ),
+		&DeVAS_image_data ( output, row, 0 ), n_cols, log_offset );
+    }
+
+    return ( output );
+}
+
+static DeVAS_float_image *
+gblur_base ( DeVAS_float_image *input, float st_dev, int log_flag,
+	float log_offset )
+/*
+ * Shared implementation of devas_float_gblur ( ) and
+ * devas_float_gblur_log ( ).
  */
 {
     DeVAS_float_image	*output;
@@ -115,6 +193,10 @@ devas_float_gblur ( DeVAS_float_image *input, float st_dev )
 	       first );
 	first = FALSE;
 
+	if ( log_flag ) {
+	    log_offset_1d ( tmp_2, tmp_2, n_rows, log_offset );
+	}
+
 	for ( row = 0; row < n_rows; row++ ) {
 	    DeVAS_image_data ( output, row, col ) = tmp_2[row];
 	}
@@ -124,6 +206,7 @@ devas_float_gblur ( DeVAS_float_image *input, float st_dev )
     free ( tmp_2 );
     free ( kernel );
     free ( save_normalize );
+    save_normalize = NULL;
 
     return ( output );
 }
@@ -203,6 +286,82 @@ gblur_float_convolve_1d ( DeVAS_float *in, DeVAS_float *out, int in_size,
     }
 }
 
+/*
+ * Coefficients for the single precision log approximation used by
+ * log_offset_1d ( ) (after the Cephes logf).  Accurate to a few ulp for
+ * positive, normalized arguments.  Kept single precision so that the loop
+ * in log_offset_1d ( ) vectorizes.
+ */
+#define	LOG_SQRTHF	0.70710678f
+#define	LOG_P0		7.0376836292E-2f
+#define	LOG_P1		-1.1514610310E-1f
+#define	LOG_P2		1.1676998740E-1f
+#define	LOG_P3		-1.2420140846E-1f
+#define	LOG_P4		1.4249322787E-1f
+#define	LOG_P5		-1.6668057665E-1f
+#define	LOG_P6		2.0000714765E-1f
+#define	LOG_P7		-2.4999993993E-1f
+#define	LOG_P8		3.3333331174E-1f
+#define	LOG_Q1		-2.12194440E-4f
+#define	LOG_Q2		0.693359375f
+
+static void
+log_offset_1d ( DeVAS_float *in, DeVAS_float *out, int size, float offset )
+/*
+ * out[i] = log ( in[i] + offset ).  in and out may be the same vector.
+ *
+ * The mantissa/exponent split is done with integer operations and the
+ * loop body has no branches, so the compiler can vectorize it.  If any
+ * argument is not a positive, normalized float, the whole vector is
+ * done with the C library log instead.
+ */
+{
+    int		i;
+    float	value, min_value;
+    uint32_t	bits;
+    float	x, z, y, e;
+    int		shift;
+
+    min_value = FLT_MAX;
+    for ( i = 0; i < size; i++ ) {
+	value = in[i] + offset;
+	min_value = ( value < min_value ) ? value : min_value;
+    }
+
+    if ( ! ( min_value >= FLT_MIN ) ) {
+	/* out of range for the fast version (or NaN) */
+	for ( i = 0; i < size; i++ ) {
+	    out[i] = log ( in[i] + offset );
+	}
+	return;
+    }
+
+    for ( i = 0; i < size; i++ ) {
+	value = in[i] + offset;
+	memcpy ( &bits, &value, sizeof ( bits ) );
+
+	/* x = mantissa in [0.5, 1.0), e = exponent */
+	e = (float) ( (int) ( ( bits >> 23 ) & 0xff ) - 126 );
+	bits = ( bits & 0x007fffff ) | 0x3f000000;
+	memcpy ( &x, &bits, sizeof ( x ) );
+
+	/* shift mantissa into [sqrt(0.5), sqrt(2.0)) */
+	shift = ( x < LOG_SQRTHF );
+	e -= (float) shift;
+	x = x + ( shift ? x : 0.0f ) - 1.0f;
+
+	z = x * x;
+	y = ((((((( LOG_P0 * x + LOG_P1 ) * x + LOG_P2 ) * x + LOG_P3 ) * x +
+			    LOG_P4 ) * x + LOG_P5 ) * x + LOG_P6 ) * x +
+		LOG_P7 ) * x + LOG_P8;
+	y *= x * z;
+	y += LOG_Q1 * e;
+	y -= 0.5f * z;
+
+	out[i] = x + y + ( LOG_Q2 * e );
+    }
+}
+
 /* static */ int /* expose this, since some application routines may care */
 DeVAS_float_gblur_kernel_size ( float st_deviation )
 {
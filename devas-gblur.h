@@ -13,6 +13,10 @@ extern "C" {
 #endif
 DeVAS_float_image   *devas_float_gblur ( DeVAS_float_image *input,
 		        float st_dev );
+DeVAS_float_image   *devas_float_gblur_log ( DeVAS_float_image *input,
+		        float st_dev, float log_offset );
+DeVAS_float_image   *devas_float_log ( DeVAS_float_image *input,
+		        float log_offset );
 
 /* expose this, since some application routines may care */
 int		    DeVAS_float_gblur_kernel_size ( float st_deviation );
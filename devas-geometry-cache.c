@@ -0,0 +1,322 @@
+/*
+ * Cache of parsed geometry files.
+ *
+ * Parsing the ASCII xyz, dist, and nor files typically takes longer than
+ * the rest of a devas-visibility run.  When one process evaluates the same
+ * geometry many times (for example, over a range of acuity and contrast
+ * settings in devas-visibility --server), the parsed files are kept in a
+ * small least-recently-used cache.  Entries are keyed on the device and
+ * inode of the file rather than its name, since jobs with different
+ * working directories may use the same relative name for different files.
+ * A file whose modification time (to the nanosecond, where the file
+ * system records it) or size has changed is read again.
+ *
+ * The cache is disabled (max_entries == 0) by default, in which case the
+ * *_cached functions just read the file.  In either case, the returned
+ * object belongs to the caller, which may modify and delete it.
+ *
+ * Not thread safe: intended for use by one job at a time.  Not available
+ * on Windows, which has no inode numbers.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "devas-geometry-cache.h"
+#include "devas-image.h"
+#include "read-geometry.h"
+#include "devas-license.h"	/* DeVAS open source license */
+
+#ifdef __APPLE__		/* nanoseconds part of modification time */
+#define	FILE_MTIME_NSEC(status)	((status).st_mtimespec.tv_nsec)
+#else
+#define	FILE_MTIME_NSEC(status)	((status).st_mtim.tv_nsec)
+#endif	/* __APPLE__ */
+
+typedef enum {
+    CACHE_COORDINATES,
+    CACHE_GEOM3D,
+    CACHE_GEOM1D
+} Cache_kind;
+
+typedef struct {
+    Cache_kind	    kind;
+    dev_t	    device;
+    ino_t	    inode;
+    time_t	    mtime;
+    long	    mtime_nsec;
+    off_t	    size;
+    unsigned long   last_used;
+    void	    *data;
+} Cache_entry;
+
+static Cache_entry	*cache = NULL;
+static int		cache_max_entries = 0;
+static int		cache_n_entries = 0;
+static unsigned long	cache_clock = 0;
+
+static void		*cache_lookup ( Cache_kind kind, char *filename );
+static void		cache_entry_free ( Cache_entry *entry );
+static DeVAS_XYZ_image	*XYZ_image_copy ( DeVAS_XYZ_image *image );
+static DeVAS_float_image
+			*float_image_copy ( DeVAS_float_image *image );
+static char		*string_copy ( char *string );
+
+void
+DeVAS_geometry_cache_set_size ( int max_entries )
+/*
+ * Set the maximum number of cached files.  0 disables caching.  Any
+ * currently cached files are discarded.
+ */
+{
+    DeVAS_geometry_cache_destroy ( );
+
+    if ( max_entries <= 0 ) {
+	return;
+    }
+
+    cache = (Cache_entry *) malloc ( max_entries * sizeof ( Cache_entry ) );
+    if ( cache == NULL ) {
+	fprintf ( stderr, "DeVAS_geometry_cache_set_size: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    cache_max_entries = max_entries;
+}
+
+void
+DeVAS_geometry_cache_destroy ( void )
+{
+    int	    i;
+
+    for ( i = 0; i < cache_n_entries; i++ ) {
+	cache_entry_free ( &cache[i] );
+    }
+
+    free ( cache );
+    cache = NULL;
+    cache_max_entries = 0;
+    cache_n_entries = 0;
+}
+
+DeVAS_coordinates *
+DeVAS_coordinates_from_filename_cached ( char *filename )
+{
+    DeVAS_coordinates	*cached;
+    DeVAS_coordinates	*coordinates;
+
+    cached = (DeVAS_coordinates *) cache_lookup ( CACHE_COORDINATES,
+	    filename );
+    if ( cached == NULL ) {
+	return ( DeVAS_coordinates_from_filename ( filename ) );
+    }
+
+    coordinates = DeVAS_coordinates_new ( );
+    *coordinates = *cached;
+
+    return ( coordinates );
+}
+
+DeVAS_XYZ_image *
+DeVAS_geom3d_from_radfilename_cached ( char *filename )
+{
+    DeVAS_XYZ_image	*cached;
+
+    cached = (DeVAS_XYZ_image *) cache_lookup ( CACHE_GEOM3D, filename );
+    if ( cached == NULL ) {
+	return ( DeVAS_geom3d_from_radfilename ( filename ) );
+    }
+
+    return ( XYZ_image_copy ( cached ) );
+}
+
+DeVAS_float_image *
+DeVAS_geom1d_from_radfilename_cached ( char *filename )
+{
+    DeVAS_float_image	*cached;
+
+    cached = (DeVAS_float_image *) cache_lookup ( CACHE_GEOM1D, filename );
+    if ( cached == NULL ) {
+	return ( DeVAS_geom1d_from_radfilename ( filename ) );
+    }
+
+    return ( float_image_copy ( cached ) );
+}
+
+static void *
+cache_lookup ( Cache_kind kind, char *filename )
+/*
+ * Return the cached parse of filename, reading it into the cache if
+ * necessary.  Returns NULL if caching is disabled or the file can't be
+ * examined, in which case the caller reads the file itself (and reports
+ * any errors in the usual way).
+ */
+{
+    struct stat	    file_status;
+    Cache_entry	    *entry;
+    int		    i;
+
+#ifdef _WIN32
+    return ( NULL );
+#else
+    if ( ( cache_max_entries == 0 ) ||
+	    ( stat ( filename, &file_status ) != 0 ) ) {
+	return ( NULL );
+    }
+
+    cache_clock++;
+
+    entry = NULL;
+    for ( i = 0; i < cache_n_entries; i++ ) {
+	if ( ( cache[i].kind == kind ) &&
+		( cache[i].device == file_status.st_dev ) &&
+		( cache[i].inode == file_status.st_ino ) ) {
+	    if ( ( cache[i].mtime == file_status.st_mtime ) &&
+		    ( cache[i].mtime_nsec == FILE_MTIME_NSEC ( file_status ) ) &&
+		    ( cache[i].size == file_status.st_size ) ) {
+		cache[i].last_used = cache_clock;
+		return ( cache[i].data );
+	    }
+	    entry = &cache[i];		/* stale, so reuse */
+	    cache_entry_free ( entry );
+	    break;
+	}
+    }
+
+    if ( entry == NULL ) {
+	if ( cache_n_entries < cache_max_entries ) {
+	    entry = &cache[cache_n_entries++];
+	} else {
+	    /* evict least recently used */
+	    entry = &cache[0];
+	    for ( i = 1; i < cache_n_entries; i++ ) {
+		if ( cache[i].last_used < entry->last_used ) {
+		    entry = &cache[i];
+		}
+	    }
+	    cache_entry_free ( entry );
+	}
+    }
+
+    entry->kind = kind;
+    entry->device = file_status.st_dev;
+    entry->inode = file_status.st_ino;
+    entry->mtime = file_status.st_mtime;
+    entry->mtime_nsec = FILE_MTIME_NSEC ( file_status );
+    entry->size = file_status.st_size;
+    entry->last_used = cache_clock;
+
+    switch ( kind ) {
+	case CACHE_COORDINATES:
+	    entry->data = DeVAS_coordinates_from_filename ( filename );
+	    break;
+
+	case CACHE_GEOM3D:
+	    entry->data = DeVAS_geom3d_from_radfilename ( filename );
+	    break;
+
+	case CACHE_GEOM1D:
+	    entry->data = DeVAS_geom1d_from_radfilename ( filename );
+	    break;
+
+	default:
+	    fprintf ( stderr, "DeVAS_geometry_cache: internal error!\n" );
+	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	    exit ( EXIT_FAILURE );
+    }
+
+    return ( entry->data );
+#endif	/* _WIN32 */
+}
+
+static void
+cache_entry_free ( Cache_entry *entry )
+{
+    switch ( entry->kind ) {
+	case CACHE_COORDINATES:
+	    DeVAS_coordinates_delete ( (DeVAS_coordinates *) entry->data );
+	    break;
+
+	case CACHE_GEOM3D:
+	    DeVAS_XYZ_image_delete ( (DeVAS_XYZ_image *) entry->data );
+	    break;
+
+	case CACHE_GEOM1D:
+	    DeVAS_float_image_delete ( (DeVAS_float_image *) entry->data );
+	    break;
+    }
+
+    entry->data = NULL;
+}
+
+static DeVAS_XYZ_image *
+XYZ_image_copy ( DeVAS_XYZ_image *image )
+{
+    DeVAS_XYZ_image *copy;
+    int		    row;
+
+    copy = DeVAS_XYZ_image_new ( DeVAS_image_n_rows ( image ),
+	    DeVAS_image_n_cols ( image ) );
+
+    for ( row = 0; row < DeVAS_image_n_rows ( image ); row++ ) {
+	memcpy ( copy->data[row], image->data[row],
+		DeVAS_image_n_cols ( image ) * sizeof ( DeVAS_XYZ ) );
+    }
+
+    DeVAS_image_exposure_set ( copy ) = DeVAS_image_exposure_set ( image );
+    DeVAS_image_exposure ( copy ) = DeVAS_image_exposure ( image );
+    DeVAS_image_view ( copy ) = DeVAS_image_view ( image );
+    DeVAS_image_description ( copy ) =
+	string_copy ( DeVAS_image_description ( image ) );
+
+    return ( copy );
+}
+
+static DeVAS_float_image *
+float_image_copy ( DeVAS_float_image *image )
+{
+    DeVAS_float_image	*copy;
+    int			row;
+
+    copy = DeVAS_float_image_new ( DeVAS_image_n_rows ( image ),
+	    DeVAS_image_n_cols ( image ) );
+
+    for ( row = 0; row < DeVAS_image_n_rows ( image ); row++ ) {
+	memcpy ( copy->data[row], image->data[row],
+		DeVAS_image_n_cols ( image ) * sizeof ( DeVAS_float ) );
+    }
+
+    DeVAS_image_exposure_set ( copy ) = DeVAS_image_exposure_set ( image );
+    DeVAS_image_exposure ( copy ) = DeVAS_image_exposure ( image );
+    DeVAS_image_view ( copy ) = DeVAS_image_view ( image );
+    DeVAS_image_description ( copy ) =
+	string_copy ( DeVAS_image_description ( image ) );
+
+    return ( copy );
+}
+
+static char *
+string_copy ( char *string )
+/*
+ * strdup ( ), with NULL for NULL.
+ */
+{
+    char    *copy;
+
+    if ( string == NULL ) {
+	return ( NULL );
+    }
+
+    copy = (char *) malloc ( strlen ( string ) + 1 );
+    if ( copy == NULL ) {
+	fprintf ( stderr, "DeVAS_geometry_cache: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+    strcpy ( copy, string );
+
+    return ( copy );
+}
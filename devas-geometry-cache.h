@@ -0,0 +1,28 @@
+/*
+ * Cache of parsed geometry files, for use when the same geometry is
+ * evaluated repeatedly by one process (devas-visibility --server).
+ */
+
+#ifndef __DeVAS_GEOMETRY_CACHE_H
+#define __DeVAS_GEOMETRY_CACHE_H
+
+#include "devas-image.h"
+#include "read-geometry.h"
+
+/* function prototypes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void		    DeVAS_geometry_cache_set_size ( int max_entries );
+void		    DeVAS_geometry_cache_destroy ( void );
+DeVAS_coordinates   *DeVAS_coordinates_from_filename_cached ( char *filename );
+DeVAS_XYZ_image	    *DeVAS_geom3d_from_radfilename_cached ( char *filename );
+DeVAS_float_image   *DeVAS_geom1d_from_radfilename_cached ( char *filename );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DeVAS_GEOMETRY_CACHE_H */
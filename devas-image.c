@@ -78,6 +78,12 @@
  *
  * 					The exposure value (only valid if
  *					DeVAS_image_exposure_set is TRUE).
+ *
+ * Bytes of pixel data held by all image objects:
+ *
+ *   DeVAS_image_bytes_allocated ( )	Currently allocated.
+ *
+ *   DeVAS_image_bytes_peak ( )		Most allocated at any one time.
  */
 
 /*
@@ -93,6 +99,11 @@
 #include "devas-license.h"	/* DeVAS open source license */
 #include "radiance/color.h"
 
+static double	image_bytes_allocated = 0.0;
+static double	image_bytes_peak = 0.0;
+
+static void	image_bytes_add ( double bytes );
+
 /*
  * RGBf (floating point RGB) values are scaled as for rgbe-format Radiance
  * files (watts/steradian/sq.meter over the visible spectrum).
@@ -247,6 +258,8 @@ TYPE##_image_new ( unsigned int n_rows, unsigned int n_cols  )		\
         exit ( EXIT_FAILURE );						\
     }									\
 									\
+    image_bytes_add ( ( (double) n_rows ) * n_cols * sizeof ( TYPE ) );	\
+									\
     line_pointers = (TYPE **) malloc ( n_rows * sizeof ( TYPE * ) );	\
     if ( line_pointers == NULL ) {					\
 	fprintf ( stderr, "DeVAS_image_new: malloc failed!" );		\
@@ -299,6 +312,8 @@ TYPE##_image_new ( unsigned int n_rows, unsigned int n_cols  )		\
         exit ( EXIT_FAILURE );						\
     }									\
 									\
+    image_bytes_add ( ( (double) n_rows ) * n_cols * sizeof ( TYPE ) );	\
+									\
     line_pointers = (TYPE **) malloc ( n_rows * sizeof ( TYPE * ) );	\
     if ( line_pointers == NULL ) {					\
 	fprintf ( stderr, "DeVAS_image_new: malloc failed!" );		\
@@ -346,6 +361,8 @@ TYPE##_image_delete ( TYPE##_image *image )				\
 	image->image_info.description = NULL;				\
     }									\
     free ( image->start_data );						\
+    image_bytes_add ( - ( (double) image->n_rows ) * image->n_cols *	\
+	    sizeof ( TYPE ) );						\
     free ( image->data );						\
     free ( image );							\
 }
@@ -359,6 +376,8 @@ TYPE##_image_delete ( TYPE##_image *image )				\
 	image->image_info.description = NULL;				\
     }									\
     fftwf_free ( image->start_data );					\
+    image_bytes_add ( - ( (double) image->n_rows ) * image->n_cols *	\
+	    sizeof ( TYPE ) );						\
     free ( image->data );						\
     free ( image );							\
 }
@@ -391,6 +410,33 @@ DeVAS_image_check_bounds ( DeVAS_gray_image *devas_image, int row, int col,
     }
 }
 
+double
+DeVAS_image_bytes_allocated ( void )
+{
+    return ( image_bytes_allocated );
+}
+
+double
+DeVAS_image_bytes_peak ( void )
+{
+    return ( image_bytes_peak );
+}
+
+static void
+image_bytes_add ( double bytes )
+/*
+ * Images may be created and deleted by more than one thread at a time.
+ */
+{
+#pragma omp critical ( devas_image_bytes )
+    {
+	image_bytes_allocated += bytes;
+	if ( image_bytes_allocated > image_bytes_peak ) {
+	    image_bytes_peak = image_bytes_allocated;
+	}
+    }
+}
+
 void
 DeVAS_print_file_lineno ( char *file, int line )
 {
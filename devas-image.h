@@ -224,6 +224,9 @@ void	DeVAS_image_check_bounds ( DeVAS_gray_image *devas_image, int row,
 
 void	DeVAS_print_file_lineno ( char *file, int line );
 
+double	DeVAS_image_bytes_allocated ( void );
+double	DeVAS_image_bytes_peak ( void );
+
 #define DeVAS_PROTOTYPE_IMAGE_SAMESIZE( TYPE )				\
 int	TYPE##_image_samesize ( TYPE##_image *i1, TYPE##_image *i2 );
 
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <math.h>
 #include "devas-margin.h"
 #include "devas-image.h"
@@ -6,11 +7,29 @@
 
 #include "radianceIO.h"
 
-static		DeVAS_xyY scale_xyY ( double distance, double background_value,
-		    DeVAS_xyY value );
-static		DeVAS_float scale_float ( double distance,
-		    double background_value, DeVAS_float value );
+#define	CORNER_TABLE_SIZE	4096	/* intervals in corner weight table */
+
+typedef struct {
+    int	    n_cols;			/* padded number of columns */
+    int	    *source_row, *source_col;	/* original pixel for margin value */
+    double  *row_weight, *col_weight;	/* edge blend, < 0.0 => inside */
+    double  *row_corner_sq, *col_corner_sq;	/* corner distance components */
+    double  corner_table[CORNER_TABLE_SIZE + 1];  /* weight vs. distance */
+} Margin_weights;
+
+static void	margin_weights_init ( Margin_weights *weights, int n_rows,
+		    int n_cols, int top, int bottom, int left, int right );
+static void	margin_weights_free ( Margin_weights *weights );
+static double	*margin_row_buffer ( int n_cols );
+static void	margin_weights_row ( Margin_weights *weights, int row,
+		    double *weight );
+static double	blend_weight ( double distance );
+static double	blend ( double weight, double background_value, double value );
 static double	sigmoid ( double x );
+static void	margin_map ( int size, int before, int after, int *source,
+		    double *weight, double *corner_sq );
+static int	imin ( int x, int y );
+static int	imax ( int x, int y );
 
 DeVAS_xyY_image *
 DeVAS_xyY_add_margin ( int v_margin, int h_margin, DeVAS_xyY_image *original )
@@ -45,7 +64,9 @@ DeVAS_xyY_add_margin ( int v_margin, int h_margin, DeVAS_xyY_image *original )
     int		    n_rows, n_cols;
     int		    new_n_rows, new_n_cols;
     double	    average_luminance;
-    double	    distance, row_diff, col_diff;
+    Margin_weights  weights;
+    double	    *weight;
+    DeVAS_xyY	    value;
 
     n_rows = DeVAS_image_n_rows ( original );
     n_cols = DeVAS_image_n_cols ( original );
@@ -132,239 +153,39 @@ DeVAS_xyY_add_margin ( int v_margin, int h_margin, DeVAS_xyY_image *original )
 
 #endif	/* DeVAS_MARGIN_AVERAGE_ALL */
 
-    /* copy contents of original image to center of new image */
-    for ( row = 0; row < n_rows; row++ ) {
-	for ( col = 0; col < n_cols; col++ ) {
-	    DeVAS_image_data ( with_margin, row + v_margin, col + h_margin ) =
-		DeVAS_image_data ( original, row, col );
-	}
-    }
-
-#ifdef DeVAS_MARGIN_REFLECT
-
     /*
-     * Reflect portion of image inside the boundary to the margin,
-     * rather than copying nearest edge pixel.
+     * Blend weights depend only on the offset from the image boundary, so
+     * they are tabulated once per padded row and column rather than
+     * computed for every margin pixel.
      */
-
-    /* top, bottom margins */
-    for ( row = 0; row < v_margin; row++ ) {
-	for ( col = 0; col < n_cols; col++ ) {
-	    DeVAS_image_data ( with_margin, row, col + h_margin ) =
-		scale_xyY ( 1.0 - ( ((double) row ) / ((double) v_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, v_margin - 1 - row, col ) );
-	    DeVAS_image_data ( with_margin, row + v_margin + n_rows,
-		    col + h_margin ) =
-		scale_xyY ( ( ((double) row ) / ((double) v_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, n_rows - 1 - row, col ) );
-	}
-    }
-
-    /* left, right margins */
-    for ( row = 0; row < n_rows; row++ ) {
-	for ( col = 0; col < h_margin; col++ ) {
-	    DeVAS_image_data ( with_margin, row + v_margin, col ) =
-		scale_xyY ( 1.0 - ( ((double) col ) / ((double) h_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, row, h_margin - 1 - col ) );
-	    DeVAS_image_data ( with_margin, row + v_margin,
-		    col + h_margin + n_cols ) =
-		scale_xyY ( ( ((double) col ) / ((double) h_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, row, n_cols - 1 - col ) );
-	}
-    }
-
-    /* corners */
-    for ( row = 0; row < v_margin; row++ ) {
-	for ( col = 0; col < h_margin; col++ ) {
-
-	    /* upper left */
-	    row_diff = ((double) ( v_margin - 1 - row ) ) /
-		((double) ( v_margin - 1 ) );
-	    col_diff = ((double) ( h_margin - 1 - col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
+    margin_weights_init ( &weights, n_rows, n_cols, v_margin, v_margin,
+	    h_margin, h_margin );
+
+#pragma omp parallel private ( row, col, weight, value )
+    {
+	weight = margin_row_buffer ( new_n_cols );
+
+#pragma omp for
+	for ( row = 0; row < new_n_rows; row++ ) {
+	    margin_weights_row ( &weights, row, weight );
+	    for ( col = 0; col < new_n_cols; col++ ) {
+		value = DeVAS_image_data ( original, weights.source_row[row],
+			weights.source_col[col] );
+		if ( weight[col] >= 0.0 ) {
+		    value.Y = blend ( weight[col], average_luminance, value.Y );
+		}
+		DeVAS_image_data ( with_margin, row, col ) = value;
 	    }
-	    DeVAS_image_data ( with_margin, row, col ) =
-		scale_xyY ( distance, average_luminance,
-			DeVAS_image_data ( original, v_margin - 1 - row,
-			    h_margin - 1 - col ) );
-
-	    /* upper right */
-	    col_diff = ((double) ( col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row, col + h_margin + n_cols ) =
-		scale_xyY ( distance, average_luminance,
-			DeVAS_image_data ( original, v_margin - 1 - row,
-			    n_cols - 1 - col ) );
-
-	    /* lower left */
-	    row_diff = ((double) ( row ) ) /
-		((double) ( v_margin - 1 ) );
-	    col_diff = ((double) ( h_margin - 1 - col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row + v_margin + n_rows, col ) =
-		scale_xyY ( distance, average_luminance,
-			DeVAS_image_data ( original, n_rows - 1 - row,
-			    h_margin - 1 - col ) );
-
-	    /* lower right */
-	    row_diff = ((double) ( row ) ) /
-		((double) ( v_margin - 1 ) );
-	    col_diff = ((double) ( col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row + v_margin + n_rows,
-		    col + h_margin + n_cols ) =
-		scale_xyY ( distance, average_luminance,
-			DeVAS_image_data ( original, n_rows - 1 - row,
-			    n_cols - 1 - col ) );
-	}
-    }
-
-#else
-
-    /*
-     * Create margin by flooding from nearest edge pixels.
-     */
-
-    /* top, bottom margins */
-    for ( row = 0; row < v_margin; row++ ) {
-	for ( col = 0; col < n_cols; col++ ) {
-	    DeVAS_image_data ( with_margin, row, col + h_margin ) =
-		scale_xyY ( 1.0 - ( ((double) row ) / ((double) v_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, 0, col ) );
-	    DeVAS_image_data ( with_margin, row + v_margin + n_rows,
-		    col + h_margin ) =
-		scale_xyY ( ( ((double) row ) / ((double) v_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, n_rows - 1, col ) );
-	}
-    }
-
-    /* left, right margins */
-    for ( row = 0; row < n_rows; row++ ) {
-	for ( col = 0; col < h_margin; col++ ) {
-	    DeVAS_image_data ( with_margin, row + v_margin, col ) =
-		scale_xyY ( 1.0 - ( ((double) col ) / ((double) h_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, row, 0 ) );
-	    DeVAS_image_data ( with_margin, row + v_margin,
-		    col + h_margin + n_cols ) =
-		scale_xyY ( ( ((double) col ) / ((double) h_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, row, n_cols - 1 ) );
 	}
-    }
-
-    /* corners */
-    for ( row = 0; row < v_margin; row++ ) {
-	for ( col = 0; col < h_margin; col++ ) {
 
-	    row_diff = ((double) ( v_margin - 1 - row ) ) /
-		((double) ( v_margin - 1 ) );
-	    col_diff = ((double) ( h_margin - 1 - col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row, col ) =
-		scale_xyY ( distance, average_luminance,
-			DeVAS_image_data ( original, 0, 0 ) );
-
-	    col_diff = ((double) ( col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row, col + h_margin + n_cols ) =
-		scale_xyY ( distance, average_luminance,
-			DeVAS_image_data ( original, 0, n_cols - 1 ) );
-
-	    row_diff = ((double) ( row ) ) /
-		((double) ( v_margin - 1 ) );
-	    col_diff = ((double) ( h_margin - 1 - col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row + v_margin + n_rows, col ) =
-		scale_xyY ( distance, average_luminance,
-			DeVAS_image_data ( original, n_rows - 1, 0 ) );
-
-	    row_diff = ((double) ( row ) ) /
-		((double) ( v_margin - 1 ) );
-	    col_diff = ((double) ( col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row + v_margin + n_rows,
-		    col + h_margin + n_cols ) =
-		scale_xyY ( distance, average_luminance,
-			DeVAS_image_data ( original, n_rows - 1, n_cols - 1 ) );
-	}
+	free ( weight );
     }
 
-#endif	/* DeVAS_MARGIN_REFLECT */
+    margin_weights_free ( &weights );
 
     return ( with_margin );
 }
 
-static DeVAS_xyY
-scale_xyY ( double distance, double background_value, DeVAS_xyY value )
-/* distance in range [0.0 - 1.0] */
-{
-    DeVAS_xyY	new_value;
-    double	weight;
-
-    if ( ( distance < 0.0 ) || ( distance > 1.0 ) ) {
-	fprintf ( stderr, "devas-margin:scale: invalid distance (%f)\n",
-		distance );
-	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
-	exit ( EXIT_FAILURE );
-    }
-
-    new_value.x = value.x;
-    new_value.y = value.y;
-
-    /* hardwired constant (6.0) in sigmoid to make results plausible */
-    weight = 2.0 * ( sigmoid ( 6.0 * ( 1.0 - distance ) ) - 0.5 );
-    new_value.Y = ( weight * value.Y ) +
-	( ( 1.0 - weight ) * background_value );
-
-    return ( new_value );
-}
-
 static double
 sigmoid ( double x )
 {
@@ -457,7 +278,9 @@ DeVAS_float_add_margin ( int v_margin, int h_margin,
     int		    	n_rows, n_cols;
     int		    	new_n_rows, new_n_cols;
     double	    	average_luminance;
-    double	    	distance, row_diff, col_diff;
+    Margin_weights	weights;
+    double		*weight;
+    DeVAS_float		value;
 
     n_rows = DeVAS_image_n_rows ( original );
     n_cols = DeVAS_image_n_cols ( original );
@@ -544,236 +367,39 @@ DeVAS_float_add_margin ( int v_margin, int h_margin,
 
 #endif	/* DeVAS_MARGIN_AVERAGE_ALL */
 
-    /* copy contents of original image to center of new image */
-    for ( row = 0; row < n_rows; row++ ) {
-	for ( col = 0; col < n_cols; col++ ) {
-	    DeVAS_image_data ( with_margin, row + v_margin, col + h_margin ) =
-		DeVAS_image_data ( original, row, col );
-	}
-    }
-
-#ifdef DeVAS_MARGIN_REFLECT
-
     /*
-     * Reflect portion of image inside the boundary to the margin,
-     * rather than copying nearest edge pixel.
+     * Blend weights depend only on the offset from the image boundary, so
+     * they are tabulated once per padded row and column rather than
+     * computed for every margin pixel.
      */
-
-    /* top, bottom margins */
-    for ( row = 0; row < v_margin; row++ ) {
-	for ( col = 0; col < n_cols; col++ ) {
-	    DeVAS_image_data ( with_margin, row, col + h_margin ) =
-		scale_float ( 1.0 - ( ((double) row ) / ((double) v_margin ) ),
-		    average_luminance,
-		      DeVAS_image_data ( original, v_margin - 1 - row, col ) );
-	    DeVAS_image_data ( with_margin, row + v_margin + n_rows,
-		    col + h_margin ) =
-		scale_float ( ( ((double) row ) / ((double) v_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, n_rows - 1 - row, col ) );
-	}
-    }
-
-    /* left, right margins */
-    for ( row = 0; row < n_rows; row++ ) {
-	for ( col = 0; col < h_margin; col++ ) {
-	    DeVAS_image_data ( with_margin, row + v_margin, col ) =
-		scale_float ( 1.0 - ( ((double) col ) / ((double) h_margin ) ),
-		    average_luminance,
-		      DeVAS_image_data ( original, row, h_margin - 1 - col ) );
-	    DeVAS_image_data ( with_margin, row + v_margin,
-		    col + h_margin + n_cols ) =
-		scale_float ( ( ((double) col ) / ((double) h_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, row, n_cols - 1 - col ) );
-	}
-    }
-
-    /* corners */
-    for ( row = 0; row < v_margin; row++ ) {
-	for ( col = 0; col < h_margin; col++ ) {
-
-	    /* upper left */
-	    row_diff = ((double) ( v_margin - 1 - row ) ) /
-		((double) ( v_margin - 1 ) );
-	    col_diff = ((double) ( h_margin - 1 - col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
+    margin_weights_init ( &weights, n_rows, n_cols, v_margin, v_margin,
+	    h_margin, h_margin );
+
+#pragma omp parallel private ( row, col, weight, value )
+    {
+	weight = margin_row_buffer ( new_n_cols );
+
+#pragma omp for
+	for ( row = 0; row < new_n_rows; row++ ) {
+	    margin_weights_row ( &weights, row, weight );
+	    for ( col = 0; col < new_n_cols; col++ ) {
+		value = DeVAS_image_data ( original, weights.source_row[row],
+			weights.source_col[col] );
+		if ( weight[col] >= 0.0 ) {
+		    value = blend ( weight[col], average_luminance, value );
+		}
+		DeVAS_image_data ( with_margin, row, col ) = value;
 	    }
-	    DeVAS_image_data ( with_margin, row, col ) =
-		scale_float ( distance, average_luminance,
-			DeVAS_image_data ( original, v_margin - 1 - row,
-			    h_margin - 1 - col ) );
-
-	    /* upper right */
-	    col_diff = ((double) ( col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row, col + h_margin + n_cols ) =
-		scale_float ( distance, average_luminance,
-			DeVAS_image_data ( original, v_margin - 1 - row,
-			    n_cols - 1 - col ) );
-
-	    /* lower left */
-	    row_diff = ((double) ( row ) ) /
-		((double) ( v_margin - 1 ) );
-	    col_diff = ((double) ( h_margin - 1 - col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row + v_margin + n_rows, col ) =
-		scale_float ( distance, average_luminance,
-			DeVAS_image_data ( original, n_rows - 1 - row,
-			    h_margin - 1 - col ) );
-
-	    /* lower right */
-	    row_diff = ((double) ( row ) ) /
-		((double) ( v_margin - 1 ) );
-	    col_diff = ((double) ( col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row + v_margin + n_rows,
-		    col + h_margin + n_cols ) =
-		scale_float ( distance, average_luminance,
-			DeVAS_image_data ( original, n_rows - 1 - row,
-			    n_cols - 1 - col ) );
 	}
-    }
 
-#else
-
-    /*
-     * Create margin by flooding from nearest edge pixels.
-     */
-
-    /* top, bottom margins */
-    for ( row = 0; row < v_margin; row++ ) {
-	for ( col = 0; col < n_cols; col++ ) {
-	    DeVAS_image_data ( with_margin, row, col + h_margin ) =
-		scale_float ( 1.0 - ( ((double) row ) / ((double) v_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, 0, col ) );
-	    DeVAS_image_data ( with_margin, row + v_margin + n_rows,
-		    col + h_margin ) =
-		scale_float ( ( ((double) row ) / ((double) v_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, n_rows - 1, col ) );
-	}
+	free ( weight );
     }
 
-    /* left, right margins */
-    for ( row = 0; row < n_rows; row++ ) {
-	for ( col = 0; col < h_margin; col++ ) {
-	    DeVAS_image_data ( with_margin, row + v_margin, col ) =
-		scale_float ( 1.0 - ( ((double) col ) / ((double) h_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, row, 0 ) );
-	    DeVAS_image_data ( with_margin, row + v_margin,
-		    col + h_margin + n_cols ) =
-		scale_float ( ( ((double) col ) / ((double) h_margin ) ),
-			average_luminance,
-			DeVAS_image_data ( original, row, n_cols - 1 ) );
-	}
-    }
-
-    /* corners */
-    for ( row = 0; row < v_margin; row++ ) {
-	for ( col = 0; col < h_margin; col++ ) {
-
-	    row_diff = ((double) ( v_margin - 1 - row ) ) /
-		((double) ( v_margin - 1 ) );
-	    col_diff = ((double) ( h_margin - 1 - col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row, col ) =
-		scale_float ( distance, average_luminance,
-			DeVAS_image_data ( original, 0, 0 ) );
-
-	    col_diff = ((double) ( col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row, col + h_margin + n_cols ) =
-		scale_float ( distance, average_luminance,
-			DeVAS_image_data ( original, 0, n_cols - 1 ) );
-
-	    row_diff = ((double) ( row ) ) /
-		((double) ( v_margin - 1 ) );
-	    col_diff = ((double) ( h_margin - 1 - col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row + v_margin + n_rows, col ) =
-		scale_float ( distance, average_luminance,
-			DeVAS_image_data ( original, n_rows - 1, 0 ) );
-
-	    row_diff = ((double) ( row ) ) /
-		((double) ( v_margin - 1 ) );
-	    col_diff = ((double) ( col ) ) /
-		((double) ( h_margin - 1 ) );
-	    distance =
-		sqrt ( ( row_diff * row_diff ) + ( col_diff * col_diff ) );
-	    if ( distance > 1.0 ) {
-		distance = 1.0;
-	    }
-	    DeVAS_image_data ( with_margin, row + v_margin + n_rows,
-		    col + h_margin + n_cols ) =
-		scale_float ( distance, average_luminance,
-			DeVAS_image_data ( original, n_rows - 1, n_cols - 1 ) );
-	}
-    }
-
-#endif	/* DeVAS_MARGIN_REFLECT */
+    margin_weights_free ( &weights );
 
     return ( with_margin );
 }
 
-static DeVAS_float
-scale_float ( double distance, double background_value, DeVAS_float value )
-/* distance in range [0.0 - 1.0] */
-{
-    DeVAS_float	new_value;
-    double	weight;
-
-    if ( ( distance < 0.0 ) || ( distance > 1.0 ) ) {
-	fprintf ( stderr, "devas-margin:scale: invalid distance (%f)\n",
-		distance );
-	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
-	exit ( EXIT_FAILURE );
-    }
-
-    /* hardwired constant (6.0) in sigmoid to make results plausible */
-    weight = 2.0 * ( sigmoid ( 6.0 * ( 1.0 - distance ) ) - 0.5 );
-    new_value = ( weight * value ) +
-	( ( 1.0 - weight ) * background_value );
-
-    return ( new_value );
-}
-
 DeVAS_float_image *
 DeVAS_float_strip_margin ( int v_margin, int h_margin,
 	DeVAS_float_image *with_margin )
@@ -835,3 +461,359 @@ DeVAS_float_strip_margin ( int v_margin, int h_margin,
 
     return ( with_margin_stripped );
 }
+
+void
+DeVAS_xyY_add_margin_split ( int top, int bottom, int left, int right,
+	DeVAS_xyY_image *original, DeVAS_float_image *luminance,
+	DeVAS_float_image *x, DeVAS_float_image *y )
+/*
+ * Equivalent to DeVAS_xyY_add_margin ( ) followed by splitting the result
+ * into separate luminance and chromaticity channels, but without creating
+ * the intermediate padded xyY image.  The margin on each side can be
+ * different (including 0), which allows the padded size to be rounded up
+ * to one that is efficient for the FFT.
+ *
+ * luminance, x, and y must be preallocated, with
+ * ( n_rows + top + bottom ) rows and ( n_cols + left + right ) columns.
+ * x and y can be NULL if the chromaticity channels aren't needed.
+ *
+ * Field-of-view is updated in the outputs to keep degrees-per-pixel the
+ * same as for the input.
+ */
+{
+    int		    row, col;
+    int		    n_rows, n_cols;
+    int		    new_n_rows, new_n_cols;
+    double	    average_luminance;
+    Margin_weights  weights;
+    double	    *weight;
+    DeVAS_xyY	    value;
+
+    n_rows = DeVAS_image_n_rows ( original );
+    n_cols = DeVAS_image_n_cols ( original );
+
+    if ( ( top < 0 ) || ( bottom < 0 ) || ( left < 0 ) || ( right < 0 ) ) {
+	fprintf ( stderr,
+		"DeVAS_xyY_add_margin_split: invalid margin (%d, %d, %d, %d)!\n",
+		top, bottom, left, right );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    if ( ( n_rows < 2 ) || ( n_cols < 2 ) ) {
+	fprintf ( stderr,
+		"DeVAS_xyY_add_margin_split: image too small (%d, %d)!\n",
+		n_rows, n_cols );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    new_n_rows = n_rows + top + bottom;
+    new_n_cols = n_cols + left + right;
+
+    if ( ( DeVAS_image_n_rows ( luminance ) != new_n_rows ) ||
+	    ( DeVAS_image_n_cols ( luminance ) != new_n_cols ) ||
+	    ( ( x != NULL ) && ( ( DeVAS_image_n_rows ( x ) != new_n_rows ) ||
+		( DeVAS_image_n_cols ( x ) != new_n_cols ) ) ) ||
+	    ( ( y != NULL ) && ( ( DeVAS_image_n_rows ( y ) != new_n_rows ) ||
+		( DeVAS_image_n_cols ( y ) != new_n_cols ) ) ) ) {
+	fprintf ( stderr,
+		"DeVAS_xyY_add_margin_split: output size doesn't match!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    /* Reset FOV based on degrees/pixel, not on trignometry. */
+    if ( ( DeVAS_image_view ( original ) . vert <= 0.0 ) ||
+	    ( DeVAS_image_view ( original ) . horiz <= 0.0 ) ) {
+	fprintf ( stderr,
+		"DeVAS_xyY_add_margin_split: invalid or missing fov (%f, %f)!\n",
+		    DeVAS_image_view ( original ) . vert,
+		    DeVAS_image_view ( original ) .  horiz );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    /* copy VIEW record and update horizontal and vertical FOVs */
+    DeVAS_image_view ( luminance ) = DeVAS_image_view ( original );
+    DeVAS_image_view ( luminance ) . vert = ((double) new_n_rows ) *
+	( DeVAS_image_view ( original ) . vert / ((double) n_rows ) );
+    DeVAS_image_view ( luminance ) . horiz = ((double) new_n_cols ) *
+	( DeVAS_image_view ( original ) . horiz / ((double) n_cols ) );
+    if ( x != NULL ) {
+	DeVAS_image_view ( x ) = DeVAS_image_view ( luminance );
+    }
+    if ( y != NULL ) {
+	DeVAS_image_view ( y ) = DeVAS_image_view ( luminance );
+    }
+
+#ifdef DeVAS_MARGIN_AVERAGE_ALL
+
+    /* compute average luminance of all pixels in original image */
+    average_luminance = 0.0;
+
+    for ( row = 0; row < n_rows; row++ ) {
+	for ( col = 0; col < n_cols; col++ ) {
+	    average_luminance += DeVAS_image_data ( original, row, col ).Y;
+	}
+    }
+
+    average_luminance /= (double) ( n_rows * n_cols );
+
+#else
+
+    /* compute average luminance of all border pixels in original image */
+    average_luminance = 0.0;
+    for ( col = 0; col < n_cols; col++ ) {
+	average_luminance += DeVAS_image_data ( original, 0, col ).Y;
+	average_luminance += DeVAS_image_data ( original, n_rows - 1 , col ).Y;
+    }
+    for ( row = 1; row < n_rows - 1; row++ ) {
+	average_luminance += DeVAS_image_data ( original, row, 0 ).Y;
+	average_luminance += DeVAS_image_data ( original, row, n_cols - 1 ).Y;
+    }
+    average_luminance /= (double) ( ( 2 * ( n_rows + n_cols ) ) - 2 );
+
+#endif	/* DeVAS_MARGIN_AVERAGE_ALL */
+
+    margin_weights_init ( &weights, n_rows, n_cols, top, bottom, left,
+	    right );
+
+#pragma omp parallel private ( row, col, weight, value )
+    {
+	weight = margin_row_buffer ( new_n_cols );
+
+#pragma omp for
+	for ( row = 0; row < new_n_rows; row++ ) {
+	    margin_weights_row ( &weights, row, weight );
+	    for ( col = 0; col < new_n_cols; col++ ) {
+		value = DeVAS_image_data ( original, weights.source_row[row],
+			weights.source_col[col] );
+
+		if ( weight[col] >= 0.0 ) {
+		    DeVAS_image_data ( luminance, row, col ) =
+			blend ( weight[col], average_luminance, value.Y );
+		} else {
+		    /* inside original image */
+		    DeVAS_image_data ( luminance, row, col ) = value.Y;
+		}
+
+		if ( x != NULL ) {
+		    DeVAS_image_data ( x, row, col ) = value.x;
+		}
+		if ( y != NULL ) {
+		    DeVAS_image_data ( y, row, col ) = value.y;
+		}
+	    }
+	}
+
+	free ( weight );
+    }
+
+    margin_weights_free ( &weights );
+}
+
+static void
+margin_weights_init ( Margin_weights *weights, int n_rows, int n_cols,
+	int top, int bottom, int left, int right )
+/*
+ * Allocate and fill in the per-row and per-column tables used to generate
+ * margins for an n_rows x n_cols image, along with a table of the corner
+ * blend weight as a function of distance.
+ */
+{
+    int	    new_n_rows, new_n_cols;
+    int	    i;
+
+    new_n_rows = n_rows + top + bottom;
+    new_n_cols = n_cols + left + right;
+
+    weights->source_row = (int *) malloc ( new_n_rows * sizeof ( int ) );
+    weights->row_weight = (double *) malloc ( new_n_rows * sizeof ( double ) );
+    weights->row_corner_sq =
+	(double *) malloc ( new_n_rows * sizeof ( double ) );
+    weights->source_col = (int *) malloc ( new_n_cols * sizeof ( int ) );
+    weights->col_weight = (double *) malloc ( new_n_cols * sizeof ( double ) );
+    weights->col_corner_sq =
+	(double *) malloc ( new_n_cols * sizeof ( double ) );
+    if ( ( weights->source_row == NULL ) || ( weights->row_weight == NULL ) ||
+	    ( weights->row_corner_sq == NULL ) ||
+	    ( weights->source_col == NULL ) || ( weights->col_weight == NULL ) ||
+	    ( weights->col_corner_sq == NULL ) ) {
+	fprintf ( stderr, "margin_weights_init: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    weights->n_cols = new_n_cols;
+
+    margin_map ( n_rows, top, bottom, weights->source_row,
+	    weights->row_weight, weights->row_corner_sq );
+    margin_map ( n_cols, left, right, weights->source_col,
+	    weights->col_weight, weights->col_corner_sq );
+
+    for ( i = 0; i <= CORNER_TABLE_SIZE; i++ ) {
+	weights->corner_table[i] =
+	    blend_weight ( ((double) i ) / ((double) CORNER_TABLE_SIZE ) );
+    }
+}
+
+static void
+margin_weights_free ( Margin_weights *weights )
+{
+    free ( weights->source_row );
+    free ( weights->row_weight );
+    free ( weights->row_corner_sq );
+    free ( weights->source_col );
+    free ( weights->col_weight );
+    free ( weights->col_corner_sq );
+}
+
+static double *
+margin_row_buffer ( int n_cols )
+/*
+ * Per-thread buffer for margin_weights_row ( ).
+ */
+{
+    double  *weight;
+
+    weight = (double *) malloc ( n_cols * sizeof ( double ) );
+    if ( weight == NULL ) {
+	fprintf ( stderr, "margin_row_buffer: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    return ( weight );
+}
+
+static void
+margin_weights_row ( Margin_weights *weights, int row, double *weight )
+/*
+ * Fill in the blend weight for each pixel in a row of the padded image.
+ * Weights are set to -1.0 inside the original image.
+ */
+{
+    int	    col;
+    double  row_weight;
+    double  row_corner_sq;
+    double  distance;
+    double  index;
+    int	    i;
+
+    row_weight = weights->row_weight[row];
+
+    if ( row_weight < 0.0 ) {
+	/* rows of original image, so only left and right margins */
+	for ( col = 0; col < weights->n_cols; col++ ) {
+	    weight[col] = weights->col_weight[col];
+	}
+	return;
+    }
+
+    row_corner_sq = weights->row_corner_sq[row];
+
+    for ( col = 0; col < weights->n_cols; col++ ) {
+	if ( weights->col_weight[col] < 0.0 ) {
+	    /* top, bottom margins */
+	    weight[col] = row_weight;
+	} else {
+	    /* corners, using linear interpolation in the weight table */
+	    distance = sqrt ( row_corner_sq + weights->col_corner_sq[col] );
+	    if ( distance >= 1.0 ) {
+		weight[col] = weights->corner_table[CORNER_TABLE_SIZE];
+	    } else {
+		index = distance * ((double) CORNER_TABLE_SIZE );
+		i = (int) index;
+		weight[col] = weights->corner_table[i] + ( ( index - i ) *
+			( weights->corner_table[i + 1] -
+			  weights->corner_table[i] ) );
+	    }
+	}
+    }
+}
+
+static double
+blend_weight ( double distance )
+/*
+ * Weight given to the image value (vs. the average luminance) at the
+ * specified normalized distance into the margin, in range [0.0 - 1.0].
+ */
+{
+    if ( ( distance < 0.0 ) || ( distance > 1.0 ) ) {
+	fprintf ( stderr, "devas-margin:blend_weight: invalid distance (%f)\n",
+		distance );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    /* hardwired constant (6.0) in sigmoid to make results plausible */
+    return ( 2.0 * ( sigmoid ( 6.0 * ( 1.0 - distance ) ) - 0.5 ) );
+}
+
+static double
+blend ( double weight, double background_value, double value )
+{
+    return ( ( weight * value ) + ( ( 1.0 - weight ) * background_value ) );
+}
+
+static void
+margin_map ( int size, int before, int after, int *source, double *weight,
+	double *corner_sq )
+/*
+ * For each position along one padded dimension, compute the index of the
+ * original pixel used for the margin value, the blend weight used for
+ * the top/bottom (left/right) margins, and the square of the component of
+ * the blend distance used for the corners.  These match the values used
+ * in the original per-pixel margin code when before == after.  weight is
+ * set to -1.0 inside the original image.
+ */
+{
+    int	    i;
+    double  corner;
+
+    /* top (left) margin */
+    for ( i = 0; i < before; i++ ) {
+#ifdef DeVAS_MARGIN_REFLECT
+	source[i] = imin ( before - 1 - i, size - 1 );
+#else
+	source[i] = 0;
+#endif	/* DeVAS_MARGIN_REFLECT */
+	weight[i] = blend_weight ( 1.0 - ( ((double) i ) / ((double) before ) ) );
+	corner = ( before > 1 ) ?
+	    ((double) ( before - 1 - i ) ) / ((double) ( before - 1 ) ) : 1.0;
+	corner_sq[i] = corner * corner;
+    }
+
+    /* original image */
+    for ( i = 0; i < size; i++ ) {
+	source[i + before] = i;
+	weight[i + before] = -1.0;
+	corner_sq[i + before] = -1.0;
+    }
+
+    /* bottom (right) margin */
+    for ( i = 0; i < after; i++ ) {
+#ifdef DeVAS_MARGIN_REFLECT
+	source[i + before + size] = imax ( size - 1 - i, 0 );
+#else
+	source[i + before + size] = size - 1;
+#endif	/* DeVAS_MARGIN_REFLECT */
+	weight[i + before + size] =
+	    blend_weight ( ((double) i ) / ((double) after ) );
+	corner = ( after > 1 ) ? ((double) i ) / ((double) ( after - 1 ) ) : 0.0;
+	corner_sq[i + before + size] = corner * corner;
+    }
+}
+
+static int
+imin ( int x, int y )
+{
+    return ( ( x < y ) ? x : y );
+}
+
+static int
+imax ( int x, int y )
+{
+    return ( ( x > y ) ? x : y );
+}
@@ -33,6 +33,11 @@ DeVAS_xyY_image	    *DeVAS_xyY_add_margin ( int v_margin, int h_margin,
 DeVAS_xyY_image	    *DeVAS_xyY_strip_margin ( int v_margin, int h_margin,
 			DeVAS_xyY_image *with_margin );
 
+void		    DeVAS_xyY_add_margin_split ( int top, int bottom,
+			int left, int right, DeVAS_xyY_image *original,
+			DeVAS_float_image *luminance, DeVAS_float_image *x,
+			DeVAS_float_image *y );
+
 #ifdef __cplusplus
 }
 #endif
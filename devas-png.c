@@ -10,8 +10,19 @@
  * Read/write in-memory 8-bit DeVAS gray-scale and RGB images from/to PNG files.
  *
  * Assumes that PNG image files have contiguous, tightly packed pixels.
+ *
+ * Reading uses the libpng simplified API.  Writing uses the full libpng
+ * API, so that the zlib compression level and PNG row filters can be set
+ * (see DeVAS_png_set_compression ( )).  With the default settings, output
+ * is the same as from the simplified API.
  */
 
+static void	write_png ( FILE *output, int n_rows, int n_cols,
+		    int color_type, png_bytep *row_pointers, char *caller );
+
+static DeVAS_png_compression	png_compression =
+				    DeVAS_PNG_COMPRESSION_DEFAULT;
+
 DeVAS_RGB_image *
 DeVAS_RGB_image_from_filename_png ( char *filename )
 {
@@ -135,28 +146,24 @@ DeVAS_RGB_image_to_filename_png ( char *filename, DeVAS_RGB_image *image )
 void
 DeVAS_RGB_image_to_file_png ( FILE *output, DeVAS_RGB_image *image )
 {
-    png_image	png_output;
+    png_bytep	*row_pointers;
+    int		row;
 
-    /* Initialize the 'png_image' structure. */
-    memset ( &png_output, 0, sizeof ( png_output ) );
-
-    png_output.opaque = NULL;
-    png_output.version = PNG_IMAGE_VERSION;
-    png_output.width = DeVAS_image_n_cols ( image );
-    png_output.height = DeVAS_image_n_rows ( image );
-    png_output.format = PNG_FORMAT_RGB;
-    png_output.flags = 0;
-    png_output.colormap_entries = 0;
-    png_output.warning_or_error = 0;
-    png_output.message[0] = '\0';
-
-    if ( png_image_write_to_stdio ( &png_output, output, 0 /*convert_to_8bit*/,
-	    (void *) ( &DeVAS_image_data ( image, 0, 0 ) ), 0 /*row_stride*/,
-	    NULL /*colormap*/) == 0 ) {
-	fprintf ( stderr,
-		"DeVAS_RGB_image_to_file_png: error writing file!\n" );
+    row_pointers = (png_bytep *) malloc ( DeVAS_image_n_rows ( image ) *
+	    sizeof ( png_bytep ) );
+    if ( row_pointers == NULL ) {
+	fprintf ( stderr, "DeVAS_RGB_image_to_file_png: malloc failed!\n" );
 	exit ( EXIT_FAILURE );
     }
+    for ( row = 0; row < DeVAS_image_n_rows ( image ); row++ ) {
+	row_pointers[row] = (png_bytep) &DeVAS_image_data ( image, row, 0 );
+    }
+
+    write_png ( output, DeVAS_image_n_rows ( image ),
+	    DeVAS_image_n_cols ( image ), PNG_COLOR_TYPE_RGB, row_pointers,
+	    "DeVAS_RGB_image_to_file_png" );
+
+    free ( row_pointers );
 }
 
 void
@@ -178,21 +185,96 @@ DeVAS_gray_image_to_filename_png ( char *filename, DeVAS_gray_image *image )
 void
 DeVAS_gray_image_to_file_png ( FILE *output, DeVAS_gray_image *image )
 {
-    png_image	png_output;
+    png_bytep	*row_pointers;
+    int		row;
 
-    /* Initialize the 'png_image' structure. */
-    memset ( &png_output, 0, sizeof ( png_output ) );
-
-    png_output.opaque = NULL;
-    png_output.version = PNG_IMAGE_VERSION;
-    png_output.width = DeVAS_image_n_cols ( image );
-    png_output.height = DeVAS_image_n_rows ( image );
-    png_output.format = PNG_FORMAT_GRAY;
-    png_output.colormap_entries = 0;
-    png_output.warning_or_error = 0;
-    png_output.message[0] = '\0';
-
-    png_image_write_to_stdio ( &png_output, output, 0 /*convert_to_8bit*/,
-	    (void *) ( &DeVAS_image_data ( image, 0, 0 ) ), 0 /*row_stride*/,
-	    NULL /*colormap*/ );
+    row_pointers = (png_bytep *) malloc ( DeVAS_image_n_rows ( image ) *
+	    sizeof ( png_bytep ) );
+    if ( row_pointers == NULL ) {
+	fprintf ( stderr, "DeVAS_gray_image_to_file_png: malloc failed!\n" );
+	exit ( EXIT_FAILURE );
+    }
+    for ( row = 0; row < DeVAS_image_n_rows ( image ); row++ ) {
+	row_pointers[row] = (png_bytep) &DeVAS_image_data ( image, row, 0 );
+    }
+
+    write_png ( output, DeVAS_image_n_rows ( image ),
+	    DeVAS_image_n_cols ( image ), PNG_COLOR_TYPE_GRAY, row_pointers,
+	    "DeVAS_gray_image_to_file_png" );
+
+    free ( row_pointers );
+}
+
+void
+DeVAS_png_set_compression ( DeVAS_png_compression compression )
+/*
+ * Set compression used for all subsequent PNG output.  The boundary,
+ * low luminance, hazard, and false positive images are mostly black, so
+ * DeVAS_PNG_COMPRESSION_FAST is much faster than the default with only a
+ * modest increase in file size.
+ */
+{
+    png_compression = compression;
+}
+
+static void
+write_png ( FILE *output, int n_rows, int n_cols, int color_type,
+	png_bytep *row_pointers, char *caller )
+/*
+ * Write an 8-bit gray or RGB PNG file, with an sRGB chunk as written by
+ * png_image_write_to_stdio ( ).
+ */
+{
+    png_structp	png_ptr;
+    png_infop	info_ptr;
+
+    png_ptr = png_create_write_struct ( PNG_LIBPNG_VER_STRING, NULL, NULL,
+	    NULL );
+    if ( png_ptr == NULL ) {
+	fprintf ( stderr, "%s: png_create_write_struct failed!\n", caller );
+	exit ( EXIT_FAILURE );
+    }
+
+    info_ptr = png_create_info_struct ( png_ptr );
+    if ( info_ptr == NULL ) {
+	fprintf ( stderr, "%s: png_create_info_struct failed!\n", caller );
+	exit ( EXIT_FAILURE );
+    }
+
+    if ( setjmp ( png_jmpbuf ( png_ptr ) ) ) {
+	fprintf ( stderr, "%s: error writing file!\n", caller );
+	exit ( EXIT_FAILURE );
+    }
+
+    png_init_io ( png_ptr, output );
+
+    switch ( png_compression ) {
+
+	case DeVAS_PNG_COMPRESSION_DEFAULT:
+	    break;
+
+	case DeVAS_PNG_COMPRESSION_FAST:
+	    png_set_compression_level ( png_ptr, 1 );
+	    png_set_filter ( png_ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE );
+	    break;
+
+	case DeVAS_PNG_COMPRESSION_BEST:
+	    png_set_compression_level ( png_ptr, 9 );
+	    break;
+
+	default:
+	    fprintf ( stderr, "%s: invalid compression setting!\n", caller );
+	    exit ( EXIT_FAILURE );
+    }
+
+    png_set_IHDR ( png_ptr, info_ptr, n_cols, n_rows, 8, color_type,
+	    PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
+	    PNG_FILTER_TYPE_BASE );
+    png_set_sRGB ( png_ptr, info_ptr, PNG_sRGB_INTENT_PERCEPTUAL );
+
+    png_write_info ( png_ptr, info_ptr );
+    png_write_image ( png_ptr, row_pointers );
+    png_write_end ( png_ptr, info_ptr );
+
+    png_destroy_write_struct ( &png_ptr, &info_ptr );
 }
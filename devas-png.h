@@ -3,6 +3,15 @@
 
 #include "devas-image.h"
 
+/*
+ * Tradeoff between speed and file size when writing PNG files.
+ */
+typedef enum {
+    DeVAS_PNG_COMPRESSION_DEFAULT,	/* libpng defaults */
+    DeVAS_PNG_COMPRESSION_FAST,		/* zlib level 1, no filtering */
+    DeVAS_PNG_COMPRESSION_BEST		/* zlib level 9 */
+} DeVAS_png_compression;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -23,6 +32,9 @@ void		DeVAS_gray_image_to_filename_png ( char *filename,
 void		DeVAS_gray_image_to_file_png ( FILE *output,
 		    DeVAS_gray_image *image );
 
+void		DeVAS_png_set_compression
+		    ( DeVAS_png_compression compression );
+
 #ifdef __cplusplus
 }
 #endif
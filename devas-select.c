@@ -0,0 +1,180 @@
+/*
+ * Exact order statistics (k-th smallest value, percentiles) of arrays of
+ * float values.
+ *
+ * Uses introselect: quickselect with a median-of-three pivot and a
+ * three-way partition (so that large numbers of identical values, common
+ * in gradient magnitude and luminance images, do not cause quadratic
+ * behavior), falling back to sorting the remaining subrange if the
+ * partitioning fails to converge.  Expected cost is O(n), worst case
+ * O(n log n).
+ *
+ * This replaces the fixed-size histograms previously used to estimate
+ * percentiles, whose accuracy depended on the dynamic range of the data.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "devas-select.h"
+#include "devas-image.h"
+#include "devas-license.h"	/* DeVAS open source license */
+
+#define	SELECT_SMALL	16	/* use insertion sort below this size */
+
+static void	insertion_sort ( float *values, int left, int right );
+static int	compare_float ( const void *a, const void *b );
+static int	depth_limit ( int n_values );
+
+float
+DeVAS_float_select ( float *values, int n_values, int k )
+/*
+ * Returns the k-th smallest element (k = 0 is the minimum, k = n_values - 1
+ * is the maximum) of values.  The contents of values are reordered.
+ */
+{
+    int	    left, right;
+    int	    lt, gt, i;
+    int	    mid;
+    int	    depth;
+    float   pivot;
+    float   a, b, c;
+    float   temp;
+
+    if ( ( n_values < 1 ) || ( k < 0 ) || ( k >= n_values ) ) {
+	fprintf ( stderr, "DeVAS_float_select: invalid arguments (%d, %d)!\n",
+		n_values, k );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    left = 0;
+    right = n_values - 1;
+    depth = depth_limit ( n_values );
+
+    while ( right > left ) {
+
+	if ( ( right - left ) < SELECT_SMALL ) {
+	    insertion_sort ( values, left, right );
+	    return ( values[k] );
+	}
+
+	if ( depth-- <= 0 ) {
+	    /* partitioning isn't converging, so guarantee O(n log n) */
+	    qsort ( values + left, right - left + 1, sizeof ( float ),
+		    compare_float );
+	    return ( values[k] );
+	}
+
+	/* median-of-three pivot */
+	mid = left + ( ( right - left ) / 2 );
+	a = values[left];
+	b = values[mid];
+	c = values[right];
+	if ( a < b ) {
+	    pivot = ( b < c ) ? b : ( ( a < c ) ? c : a );
+	} else {
+	    pivot = ( a < c ) ? a : ( ( b < c ) ? c : b );
+	}
+
+	/*
+	 * Three-way partition:
+	 *   [left, lt)	    < pivot
+	 *   [lt, gt]	    == pivot
+	 *   (gt, right]    > pivot
+	 */
+	lt = left;
+	gt = right;
+	i = left;
+	while ( i <= gt ) {
+	    if ( values[i] < pivot ) {
+		temp = values[lt];
+		values[lt] = values[i];
+		values[i] = temp;
+		lt++;
+		i++;
+	    } else if ( values[i] > pivot ) {
+		temp = values[gt];
+		values[gt] = values[i];
+		values[i] = temp;
+		gt--;
+	    } else {
+		i++;
+	    }
+	}
+
+	if ( k < lt ) {
+	    right = lt - 1;
+	} else if ( k > gt ) {
+	    left = gt + 1;
+	} else {
+	    return ( pivot );
+	}
+    }
+
+    return ( values[k] );
+}
+
+float
+DeVAS_float_percentile ( float *values, int n_values, double fraction )
+/*
+ * Returns the value such that (approximately) fraction of the elements of
+ * values are less than or equal to it.  fraction is in the range
+ * [0.0 - 1.0].  The returned value is always an element of values (no
+ * interpolation is done).  The contents of values are reordered.
+ */
+{
+    int	    k;
+
+    if ( ( fraction < 0.0 ) || ( fraction > 1.0 ) ) {
+	fprintf ( stderr, "DeVAS_float_percentile: invalid fraction (%f)!\n",
+		fraction );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    k = (int) rint ( fraction * ( (double) ( n_values - 1 ) ) );
+
+    return ( DeVAS_float_select ( values, n_values, k ) );
+}
+
+static void
+insertion_sort ( float *values, int left, int right )
+{
+    int	    i, j;
+    float   value;
+
+    for ( i = left + 1; i <= right; i++ ) {
+	value = values[i];
+	for ( j = i - 1; ( j >= left ) && ( values[j] > value ); j-- ) {
+	    values[j + 1] = values[j];
+	}
+	values[j + 1] = value;
+    }
+}
+
+static int
+compare_float ( const void *a, const void *b )
+{
+    float   fa = *((const float *) a );
+    float   fb = *((const float *) b );
+
+    return ( ( fa > fb ) - ( fa < fb ) );
+}
+
+static int
+depth_limit ( int n_values )
+/*
+ * 2 * floor ( log2 ( n_values ) ), as in introsort.
+ */
+{
+    int	    depth;
+
+    depth = 0;
+    while ( n_values > 1 ) {
+	n_values >>= 1;
+	depth++;
+    }
+
+    return ( 2 * depth );
+}
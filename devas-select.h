@@ -0,0 +1,25 @@
+/*
+ * Exact order statistics (k-th smallest value, percentiles) of arrays of
+ * float values.
+ */
+
+#ifndef __DeVAS_SELECT_H
+#define __DeVAS_SELECT_H
+
+#include "devas-image.h"
+
+/* function prototypes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+float		    DeVAS_float_select ( float *values, int n_values, int k );
+float		    DeVAS_float_percentile ( float *values, int n_values,
+			double fraction );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DeVAS_SELECT_H */
@@ -0,0 +1,419 @@
+/*
+ * Sequences of input and output Radiance files, for filtering the frames
+ * of a walkthrough or animation in one run.
+ *
+ * A sequence is either a pair of printf-style file name patterns with a
+ * single integer conversion (e.g., frame%04d.hdr) and a range of frame
+ * numbers, or a list file with an input and an output file name for each
+ * frame.
+ *
+ * Reading the next frame and writing the previous one can each be done
+ * by a background thread while the current frame is filtered.  Only one
+ * read and one write can be outstanding at a time.  Header parsing uses
+ * static variables in radiance-header.c, so no other Radiance files may
+ * be read while a read is outstanding.  The background threads decode
+ * and encode pixels without OpenMP parallelism, leaving the processors
+ * to the filtering.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif	/* _OPENMP */
+#include "devas-sequence.h"
+#include "devas-image.h"
+#include "devas-utils.h"
+#include "radianceIO.h"
+#include "devas-license.h"	/* DeVAS open source license */
+
+#define	SEQUENCE_NAME_MAX	4096	/* longest file name in a list file */
+#define	SEQUENCE_INITIAL_SIZE	64	/* list grows as needed */
+
+static DeVAS_sequence	*sequence_new ( int n_frames );
+static int		valid_pattern ( char *pattern );
+static char		*frame_file_name ( char *pattern, int frame );
+static void		*read_frame ( void *arg );
+static void		*write_frame ( void *arg );
+
+DeVAS_sequence *
+DeVAS_sequence_from_pattern ( char *input_pattern, char *output_pattern,
+	int first, int last )
+/*
+ * Frames first through last (inclusive), with file names made by
+ * formatting the frame number with input_pattern and output_pattern,
+ * each of which must contain exactly one %d conversion (optionally with
+ * flags and a field width, as in %04d) and no other conversions other
+ * than %%.
+ */
+{
+    DeVAS_sequence  *sequence;
+    int		    frame;
+
+    if ( !valid_pattern ( input_pattern ) ) {
+	fprintf ( stderr,
+    "DeVAS_sequence_from_pattern: invalid file name pattern (%s)!\n",
+		input_pattern );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    if ( !valid_pattern ( output_pattern ) ) {
+	fprintf ( stderr,
+    "DeVAS_sequence_from_pattern: invalid file name pattern (%s)!\n",
+		output_pattern );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    if ( last < first ) {
+	fprintf ( stderr,
+		"DeVAS_sequence_from_pattern: invalid frame range (%d:%d)!\n",
+		first, last );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    sequence = sequence_new ( last - first + 1 );
+
+    for ( frame = first; frame <= last; frame++ ) {
+	sequence->input_file_names[sequence->n_frames] =
+	    frame_file_name ( input_pattern, frame );
+	sequence->output_file_names[sequence->n_frames] =
+	    frame_file_name ( output_pattern, frame );
+	sequence->n_frames++;
+    }
+
+    return ( sequence );
+}
+
+DeVAS_sequence *
+DeVAS_sequence_from_list ( char *list_file_name )
+/*
+ * Frames listed in list_file_name, which contains white space separated
+ * pairs of input and output file names, one pair per frame.  File names
+ * may not contain white space.
+ */
+{
+    DeVAS_sequence  *sequence;
+    FILE	    *list_file;
+    char	    input_name[SEQUENCE_NAME_MAX];
+    char	    output_name[SEQUENCE_NAME_MAX];
+    int		    max_frames;
+    int		    n_read;
+
+    list_file = fopen ( list_file_name, "r" );
+    if ( list_file == NULL ) {
+	perror ( list_file_name );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    max_frames = SEQUENCE_INITIAL_SIZE;
+    sequence = sequence_new ( max_frames );
+
+    while ( ( n_read = fscanf ( list_file, "%4095s %4095s", input_name,
+		    output_name ) ) == 2 ) {
+	if ( sequence->n_frames >= max_frames ) {
+	    max_frames *= 2;
+	    sequence->input_file_names = (char **) realloc
+		( sequence->input_file_names, max_frames * sizeof ( char * ) );
+	    sequence->output_file_names = (char **) realloc
+		( sequence->output_file_names, max_frames * sizeof ( char * ) );
+	    if ( ( sequence->input_file_names == NULL ) ||
+		    ( sequence->output_file_names == NULL ) ) {
+		fprintf ( stderr,
+			"DeVAS_sequence_from_list: realloc failed!\n" );
+		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+		exit ( EXIT_FAILURE );
+	    }
+	}
+
+	sequence->input_file_names[sequence->n_frames] =
+	    strdup ( input_name );
+	sequence->output_file_names[sequence->n_frames] =
+	    strdup ( output_name );
+	if ( ( sequence->input_file_names[sequence->n_frames] == NULL ) ||
+		( sequence->output_file_names[sequence->n_frames] == NULL ) ) {
+	    fprintf ( stderr, "DeVAS_sequence_from_list: strdup failed!\n" );
+	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	    exit ( EXIT_FAILURE );
+	}
+	sequence->n_frames++;
+    }
+
+    if ( ( n_read != EOF ) || ferror ( list_file ) ) {
+	fprintf ( stderr,
+	    "DeVAS_sequence_from_list: %s must contain pairs of file names!\n",
+		list_file_name );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    fclose ( list_file );
+
+    if ( sequence->n_frames == 0 ) {
+	fprintf ( stderr, "DeVAS_sequence_from_list: %s is empty!\n",
+		list_file_name );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    return ( sequence );
+}
+
+void
+DeVAS_sequence_delete ( DeVAS_sequence *sequence )
+/*
+ * Waits for any outstanding write.  Any image from an outstanding read is
+ * deleted.
+ */
+{
+    int	    frame;
+
+    if ( sequence->reading ) {
+	DeVAS_xyY_image_delete ( DeVAS_sequence_read_finish ( sequence ) );
+    }
+    DeVAS_sequence_write_finish ( sequence );
+
+    for ( frame = 0; frame < sequence->n_frames; frame++ ) {
+	free ( sequence->input_file_names[frame] );
+	free ( sequence->output_file_names[frame] );
+    }
+    free ( sequence->input_file_names );
+    free ( sequence->output_file_names );
+    free ( sequence );
+}
+
+void
+DeVAS_sequence_read_start ( DeVAS_sequence *sequence, int frame,
+	DeVAS_luminance_stats *stats )
+/*
+ * Start reading frame in the background, adding the luminance of every
+ * pixel to stats (if not NULL).  stats must not be used until the read
+ * is finished.
+ */
+{
+    if ( ( frame < 0 ) || ( frame >= sequence->n_frames ) ||
+	    sequence->reading ) {
+	fprintf ( stderr, "DeVAS_sequence_read_start: invalid frame (%d)!\n",
+		frame );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    sequence->read_frame = frame;
+    sequence->read_stats = stats;
+    sequence->read_image = NULL;
+
+    if ( pthread_create ( &sequence->reader, NULL, read_frame,
+		(void *) sequence ) != 0 ) {
+	fprintf ( stderr, "DeVAS_sequence_read_start: pthread_create failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+    sequence->reading = TRUE;
+}
+
+DeVAS_xyY_image *
+DeVAS_sequence_read_finish ( DeVAS_sequence *sequence )
+/*
+ * Wait for the read started by DeVAS_sequence_read_start ( ) and return
+ * the frame, which is owned by the caller.
+ */
+{
+    if ( !sequence->reading ) {
+	fprintf ( stderr, "DeVAS_sequence_read_finish: no read started!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    if ( pthread_join ( sequence->reader, NULL ) != 0 ) {
+	fprintf ( stderr, "DeVAS_sequence_read_finish: pthread_join failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+    sequence->reading = FALSE;
+
+    return ( sequence->read_image );
+}
+
+void
+DeVAS_sequence_write_start ( DeVAS_sequence *sequence, int frame,
+	DeVAS_xyY_image *image )
+/*
+ * Start writing image to the output file for frame in the background,
+ * first waiting for any outstanding write.  The sequence takes ownership
+ * of image, which is deleted once written.
+ */
+{
+    if ( ( frame < 0 ) || ( frame >= sequence->n_frames ) ) {
+	fprintf ( stderr, "DeVAS_sequence_write_start: invalid frame (%d)!\n",
+		frame );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    DeVAS_sequence_write_finish ( sequence );
+
+    sequence->write_frame = frame;
+    sequence->write_image = image;
+
+    if ( pthread_create ( &sequence->writer, NULL, write_frame,
+		(void *) sequence ) != 0 ) {
+	fprintf ( stderr,
+		"DeVAS_sequence_write_start: pthread_create failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+    sequence->writing = TRUE;
+}
+
+void
+DeVAS_sequence_write_finish ( DeVAS_sequence *sequence )
+/*
+ * Wait for any outstanding write.
+ */
+{
+    if ( !sequence->writing ) {
+	return;
+    }
+
+    if ( pthread_join ( sequence->writer, NULL ) != 0 ) {
+	fprintf ( stderr,
+		"DeVAS_sequence_write_finish: pthread_join failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+    sequence->writing = FALSE;
+}
+
+static DeVAS_sequence *
+sequence_new ( int max_frames )
+{
+    DeVAS_sequence  *sequence;
+
+    sequence = (DeVAS_sequence *) malloc ( sizeof ( DeVAS_sequence ) );
+    if ( sequence == NULL ) {
+	fprintf ( stderr, "DeVAS_sequence: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    sequence->n_frames = 0;
+    sequence->input_file_names =
+	(char **) malloc ( max_frames * sizeof ( char * ) );
+    sequence->output_file_names =
+	(char **) malloc ( max_frames * sizeof ( char * ) );
+    if ( ( sequence->input_file_names == NULL ) ||
+	    ( sequence->output_file_names == NULL ) ) {
+	fprintf ( stderr, "DeVAS_sequence: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    sequence->reading = FALSE;
+    sequence->read_frame = -1;
+    sequence->read_stats = NULL;
+    sequence->read_image = NULL;
+
+    sequence->writing = FALSE;
+    sequence->write_frame = -1;
+    sequence->write_image = NULL;
+
+    return ( sequence );
+}
+
+static int
+valid_pattern ( char *pattern )
+/*
+ * TRUE if pattern has exactly one conversion, which is %d with optional
+ * flags and field width, other than %%.  Anything else could make
+ * formatting a frame number misbehave.
+ */
+{
+    int	    n_conversions = 0;
+
+    while ( *pattern != '\0' ) {
+	if ( *pattern++ != '%' ) {
+	    continue;
+	}
+
+	if ( *pattern == '%' ) {
+	    pattern++;		/* literal '%' */
+	    continue;
+	}
+
+	while ( ( *pattern == '0' ) || ( *pattern == '-' ) ||
+		( *pattern == '+' ) || ( *pattern == ' ' ) ) {
+	    pattern++;		/* flags */
+	}
+	while ( isdigit ( (unsigned char) *pattern ) ) {
+	    pattern++;		/* field width */
+	}
+
+	if ( *pattern++ != 'd' ) {
+	    return ( FALSE );
+	}
+	n_conversions++;
+    }
+
+    return ( n_conversions == 1 );
+}
+
+static char *
+frame_file_name ( char *pattern, int frame )
+{
+    char    *file_name;
+    int	    length;
+
+    length = snprintf ( NULL, 0, pattern, frame );
+
+    file_name = (char *) malloc ( length + 1 );
+    if ( file_name == NULL ) {
+	fprintf ( stderr, "DeVAS_sequence: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    snprintf ( file_name, length + 1, pattern, frame );
+
+    return ( file_name );
+}
+
+static void *
+read_frame ( void *arg )
+{
+    DeVAS_sequence  *sequence = (DeVAS_sequence *) arg;
+
+#ifdef _OPENMP
+    omp_set_num_threads ( 1 );	/* leave the processors to filtering */
+#endif	/* _OPENMP */
+
+    sequence->read_image = DeVAS_xyY_image_from_radfilename_stats
+	( DeVAS_sequence_input_file_name ( sequence, sequence->read_frame ),
+	  sequence->read_stats );
+
+    return ( NULL );
+}
+
+static void *
+write_frame ( void *arg )
+{
+    DeVAS_sequence  *sequence = (DeVAS_sequence *) arg;
+
+#ifdef _OPENMP
+    omp_set_num_threads ( 1 );	/* leave the processors to filtering */
+#endif	/* _OPENMP */
+
+    DeVAS_xyY_image_to_radfilename
+	( DeVAS_sequence_output_file_name ( sequence, sequence->write_frame ),
+	  sequence->write_image );
+    DeVAS_xyY_image_delete ( sequence->write_image );
+    sequence->write_image = NULL;
+
+    return ( NULL );
+}
@@ -0,0 +1,60 @@
+/*
+ * Sequences of input and output Radiance files, for filtering the frames
+ * of a walkthrough or animation in one run, with reading of the next
+ * frame and writing of the previous one done in the background.
+ */
+
+#ifndef __DeVAS_SEQUENCE_H
+#define __DeVAS_SEQUENCE_H
+
+#include <pthread.h>
+#include "devas-image.h"
+#include "devas-autoclip.h"
+
+typedef struct {
+    int			    n_frames;
+    char		    **input_file_names;
+    char		    **output_file_names;
+
+    /* background read of one frame */
+    pthread_t		    reader;
+    int			    reading;		/* reader thread started */
+    int			    read_frame;
+    DeVAS_luminance_stats   *read_stats;
+    DeVAS_xyY_image	    *read_image;
+
+    /* background write of one frame */
+    pthread_t		    writer;
+    int			    writing;		/* writer thread started */
+    int			    write_frame;
+    DeVAS_xyY_image	    *write_image;
+} DeVAS_sequence;
+
+#define	DeVAS_sequence_n_frames(sequence)	((sequence)->n_frames)
+#define	DeVAS_sequence_input_file_name(sequence,frame) \
+    ((sequence)->input_file_names[frame])
+#define	DeVAS_sequence_output_file_name(sequence,frame) \
+    ((sequence)->output_file_names[frame])
+
+/* function prototypes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+DeVAS_sequence	    *DeVAS_sequence_from_pattern ( char *input_pattern,
+			char *output_pattern, int first, int last );
+DeVAS_sequence	    *DeVAS_sequence_from_list ( char *list_file_name );
+void		    DeVAS_sequence_delete ( DeVAS_sequence *sequence );
+void		    DeVAS_sequence_read_start ( DeVAS_sequence *sequence,
+			int frame, DeVAS_luminance_stats *stats );
+DeVAS_xyY_image	    *DeVAS_sequence_read_finish ( DeVAS_sequence *sequence );
+void		    DeVAS_sequence_write_start ( DeVAS_sequence *sequence,
+			int frame, DeVAS_xyY_image *image );
+void		    DeVAS_sequence_write_finish ( DeVAS_sequence *sequence );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DeVAS_SEQUENCE_H */
@@ -0,0 +1,743 @@
+/*
+ * Run command line jobs received on a Unix domain socket, using a pool of
+ * long-lived worker processes.  Used by devas-visibility --server.
+ *
+ * A client connects to the socket and sends one job description, a JSON
+ * object such as
+ *
+ *   { "args": [ "--mild", "--printaverage", "input.hdr", ... ],
+ *     "cwd": "/path/to/job" }
+ *
+ * "args" holds the command line arguments (without the program name),
+ * exactly as they would be given to the program.  "cwd", if present, is
+ * the directory relative file names are resolved against.  Anything the
+ * job writes to stdout or stderr is sent back over the connection,
+ * followed by a final line
+ *
+ *   {"status": <exit status>}
+ *
+ * after which the connection is closed.
+ *
+ * Each worker process accepts connections from the shared listening
+ * socket and runs one job at a time, in process, using n_threads OpenMP
+ * threads so that the workers together don't oversubscribe the
+ * processors.  A client that doesn't send a complete job description
+ * within SERVER_REQUEST_TIMEOUT seconds is sent a failure status, so
+ * that it can't hold on to a worker.  Workers persist across
+ * jobs, so that state cached by the job code (FFTW plans, parsed geometry)
+ * is reused.  Library routines call exit ( ) on errors.  A worker that
+ * exits reports a failure status to its client and is replaced by the
+ * supervising process, as is a worker that has run SERVER_JOBS_PER_WORKER
+ * jobs.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif	/* _OPENMP */
+#include "devas-server.h"
+#include "devas-image.h"
+#include "devas-license.h"	/* DeVAS open source license */
+
+typedef struct {
+    char    *text;
+    int	    position;
+} Json_input;
+
+static pid_t	start_worker ( int listen_fd, int n_threads, char *job_name,
+		    DeVAS_server_job job );
+static void	worker ( int listen_fd, int n_threads, char *job_name,
+		    DeVAS_server_job job );
+static void	run_job ( int connection, char *job_name,
+		    DeVAS_server_job job );
+static char	*read_request ( int connection );
+static int	parse_job ( char *request, char *job_name, int *argc_p,
+		    char ***argv_p, char **cwd_p );
+static void	json_skip_space ( Json_input *input );
+static char	*json_parse_string ( Json_input *input );
+static void	free_job ( int argc, char **argv, char *cwd );
+static char	*string_copy ( char *string );
+static void	reply_status ( int connection, int status, char *error );
+static void	report_exit ( void );
+static void	stop_handler ( int signal_number );
+
+static volatile sig_atomic_t	server_stop = FALSE;
+static int			job_connection = -1;	/* job in progress */
+
+int
+DeVAS_server ( char *socket_path, int n_workers, int n_threads,
+	char *job_name, DeVAS_server_job job )
+/*
+ * Listen on socket_path and run jobs with n_workers worker processes, each
+ * using n_threads threads, until interrupted (SIGINT or SIGTERM).  Returns
+ * exit status.
+ */
+{
+    int			listen_fd;
+    struct sockaddr_un	address;
+    struct stat		file_status;
+    struct sigaction	action;
+    pid_t		*workers;
+    pid_t		pid;
+    int			status;
+    int			i;
+
+    if ( n_workers < 1 ) {
+	fprintf ( stderr, "DeVAS_server: invalid number of workers (%d)!\n",
+		n_workers );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	return ( EXIT_FAILURE );
+    }
+
+    if ( n_threads < 1 ) {
+	fprintf ( stderr, "DeVAS_server: invalid number of threads (%d)!\n",
+		n_threads );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	return ( EXIT_FAILURE );
+    }
+
+    if ( strlen ( socket_path ) >= sizeof ( address.sun_path ) ) {
+	fprintf ( stderr, "DeVAS_server: socket path too long (%s)!\n",
+		socket_path );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	return ( EXIT_FAILURE );
+    }
+
+    /* remove a socket left by a previous server, but nothing else */
+    if ( ( lstat ( socket_path, &file_status ) == 0 ) &&
+	    S_ISSOCK ( file_status.st_mode ) ) {
+	unlink ( socket_path );
+    }
+
+    listen_fd = socket ( AF_UNIX, SOCK_STREAM, 0 );
+    if ( listen_fd < 0 ) {
+	perror ( "DeVAS_server: socket" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	return ( EXIT_FAILURE );
+    }
+
+    memset ( &address, 0, sizeof ( address ) );
+    address.sun_family = AF_UNIX;
+    strcpy ( address.sun_path, socket_path );
+
+    if ( ( bind ( listen_fd, (struct sockaddr *) &address,
+		    sizeof ( address ) ) != 0 ) ||
+	    ( listen ( listen_fd, SOMAXCONN ) != 0 ) ) {
+	perror ( socket_path );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	close ( listen_fd );
+	return ( EXIT_FAILURE );
+    }
+
+    /* a client that goes away shouldn't kill the worker writing to it */
+    signal ( SIGPIPE, SIG_IGN );
+
+    workers = (pid_t *) malloc ( n_workers * sizeof ( pid_t ) );
+    if ( workers == NULL ) {
+	fprintf ( stderr, "DeVAS_server: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    for ( i = 0; i < n_workers; i++ ) {
+	workers[i] = start_worker ( listen_fd, n_threads, job_name, job );
+    }
+
+    memset ( &action, 0, sizeof ( action ) );
+    action.sa_handler = stop_handler;
+    sigemptyset ( &action.sa_mask );
+    action.sa_flags = 0;	/* no SA_RESTART, so waitpid ( ) returns */
+    sigaction ( SIGINT, &action, NULL );
+    sigaction ( SIGTERM, &action, NULL );
+
+    fprintf ( stderr, "%s: listening on %s with %d worker%s of %d thread%s\n",
+	    job_name, socket_path, n_workers, ( n_workers == 1 ) ? "" : "s",
+	    n_threads, ( n_threads == 1 ) ? "" : "s" );
+
+    /* replace workers as they exit */
+    while ( ! server_stop ) {
+	pid = waitpid ( -1, &status, 0 );
+	if ( pid < 0 ) {
+	    if ( errno == EINTR ) {
+		continue;
+	    }
+	    perror ( "DeVAS_server: waitpid" );
+	    break;
+	}
+
+	for ( i = 0; i < n_workers; i++ ) {
+	    if ( workers[i] == pid ) {
+		workers[i] = server_stop ? -1 :
+		    start_worker ( listen_fd, n_threads, job_name, job );
+		break;
+	    }
+	}
+    }
+
+    /* shut down */
+    for ( i = 0; i < n_workers; i++ ) {
+	if ( workers[i] > 0 ) {
+	    kill ( workers[i], SIGTERM );
+	}
+    }
+    while ( ( wait ( NULL ) > 0 ) || ( errno == EINTR ) ) {
+	continue;
+    }
+
+    close ( listen_fd );
+    unlink ( socket_path );
+    free ( workers );
+
+    return ( EXIT_SUCCESS );
+}
+
+static pid_t
+start_worker ( int listen_fd, int n_threads, char *job_name,
+	DeVAS_server_job job )
+{
+    pid_t   pid;
+
+    /* so buffered output isn't written by both processes */
+    fflush ( stdout );
+    fflush ( stderr );
+
+    pid = fork ( );
+    if ( pid < 0 ) {
+	perror ( "DeVAS_server: fork" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    if ( pid == 0 ) {
+	signal ( SIGINT, SIG_DFL );
+	signal ( SIGTERM, SIG_DFL );
+	worker ( listen_fd, n_threads, job_name, job ); /* doesn't return */
+    }
+
+    return ( pid );
+}
+
+static void
+worker ( int listen_fd, int n_threads, char *job_name, DeVAS_server_job job )
+{
+    int		    connection;
+    struct timeval  timeout;
+    int		    n_jobs;
+
+    atexit ( report_exit );
+
+#ifdef _OPENMP
+    omp_set_num_threads ( n_threads );
+#else
+    (void) n_threads;
+#endif	/* _OPENMP */
+
+    timeout.tv_sec = SERVER_REQUEST_TIMEOUT;
+    timeout.tv_usec = 0;
+
+    n_jobs = 0;
+    while ( n_jobs < SERVER_JOBS_PER_WORKER ) {
+	connection = accept ( listen_fd, NULL, NULL );
+	if ( connection < 0 ) {
+	    if ( ( errno == EINTR ) || ( errno == ECONNABORTED ) ) {
+		continue;
+	    }
+	    perror ( "DeVAS_server: accept" );
+	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	    exit ( EXIT_FAILURE );
+	}
+
+	/* so read_request ( ) gives up on a client that stops sending */
+	if ( setsockopt ( connection, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+		    sizeof ( timeout ) ) != 0 ) {
+	    perror ( "DeVAS_server: setsockopt" );
+	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	    exit ( EXIT_FAILURE );
+	}
+
+	run_job ( connection, job_name, job );
+	close ( connection );
+	n_jobs++;
+    }
+
+    exit ( EXIT_SUCCESS );
+}
+
+static void
+run_job ( int connection, char *job_name, DeVAS_server_job job )
+/*
+ * Read a job description from connection, run it with stdout and stderr
+ * redirected to connection, and send back the exit status.
+ */
+{
+    char    *request;
+    int	    job_argc;
+    char    **job_argv;
+    char    *cwd;
+    int	    saved_cwd;
+    int	    saved_stdout, saved_stderr;
+    int	    status;
+
+    request = read_request ( connection );
+    if ( request == NULL ) {
+	reply_status ( connection, EXIT_FAILURE,
+		"unreadable job description" );
+	return;
+    }
+
+    if ( ! parse_job ( request, job_name, &job_argc, &job_argv, &cwd ) ) {
+	free ( request );
+	reply_status ( connection, EXIT_FAILURE, "invalid job description" );
+	return;
+    }
+    free ( request );
+
+    saved_cwd = -1;
+    if ( cwd != NULL ) {
+	saved_cwd = open ( ".", O_RDONLY );
+	if ( ( saved_cwd < 0 ) || ( chdir ( cwd ) != 0 ) ) {
+	    if ( saved_cwd >= 0 ) {
+		close ( saved_cwd );
+	    }
+	    free_job ( job_argc, job_argv, cwd );
+	    reply_status ( connection, EXIT_FAILURE, "can't change to cwd" );
+	    return;
+	}
+    }
+
+    /* job output goes to the client */
+    fflush ( stdout );
+    fflush ( stderr );
+    saved_stdout = dup ( STDOUT_FILENO );
+    saved_stderr = dup ( STDERR_FILENO );
+    dup2 ( connection, STDOUT_FILENO );
+    dup2 ( connection, STDERR_FILENO );
+    job_connection = connection;
+
+    status = ( *job ) ( job_argc, job_argv );
+
+    fflush ( stdout );
+    fflush ( stderr );
+    job_connection = -1;
+    dup2 ( saved_stdout, STDOUT_FILENO );
+    dup2 ( saved_stderr, STDERR_FILENO );
+    close ( saved_stdout );
+    close ( saved_stderr );
+
+    if ( saved_cwd >= 0 ) {
+	if ( fchdir ( saved_cwd ) != 0 ) {
+	    perror ( "DeVAS_server: fchdir" );
+	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	    exit ( EXIT_FAILURE );	/* worker will be replaced */
+	}
+	close ( saved_cwd );
+    }
+
+    free_job ( job_argc, job_argv, cwd );
+
+    reply_status ( connection, status, NULL );
+}
+
+static char *
+read_request ( int connection )
+/*
+ * Read a JSON object from connection, stopping at its closing brace or at
+ * end of file.  Returns NULL on error, if the request is too long, or if
+ * the client sends nothing for SERVER_REQUEST_TIMEOUT seconds.
+ */
+{
+    char    *request;
+    char    *new_request;
+    int	    size, length;
+    ssize_t n_read;
+    int	    i;
+    int	    in_string, escape;
+    int	    depth, started;
+
+    size = 4096;
+    length = 0;
+    request = (char *) malloc ( size );
+    if ( request == NULL ) {
+	return ( NULL );
+    }
+
+    in_string = escape = FALSE;
+    depth = 0;
+    started = FALSE;
+
+    for ( ;; ) {
+	if ( length == size - 1 ) {
+	    if ( size >= SERVER_REQUEST_MAX ) {
+		free ( request );
+		return ( NULL );
+	    }
+	    size *= 2;
+	    new_request = (char *) realloc ( request, size );
+	    if ( new_request == NULL ) {
+		free ( request );
+		return ( NULL );
+	    }
+	    request = new_request;
+	}
+
+	n_read = read ( connection, request + length, size - 1 - length );
+	if ( n_read < 0 ) {
+	    if ( errno == EINTR ) {
+		continue;
+	    }
+	    free ( request );
+	    return ( NULL );
+	}
+	if ( n_read == 0 ) {
+	    break;		/* end of file */
+	}
+
+	/* track nesting, so we know when the object is complete */
+	for ( i = length; i < length + n_read; i++ ) {
+	    if ( in_string ) {
+		if ( escape ) {
+		    escape = FALSE;
+		} else if ( request[i] == '\\' ) {
+		    escape = TRUE;
+		} else if ( request[i] == '"' ) {
+		    in_string = FALSE;
+		}
+	    } else if ( request[i] == '"' ) {
+		in_string = TRUE;
+	    } else if ( ( request[i] == '{' ) || ( request[i] == '[' ) ) {
+		depth++;
+		started = TRUE;
+	    } else if ( ( request[i] == '}' ) || ( request[i] == ']' ) ) {
+		depth--;
+	    }
+	}
+	length += n_read;
+
+	if ( started && ( depth <= 0 ) ) {
+	    break;
+	}
+    }
+
+    request[length] = '\0';
+
+    return ( request );
+}
+
+static int
+parse_job ( char *request, char *job_name, int *argc_p, char ***argv_p,
+	char **cwd_p )
+/*
+ * Parse a job description.  Returns TRUE on success, with *argv_p,
+ * *cwd_p, and the strings they point to malloc'ed.
+ */
+{
+    Json_input	input;
+    char	*key;
+    char	*value;
+    char	**argv;
+    char	**new_argv;
+    int		argc;
+    int		args_found;
+    char	*cwd;
+
+    input.text = request;
+    input.position = 0;
+
+    argc = 1;
+    argv = (char **) malloc ( 2 * sizeof ( char * ) );
+    if ( argv == NULL ) {
+	return ( FALSE );
+    }
+    argv[0] = string_copy ( job_name );
+    argv[1] = NULL;
+    args_found = FALSE;
+    cwd = NULL;
+
+    json_skip_space ( &input );
+    if ( input.text[input.position] != '{' ) {
+	free_job ( argc, argv, cwd );
+	return ( FALSE );
+    }
+    input.position++;
+
+    json_skip_space ( &input );
+    while ( input.text[input.position] != '}' ) {
+
+	key = json_parse_string ( &input );
+	json_skip_space ( &input );
+	if ( ( key == NULL ) || ( input.text[input.position] != ':' ) ) {
+	    free ( key );
+	    free_job ( argc, argv, cwd );
+	    return ( FALSE );
+	}
+	input.position++;
+	json_skip_space ( &input );
+
+	if ( ( strcmp ( key, "args" ) == 0 ) && ! args_found &&
+		( input.text[input.position] == '[' ) ) {
+	    args_found = TRUE;
+	    input.position++;
+	    json_skip_space ( &input );
+	    while ( input.text[input.position] != ']' ) {
+		value = json_parse_string ( &input );
+		if ( value == NULL ) {
+		    free ( key );
+		    free_job ( argc, argv, cwd );
+		    return ( FALSE );
+		}
+		new_argv = (char **) realloc ( argv,
+			( argc + 2 ) * sizeof ( char * ) );
+		if ( new_argv == NULL ) {
+		    free ( value );
+		    free ( key );
+		    free_job ( argc, argv, cwd );
+		    return ( FALSE );
+		}
+		argv = new_argv;
+		argv[argc++] = value;
+		argv[argc] = NULL;
+
+		json_skip_space ( &input );
+		if ( input.text[input.position] == ',' ) {
+		    input.position++;
+		    json_skip_space ( &input );
+		} else if ( input.text[input.position] != ']' ) {
+		    free ( key );
+		    free_job ( argc, argv, cwd );
+		    return ( FALSE );
+		}
+	    }
+	    input.position++;
+	} else if ( ( strcmp ( key, "cwd" ) == 0 ) && ( cwd == NULL ) ) {
+	    cwd = json_parse_string ( &input );
+	    if ( cwd == NULL ) {
+		free ( key );
+		free_job ( argc, argv, cwd );
+		return ( FALSE );
+	    }
+	} else {
+	    /* unknown or repeated key, or wrong type of value */
+	    free ( key );
+	    free_job ( argc, argv, cwd );
+	    return ( FALSE );
+	}
+	free ( key );
+
+	json_skip_space ( &input );
+	if ( input.text[input.position] == ',' ) {
+	    input.position++;
+	    json_skip_space ( &input );
+	} else if ( input.text[input.position] != '}' ) {
+	    free_job ( argc, argv, cwd );
+	    return ( FALSE );
+	}
+    }
+
+    if ( ! args_found ) {
+	free_job ( argc, argv, cwd );
+	return ( FALSE );
+    }
+
+    *argc_p = argc;
+    *argv_p = argv;
+    *cwd_p = cwd;
+
+    return ( TRUE );
+}
+
+static void
+json_skip_space ( Json_input *input )
+{
+    while ( ( input->text[input->position] == ' ' ) ||
+	    ( input->text[input->position] == '\t' ) ||
+	    ( input->text[input->position] == '\n' ) ||
+	    ( input->text[input->position] == '\r' ) ) {
+	input->position++;
+    }
+}
+
+static char *
+json_parse_string ( Json_input *input )
+/*
+ * Parse a JSON string, returning its value in a malloc'ed string, or NULL
+ * if the input is not a valid string.  \u escapes are converted to UTF-8.
+ */
+{
+    char	    *value;
+    int		    length;
+    int		    c;
+    unsigned int    code_point;
+    int		    i;
+
+    if ( input->text[input->position] != '"' ) {
+	return ( NULL );
+    }
+    input->position++;
+
+    /* the value is never longer than its representation */
+    value = (char *) malloc ( strlen ( input->text + input->position ) + 1 );
+    if ( value == NULL ) {
+	return ( NULL );
+    }
+
+    length = 0;
+    for ( ;; ) {
+	c = (unsigned char) input->text[input->position++];
+
+	if ( c == '"' ) {
+	    break;
+	} else if ( c < ' ' ) {		/* includes end of input */
+	    free ( value );
+	    return ( NULL );
+	} else if ( c != '\\' ) {
+	    value[length++] = c;
+	    continue;
+	}
+
+	c = input->text[input->position++];
+	switch ( c ) {
+	    case '"':
+	    case '\\':
+	    case '/':
+		value[length++] = c;
+		break;
+
+	    case 'b':
+		value[length++] = '\b';
+		break;
+
+	    case 'f':
+		value[length++] = '\f';
+		break;
+
+	    case 'n':
+		value[length++] = '\n';
+		break;
+
+	    case 'r':
+		value[length++] = '\r';
+		break;
+
+	    case 't':
+		value[length++] = '\t';
+		break;
+
+	    case 'u':
+		code_point = 0;
+		for ( i = 0; i < 4; i++ ) {
+		    c = input->text[input->position++];
+		    code_point <<= 4;
+		    if ( ( c >= '0' ) && ( c <= '9' ) ) {
+			code_point += c - '0';
+		    } else if ( ( c >= 'a' ) && ( c <= 'f' ) ) {
+			code_point += c - 'a' + 10;
+		    } else if ( ( c >= 'A' ) && ( c <= 'F' ) ) {
+			code_point += c - 'A' + 10;
+		    } else {
+			free ( value );
+			return ( NULL );
+		    }
+		}
+		if ( code_point == 0 ) {
+		    free ( value );	/* can't be part of a C string */
+		    return ( NULL );
+		} else if ( code_point < 0x80 ) {
+		    value[length++] = code_point;
+		} else if ( code_point < 0x800 ) {
+		    value[length++] = 0xc0 | ( code_point >> 6 );
+		    value[length++] = 0x80 | ( code_point & 0x3f );
+		} else {
+		    value[length++] = 0xe0 | ( code_point >> 12 );
+		    value[length++] = 0x80 | ( ( code_point >> 6 ) & 0x3f );
+		    value[length++] = 0x80 | ( code_point & 0x3f );
+		}
+		break;
+
+	    default:
+		free ( value );
+		return ( NULL );
+	}
+    }
+
+    value[length] = '\0';
+
+    return ( value );
+}
+
+static void
+free_job ( int argc, char **argv, char *cwd )
+{
+    int	    i;
+
+    for ( i = 0; i < argc; i++ ) {
+	free ( argv[i] );
+    }
+    free ( argv );
+    free ( cwd );
+}
+
+static char *
+string_copy ( char *string )
+{
+    char    *copy;
+
+    copy = (char *) malloc ( strlen ( string ) + 1 );
+    if ( copy == NULL ) {
+	fprintf ( stderr, "DeVAS_server: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+    strcpy ( copy, string );
+
+    return ( copy );
+}
+
+static void
+reply_status ( int connection, int status, char *error )
+{
+    char    reply[256];
+
+    if ( error != NULL ) {
+	snprintf ( reply, sizeof ( reply ),
+		"{\"status\": %d, \"error\": \"%s\"}\n", status, error );
+    } else {
+	snprintf ( reply, sizeof ( reply ), "{\"status\": %d}\n", status );
+    }
+
+    if ( write ( connection, reply, strlen ( reply ) ) < 0 ) {
+	/* client has gone away, so there's no one to tell */
+    }
+}
+
+static void
+report_exit ( void )
+/*
+ * atexit ( ) handler for workers.  Library routines call exit ( ) on
+ * errors, so this is how such failures are reported to the client.
+ */
+{
+    if ( job_connection >= 0 ) {
+	fflush ( stdout );
+	fflush ( stderr );
+	reply_status ( job_connection, EXIT_FAILURE, NULL );
+	job_connection = -1;
+    }
+}
+
+static void
+stop_handler ( int signal_number )
+{
+    server_stop = TRUE;
+}
@@ -0,0 +1,34 @@
+/*
+ * Run command line jobs received on a Unix domain socket, using a pool of
+ * long-lived worker processes.
+ */
+
+#ifndef __DeVAS_SERVER_H
+#define __DeVAS_SERVER_H
+
+#define	SERVER_JOBS_PER_WORKER	200	/* worker is replaced after this */
+					/* many jobs, bounding any leaks */
+#define	SERVER_REQUEST_MAX	(1024 * 1024)	/* bytes */
+#define	SERVER_REQUEST_TIMEOUT	30	/* seconds allowed for a client to */
+					/* send its job description */
+
+/*
+ * A job is run as ( *job ) ( argc, argv ), with argv[0] set to the
+ * job_name passed to DeVAS_server ( ).  Returns exit status.
+ */
+typedef int	( *DeVAS_server_job ) ( int argc, char *argv[] );
+
+/* function prototypes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int		    DeVAS_server ( char *socket_path, int n_workers,
+			int n_threads, char *job_name, DeVAS_server_job job );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DeVAS_SERVER_H */
@@ -0,0 +1,372 @@
+/*
+ * On-disk cache of precomputed filter tables.
+ *
+ * Each table is stored in its own file in the cache directory, named by
+ * the kind of table, its size, and the exact (hexadecimal floating point)
+ * values of the parameters it was computed from.  The file starts with a
+ * header repeating this information, followed by the table values in
+ * row order.  Cached tables are memory mapped read only, so a lookup
+ * costs only the page faults of the values actually used, and any
+ * attempt to modify a cached table is caught.
+ *
+ * A file that is missing, the wrong size, or whose header does not match
+ * is treated as a miss, and the table is recomputed and stored again.
+ * Files are written under a temporary name and then renamed, so
+ * concurrent runs sharing a cache directory never see a partial table.
+ * Failure to write the cache is reported, but is not an error.  A cache
+ * directory that can't be created is reported once and disables the
+ * cache, and one that can't be written is used read only.
+ *
+ * Memory mapping is not available on Windows, where the cache is
+ * disabled.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif	/* _WIN32 */
+#include "devas-table-cache.h"
+#include "devas-image.h"
+#include "devas-utils.h"
+#include "devas-license.h"	/* DeVAS open source license */
+
+#define	TABLE_CACHE_MAGIC	"DeVAStbl"
+#define	TABLE_CACHE_VERSION	1	/* increment if table contents change */
+#define	TABLE_CACHE_BYTE_ORDER	0x01020304
+#define	TABLE_CACHE_NAME_MAX	1024
+
+typedef struct {
+    char	magic[8];
+    int32_t	version;
+    int32_t	byte_order;	/* TABLE_CACHE_BYTE_ORDER as written */
+    int32_t	n_rows, n_cols;
+    int32_t	n_parameters;
+    int32_t	unused;
+    double	parameters[DeVAS_TABLE_CACHE_MAX_PARAMETERS];
+} Table_header;
+
+typedef struct Mapped_table {
+    DeVAS_float_image	*table;
+    void		*map;
+    size_t		length;
+    struct Mapped_table	*next;
+} Mapped_table;
+
+static char		*cache_directory = NULL;
+static int		cache_read_only = FALSE;	/* can't store */
+static Mapped_table	*mapped_tables = NULL;
+
+#ifndef _WIN32
+static void		table_file_name ( char *file_name, char *kind,
+			    int n_rows, int n_cols, int n_parameters,
+			    double *parameters );
+static void		make_header ( Table_header *header, int n_rows,
+			    int n_cols, int n_parameters, double *parameters );
+#endif	/* _WIN32 */
+
+void
+DeVAS_table_cache_set_directory ( char *directory )
+/*
+ * Use directory (created if it does not exist) for subsequent loads and
+ * stores.  NULL disables the cache, which is the default.  If directory
+ * can't be created, a warning is printed and the cache is left disabled.
+ * If it can't be written, tables already in it are loaded but new ones
+ * are not stored.
+ */
+{
+#ifndef _WIN32
+    struct stat	    directory_stat;
+#endif	/* _WIN32 */
+
+    if ( cache_directory != NULL ) {
+	free ( cache_directory );
+	cache_directory = NULL;
+    }
+    cache_read_only = FALSE;
+
+    if ( directory == NULL ) {
+	return;
+    }
+
+#ifndef _WIN32
+    if ( ( mkdir ( directory, 0777 ) != 0 ) && ( errno != EEXIST ) ) {
+	perror ( directory );
+	fprintf ( stderr,
+		"DeVAS_table_cache_set_directory: tables not cached\n" );
+	return;
+    }
+
+    if ( ( stat ( directory, &directory_stat ) != 0 ) ||
+	    !S_ISDIR ( directory_stat.st_mode ) ) {
+	fprintf ( stderr, "DeVAS_table_cache_set_directory: %s is not a "
+		"directory, tables not cached\n", directory );
+	return;
+    }
+
+    if ( access ( directory, W_OK | X_OK ) != 0 ) {
+	perror ( directory );
+	fprintf ( stderr, "DeVAS_table_cache_set_directory: cached tables "
+		"used, new ones not stored\n" );
+	cache_read_only = TRUE;
+    }
+
+    cache_directory = strdup ( directory );
+    if ( cache_directory == NULL ) {
+	fprintf ( stderr, "DeVAS_table_cache_set_directory: strdup failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+#else
+    fprintf ( stderr,
+	    "DeVAS_table_cache_set_directory: not supported on Windows!\n" );
+#endif	/* _WIN32 */
+}
+
+char *
+DeVAS_table_cache_directory ( void )
+{
+    return ( cache_directory );
+}
+
+DeVAS_float_image *
+DeVAS_table_cache_load ( char *kind, int n_rows, int n_cols,
+	int n_parameters, double *parameters )
+/*
+ * Cached n_rows x n_cols table of the given kind computed from
+ * parameters, or NULL if it is not in the cache (or the cache is
+ * disabled).  The table is read only, and must be freed with
+ * DeVAS_table_cache_release ( ).
+ */
+{
+#ifndef _WIN32
+    DeVAS_float_image	*table;
+    Mapped_table	*mapped;
+    Table_header	expected;
+    char		file_name[TABLE_CACHE_NAME_MAX];
+    struct stat		file_stat;
+    size_t		length;
+    void		*map;
+    int			fd;
+    int			row;
+    VIEW		nullview = NULLVIEW;
+
+    if ( cache_directory == NULL ) {
+	return ( NULL );
+    }
+
+    table_file_name ( file_name, kind, n_rows, n_cols, n_parameters,
+	    parameters );
+    make_header ( &expected, n_rows, n_cols, n_parameters, parameters );
+    length = sizeof ( Table_header ) +
+	( ( (size_t) n_rows ) * n_cols * sizeof ( float ) );
+
+    fd = open ( file_name, O_RDONLY );
+    if ( fd < 0 ) {
+	return ( NULL );	/* not cached yet */
+    }
+
+    if ( ( fstat ( fd, &file_stat ) != 0 ) ||
+	    ( file_stat.st_size != (off_t) length ) ) {
+	close ( fd );
+	return ( NULL );	/* stale or partial */
+    }
+
+    map = mmap ( NULL, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close ( fd );
+    if ( map == MAP_FAILED ) {
+	return ( NULL );
+    }
+
+    if ( memcmp ( map, &expected, sizeof ( Table_header ) ) != 0 ) {
+	munmap ( map, length );
+	return ( NULL );	/* different version or parameters */
+    }
+
+    table = (DeVAS_float_image *) malloc ( sizeof ( DeVAS_float_image ) );
+    mapped = (Mapped_table *) malloc ( sizeof ( Mapped_table ) );
+    if ( ( table == NULL ) || ( mapped == NULL ) ) {
+	fprintf ( stderr, "DeVAS_table_cache_load: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    table->n_rows = n_rows;
+    table->n_cols = n_cols;
+    table->exposure_set = FALSE;
+    table->exposure = 1.0;
+    table->image_info.view = nullview;
+    table->image_info.description = NULL;
+    table->start_data = (float *) ( ( (char *) map ) +
+	    sizeof ( Table_header ) );
+    table->data = (float **) malloc ( n_rows * sizeof ( float * ) );
+    if ( table->data == NULL ) {
+	fprintf ( stderr, "DeVAS_table_cache_load: malloc failed!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+    for ( row = 0; row < n_rows; row++ ) {
+	table->data[row] = table->start_data + ( ( (size_t) row ) * n_cols );
+    }
+
+    mapped->table = table;
+    mapped->map = map;
+    mapped->length = length;
+    mapped->next = mapped_tables;
+    mapped_tables = mapped;
+
+    return ( table );
+#else
+    return ( NULL );
+#endif	/* _WIN32 */
+}
+
+void
+DeVAS_table_cache_store ( char *kind, DeVAS_float_image *table,
+	int n_parameters, double *parameters )
+/*
+ * Add table of the given kind computed from parameters to the cache (if
+ * enabled), replacing any existing entry.
+ */
+{
+#ifndef _WIN32
+    Table_header    header;
+    char	    file_name[TABLE_CACHE_NAME_MAX];
+    char	    temp_file_name[TABLE_CACHE_NAME_MAX + 32];
+    FILE	    *table_file;
+    size_t	    n_values;
+    int		    row;
+    int		    ok;
+
+    if ( ( cache_directory == NULL ) || cache_read_only ) {
+	return;
+    }
+
+    table_file_name ( file_name, kind, DeVAS_image_n_rows ( table ),
+	    DeVAS_image_n_cols ( table ), n_parameters, parameters );
+    make_header ( &header, DeVAS_image_n_rows ( table ),
+	    DeVAS_image_n_cols ( table ), n_parameters, parameters );
+    snprintf ( temp_file_name, TABLE_CACHE_NAME_MAX + 32, "%s.%d.tmp",
+	    file_name, (int) getpid ( ) );
+
+    table_file = fopen ( temp_file_name, "wb" );
+    if ( table_file == NULL ) {
+	perror ( temp_file_name );
+	fprintf ( stderr, "DeVAS_table_cache_store: table not cached\n" );
+	return;
+    }
+
+    n_values = DeVAS_image_n_cols ( table );
+    ok = ( fwrite ( &header, sizeof ( Table_header ), 1, table_file ) == 1 );
+    for ( row = 0; ok && ( row < DeVAS_image_n_rows ( table ) ); row++ ) {
+	ok = ( fwrite ( &DeVAS_image_data ( table, row, 0 ), sizeof ( float ),
+		    n_values, table_file ) == n_values );
+    }
+    ok = ( fclose ( table_file ) == 0 ) && ok;
+
+    if ( !ok || ( rename ( temp_file_name, file_name ) != 0 ) ) {
+	perror ( file_name );
+	fprintf ( stderr, "DeVAS_table_cache_store: table not cached\n" );
+	unlink ( temp_file_name );
+    }
+#endif	/* _WIN32 */
+}
+
+void
+DeVAS_table_cache_release ( DeVAS_float_image *table )
+/*
+ * Free a table returned by DeVAS_table_cache_load ( ).  Tables not from
+ * the cache are deleted with DeVAS_float_image_delete ( ), so this can be
+ * used for any table that might have come from the cache.
+ */
+{
+    Mapped_table    **mapped_p;
+    Mapped_table    *mapped;
+
+    for ( mapped_p = &mapped_tables; *mapped_p != NULL;
+	    mapped_p = &( *mapped_p ) -> next ) {
+	if ( ( *mapped_p ) -> table == table ) {
+	    mapped = *mapped_p;
+	    *mapped_p = mapped->next;
+
+#ifndef _WIN32
+	    munmap ( mapped->map, mapped->length );
+#endif	/* _WIN32 */
+	    free ( table->data );
+	    free ( table );
+	    free ( mapped );
+
+	    return;
+	}
+    }
+
+    DeVAS_float_image_delete ( table );
+}
+
+#ifndef _WIN32
+
+static void
+table_file_name ( char *file_name, char *kind, int n_rows, int n_cols,
+	int n_parameters, double *parameters )
+/*
+ * <directory>/<kind>-<n_rows>x<n_cols>[-<parameter>]....tbl, with
+ * parameters printed exactly in hexadecimal floating point.
+ */
+{
+    int	    length;
+    int	    i;
+
+    if ( ( n_parameters < 0 ) ||
+	    ( n_parameters > DeVAS_TABLE_CACHE_MAX_PARAMETERS ) ) {
+	fprintf ( stderr, "DeVAS_table_cache: invalid n_parameters (%d)!\n",
+		n_parameters );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    length = snprintf ( file_name, TABLE_CACHE_NAME_MAX, "%s/%s-%dx%d",
+	    cache_directory, kind, n_rows, n_cols );
+    for ( i = 0; ( i < n_parameters ) && ( length < TABLE_CACHE_NAME_MAX );
+	    i++ ) {
+	length += snprintf ( file_name + length, TABLE_CACHE_NAME_MAX - length,
+		"-%a", parameters[i] );
+    }
+    if ( length < TABLE_CACHE_NAME_MAX ) {
+	length += snprintf ( file_name + length, TABLE_CACHE_NAME_MAX - length,
+		".tbl" );
+    }
+
+    if ( length >= TABLE_CACHE_NAME_MAX ) {
+	fprintf ( stderr, "DeVAS_table_cache: directory name too long!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+}
+
+static void
+make_header ( Table_header *header, int n_rows, int n_cols,
+	int n_parameters, double *parameters )
+{
+    int	    i;
+
+    memset ( header, 0, sizeof ( Table_header ) );	/* compared bytewise */
+
+    memcpy ( header->magic, TABLE_CACHE_MAGIC, sizeof ( header->magic ) );
+    header->version = TABLE_CACHE_VERSION;
+    header->byte_order = TABLE_CACHE_BYTE_ORDER;
+    header->n_rows = n_rows;
+    header->n_cols = n_cols;
+    header->n_parameters = n_parameters;
+    for ( i = 0; i < n_parameters; i++ ) {
+	header->parameters[i] = parameters[i];
+    }
+}
+
+#endif	/* _WIN32 */
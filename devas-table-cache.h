@@ -0,0 +1,35 @@
+/*
+ * On-disk cache of precomputed filter tables (the log2r and CSF weight
+ * tables used by devas_filter ( )), keyed by table size and the
+ * parameters the table was computed from, so that repeated runs at the
+ * same image size can map a table from the cache directory rather than
+ * computing it.
+ */
+
+#ifndef __DeVAS_TABLE_CACHE_H
+#define __DeVAS_TABLE_CACHE_H
+
+#include "devas-image.h"
+
+#define	DeVAS_TABLE_CACHE_MAX_PARAMETERS    8
+
+/* function prototypes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void		    DeVAS_table_cache_set_directory ( char *directory );
+char		    *DeVAS_table_cache_directory ( void );
+DeVAS_float_image   *DeVAS_table_cache_load ( char *kind, int n_rows,
+			int n_cols, int n_parameters, double *parameters );
+void		    DeVAS_table_cache_store ( char *kind,
+			DeVAS_float_image *table, int n_parameters,
+			double *parameters );
+void		    DeVAS_table_cache_release ( DeVAS_float_image *table );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DeVAS_TABLE_CACHE_H */
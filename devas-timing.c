@@ -0,0 +1,318 @@
+/*
+ * Accumulated wall clock time for named processing stages.
+ *
+ * Stages are kept in the order they are first stopped, so a report lists
+ * them in pipeline order.  Times for a stage that is run more than once
+ * (for example, by devas-visibility's false positive computation) are
+ * summed.
+ *
+ * When tracing is enabled, each stop also records an event with the
+ * stage's start time and duration, the bytes held by image objects, and
+ * the peak resident set size of the process, which can be written out in
+ * the Chrome trace event format (viewable with chrome://tracing or
+ * https://ui.perfetto.dev).
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifndef CLOCK_MONOTONIC
+#include <sys/time.h>
+#endif	/* CLOCK_MONOTONIC */
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif	/* _WIN32 */
+#include "devas-timing.h"
+#include "devas-image.h"
+#include "devas-license.h"	/* DeVAS open source license */
+
+typedef struct {
+    char    name[DeVAS_TIMING_NAME_MAX];
+    double  seconds;
+    int	    count;
+} Timing_stage;
+
+typedef struct {
+    char    name[DeVAS_TIMING_NAME_MAX];
+    double  start;		/* seconds since tracing was enabled */
+    double  duration;
+    double  image_bytes;	/* held by image objects at end of stage */
+    double  peak_rss_kb;
+} Timing_event;
+
+#define	TIMING_EVENTS_INITIAL	256	/* event table grows as needed */
+
+static int		timing_enabled = FALSE;
+static Timing_stage	timing_stages[DeVAS_TIMING_MAX_STAGES];
+static int		timing_n_stages = 0;
+
+static int		trace_enabled = FALSE;
+static double		trace_origin = 0.0;
+static Timing_event	*trace_events = NULL;
+static int		trace_n_events = 0;
+static int		trace_max_events = 0;
+
+static void		trace_add_event ( char *stage, double start,
+			    double end );
+
+void
+DeVAS_timing_enable ( int enable )
+{
+    timing_enabled = enable;
+}
+
+int
+DeVAS_timing_enabled ( void )
+{
+    return ( timing_enabled );
+}
+
+void
+DeVAS_timing_reset ( void )
+/*
+ * Discard all recorded stages.
+ */
+{
+    timing_n_stages = 0;
+    trace_n_events = 0;
+}
+
+double
+DeVAS_timing_now ( void )
+/*
+ * Seconds since an arbitrary starting point.
+ */
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec now;
+
+    clock_gettime ( CLOCK_MONOTONIC, &now );
+
+    return ( ( (double) now.tv_sec ) + ( 1.0e-9 * (double) now.tv_nsec ) );
+#else
+    struct timeval  now;
+
+    gettimeofday ( &now, NULL );
+
+    return ( ( (double) now.tv_sec ) + ( 1.0e-6 * (double) now.tv_usec ) );
+#endif	/* CLOCK_MONOTONIC */
+}
+
+double
+DeVAS_timing_start ( void )
+{
+    if ( ! timing_enabled ) {
+	return ( 0.0 );
+    }
+
+    return ( DeVAS_timing_now ( ) );
+}
+
+void
+DeVAS_timing_stop ( char *stage, double start )
+/*
+ * Add the time since start (as returned by DeVAS_timing_start ( )) to the
+ * total for stage.
+ */
+{
+    double  now;
+    double  elapsed;
+    int	    i;
+
+    if ( ! timing_enabled ) {
+	return;
+    }
+
+    now = DeVAS_timing_now ( );
+    elapsed = now - start;
+
+    if ( trace_enabled ) {
+	trace_add_event ( stage, start, now );
+    }
+
+    for ( i = 0; i < timing_n_stages; i++ ) {
+	if ( strcmp ( timing_stages[i].name, stage ) == 0 ) {
+	    timing_stages[i].seconds += elapsed;
+	    timing_stages[i].count++;
+	    return;
+	}
+    }
+
+    if ( timing_n_stages >= DeVAS_TIMING_MAX_STAGES ) {
+	return;		/* table full */
+    }
+
+    strncpy ( timing_stages[timing_n_stages].name, stage,
+	    DeVAS_TIMING_NAME_MAX - 1 );
+    timing_stages[timing_n_stages].name[DeVAS_TIMING_NAME_MAX - 1] = '\0';
+    timing_stages[timing_n_stages].seconds = elapsed;
+    timing_stages[timing_n_stages].count = 1;
+    timing_n_stages++;
+}
+
+void
+DeVAS_timing_stop_indexed ( char *stage, int index, double start )
+/*
+ * Same as DeVAS_timing_stop ( ), for stage "<stage>_<index>".
+ */
+{
+    char    name[DeVAS_TIMING_NAME_MAX];
+
+    if ( ! timing_enabled ) {
+	return;
+    }
+
+    snprintf ( name, DeVAS_TIMING_NAME_MAX, "%s_%d", stage, index );
+
+    DeVAS_timing_stop ( name, start );
+}
+
+int
+DeVAS_timing_n_stages ( void )
+{
+    return ( timing_n_stages );
+}
+
+char *
+DeVAS_timing_stage_name ( int stage )
+{
+    return ( timing_stages[stage].name );
+}
+
+double
+DeVAS_timing_stage_seconds ( int stage )
+{
+    return ( timing_stages[stage].seconds );
+}
+
+int
+DeVAS_timing_stage_count ( int stage )
+{
+    return ( timing_stages[stage].count );
+}
+
+void
+DeVAS_timing_trace_enable ( int enable )
+/*
+ * Start (or stop) recording an event for every stage stopped.  Enabling
+ * tracing also enables timing, and event times are relative to when
+ * tracing was enabled.
+ */
+{
+    if ( enable ) {
+	timing_enabled = TRUE;
+	trace_origin = DeVAS_timing_now ( );
+	trace_n_events = 0;
+    }
+
+    trace_enabled = enable;
+}
+
+double
+DeVAS_timing_peak_rss_kb ( void )
+/*
+ * Peak resident set size of the process, in kilobytes, or 0.0 if not
+ * available.
+ */
+{
+#ifndef _WIN32
+    struct rusage   usage;
+
+    if ( getrusage ( RUSAGE_SELF, &usage ) != 0 ) {
+	return ( 0.0 );
+    }
+
+#ifdef __APPLE__
+    return ( ( (double) usage.ru_maxrss ) / 1024.0 );	/* bytes */
+#else
+    return ( (double) usage.ru_maxrss );		/* kilobytes */
+#endif	/* __APPLE__ */
+#else
+    return ( 0.0 );
+#endif	/* _WIN32 */
+}
+
+void
+DeVAS_timing_write_trace ( char *file_name, char *process_name )
+/*
+ * Write recorded events as Chrome trace event JSON.  Each stage is a
+ * complete ("X") event, with memory use at the end of the stage as a
+ * counter ("C") event.
+ */
+{
+    FILE    *trace_file;
+    int	    i;
+    int	    pid;
+
+#ifndef _WIN32
+    pid = (int) getpid ( );
+#else
+    pid = 1;
+#endif	/* _WIN32 */
+
+    trace_file = fopen ( file_name, "w" );
+    if ( trace_file == NULL ) {
+	perror ( file_name );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+
+    fprintf ( trace_file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n" );
+    for ( i = 0; i < trace_n_events; i++ ) {
+	/* times are in microseconds */
+	fprintf ( trace_file,
+		"{\"name\": \"%s\", \"cat\": \"devas\", \"ph\": \"X\", "
+		"\"ts\": %.1f, \"dur\": %.1f, \"pid\": %d, \"tid\": 0, "
+		"\"args\": {\"image_mb\": %.3f, \"peak_rss_mb\": %.3f}},\n",
+		trace_events[i].name, 1.0e6 * trace_events[i].start,
+		1.0e6 * trace_events[i].duration, pid,
+		trace_events[i].image_bytes / ( 1024.0 * 1024.0 ),
+		trace_events[i].peak_rss_kb / 1024.0 );
+	fprintf ( trace_file,
+		"{\"name\": \"memory\", \"ph\": \"C\", \"ts\": %.1f, "
+		"\"pid\": %d, \"args\": {\"image_mb\": %.3f, "
+		"\"peak_rss_mb\": %.3f}},\n",
+		1.0e6 * ( trace_events[i].start + trace_events[i].duration ),
+		pid, trace_events[i].image_bytes / ( 1024.0 * 1024.0 ),
+		trace_events[i].peak_rss_kb / 1024.0 );
+    }
+    fprintf ( trace_file,
+	    "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, "
+	    "\"args\": {\"name\": \"%s\"}}\n", pid, process_name );
+    fprintf ( trace_file, "]}\n" );
+
+    if ( fclose ( trace_file ) != 0 ) {
+	perror ( file_name );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
+    }
+}
+
+static void
+trace_add_event ( char *stage, double start, double end )
+{
+    Timing_event    *event;
+
+    if ( trace_n_events >= trace_max_events ) {
+	trace_max_events = ( trace_max_events == 0 ) ?
+	    TIMING_EVENTS_INITIAL : 2 * trace_max_events;
+	trace_events = (Timing_event *) realloc ( trace_events,
+		trace_max_events * sizeof ( Timing_event ) );
+	if ( trace_events == NULL ) {
+	    fprintf ( stderr, "DeVAS_timing_stop: realloc failed!\n" );
+	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	    exit ( EXIT_FAILURE );
+	}
+    }
+
+    event = &trace_events[trace_n_events++];
+
+    strncpy ( event->name, stage, DeVAS_TIMING_NAME_MAX - 1 );
+    event->name[DeVAS_TIMING_NAME_MAX - 1] = '\0';
+    event->start = start - trace_origin;
+    event->duration = end - start;
+    event->image_bytes = DeVAS_image_bytes_allocated ( );
+    event->peak_rss_kb = DeVAS_timing_peak_rss_kb ( );
+}
@@ -0,0 +1,52 @@
+/*
+ * Accumulated wall clock time for named processing stages, used by
+ * devas-bench to report where the time in devas_filter ( ) and
+ * devas_visibility ( ) goes, and by --profile=<file> to write a trace of a
+ * run.
+ */
+
+#ifndef __DeVAS_TIMING_H
+#define __DeVAS_TIMING_H
+
+#define	DeVAS_TIMING_MAX_STAGES	64	/* later stages are not recorded */
+#define	DeVAS_TIMING_NAME_MAX	32	/* including terminating '\0' */
+
+/*
+ * Typical use:
+ *
+ *   start = DeVAS_timing_start ( );
+ *   forward_transform ( ... );
+ *   DeVAS_timing_stop ( "forward_transform", start );
+ *
+ * Both are (almost) free when timing is not enabled.  Stages must be
+ * started and stopped outside of parallel regions.
+ */
+
+/* function prototypes */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void		    DeVAS_timing_enable ( int enable );
+int		    DeVAS_timing_enabled ( void );
+void		    DeVAS_timing_reset ( void );
+double		    DeVAS_timing_now ( void );
+double		    DeVAS_timing_start ( void );
+void		    DeVAS_timing_stop ( char *stage, double start );
+void		    DeVAS_timing_stop_indexed ( char *stage, int index,
+			double start );
+int		    DeVAS_timing_n_stages ( void );
+char		    *DeVAS_timing_stage_name ( int stage );
+double		    DeVAS_timing_stage_seconds ( int stage );
+int		    DeVAS_timing_stage_count ( int stage );
+void		    DeVAS_timing_trace_enable ( int enable );
+double		    DeVAS_timing_peak_rss_kb ( void );
+void		    DeVAS_timing_write_trace ( char *file_name,
+			char *process_name );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DeVAS_TIMING_H */
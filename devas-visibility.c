@@ -8,7 +8,10 @@
 #include "devas-canny.h"
 #include "geometry-discontinuities.h"
 #include "dilate.h"
+#include "devas-edge-list.h"
+#include "devas-edge-grid.h"
 #include "devas-png.h"
+#include "devas-timing.h"
 
 /*******************
 #define	DEBUG_HAZARDS		"devas-visibility-debug-hazards.png"
@@ -20,10 +23,13 @@
 
 static DeVAS_float_image *DeVAS_image_xyY_to_Y ( DeVAS_xyY_image *xyY_image );
 static DeVAS_float_image
-		*compute_hazards ( DeVAS_gray_image *standard_boundaries,
-			    DeVAS_float_image *comparison_distance,
+		*compute_hazards ( DeVAS_edge_list *standard_boundaries,
+			    DeVAS_gray_image *comparison_boundaries,
+			    DeVAS_edge_list *comparison_edges,
 			    double degrees_per_pixel );
 
+static DeVAS_nearest_method	nearest_method = DeVAS_NEAREST_AUTO;
+
 DeVAS_float_image *
 devas_visibility ( DeVAS_xyY_image *filtered_image,
 	DeVAS_coordinates *coordinates,
@@ -82,26 +88,31 @@ devas_visibility ( DeVAS_xyY_image *filtered_image,
  */
 {
     DeVAS_float_image	*filtered_image_luminance;
-    DeVAS_float_image	*luminance_edge_distance;
-    DeVAS_float_image	*geometry_edge_distance = NULL;
     DeVAS_float_image	*hazards_image;
+    DeVAS_edge_list	*luminance_edges;
+    DeVAS_edge_list	*geometry_edges;
     double		degrees_per_pixel;
+    double		stage_start;	/* for DeVAS_timing_stop ( ) */
 
     /* pull out luminance channel from devas-filtered output image */
     filtered_image_luminance = DeVAS_image_xyY_to_Y ( filtered_image );
 
     /* find luminance boudaries using (slightly) modified Canny edge detector */
+    stage_start = DeVAS_timing_start ( );
     *luminance_boundaries = devas_canny_autothresh ( filtered_image_luminance,
 	    CANNY_ST_DEV , NULL /* magnitude_p */, NULL /* orientation_p */ );
+    DeVAS_timing_stop ( "canny", stage_start );
 
     /* clean up */
     DeVAS_float_image_delete ( filtered_image_luminance );
 
     /* find geometric boundaries */
+    stage_start = DeVAS_timing_start ( );
     *geometry_boundaries =
 	geometry_discontinuities ( coordinates, xyz, dist, nor,
 		position_patch_size, orientation_patch_size, position_threshold,
 		orientation_threshold );
+    DeVAS_timing_stop ( "geometry_discontinuities", stage_start );
 
     /* consistency check */
     if ( !DeVAS_image_samesize ( *luminance_boundaries,
@@ -111,9 +122,6 @@ devas_visibility ( DeVAS_xyY_image *filtered_image,
 	exit ( EXIT_FAILURE );
     }
 
-    /* squared-distance transform */
-    luminance_edge_distance = dt_euclid_sq ( *luminance_boundaries );
-
     /* conversion factor */
     degrees_per_pixel = fmax ( DeVAS_image_view ( filtered_image ) . vert,
 	    DeVAS_image_view ( filtered_image ) . horiz ) /
@@ -122,24 +130,41 @@ devas_visibility ( DeVAS_xyY_image *filtered_image,
 
     /*
      * Compute distance, represented as a visual angle, from each geometric
-     * boundary pixel to nearest luminance boundary pixel.
+     * boundary pixel to nearest luminance boundary pixel.  Boundaries are
+     * sparse, so only the listed edge pixels are visited.
      */
-    hazards_image = compute_hazards ( *geometry_boundaries,
-	    luminance_edge_distance, degrees_per_pixel );
+    stage_start = DeVAS_timing_start ( );
+    geometry_edges = DeVAS_edge_list_from_gray_image ( *geometry_boundaries );
+    luminance_edges = DeVAS_edge_list_from_gray_image ( *luminance_boundaries );
+
+    hazards_image = compute_hazards ( geometry_edges, *luminance_boundaries,
+	    luminance_edges, degrees_per_pixel );
+    DeVAS_timing_stop ( "compute_hazards", stage_start );
 
     if ( false_positives != NULL ) {
-	geometry_edge_distance = dt_euclid_sq ( *geometry_boundaries );
-	*false_positives = compute_hazards ( *luminance_boundaries,
-		geometry_edge_distance, degrees_per_pixel );
-	DeVAS_float_image_delete ( geometry_edge_distance );
+	stage_start = DeVAS_timing_start ( );
+	*false_positives = compute_hazards ( luminance_edges,
+		*geometry_boundaries, geometry_edges, degrees_per_pixel );
+	DeVAS_timing_stop ( "compute_false_positives", stage_start );
     }
 
     /* clean up */
-    DeVAS_float_image_delete ( luminance_edge_distance );
+    DeVAS_edge_list_delete ( geometry_edges );
+    DeVAS_edge_list_delete ( luminance_edges );
 
     return ( hazards_image );
 }
 
+void
+devas_visibility_set_nearest_method ( DeVAS_nearest_method method )
+/*
+ * Select how devas_visibility ( ) finds distances to the nearest boundary.
+ * Both methods give the same results.  Default is DeVAS_NEAREST_AUTO.
+ */
+{
+    nearest_method = method;
+}
+
 static DeVAS_float_image *
 DeVAS_image_xyY_to_Y ( DeVAS_xyY_image *xyY_image )
 /*
@@ -166,15 +191,19 @@ DeVAS_image_xyY_to_Y ( DeVAS_xyY_image *xyY_image )
 }
 
 static DeVAS_float_image *
-compute_hazards ( DeVAS_gray_image *standard_boundaries,
-	DeVAS_float_image *comparison_distance, double degrees_per_pixel )
+compute_hazards ( DeVAS_edge_list *standard_boundaries,
+	DeVAS_gray_image *comparison_boundaries,
+	DeVAS_edge_list *comparison_edges, double degrees_per_pixel )
 /*
  * Compute distance, represented as a visual angle, from each geometric
  * boundary pixel to nearest luminance boundary pixel.
  *
- * standard_boundaries:	TRUE => pixel is a geometric edge.
+ * standard_boundaries:	Locations of geometric edges.
+ *
+ * comparison_boundaries:
+ * 			TRUE => pixel is a luminance edge.
  *
- * comparison_distance:	Squared distance to nearest luminance edge.
+ * comparison_edges:	Locations of luminance edges.
  *
  * degrees_per_pixel:	Angle in degrees between two horizontally or vertically
  * 			adjacent pixel locations.
@@ -187,9 +216,17 @@ compute_hazards ( DeVAS_gray_image *standard_boundaries,
  */
 {
     int			row, col;
+    int			n_rows, n_cols;
+    int			i;
+    int			use_grid;
+    DeVAS_float_image	*comparison_distance = NULL;
+    DeVAS_edge_grid	*comparison_grid = NULL;
     DeVAS_float_image	*hazards;
 
-    if ( ! DeVAS_image_samesize ( standard_boundaries, comparison_distance ) ) {
+    if ( ( ! DeVAS_edge_list_samesize ( standard_boundaries,
+		    comparison_boundaries ) ) ||
+	    ( ! DeVAS_edge_list_samesize ( comparison_edges,
+		    comparison_boundaries ) ) ) {
 	fprintf ( stderr, "compute_hazards: argument size mismatch!\n" );
 	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
 	exit ( EXIT_FAILURE );
@@ -202,22 +239,66 @@ compute_hazards ( DeVAS_gray_image *standard_boundaries,
 	exit ( EXIT_FAILURE );
     }
 
-    hazards = DeVAS_float_image_new (
-	    	DeVAS_image_n_rows ( standard_boundaries ),
-	    	    DeVAS_image_n_cols ( standard_boundaries ) );
+    n_rows = DeVAS_image_n_rows ( comparison_boundaries );
+    n_cols = DeVAS_image_n_cols ( comparison_boundaries );
+
+    /*
+     * Distances are only needed at the standard boundary pixels.  If there
+     * are few enough of them, searching a grid of bucketed comparison
+     * boundary pixels from each one is cheaper than a distance transform
+     * of the whole image.
+     */
+    switch ( nearest_method ) {
+	case DeVAS_NEAREST_TRANSFORM:
+	    use_grid = FALSE;
+	    break;
+
+	case DeVAS_NEAREST_GRID:
+	    use_grid = TRUE;
+	    break;
+
+	default:
+	    use_grid = DeVAS_edge_grid_preferred ( standard_boundaries,
+		    comparison_edges );
+	    break;
+    }
 
-    for ( row = 0; row < DeVAS_image_n_rows ( standard_boundaries ); row++ ) {
-	for ( col = 0; col < DeVAS_image_n_cols ( standard_boundaries );
-		col++ ) {
-	    if ( DeVAS_image_data ( standard_boundaries, row, col ) ) {
+    if ( use_grid ) {
+	comparison_grid = DeVAS_edge_grid_new ( comparison_edges );
+    } else {
+	/* squared-distance transform */
+	comparison_distance = dt_euclid_sq ( comparison_boundaries );
+    }
+
+    hazards = DeVAS_float_image_new ( n_rows, n_cols );
+
+#pragma omp parallel for private ( col, i )
+    for ( row = 0; row < n_rows; row++ ) {
+	for ( col = 0; col < n_cols; col++ ) {
+	    DeVAS_image_data ( hazards, row, col ) = HAZARD_NO_EDGE;
+	}
+	for ( i = DeVAS_edge_list_row_start ( standard_boundaries, row );
+		i < DeVAS_edge_list_row_end ( standard_boundaries, row );
+		i++ ) {
+	    col = DeVAS_edge_list_col ( standard_boundaries, i );
+	    if ( use_grid ) {
 		DeVAS_image_data ( hazards, row, col ) = degrees_per_pixel *
-		    sqrt ( DeVAS_image_data ( comparison_distance, row, col ) );
+		    sqrt ( DeVAS_edge_grid_nearest_sq ( comparison_grid,
+				row, col ) );
 	    } else {
-		DeVAS_image_data ( hazards, row, col ) = HAZARD_NO_EDGE;
+		DeVAS_image_data ( hazards, row, col ) = degrees_per_pixel *
+		    sqrt ( DeVAS_image_data ( comparison_distance, row,
+				col ) );
 	    }
 	}
     }
 
+    if ( use_grid ) {
+	DeVAS_edge_grid_delete ( comparison_grid );
+    } else {
+	DeVAS_float_image_delete ( comparison_distance );
+    }
+
 #if defined(DEBUG_HAZARDS)
 
     /*
@@ -227,21 +308,17 @@ compute_hazards ( DeVAS_gray_image *standard_boundaries,
     double	    max_hazard;
 
     max_hazard = -2.0;
-    for ( row = 0; row < DeVAS_image_n_rows ( standard_boundaries ); row++ ) {
-	for ( col = 0; col < DeVAS_image_n_cols ( standard_boundaries );
-		col++ ) {
+    for ( row = 0; row < n_rows; row++ ) {
+	for ( col = 0; col < n_cols; col++ ) {
 	    max_hazard =
 		fmax ( max_hazard, DeVAS_image_data ( hazards, row, col ) );
 	}
     }
     fprintf ( stderr, "max_hazard = %f\n", max_hazard );
 
-    display_hazards =
-	DeVAS_gray_image_new ( DeVAS_image_n_rows ( standard_boundaries ),
-		DeVAS_image_n_cols ( standard_boundaries ) );
-    for ( row = 0; row < DeVAS_image_n_rows ( standard_boundaries ); row++ ) {
-	for ( col = 0; col < DeVAS_image_n_cols ( standard_boundaries );
-		col++ ) {
+    display_hazards = DeVAS_gray_image_new ( n_rows, n_cols );
+    for ( row = 0; row < n_rows; row++ ) {
+	for ( col = 0; col < n_cols; col++ ) {
 	    if ( DeVAS_image_data ( hazards, row, col ) == HAZARD_NO_EDGE ) {
 		DeVAS_image_data ( display_hazards, row, col ) = 0;
 	    } else {
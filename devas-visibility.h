@@ -13,6 +13,16 @@
 #define	HAZARD_NO_EDGE		(-1.0)
 #define	HAZARD_NO_EDGE_GRAY	(0)
 
+/*
+ * How distances to the nearest boundary are found.  DeVAS_NEAREST_AUTO
+ * estimates the cost of both methods from the number of boundary pixels.
+ */
+typedef enum {
+    DeVAS_NEAREST_AUTO,
+    DeVAS_NEAREST_TRANSFORM,	/* distance transform of the full image */
+    DeVAS_NEAREST_GRID		/* search of bucketed boundary pixels */
+} DeVAS_nearest_method;
+
 /* function prototypes */
 
 #ifdef __cplusplus
@@ -28,6 +38,8 @@ DeVAS_float_image    *devas_visibility ( DeVAS_xyY_image *filtered_image,
 			DeVAS_gray_image **luminance_boundaries,
 			DeVAS_gray_image **geometry_boundaries,
 			DeVAS_float_image **false_positives );
+void		    devas_visibility_set_nearest_method
+			( DeVAS_nearest_method method );
 
 #ifdef __cplusplus
 }
@@ -21,15 +21,17 @@
 
 /*
  * See Felzenszwalb and Huttenlocher (2012) for the definition of these
- * variables.
+ * variables.  Workspace is allocated per call, so that distance transforms
+ * of different images can be computed concurrently.
  */
-static int	*v;	/* temporary work space */
-static float	*z;	/* temporary work space */
-static float	*f;	/* temporary work space */
-static float	*D_f;	/* temporary work space */
-static float	inf;	/* larger than any valid distance^2 */
+typedef struct {
+    int	    *v;		/* temporary work space */
+    float   *z;		/* temporary work space */
+    float   inf;	/* larger than any valid distance^2 */
+} DT_workspace;
 
-static void	dt_euclid_sq_1d ( int size, float *input, float *output );
+static void	dt_euclid_sq_1d ( int size, float *f, float *D_f,
+		    DT_workspace *workspace );
 
 DeVAS_gray_image *
 DeVAS_gray_dilate ( DeVAS_gray_image *input, double radius )
@@ -126,6 +128,12 @@ dt_euclid_sq_2 ( DeVAS_gray_image *input, DeVAS_float_image *output )
     unsigned int	n_rows, n_cols;
     unsigned int	row, col;
     unsigned int	max_n_rows_n_cols;
+    DT_workspace	workspace;
+    int			*v;
+    float		*z;
+    float		*f;
+    float		*D_f;
+    float		inf;
 
     n_rows = DeVAS_image_n_rows ( input );
     n_cols = DeVAS_image_n_cols ( input );
@@ -156,6 +164,10 @@ dt_euclid_sq_2 ( DeVAS_gray_image *input, DeVAS_float_image *output )
 
     inf = SQ ( n_rows + n_cols + 1 );	/* larger than any valid distance^s */
 
+    workspace.v = v;
+    workspace.z = z;
+    workspace.inf = inf;
+
     for ( row = 0; row < n_rows; row++ ) {
 	for ( col = 0; col < n_cols; col++ ) {
 	    if ( DeVAS_image_data ( input, row, col ) ) {
@@ -172,7 +184,7 @@ dt_euclid_sq_2 ( DeVAS_gray_image *input, DeVAS_float_image *output )
 	    f[row] = DeVAS_image_data ( output, row, col );
 	}
 
-	dt_euclid_sq_1d ( n_rows, f, D_f );
+	dt_euclid_sq_1d ( n_rows, f, D_f, &workspace );
 
 	for ( row = 0; row < n_rows; row++ ) {
 	    DeVAS_image_data ( output, row, col ) = D_f[row];
@@ -185,7 +197,7 @@ dt_euclid_sq_2 ( DeVAS_gray_image *input, DeVAS_float_image *output )
 	    f[col] = DeVAS_image_data ( output, row, col );
 	}
 
-	dt_euclid_sq_1d ( n_cols, f, D_f );
+	dt_euclid_sq_1d ( n_cols, f, D_f, &workspace );
 
 	for ( col = 0; col < n_cols; col++ ) {
 	    DeVAS_image_data ( output, row, col ) = D_f[col];
@@ -199,15 +211,21 @@ dt_euclid_sq_2 ( DeVAS_gray_image *input, DeVAS_float_image *output )
 }
 
 static void
-dt_euclid_sq_1d ( int size, float *f, float *D_f )
+dt_euclid_sq_1d ( int size, float *f, float *D_f, DT_workspace *workspace )
 /*
  * One-dimensional distance transform under the squared Euclidean distance.
  */
 {
     unsigned int    k, q;
     float	    s;
+    int		    *v;
+    float	    *z;
+    float	    inf;
 
     /* images v, z, and D_f preallocated */
+    v = workspace->v;
+    z = workspace->z;
+    inf = workspace->inf;
 
     k = 0;		/* Index of rightmost parabola in lower envelope */
 
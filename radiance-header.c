@@ -77,7 +77,8 @@ DeVAS_read_radiance_header ( FILE *radiance_fp, int *n_rows_p, int *n_cols_p,
  *			exposure_set_p is TRUE.
  *
  * header_text_p:	Header text of original file, except for EXPOSURE
- * 			and VIEW records.
+ * 			and VIEW records.  Allocated with malloc, and
+ * 			owned by the caller.
  *
  * All detected errors are fatal.
  */
@@ -158,6 +159,9 @@ DeVAS_read_radiance_header ( FILE *radiance_fp, int *n_rows_p, int *n_cols_p,
 
     if ( header_text_p != NULL ) {
 	*header_text_p = header_text;
+    } else if ( header_text != NULL ) {
+	free ( header_text );
+	header_text = NULL;
     }
 }
 
@@ -183,10 +187,7 @@ initialize_headline ( void )
     view_set = FALSE;
     indented_view = DeVAS_null_view;
     indented_view_set = FALSE;
-    if ( header_text != NULL ) {
-	free ( header_text );
-    }
-    header_text = NULL;
+    header_text = NULL;		/* previous text belongs to the caller */
     exposure_set = FALSE;
     exposure = 1.0;
 }
@@ -14,7 +14,10 @@
 #include  <math.h>
 #include  "color.h"
 
-#ifdef getc_unlocked		/* avoid horrendous overhead of flockfile */
+#if defined(getc_unlocked) || defined(__GLIBC__) || defined(__APPLE__)
+				/* avoid horrendous overhead of flockfile */
+				/* (glibc and macOS declare getc_unlocked */
+				/* as a function, not a macro) */
 #undef getc
 #undef putc
 #define getc    getc_unlocked
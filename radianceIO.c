@@ -11,6 +11,11 @@
 #include "radiance/view.h"
 #include "devas-license.h"	/* DeVAS open source license */
 
+static void	xyY_to_colr_scanline ( DeVAS_xyY *xyY, int n_cols,
+		    COLR *scanline );
+static void	colr_scanline_to_xyY ( COLR *scanline, int n_cols,
+		    RadianceColorFormat color_format, DeVAS_xyY *xyY );
+
 DeVAS_float_image *
 DeVAS_brightness_image_from_radfilename ( char *filename  )
 /*
@@ -728,6 +733,27 @@ DeVAS_xyY_image_from_radfilename ( char *filename  )
  * Reads Radiance rgbe or xyze file specified by pathname and returns
  * an in-memory xyY image.  A pathname of "-" specifies standard input.
  */
+{
+    return ( DeVAS_xyY_image_from_radfilename_stats ( filename, NULL ) );
+}
+
+DeVAS_xyY_image *
+DeVAS_xyY_image_from_radfile ( FILE *radiance_fp )
+/*
+ * Reads Radiance rgbe or xyze file from an open file descriptor and returns
+ * an in-memory xyY image.
+ */
+{
+    return ( DeVAS_xyY_image_from_radfile_stats ( radiance_fp, NULL ) );
+}
+
+DeVAS_xyY_image *
+DeVAS_xyY_image_from_radfilename_stats ( char *filename,
+	DeVAS_luminance_stats *stats )
+/*
+ * Same as DeVAS_xyY_image_from_radfilename ( ), also adding the luminance
+ * of every pixel to stats (if not NULL).
+ */
 {
     FILE		*radiance_fp;
     DeVAS_xyY_image	*xyY;
@@ -742,87 +768,91 @@ DeVAS_xyY_image_from_radfilename ( char *filename  )
 	}
     }
 
-    xyY = DeVAS_xyY_image_from_radfile ( radiance_fp );
+    xyY = DeVAS_xyY_image_from_radfile_stats ( radiance_fp, stats );
     fclose ( radiance_fp );
 
     return ( xyY );
 }
 
 DeVAS_xyY_image *
-DeVAS_xyY_image_from_radfile ( FILE *radiance_fp )
+DeVAS_xyY_image_from_radfile_stats ( FILE *radiance_fp,
+	DeVAS_luminance_stats *stats )
 /*
- * Reads Radiance rgbe or xyze file from an open file descriptor and returns
- * an in-memory xyY image.
+ * Same as DeVAS_xyY_image_from_radfile ( ), also adding the luminance of
+ * every pixel to stats (if not NULL).
+ *
+ * The encoded scanlines are read first, and then decoded and converted to
+ * xyY row parallel, with statistics gathered for each row as it is
+ * converted.
  */
 {
     DeVAS_xyY_image	*xyY;
-    COLOR		*radiance_scanline;
-    COLOR		XYZ_rad_pixel;
-    DeVAS_XYZ		XYZ_DeVAS_pixel;
+    COLR		*radiance_image;
+    DeVAS_luminance_stats	*partial_stats;
     RadianceColorFormat	color_format;
     VIEW		view;
     int			exposure_set;
     double		exposure;
-    int			row, col;
+    int			row;
     int			n_rows, n_cols;
     char		*description;
 
     DeVAS_read_radiance_header ( radiance_fp, &n_rows, &n_cols,
 	    &color_format, &view, &exposure_set, &exposure, &description );
 
-    radiance_scanline = (COLOR *) malloc ( n_cols * sizeof ( COLOR ) );
-    if ( radiance_scanline == NULL ) {
-	fprintf ( stderr, "DeVAS_xyY_image_from_radfile: malloc failed!\n" );
+    if ( ( color_format != radcolor_rgbe ) &&
+	    ( color_format != radcolor_xyze ) ) {
+	fprintf ( stderr,
+		"DeVAS_XYZ_image_from_radfile: internal error!\n" );
 	exit ( EXIT_FAILURE );
     }
 
-    xyY = DeVAS_xyY_image_new ( n_rows, n_cols );
-    DeVAS_image_view ( xyY ) = view;
-    DeVAS_image_description ( xyY ) = description;
-    DeVAS_image_exposure_set ( xyY ) = exposure_set;
-    DeVAS_image_exposure ( xyY ) = exposure;
+    radiance_image = (COLR *) malloc ( ( (size_t) n_rows ) * n_cols *
+	    sizeof ( COLR ) );
+    if ( radiance_image == NULL ) {
+	fprintf ( stderr, "DeVAS_xyY_image_from_radfile: malloc failed!\n" );
+	exit ( EXIT_FAILURE );
+    }
 
     for ( row = 0; row < n_rows; row++ ) {
-	if ( freadscan( radiance_scanline, n_cols, radiance_fp ) < 0 ) {
+	if ( freadcolrs ( radiance_image + ( ( (size_t) row ) * n_cols ),
+		    n_cols, radiance_fp ) < 0 ) {
 	    fprintf ( stderr,
 		"DeVAS_xyY_image_from_radfile: error reading Radiance file!" );
 	    exit ( EXIT_FAILURE );
 	}
-	if ( color_format == radcolor_rgbe ) {
-	    for ( col = 0; col < n_cols; col++ ) {
-		colortrans ( XYZ_rad_pixel, rgb2xyzmat,
-			radiance_scanline[col] );
+    }
 
-		XYZ_DeVAS_pixel.X =
-		    colval ( XYZ_rad_pixel, CIEX ) * DeVAS_WHTEFFICACY;
-		XYZ_DeVAS_pixel.Y =
-		    colval ( XYZ_rad_pixel, CIEY ) * DeVAS_WHTEFFICACY;
-		XYZ_DeVAS_pixel.Z =
-		    colval ( XYZ_rad_pixel, CIEZ ) * DeVAS_WHTEFFICACY;
+    xyY = DeVAS_xyY_image_new ( n_rows, n_cols );
+    DeVAS_image_view ( xyY ) = view;
+    DeVAS_image_description ( xyY ) = description;
+    DeVAS_image_exposure_set ( xyY ) = exposure_set;
+    DeVAS_image_exposure ( xyY ) = exposure;
 
-		DeVAS_image_data ( xyY, row, col ) =
-		    DeVAS_XYZ2xyY ( XYZ_DeVAS_pixel );
+#pragma omp parallel private ( partial_stats )
+    {
+	partial_stats = ( stats == NULL ) ? NULL :
+	    DeVAS_luminance_stats_new ( );
+
+#pragma omp for
+	for ( row = 0; row < n_rows; row++ ) {
+	    colr_scanline_to_xyY ( radiance_image + ( ( (size_t) row ) * n_cols ),
+		    n_cols, color_format, &DeVAS_image_data ( xyY, row, 0 ) );
+	    if ( partial_stats != NULL ) {
+		DeVAS_luminance_stats_add ( partial_stats,
+			&DeVAS_image_data ( xyY, row, 0 ), n_cols );
 	    }
-	} else if ( color_format == radcolor_xyze ) {
-	    for ( col = 0; col < n_cols; col++ ) {
-		XYZ_DeVAS_pixel.X =
-		    colval ( radiance_scanline[col], CIEX );
-		XYZ_DeVAS_pixel.Y =
-		    colval ( radiance_scanline[col], CIEY );
-		XYZ_DeVAS_pixel.Z =
-		    colval ( radiance_scanline[col], CIEZ );
+	}
 
-		DeVAS_image_data ( xyY, row, col ) =
-		    DeVAS_XYZ2xyY ( XYZ_DeVAS_pixel );
-	    }
-	} else {
-	    fprintf ( stderr,
-		    "DeVAS_XYZ_image_from_radfile: internal error!\n" );
-	    exit ( EXIT_FAILURE );
+	if ( partial_stats != NULL ) {
+#pragma omp critical ( devas_luminance_stats )
+	    DeVAS_luminance_stats_merge ( stats, partial_stats );
+
+	    DeVAS_luminance_stats_delete ( partial_stats );
 	}
     }
 
-    free ( radiance_scanline );
+    free ( radiance_image );
 
     return ( xyY );
 }
@@ -851,18 +881,19 @@ void
 DeVAS_xyY_image_to_radfile ( FILE *radiance_fp, DeVAS_xyY_image *xyY )
 /*
  * For now, only write rgbe format files.
+ *
+ * Each pixel goes from xyY to rgbe in a single pass, with the whole image
+ * converted (row parallel) before any of it is written.
  */
 {
     int			n_rows, n_cols;
-    int			row, col;
+    int			row;
     VIEW		view;
     RadianceColorFormat	color_format;
     int			exposure_set;
     double		exposure;
     char		*description;
-    DeVAS_XYZ		XYZ_DeVAS_pixel;
-    COLOR		XYZ_rad_pixel;
-    COLOR		*radiance_scanline;
+    COLR		*radiance_image;
 
     n_rows = DeVAS_image_n_rows ( xyY );
     n_cols = DeVAS_image_n_cols ( xyY );
@@ -879,32 +910,106 @@ DeVAS_xyY_image_to_radfile ( FILE *radiance_fp, DeVAS_xyY_image *xyY )
     DeVAS_write_radiance_header ( radiance_fp, n_rows, n_cols, color_format,
 	    view, exposure_set, exposure, description );
 
-    radiance_scanline = (COLOR *) malloc ( n_cols * sizeof ( COLOR ) );
-    if ( radiance_scanline == NULL ) {
-	fprintf ( stderr, "DeVAS_xyY_image_from_radfile: malloc failed!\n" );
+    radiance_image = (COLR *) malloc ( ( (size_t) n_rows ) * n_cols *
+	    sizeof ( COLR ) );
+    if ( radiance_image == NULL ) {
+	fprintf ( stderr, "DeVAS_xyY_image_to_radfile: malloc failed!\n" );
 	exit ( EXIT_FAILURE );
     }
 
+#pragma omp parallel for
     for ( row = 0; row < n_rows; row++ ) {
-	for ( col = 0; col < n_cols; col++ ) {
-	    XYZ_DeVAS_pixel =
-		DeVAS_xyY2XYZ ( DeVAS_image_data ( xyY, row,col ) );
-	    colval ( XYZ_rad_pixel, CIEX ) =
-		XYZ_DeVAS_pixel.X / DeVAS_WHTEFFICACY;
-	    colval ( XYZ_rad_pixel, CIEY ) =
-		XYZ_DeVAS_pixel.Y / DeVAS_WHTEFFICACY;
-	    colval ( XYZ_rad_pixel, CIEZ ) =
-		XYZ_DeVAS_pixel.Z / DeVAS_WHTEFFICACY;
-
-	    colortrans ( radiance_scanline[col], xyz2rgbmat, XYZ_rad_pixel );
-	}
+	xyY_to_colr_scanline ( &DeVAS_image_data ( xyY, row, 0 ), n_cols,
+		radiance_image + ( ( (size_t) row ) * n_cols ) );
+    }
 
-	if ( fwritescan ( radiance_scanline, n_cols, radiance_fp ) < 0 ) {
+    for ( row = 0; row < n_rows; row++ ) {
+	if ( fwritecolrs ( radiance_image + ( ( (size_t) row ) * n_cols ),
+		    n_cols, radiance_fp ) < 0 ) {
 	    fprintf ( stderr,
 		"DeVAS_xyY_image_to_radfile: error writing radiance file!\n" );
 	    exit ( EXIT_FAILURE );
 	}
     }
 
-    free ( radiance_scanline );
+    free ( radiance_image );
+}
+
+static void
+xyY_to_colr_scanline ( DeVAS_xyY *xyY, int n_cols, COLR *scanline )
+/*
+ * Same result as DeVAS_xyY2XYZ ( ) followed by colortrans ( ) with
+ * xyz2rgbmat and setcolr ( ), without the per-pixel function calls.
+ */
+{
+    int	    col;
+    COLORV  X, Y, Z;
+    COLORV  red, green, blue;
+
+    for ( col = 0; col < n_cols; col++ ) {
+	if ( xyY[col].y <= 0.0 ) {
+	    X = Y = Z = 0.0;
+	} else {
+	    /* rounded to float at the same points as DeVAS_xyY2XYZ ( ) */
+	    X = ( ( xyY[col].x * xyY[col].Y ) / xyY[col].y ) /
+		DeVAS_WHTEFFICACY;
+	    Y = xyY[col].Y / DeVAS_WHTEFFICACY;
+	    Z = ( (float) ( ( ( 1.0 - xyY[col].x - xyY[col].y ) *
+			    xyY[col].Y ) / xyY[col].y ) ) / DeVAS_WHTEFFICACY;
+	}
+
+	red = ( xyz2rgbmat[0][0] * X ) + ( xyz2rgbmat[0][1] * Y ) +
+	    ( xyz2rgbmat[0][2] * Z );
+	green = ( xyz2rgbmat[1][0] * X ) + ( xyz2rgbmat[1][1] * Y ) +
+	    ( xyz2rgbmat[1][2] * Z );
+	blue = ( xyz2rgbmat[2][0] * X ) + ( xyz2rgbmat[2][1] * Y ) +
+	    ( xyz2rgbmat[2][2] * Z );
+
+	setcolr ( scanline[col], red, green, blue );
+    }
+}
+
+static void
+colr_scanline_to_xyY ( COLR *scanline, int n_cols,
+	RadianceColorFormat color_format, DeVAS_xyY *xyY )
+/*
+ * Same result as freadscan ( ) followed by the per-pixel conversions
+ * previously done in DeVAS_xyY_image_from_radfile ( ).  Like freadscan ( ),
+ * runs of identical encoded pixels are only converted once.
+ */
+{
+    int			col;
+    COLOR		radiance_pixel;
+    COLOR		XYZ_rad_pixel;
+    DeVAS_XYZ		XYZ_DeVAS_pixel;
+
+    for ( col = 0; col < n_cols; col++ ) {
+	if ( ( col > 0 ) &&
+		( scanline[col][RED] == scanline[col - 1][RED] ) &&
+		( scanline[col][GRN] == scanline[col - 1][GRN] ) &&
+		( scanline[col][BLU] == scanline[col - 1][BLU] ) &&
+		( scanline[col][EXP] == scanline[col - 1][EXP] ) ) {
+	    xyY[col] = xyY[col - 1];
+	    continue;
+	}
+
+	colr_color ( radiance_pixel, scanline[col] );
+
+	if ( color_format == radcolor_rgbe ) {
+	    colortrans ( XYZ_rad_pixel, rgb2xyzmat, radiance_pixel );
+
+	    XYZ_DeVAS_pixel.X =
+		colval ( XYZ_rad_pixel, CIEX ) * DeVAS_WHTEFFICACY;
+	    XYZ_DeVAS_pixel.Y =
+		colval ( XYZ_rad_pixel, CIEY ) * DeVAS_WHTEFFICACY;
+	    XYZ_DeVAS_pixel.Z =
+		colval ( XYZ_rad_pixel, CIEZ ) * DeVAS_WHTEFFICACY;
+	} else {	/* radcolor_xyze */
+	    XYZ_DeVAS_pixel.X = colval ( radiance_pixel, CIEX );
+	    XYZ_DeVAS_pixel.Y = colval ( radiance_pixel, CIEY );
+	    XYZ_DeVAS_pixel.Z = colval ( radiance_pixel, CIEZ );
+	}
+
+	xyY[col] = DeVAS_XYZ2xyY ( XYZ_DeVAS_pixel );
+    }
 }
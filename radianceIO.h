@@ -7,6 +7,7 @@
 
 #include "devas-image.h"
 #include "radiance-header.h"
+#include "devas-autoclip.h"		/* DeVAS_luminance_stats */
 #include "devas-license.h"       /* DeVAS open source license */
 
 #ifdef __cplusplus
@@ -43,6 +44,10 @@ void		    DeVAS_XYZ_image_to_radfile ( FILE *radiance_fp,
 
 DeVAS_xyY_image	    *DeVAS_xyY_image_from_radfilename ( char *filename );
 DeVAS_xyY_image	    *DeVAS_xyY_image_from_radfile ( FILE *radiance_fp );
+DeVAS_xyY_image	    *DeVAS_xyY_image_from_radfilename_stats ( char *filename,
+			DeVAS_luminance_stats *stats );
+DeVAS_xyY_image	    *DeVAS_xyY_image_from_radfile_stats ( FILE *radiance_fp,
+			DeVAS_luminance_stats *stats );
 void		    DeVAS_xyY_image_to_radfilename ( char *filename,
 			DeVAS_xyY_image *xyY );
 void		    DeVAS_xyY_image_to_radfile ( FILE *radiance_fp,
@@ -0,0 +1,84 @@
+# Run one devas-filter or devas-visibility regression test and compare its
+# output files with the stored reference versions (see CMakeLists.txt).
+#
+#   cmake -DKIND=filter|visibility -DPROGRAM=<exe> -DCOMPARE=<exe>
+#	-DSCENE=<dir> -DOPTIONS=<space separated options>
+#	-DREFERENCE_DIR=<dir> -DWORK_DIR=<dir> -P regression.cmake
+#
+# If the environment variable DeVAS_UPDATE_REFERENCES is set, the outputs
+# are copied to REFERENCE_DIR instead of being compared.
+
+# Tolerances allow for round-off differences between compilers, platforms,
+# and numbers of threads, but not for changes in the algorithms.  Peak is
+# the largest reference value for HDR files and 255 for PNG files.
+set ( HDR_TOLERANCES
+	--pixel-tolerance=0.002 --max-differing=0.005
+	--max-abs-diff=0.02 --min-psnr=60 )
+set ( PNG_TOLERANCES
+	--pixel-tolerance=0.004 --max-differing=0.002
+	--max-abs-diff=0.25 --min-psnr=40 )
+set ( HVS_TOLERANCES --max-hvs-delta=0.002 )
+
+separate_arguments ( OPTIONS UNIX_COMMAND "${OPTIONS}" )
+
+file ( REMOVE_RECURSE ${WORK_DIR} )
+file ( MAKE_DIRECTORY ${WORK_DIR} )
+
+# run in WORK_DIR with relative file names, since the command line is
+# recorded in the header of HDR output files
+file ( RELATIVE_PATH program ${WORK_DIR} ${PROGRAM} )
+file ( RELATIVE_PATH scene ${WORK_DIR} ${SCENE} )
+
+if ( KIND STREQUAL "filter" )
+  set ( OUTPUTS filtered.hdr )
+  execute_process ( COMMAND ${program} ${OPTIONS}
+	${scene}/input.hdr filtered.hdr
+	WORKING_DIRECTORY ${WORK_DIR}
+	RESULT_VARIABLE status )
+elseif ( KIND STREQUAL "visibility" )
+  set ( OUTPUTS simulated-view.hdr hazards.png hvs.txt )
+  execute_process ( COMMAND ${program} ${OPTIONS} --printaverage
+	${scene}/input.hdr ${scene}/coordinates.txt ${scene}/xyz.txt
+	${scene}/dist.txt ${scene}/nor.txt simulated-view.hdr hazards.png
+	WORKING_DIRECTORY ${WORK_DIR}
+	OUTPUT_FILE hvs.txt
+	RESULT_VARIABLE status )
+else ( )
+  message ( FATAL_ERROR "unknown KIND (${KIND})" )
+endif ( )
+
+if ( NOT status EQUAL 0 )
+  message ( FATAL_ERROR "${PROGRAM} failed (${status})" )
+endif ( )
+
+if ( DEFINED ENV{DeVAS_UPDATE_REFERENCES} )
+  file ( MAKE_DIRECTORY ${REFERENCE_DIR} )
+  foreach ( output ${OUTPUTS} )
+    file ( COPY ${WORK_DIR}/${output} DESTINATION ${REFERENCE_DIR} )
+  endforeach ( )
+  message ( STATUS "updated ${REFERENCE_DIR}" )
+  return ( )
+endif ( )
+
+set ( failed "" )
+foreach ( output ${OUTPUTS} )
+  if ( output MATCHES "\\.hdr$" )
+    set ( tolerances ${HDR_TOLERANCES} )
+  elseif ( output MATCHES "\\.png$" )
+    set ( tolerances ${PNG_TOLERANCES} )
+  else ( )
+    set ( tolerances ${HVS_TOLERANCES} )
+  endif ( )
+
+  message ( STATUS "${output}:" )
+  execute_process ( COMMAND ${COMPARE} ${tolerances}
+	${REFERENCE_DIR}/${output} ${WORK_DIR}/${output}
+	RESULT_VARIABLE status )
+  if ( NOT status EQUAL 0 )
+    list ( APPEND failed ${output} )
+  endif ( )
+endforeach ( )
+
+if ( failed )
+  message ( FATAL_ERROR "outside tolerances: ${failed}" )
+endif ( )
@@ -5,14 +5,35 @@
 #include "devas-visibility.h"
 #include "devas-image.h"
 #include "devas-utils.h"
+#include "devas-edge-list.h"
 #include "devas-license.h"
 
 #define	SQ(x)	((x) * (x))
 
+#define	HAZARD_COLORMAP_SIZE	1024	/* hazard_level steps in colormap */
+
 static DeVAS_RGB		color_hazard_level ( double hazard_level,
 			     Visualization_type visualization_type );
-static DeVAS_gray_image	*expand_3x_i ( DeVAS_gray_image *image );
-static DeVAS_float_image	*expand_3x_f ( DeVAS_float_image *image );
+static void		make_hazard_colormap
+			     ( Visualization_type visualization_type,
+			       DeVAS_RGB *colormap );
+static DeVAS_RGB		lookup_hazard_color ( double hazard_level,
+			     DeVAS_RGB *colormap );
+static int		thicken_row ( DeVAS_float_image *hazards,
+			     DeVAS_edge_list *edges, int row, float *thickened,
+			     int *thickened_col, float *thickened_angle );
+static int		geometry_thickened ( DeVAS_gray_image *image, int row,
+			     int col );
+static void		hazard_levels ( float *visual_angle, int n_values,
+			     Measurement_type measurement_type,
+			     double scale_parameter, double *hazard_level );
+static double		hazard_score_row ( DeVAS_float_image *hazards,
+			     DeVAS_edge_list *edges, int row,
+			     DeVAS_gray_image *mask,
+			     DeVAS_gray_image *ROI,
+			     Measurement_type measurement_type,
+			     double scale_parameter, float *edge_angle,
+			     unsigned int *count );
 
 DeVAS_RGB_image *
 visualize_hazards ( DeVAS_float_image *hazards,
@@ -55,22 +76,22 @@ visualize_hazards ( DeVAS_float_image *hazards,
  * 			high likelihood that boundary is visible.
  */
 {
-    double		reciprocal_scale = -1.0;
-    			/* 1 - scale / ( visual_angle + scale ) */
-    double		max_hazard = -1.0;
-    			/* min(visual_angle,max_hazard ) / max_hazard */
-    double		Gaussian_sigma = -1.0;
-    			/* 1 - exp ( -0.5 * ( x / Gaussian_sigma ) ^ 2 ) */
     int			row, col;
-    double		hazard_level;
-    DeVAS_float_image	*hazards_thickened;
-    DeVAS_gray_image	*geometry_thickened = NULL;
+    int			n_rows, n_cols;
+    int			i;
+    DeVAS_edge_list	*edges;
+    float		*thickened;
+    int			*thickened_col;
+    float		*thickened_angle;
+    int			n_thickened;
+    double		*hazard_level;
     DeVAS_RGB_image	*visualization;
     DeVAS_RGB		black;
     DeVAS_RGBf		mask_color_f;
     DeVAS_RGB		mask_color;
     DeVAS_RGBf		geometry_color_f;
     DeVAS_RGB		geometry_color;
+    DeVAS_RGB		colormap[HAZARD_COLORMAP_SIZE + 1];
     double		sum;
     unsigned int	count;
 
@@ -100,34 +121,19 @@ visualize_hazards ( DeVAS_float_image *hazards,
 	exit ( EXIT_FAILURE );
     }
 
-    switch ( measurement_type ) {
-	case reciprocal_measure:
-	    reciprocal_scale = scale_parameter;
-	    break;
-
-	case linear_measure:
-	    max_hazard = scale_parameter;
-	    break;
-
-	case Gaussian_measure:
-	    Gaussian_sigma = scale_parameter;
-	    break;
-
-	default:
-	    fprintf ( stderr,
-		    "visualize_hazards: invalid measurement_type!\n" );
-	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
-	    exit ( EXIT_FAILURE );
+    if ( ( measurement_type != reciprocal_measure ) &&
+	    ( measurement_type != linear_measure ) &&
+	    ( measurement_type != Gaussian_measure ) ) {
+	fprintf ( stderr,
+		"visualize_hazards: invalid measurement_type!\n" );
+	DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	exit ( EXIT_FAILURE );
     }
 
-    /* make things easier to see */
-    hazards_thickened = expand_3x_f ( hazards );
-    if ( geometry_boundaries != NULL ) {
-	geometry_thickened = expand_3x_i ( *geometry_boundaries );
-    }
+    n_rows = DeVAS_image_n_rows ( hazards );
+    n_cols = DeVAS_image_n_cols ( hazards );
 
-    visualization = DeVAS_RGB_image_new ( DeVAS_image_n_rows ( hazards ),
-	    DeVAS_image_n_cols ( hazards ) );
+    visualization = DeVAS_RGB_image_new ( n_rows, n_cols );
 
     black.red = black.green = black.blue = 0;
 
@@ -147,130 +153,106 @@ visualize_hazards ( DeVAS_float_image *hazards,
 	geometry_color = RGBf_to_RGB ( geometry_color_f );
     }
 
-    for ( row = 0; row < DeVAS_image_n_rows ( hazards ); row++ ) {
-	for ( col = 0; col < DeVAS_image_n_cols ( hazards ); col++ ) {
-
-	    if ( ( ROI != NULL ) && ! DeVAS_image_data ( ROI, row, col ) ) {
-		DeVAS_image_data ( visualization, row, col ) = black;
-		continue;
-	    }
-
-	    if ( ( mask != NULL ) && ( DeVAS_image_data ( mask, row, col ) ) ) {
-		if ( ( geometry_boundaries != NULL ) &&
-		      ( DeVAS_image_data ( geometry_thickened, row, col ) ) ) {
-		    DeVAS_image_data ( visualization, row, col ) =
-			geometry_color;
-		} else {
-		    DeVAS_image_data ( visualization, row, col ) = mask_color;
-		}
-		continue;
-	    }
-
-	    if ( DeVAS_image_data ( hazards_thickened, row, col ) >= 0.0 ) {
-		/* geometry edge that should be color coded */
-
-		switch ( measurement_type ) {
-
-		    case reciprocal_measure:
-			hazard_level = 1.0 - ( reciprocal_scale /
-			    ( DeVAS_image_data ( hazards_thickened, row, col ) +
-				  reciprocal_scale ) );
-			break;
+    make_hazard_colormap ( visualization_type, colormap );
+
+    /*
+     * Hazards are only defined on boundary elements, which are a small
+     * fraction of the image.  Everything except the mask is computed
+     * from a list of their locations, rather than by scanning the image.
+     */
+    edges = DeVAS_edge_list_from_float_image ( hazards );
+
+    /*
+     * Single pass over the image.  Hazard and geometry markings are
+     * thickened to 3x3 (to make things easier to see) as each row is
+     * colored, and the hazard visibility score is accumulated from the
+     * unthickened values at the same time.
+     */
+    sum = 0.0;
+    count = 0;
+
+#pragma omp parallel private ( row, col, i, thickened, thickened_col, \
+	thickened_angle, n_thickened, hazard_level ) \
+	reduction ( + : sum, count )
+    {
+	thickened = (float *) malloc ( n_cols * sizeof ( float ) );
+	thickened_col = (int *) malloc ( n_cols * sizeof ( int ) );
+	thickened_angle = (float *) malloc ( n_cols * sizeof ( float ) );
+	hazard_level = (double *) malloc ( n_cols * sizeof ( double ) );
+	if ( ( thickened == NULL ) || ( thickened_col == NULL ) ||
+		( thickened_angle == NULL ) || ( hazard_level == NULL ) ) {
+	    fprintf ( stderr, "visualize_hazards: malloc failed!\n" );
+	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	    exit ( EXIT_FAILURE );
+	}
 
-		    case linear_measure:
-			hazard_level =
-			    fmin ( DeVAS_image_data ( hazards_thickened, row,
-					col ), max_hazard ) / max_hazard;
-			break;
+	for ( col = 0; col < n_cols; col++ ) {
+	    thickened[col] = HAZARD_NO_EDGE;
+	}
 
-		    case Gaussian_measure:
-			hazard_level = 1.0 -
-			    exp ( -0.5 *
-				    ( SQ ( DeVAS_image_data ( hazards_thickened,
-					    row, col ) / Gaussian_sigma ) ) );
-			break;
+#pragma omp for
+	for ( row = 0; row < n_rows; row++ ) {
 
-		    default:
-			fprintf ( stderr,
-				"visualize_hazards: internal error!\n" );
-	    		DeVAS_print_file_lineno ( __FILE__, __LINE__ );
-			exit ( EXIT_FAILURE );
+	    /* not a geometry edge, or outside the ROI */
+	    for ( col = 0; col < n_cols; col++ ) {
+		DeVAS_image_data ( visualization, row, col ) = black;
+	    }
 
+	    if ( mask != NULL ) {
+		for ( col = 0; col < n_cols; col++ ) {
+		    if ( ( ( ROI != NULL ) &&
+				! DeVAS_image_data ( ROI, row, col ) ) ||
+			    ! DeVAS_image_data ( mask, row, col ) ) {
+			continue;
+		    }
+		    if ( ( geometry_boundaries != NULL ) &&
+			    geometry_thickened ( *geometry_boundaries, row,
+				col ) ) {
+			DeVAS_image_data ( visualization, row, col ) =
+			    geometry_color;
+		    } else {
+			DeVAS_image_data ( visualization, row, col ) =
+			    mask_color;
+		    }
 		}
-
-		DeVAS_image_data ( visualization, row, col ) =
-		    color_hazard_level ( hazard_level, visualization_type );
-
-	    } else {
-		/* not a  geometry edge */
-
-		DeVAS_image_data ( visualization, row, col ) = black;
 	    }
 
-	}
-    }
+	    /* geometry edges that should be color coded */
+	    n_thickened = thicken_row ( hazards, edges, row, thickened,
+		    thickened_col, thickened_angle );
+	    hazard_levels ( thickened_angle, n_thickened, measurement_type,
+		    scale_parameter, hazard_level );
 
-    if ( hazard_average != NULL ) {
-	/*
-	 * Need to do this separately since we don't want the thickened values.
-	 */
-
-	sum = 0.0;
-	count = 0;
-	for ( row = 0; row < DeVAS_image_n_rows ( hazards ); row++ ) {
-	    for ( col = 0; col < DeVAS_image_n_cols ( hazards ); col++ ) {
-		if ( ( DeVAS_image_data ( hazards, row, col ) ==
-			    HAZARD_NO_EDGE ) ||
+	    for ( i = 0; i < n_thickened; i++ ) {
+		col = thickened_col[i];
+		if ( ( ( ROI != NULL ) &&
+			    ! DeVAS_image_data ( ROI, row, col ) ) ||
 			( ( mask != NULL ) &&
-			  ( DeVAS_image_data ( mask, row, col ) ) ) ||
-			( ( ROI != NULL ) &&
-			  ( ! DeVAS_image_data ( ROI, row, col ) ) ) ) {
+			  DeVAS_image_data ( mask, row, col ) ) ) {
 		    continue;
 		}
+		DeVAS_image_data ( visualization, row, col ) =
+		    lookup_hazard_color ( hazard_level[i], colormap );
+	    }
 
-		/*
-		 * For Hazard Visibility Score, high values are good, low
-		 * values are bad.  (This is opposite the conventions for
-		 * hazard visualization.)
-		 */
-
-		switch ( measurement_type ) {
-
-		    case reciprocal_measure:
-			sum += reciprocal_scale /
-			    ( DeVAS_image_data ( hazards, row, col ) +
-			      reciprocal_scale );
-			break;
-
-		    case linear_measure:
-			sum +=
-			    1.0 - ( fmin ( DeVAS_image_data ( hazards, row,
-					    col ), max_hazard ) / max_hazard );
-			break;
-
-		    case Gaussian_measure:
-			sum +=
-			    exp ( -0.5 * ( SQ ( DeVAS_image_data ( hazards,
-					    row, col ) / Gaussian_sigma ) ) );
-			break;
-
-		    default:
-			fprintf ( stderr,
-				"visualize_hazards: internal error!\n" );
-			DeVAS_print_file_lineno ( __FILE__, __LINE__ );
-
-		}
-
-		count++;
+	    if ( hazard_average != NULL ) {
+		/* thickened_angle is no longer needed for this row */
+		sum += hazard_score_row ( hazards, edges, row, mask, ROI,
+			measurement_type, scale_parameter, thickened_angle,
+			&count );
 	    }
 	}
 
-	*hazard_average = sum / (double) count;
+	free ( thickened );
+	free ( thickened_col );
+	free ( thickened_angle );
+	free ( hazard_level );
     }
 
-    DeVAS_float_image_delete ( hazards_thickened );
-    if ( geometry_thickened != NULL ) {
-	DeVAS_gray_image_delete ( geometry_thickened );
+    DeVAS_edge_list_delete ( edges );
+
+    if ( hazard_average != NULL ) {
+	*hazard_average = sum / (double) count;
     }
 
     return ( visualization );
@@ -337,90 +319,224 @@ color_hazard_level ( double hazard_level,
     return ( vis_color );
 }
 
-static DeVAS_float_image *
-expand_3x_f ( DeVAS_float_image *image )
+static void
+make_hazard_colormap ( Visualization_type visualization_type,
+	DeVAS_RGB *colormap )
 /*
- * 3x increase in size to make markings more visible.
+ * Tabulate color_hazard_level ( ) at HAZARD_COLORMAP_SIZE + 1 evenly
+ * spaced hazard levels in [0.0 - 1.0].  The color components change by
+ * at most 255 over the full range, so nearest entry lookup is within 1
+ * of computing the color directly.
  */
 {
-    int			n_rows, n_cols;
-    int			row, col;
-    int			i, j;
-    float		local_max;
-    DeVAS_float_image	*new_image;
-
-    n_rows = DeVAS_image_n_rows ( image );
-    n_cols = DeVAS_image_n_cols ( image );
+    int	    i;
 
-    new_image = DeVAS_float_image_new ( n_rows, n_cols );
+    for ( i = 0; i <= HAZARD_COLORMAP_SIZE; i++ ) {
+	colormap[i] = color_hazard_level ( ((double) i ) /
+		((double) HAZARD_COLORMAP_SIZE ), visualization_type );
+    }
+}
 
-    for ( row = 0; row < n_rows; row++ ) {
-	DeVAS_image_data ( new_image, row, 0 ) = HAZARD_NO_EDGE;
-	DeVAS_image_data ( new_image, row, n_cols - 1 ) = HAZARD_NO_EDGE;
+static DeVAS_RGB
+lookup_hazard_color ( double hazard_level, DeVAS_RGB *colormap )
+{
+    if ( hazard_level >= 1.0 ) {
+	return ( colormap[HAZARD_COLORMAP_SIZE] );
+    } else if ( hazard_level > 0.0 ) {
+	return ( colormap[(int) ( ( hazard_level * HAZARD_COLORMAP_SIZE ) +
+		    0.5 )] );
+    } else {
+	return ( colormap[0] );
     }
+}
 
-    for ( col = 1; col < n_cols - 1; col++ ) {
-	DeVAS_image_data ( new_image, 0, col ) = HAZARD_NO_EDGE;
-	DeVAS_image_data ( new_image, n_rows - 1, col ) = HAZARD_NO_EDGE;
+static int
+thicken_row ( DeVAS_float_image *hazards, DeVAS_edge_list *edges, int row,
+	float *thickened, int *thickened_col, float *thickened_angle )
+/*
+ * Compute one row of the 3x3 local maximum of hazards, to make markings
+ * more visible.  Pixels on the image border are left unmarked.  Only the
+ * neighborhoods of edges in rows row-1 .. row+1 are visited.
+ *
+ * Returns the number of marked pixels in the row, with their columns in
+ * thickened_col and their values in thickened_angle.  thickened is
+ * scratch space for one row, which must be HAZARD_NO_EDGE on entry and
+ * is restored to HAZARD_NO_EDGE on return.
+ */
+{
+    int	    n_rows, n_cols;
+    int	    edge_row, edge_col;
+    int	    col, first_col, last_col;
+    int	    i;
+    int	    n_thickened;
+    float   value;
+
+    n_rows = DeVAS_image_n_rows ( hazards );
+    n_cols = DeVAS_image_n_cols ( hazards );
+
+    if ( ( row == 0 ) || ( row == n_rows - 1 ) ) {
+	return ( 0 );
     }
 
-    for ( row = 1; row < DeVAS_image_n_rows ( image ) - 1; row++ ) {
-	for ( col = 1; col < DeVAS_image_n_cols ( image ) - 1; col++ ) {
-	    local_max = HAZARD_NO_EDGE;
-	    for ( i = -1; i <= 1; i++ ) {
-		for ( j = -1; j <= 1; j++ ) {
-		    local_max = fmax ( local_max,
-			    DeVAS_image_data ( image, row+i, col+j ) );
+    n_thickened = 0;
+    for ( edge_row = row - 1; edge_row <= row + 1; edge_row++ ) {
+	for ( i = DeVAS_edge_list_row_start ( edges, edge_row );
+		i < DeVAS_edge_list_row_end ( edges, edge_row ); i++ ) {
+	    edge_col = DeVAS_edge_list_col ( edges, i );
+	    value = DeVAS_image_data ( hazards, edge_row, edge_col );
+
+	    first_col = ( edge_col > 1 ) ? edge_col - 1 : 1;
+	    last_col = ( edge_col < n_cols - 2 ) ? edge_col + 1 : n_cols - 2;
+	    for ( col = first_col; col <= last_col; col++ ) {
+		if ( thickened[col] < 0.0 ) {
+		    thickened_col[n_thickened++] = col;
+		    thickened[col] = value;
+		} else {
+		    thickened[col] = fmax ( thickened[col], value );
 		}
 	    }
+	}
+    }
+
+    for ( i = 0; i < n_thickened; i++ ) {
+	thickened_angle[i] = thickened[thickened_col[i]];
+	thickened[thickened_col[i]] = HAZARD_NO_EDGE;
+    }
+
+    return ( n_thickened );
+}
+
+static int
+geometry_thickened ( DeVAS_gray_image *image, int row, int col )
+/*
+ * 3x3 local maximum of image at [row][col], to make markings more visible.
+ * Pixels on the image border are HAZARD_NO_EDGE_GRAY.
+ */
+{
+    int	    i, j;
+    int	    local_max;
 
-	    DeVAS_image_data ( new_image, row, col ) = local_max;
+    if ( ( row == 0 ) || ( row == DeVAS_image_n_rows ( image ) - 1 ) ||
+	    ( col == 0 ) || ( col == DeVAS_image_n_cols ( image ) - 1 ) ) {
+	return ( HAZARD_NO_EDGE_GRAY );
+    }
+
+    local_max = HAZARD_NO_EDGE_GRAY;
+    for ( i = -1; i <= 1; i++ ) {
+	for ( j = -1; j <= 1; j++ ) {
+	    local_max = imax ( local_max,
+		    DeVAS_image_data ( image, row+i, col+j ) );
 	}
     }
 
-    return ( new_image );
+    return ( local_max );
 }
 
-static DeVAS_gray_image *
-expand_3x_i ( DeVAS_gray_image *image )
+static void
+hazard_levels ( float *visual_angle, int n_values,
+	Measurement_type measurement_type, double scale_parameter,
+	double *hazard_level )
 /*
- * 3x increase in size to make markings more visible.
+ * Convert a list of visual angles to hazard levels (in range [0.0 - 1.0])
+ * for display.  Each measurement type has its own loop so that the
+ * dispatch is done once per row rather than once per pixel.
  */
 {
-    int			n_rows, n_cols;
-    int			row, col;
-    int			i, j;
-    float		local_max;
-    DeVAS_gray_image	*new_image;
+    int	    i;
 
-    n_rows = DeVAS_image_n_rows ( image );
-    n_cols = DeVAS_image_n_cols ( image );
+    switch ( measurement_type ) {
 
-    new_image = DeVAS_gray_image_new ( n_rows, n_cols );
+	case reciprocal_measure:
+	    for ( i = 0; i < n_values; i++ ) {
+		hazard_level[i] = 1.0 - ( scale_parameter /
+			( visual_angle[i] + scale_parameter ) );
+	    }
+	    break;
 
-    for ( row = 0; row < n_rows; row++ ) {
-	DeVAS_image_data ( new_image, row, 0 ) = HAZARD_NO_EDGE_GRAY;
-	DeVAS_image_data ( new_image, row, n_cols - 1 ) = HAZARD_NO_EDGE_GRAY;
+	case linear_measure:
+	    for ( i = 0; i < n_values; i++ ) {
+		hazard_level[i] = fmin ( visual_angle[i], scale_parameter ) /
+		    scale_parameter;
+	    }
+	    break;
+
+	case Gaussian_measure:
+	    for ( i = 0; i < n_values; i++ ) {
+		hazard_level[i] = 1.0 - exp ( -0.5 *
+			( SQ ( visual_angle[i] / scale_parameter ) ) );
+	    }
+	    break;
+
+	default:
+	    fprintf ( stderr, "visualize_hazards: internal error!\n" );
+	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	    exit ( EXIT_FAILURE );
     }
+}
 
-    for ( col = 1; col < n_cols - 1; col++ ) {
-	DeVAS_image_data ( new_image, 0, col ) = HAZARD_NO_EDGE_GRAY;
-	DeVAS_image_data ( new_image, n_rows - 1, col ) = HAZARD_NO_EDGE_GRAY;
+static double
+hazard_score_row ( DeVAS_float_image *hazards, DeVAS_edge_list *edges,
+	int row, DeVAS_gray_image *mask, DeVAS_gray_image *ROI,
+	Measurement_type measurement_type, double scale_parameter,
+	float *edge_angle, unsigned int *count )
+/*
+ * Sum of hazard visibility scores over the geometry boundary elements in
+ * one row, excluding masked pixels and pixels outside the ROI.  count is
+ * incremented by the number of elements included.  Uses unthickened
+ * values.  edge_angle is scratch space for one row.
+ *
+ * For Hazard Visibility Score, high values are good, low values are bad.
+ * (This is opposite the conventions for hazard visualization.)
+ */
+{
+    int	    col;
+    int	    n_edges;
+    int	    i;
+    double  sum;
+
+    /* collect the elements to be scored */
+    n_edges = 0;
+    for ( i = DeVAS_edge_list_row_start ( edges, row );
+	    i < DeVAS_edge_list_row_end ( edges, row ); i++ ) {
+	col = DeVAS_edge_list_col ( edges, i );
+	if ( ( ( mask != NULL ) && ( DeVAS_image_data ( mask, row, col ) ) )
+		|| ( ( ROI != NULL ) &&
+		    ( ! DeVAS_image_data ( ROI, row, col ) ) ) ) {
+	    continue;
+	}
+	edge_angle[n_edges++] = DeVAS_image_data ( hazards, row, col );
     }
 
-    for ( row = 1; row < DeVAS_image_n_rows ( image ) - 1; row++ ) {
-	for ( col = 1; col < DeVAS_image_n_cols ( image ) - 1; col++ ) {
-	    local_max = HAZARD_NO_EDGE_GRAY;
-	    for ( i = -1; i <= 1; i++ ) {
-		for ( j = -1; j <= 1; j++ ) {
-		    local_max = imax ( local_max,
-			    DeVAS_image_data ( image, row+i, col+j ) );
-		}
+    sum = 0.0;
+
+    switch ( measurement_type ) {
+
+	case reciprocal_measure:
+	    for ( i = 0; i < n_edges; i++ ) {
+		sum += scale_parameter / ( edge_angle[i] + scale_parameter );
 	    }
+	    break;
 
-	    DeVAS_image_data ( new_image, row, col ) = local_max;
-	}
+	case linear_measure:
+	    for ( i = 0; i < n_edges; i++ ) {
+		sum += 1.0 - ( fmin ( edge_angle[i], scale_parameter ) /
+			scale_parameter );
+	    }
+	    break;
+
+	case Gaussian_measure:
+	    for ( i = 0; i < n_edges; i++ ) {
+		sum += exp ( -0.5 * ( SQ ( edge_angle[i] / scale_parameter ) ) );
+	    }
+	    break;
+
+	default:
+	    fprintf ( stderr, "visualize_hazards: internal error!\n" );
+	    DeVAS_print_file_lineno ( __FILE__, __LINE__ );
+	    exit ( EXIT_FAILURE );
     }
 
-    return ( new_image );
+    *count += n_edges;
+
+    return ( sum );
 }